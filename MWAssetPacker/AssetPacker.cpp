@@ -0,0 +1,129 @@
+/*
+* File:		AssetPacker.cpp
+* Author:	Keegan MacDonald (keeganm742@gmail.com)
+* Created:	2026.10.16
+*/
+
+#include "AssetPacker.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+bool AssetPacker::run(const AssetPackerSettings& settings) {
+	m_fileNames.clear();
+	for (const std::string& path : settings.paths) {
+		addFiles(path);
+	}
+	if (m_fileNames.empty()) {
+		std::cout << "No PNG, WAV, FLAC, Ogg Vorbis or TTF files found"
+			<< std::endl;
+		return false;
+	}
+	// Pack the files in a stable order so the same assets always make the
+	// same pack
+	std::sort(m_fileNames.begin(), m_fileNames.end());
+	m_fileNames.erase(std::unique(m_fileNames.begin(), m_fileNames.end()),
+		m_fileNames.end());
+
+	// Decode the resources on this thread, no OpenGL or OpenAL context is
+	// needed since nothing is uploaded
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+	MW::RESOURCES.init(0);
+	bool written = MW::RESOURCES.buildPack(settings.packFileName,
+		m_fileNames, settings.fontPointSizes);
+	MW::RESOURCES.destroy();
+	double time = std::chrono::duration<double>(Clock::now() - start).count();
+
+	if (!written) {
+		std::cout << "Failed to write " << settings.packFileName << std::endl;
+		return false;
+	}
+	std::cout << "Packed " << m_fileNames.size() << " files into "
+		<< settings.packFileName << " in " << (int)(time * 1000.0) << " ms"
+		<< std::endl;
+	return true;
+}
+
+void AssetPacker::addFiles(const std::string& path) {
+	std::error_code error;
+	if (std::filesystem::is_directory(path, error)) {
+		for (const std::filesystem::directory_entry& entry
+			: std::filesystem::recursive_directory_iterator(path, error)) {
+			// Match extensions in any case, as ResourceManager::buildPack()
+			// does when it decodes the files
+			std::string extension = entry.path().extension().string();
+			std::transform(extension.begin(), extension.end(),
+				extension.begin(), [](char c) { return (char)std::tolower(c); });
+			if (entry.is_regular_file(error) && (extension == ".png"
+				|| extension == ".wav" || extension == ".flac"
+				|| extension == ".ogg" || extension == ".ttf")) {
+				addFiles(entry.path().generic_string());
+			}
+		}
+		return;
+	}
+
+	// Name the resource with forward slashes, as the game loads it
+	m_fileNames.push_back(std::filesystem::path(path).generic_string());
+}
+
+/*
+* Print the command line options of the packer
+*/
+static void printUsage() {
+	std::cout << "Usage: MWAssetPacker [options] <pack file> "
+		<< "<PNG, WAV, FLAC, Ogg and TTF files or directories>" << std::endl
+		<< "  --font-sizes N,N  Point sizes to pack each font at (48)"
+		<< std::endl
+		<< "Run from the game's directory so the files are named as the "
+		<< "game loads them" << std::endl;
+}
+
+int main(int argc, char** argv) {
+	AssetPackerSettings settings;
+	std::vector<std::string> arguments;
+	for (int i = 1; i < argc; i++) {
+		std::string option = argv[i];
+		if (option.rfind("--", 0) != 0) {
+			arguments.push_back(option);
+			continue;
+		}
+		if (i + 1 >= argc) {
+			printUsage();
+			return -1;
+		}
+		std::string value = argv[++i];
+		try {
+			if (option == "--font-sizes") {
+				settings.fontPointSizes.clear();
+				std::stringstream sizes(value);
+				std::string size;
+				while (std::getline(sizes, size, ',')) {
+					settings.fontPointSizes.push_back(std::stoul(size));
+				}
+			}
+			else {
+				printUsage();
+				return -1;
+			}
+		}
+		catch (std::exception&) {
+			printUsage();
+			return -1;
+		}
+	}
+	if (arguments.size() < 2) {
+		printUsage();
+		return -1;
+	}
+	settings.packFileName = arguments[0];
+	settings.paths.assign(arguments.begin() + 1, arguments.end());
+
+	AssetPacker packer;
+	return packer.run(settings) ? 0 : -1;
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+/*
+* File:		AssetPacker.h
+* Author:	Keegan MacDonald (keeganm742@gmail.com)
+* Created:	2026.10.16
+*/
+
+#ifndef ASSET_PACKER_H
+#define ASSET_PACKER_H
+
+#include <Milkweed/MW.h>
+
+using namespace Milkweed;
+
+/*
+* The settings of the asset packer, read from the command line
+*/
+struct AssetPackerSettings {
+	// The file name to write the pack to
+	std::string packFileName;
+	// The resource files, or directories searched for resource files, to pack
+	std::vector<std::string> paths;
+	// The point sizes to pack each font at
+	std::vector<unsigned int> fontPointSizes = { 48 };
+};
+
+/*
+* Packs a game's textures, sounds and fonts into an asset pack its
+* ResourceManager can mount in place of the loose files
+*/
+class AssetPacker {
+public:
+	/*
+	* Decode every resource file found and write them into a pack
+	*
+	* @param settings: The settings of the packer
+	* @return Whether any files were found and the pack was written
+	*/
+	bool run(const AssetPackerSettings& settings);
+
+private:
+	// The file names of the resources to pack
+	std::vector<std::string> m_fileNames;
+
+	/*
+	* Add a resource file, or every resource file under a directory
+	*/
+	void addFiles(const std::string& path);
+};
+
+#endif
\ No newline at end of file
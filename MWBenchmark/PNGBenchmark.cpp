@@ -0,0 +1,185 @@
+/*
+* File:		PNGBenchmark.cpp
+* Author:	Keegan MacDonald (keeganm742@gmail.com)
+* Created:	2026.10.16
+*/
+
+#include "PNGBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+
+/*
+* The decodePNG function is found in picoPNG.cpp, which is built into the
+* Milkweed library
+*/
+extern int decodePNG(std::vector<unsigned char>& out_image,
+	unsigned long& image_width, unsigned long& image_height,
+	const unsigned char* in_png, size_t in_size, bool convert_to_rgba32 = true);
+
+bool PNGBenchmark::run(const PNGBenchmarkSettings& settings) {
+	m_files.clear();
+	for (const std::string& path : settings.paths) {
+		addFiles(path);
+	}
+	if (m_files.empty()) {
+		std::cout << "No PNG files found" << std::endl;
+		return false;
+	}
+
+	// Decode every file once with each decoder, checking they agree and
+	// sizing the PNGDecoder's output buffer for the largest image
+	PNGDecoder decoder;
+	size_t compressedBytes = 0, pixelBytes = 0, largest = 0;
+	unsigned int failures = 0, differences = 0;
+	for (const PNGFile& file : m_files) {
+		compressedBytes += file.data.size();
+		std::vector<unsigned char> picoPixels, pixels;
+		unsigned long width = 0, height = 0;
+		int picoStatus = decodePNG(picoPixels, width, height,
+			file.data.data(), file.data.size());
+		glm::ivec2 dimensions;
+		if (!decoder.decode(file.data.data(), file.data.size(), pixels,
+			dimensions)) {
+			std::cout << "  " << file.path << ": PNGDecoder failed, "
+				<< decoder.getError() << std::endl;
+			failures++;
+			continue;
+		}
+		pixelBytes += pixels.size();
+		largest = std::max(largest, pixels.size());
+		if (picoStatus != 0) {
+			std::cout << "  " << file.path << ": picoPNG failed with error "
+				<< picoStatus << std::endl;
+		}
+		else if (picoPixels != pixels) {
+			std::cout << "  " << file.path << ": the decoders' pixels differ"
+				<< std::endl;
+			differences++;
+		}
+	}
+
+	// Time each decoder, picoPNG allocating its output each time as the
+	// texture loader did and the PNGDecoder writing into one buffer
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+	for (unsigned int i = 0; i < settings.iterations; i++) {
+		for (const PNGFile& file : m_files) {
+			std::vector<unsigned char> pixels;
+			unsigned long width = 0, height = 0;
+			decodePNG(pixels, width, height, file.data.data(),
+				file.data.size());
+		}
+	}
+	double picoTime = std::chrono::duration<double>(Clock::now()
+		- start).count();
+
+	std::vector<unsigned char> buffer(largest);
+	start = Clock::now();
+	for (unsigned int i = 0; i < settings.iterations; i++) {
+		for (const PNGFile& file : m_files) {
+			decoder.decode(file.data.data(), file.data.size(), buffer.data(),
+				buffer.size());
+		}
+	}
+	double decoderTime = std::chrono::duration<double>(Clock::now()
+		- start).count();
+
+	double passes = (double)std::max(settings.iterations, 1u);
+	double megabytes = (double)pixelBytes / (1024.0 * 1024.0);
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "Decoded " << m_files.size() << " PNG files ("
+		<< compressedBytes / 1024 << " KB compressed, " << megabytes
+		<< " MB of pixels) " << settings.iterations << " times"
+		<< std::endl;
+	std::cout << "  picoPNG:    " << picoTime * 1000.0 / passes
+		<< " ms per pass, " << megabytes * passes / picoTime << " MB/s"
+		<< std::endl;
+	std::cout << "  PNGDecoder: " << decoderTime * 1000.0 / passes
+		<< " ms per pass, " << megabytes * passes / decoderTime << " MB/s"
+		<< std::endl;
+	std::cout << "  Speedup: " << picoTime / decoderTime << "x" << std::endl;
+	if (failures > 0 || differences > 0) {
+		std::cout << "  " << failures << " files failed to decode, "
+			<< differences << " decoded differently" << std::endl;
+	}
+
+	return failures == 0;
+}
+
+void PNGBenchmark::addFiles(const std::string& path) {
+	std::error_code error;
+	if (std::filesystem::is_directory(path, error)) {
+		for (const std::filesystem::directory_entry& entry
+			: std::filesystem::recursive_directory_iterator(path, error)) {
+			if (entry.is_regular_file(error)
+				&& entry.path().extension() == ".png") {
+				addFiles(entry.path().string());
+			}
+		}
+		return;
+	}
+
+	std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (file.fail()) {
+		std::cout << "Could not open " << path << std::endl;
+		return;
+	}
+	PNGFile png;
+	png.path = path;
+	png.data.resize((size_t)file.tellg());
+	file.seekg(0, std::ios::beg);
+	file.read((char*)png.data.data(), png.data.size());
+	m_files.push_back(std::move(png));
+}
+
+/*
+* Print the command line options of the benchmark
+*/
+static void printUsage() {
+	PNGBenchmarkSettings defaults;
+	std::cout << "Usage: MWBenchmark [options] [PNG files or directories]"
+		<< std::endl
+		<< "  --iterations N  Times each file is decoded ("
+		<< defaults.iterations << ")" << std::endl
+		<< "Decodes the test client's textures if no files are given"
+		<< std::endl;
+}
+
+int main(int argc, char** argv) {
+	PNGBenchmarkSettings settings;
+	for (int i = 1; i < argc; i++) {
+		std::string option = argv[i];
+		if (option.rfind("--", 0) != 0) {
+			settings.paths.push_back(option);
+			continue;
+		}
+		if (i + 1 >= argc) {
+			printUsage();
+			return -1;
+		}
+		std::string value = argv[++i];
+		try {
+			if (option == "--iterations") {
+				settings.iterations = std::stoul(value);
+			}
+			else {
+				printUsage();
+				return -1;
+			}
+		}
+		catch (std::exception&) {
+			printUsage();
+			return -1;
+		}
+	}
+	if (settings.paths.empty()) {
+		settings.paths.push_back("../MWTestClient/Assets/texture/");
+	}
+
+	PNGBenchmark benchmark;
+	return benchmark.run(settings) ? 0 : -1;
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+/*
+* File:		PNGBenchmark.h
+* Author:	Keegan MacDonald (keeganm742@gmail.com)
+* Created:	2026.10.16
+*/
+
+#ifndef PNG_BENCHMARK_H
+#define PNG_BENCHMARK_H
+
+#include <Milkweed/MW.h>
+
+using namespace Milkweed;
+
+/*
+* The settings of a PNG decoding benchmark, read from the command line
+*/
+struct PNGBenchmarkSettings {
+	// The PNG files, or directories searched for PNG files, to decode
+	std::vector<std::string> paths;
+	// The number of times each file is decoded by each decoder
+	unsigned int iterations = 20;
+};
+
+/*
+* Times picoPNG and the PNGDecoder decoding the same set of PNG files, and
+* checks that they decode each file to the same pixels
+*/
+class PNGBenchmark {
+public:
+	/*
+	* Run the benchmark and print its report
+	*
+	* @param settings: The settings of the benchmark
+	* @return Whether any files were found and the PNGDecoder decoded all of
+	* them
+	*/
+	bool run(const PNGBenchmarkSettings& settings);
+
+private:
+	/*
+	* A PNG file read into memory
+	*/
+	struct PNGFile {
+		// The path of the file
+		std::string path;
+		// The contents of the file
+		std::vector<unsigned char> data;
+	};
+
+	// The files being decoded
+	std::vector<PNGFile> m_files;
+
+	/*
+	* Read a PNG file, or every PNG file under a directory, into memory
+	*/
+	void addFiles(const std::string& path);
+};
+
+#endif
\ No newline at end of file
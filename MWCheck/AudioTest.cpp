@@ -0,0 +1,306 @@
+/*
+* File:		AudioTest.cpp
+* Author:	Keegan MacDonald (keeganm742@gmail.com)
+* Created:	2026.10.16
+*/
+
+#include "AudioTest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+// The size of each read from a stream in frames, an odd size so reads end
+// part way through the decoders' blocks
+#define READ_FRAMES 1000
+// The time the music source must stay stopped for the track to count as
+// finished, longer than the audio manager takes to restart a starved source
+#define STOPPED_MILLISECONDS 200
+// The time a track is given to play past its length before it fails
+#define PLAYBACK_MARGIN_SECONDS 5.0
+
+bool AudioTest::run(const AudioTestSettings& settings) {
+	// Find the compressed sounds, the WAVE files are their references
+	std::vector<std::string> fileNames;
+	std::error_code error;
+	for (const std::filesystem::directory_entry& entry
+		: std::filesystem::directory_iterator(settings.path, error)) {
+		std::string extension = entry.path().extension().string();
+		if (entry.is_regular_file(error)
+			&& (extension == ".flac" || extension == ".ogg")) {
+			fileNames.push_back(entry.path().generic_string());
+		}
+	}
+	std::sort(fileNames.begin(), fileNames.end());
+	if (fileNames.empty()) {
+		std::cout << "No FLAC or Ogg Vorbis files in " << settings.path
+			<< std::endl;
+		return false;
+	}
+
+	unsigned int failures = 0;
+	std::vector<double> lengths(fileNames.size(), 0.0);
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "Decoding " << fileNames.size() << " sounds" << std::endl;
+	for (size_t i = 0; i < fileNames.size(); i++) {
+		DecodedSound sound;
+		if (!checkDecoding(settings, fileNames[i], sound)) {
+			failures++;
+		}
+		lengths[i] = sound.frameSize > 0 ? sound.getLength() : 0.0;
+	}
+
+	if (settings.play) {
+		// OpenAL Soft reads its backend from the environment when the device
+		// is opened
+		if (settings.driver != "default") {
+#ifdef _WIN32
+			_putenv_s("ALSOFT_DRIVERS", settings.driver.c_str());
+#else
+			setenv("ALSOFT_DRIVERS", settings.driver.c_str(), 1);
+#endif
+		}
+		std::cout << "Playing " << fileNames.size() << " sounds through the "
+			<< settings.driver << " OpenAL backend" << std::endl;
+		if (!AudioManager::getInstance().init()) {
+			std::cout << "  Could not open the audio device" << std::endl;
+			return false;
+		}
+		for (size_t i = 0; i < fileNames.size(); i++) {
+			if (!checkPlayback(fileNames[i], lengths[i])) {
+				failures++;
+			}
+		}
+		AudioManager::getInstance().destroy();
+	}
+
+	std::cout << (failures == 0 ? "Every sound decoded and played correctly"
+		: "FAILED") << std::endl;
+	return failures == 0;
+}
+
+bool AudioTest::decode(const std::string& fileName, DecodedSound& sound) {
+	std::unique_ptr<AudioStream> stream = AudioStream::open(fileName);
+	if (stream == nullptr) {
+		std::cout << "  " << fileName << ": could not be opened" << std::endl;
+		return false;
+	}
+	sound.format = stream->getFormat();
+	sound.sampleRate = stream->getSampleRate();
+	sound.frameSize = stream->getFrameSize();
+
+	// Read the stream a chunk at a time as the audio manager does, twice
+	std::vector<unsigned char> chunk((size_t)READ_FRAMES * sound.frameSize);
+	std::vector<unsigned char> passes[2];
+	for (unsigned int pass = 0; pass < 2; pass++) {
+		if (pass > 0 && !stream->rewind()) {
+			std::cout << "  " << fileName << ": could not be rewound"
+				<< std::endl;
+			return false;
+		}
+		while (true) {
+			size_t size = stream->read(chunk.data(), chunk.size());
+			if (size % sound.frameSize != 0) {
+				std::cout << "  " << fileName << ": read part of a frame"
+					<< std::endl;
+				return false;
+			}
+			passes[pass].insert(passes[pass].end(), chunk.begin(),
+				chunk.begin() + size);
+			if (size < chunk.size()) {
+				break;
+			}
+		}
+		if (stream->hasFailed()) {
+			std::cout << "  " << fileName << ": is corrupt" << std::endl;
+			return false;
+		}
+	}
+	if (passes[0] != passes[1]) {
+		std::cout << "  " << fileName << ": decoded differently after "
+			<< "rewinding" << std::endl;
+		return false;
+	}
+	if (passes[0].empty()) {
+		std::cout << "  " << fileName << ": has no samples" << std::endl;
+		return false;
+	}
+	sound.samples = std::move(passes[0]);
+	return true;
+}
+
+bool AudioTest::checkDecoding(const AudioTestSettings& settings,
+	const std::string& fileName, DecodedSound& sound) {
+	if (!decode(fileName, sound)) {
+		return false;
+	}
+	std::filesystem::path referenceName = fileName;
+	referenceName.replace_extension(".wav");
+	DecodedSound reference;
+	if (!decode(referenceName.generic_string(), reference)) {
+		return false;
+	}
+
+	// Check a corrupt copy first, so the warnings it logs come before this
+	// sound's report
+	bool lossless = std::filesystem::path(fileName).extension() == ".flac";
+	bool corruptionFailed = !lossless || checkCorruption(fileName);
+
+	std::string name = std::filesystem::path(fileName).filename().string();
+	size_t frames = sound.samples.size() / sound.frameSize;
+	std::cout << "  " << name << ": " << frames << " frames at "
+		<< sound.sampleRate << " Hz, ";
+	if (sound.format != reference.format
+		|| sound.sampleRate != reference.sampleRate) {
+		std::cout << "format differs from its WAVE file" << std::endl;
+		return false;
+	}
+	if (sound.samples.size() != reference.samples.size()) {
+		std::cout << "its WAVE file has "
+			<< reference.samples.size() / reference.frameSize << " frames"
+			<< std::endl;
+		return false;
+	}
+
+	if (lossless) {
+		// FLAC is lossless, so its samples must be the WAVE file's exactly
+		if (sound.samples != reference.samples) {
+			std::cout << "samples differ from its WAVE file" << std::endl;
+			return false;
+		}
+		std::cout << "matches its WAVE file";
+		if (!corruptionFailed) {
+			std::cout << ", but decoded with a bit flipped" << std::endl;
+			return false;
+		}
+		std::cout << " and fails with a bit flipped" << std::endl;
+		return true;
+	}
+
+	// Vorbis is lossy, so its samples only have to be close to the WAVE
+	// file's
+	if (sound.format != AL_FORMAT_MONO16
+		&& sound.format != AL_FORMAT_STEREO16) {
+		std::cout << "Ogg Vorbis references must be 16 bit" << std::endl;
+		return false;
+	}
+	double snr = getSNR(reference.samples, sound.samples);
+	std::cout << snr << " dB signal to noise against its WAVE file";
+	if (snr < settings.minVorbisSNR) {
+		std::cout << ", less than " << settings.minVorbisSNR << " dB"
+			<< std::endl;
+		return false;
+	}
+	std::cout << std::endl;
+	return true;
+}
+
+bool AudioTest::checkCorruption(const std::string& fileName) {
+	std::ifstream file(fileName, std::ios::in | std::ios::binary);
+	std::vector<char> data((std::istreambuf_iterator<char>(file)),
+		std::istreambuf_iterator<char>());
+	if (data.empty()) {
+		return false;
+	}
+
+	// Flip a bit three quarters of the way into the file, well past its
+	// metadata, and write the copy next to the system's temporary files
+	data[data.size() * 3 / 4] ^= 0x10;
+	std::filesystem::path corruptName = std::filesystem::temp_directory_path()
+		/ ("corrupt_" + std::filesystem::path(fileName).filename().string());
+	{
+		std::ofstream corrupt(corruptName, std::ios::out | std::ios::binary);
+		corrupt.write(data.data(), data.size());
+	}
+
+	bool failed = true;
+	std::unique_ptr<AudioStream> stream
+		= AudioStream::open(corruptName.string());
+	if (stream != nullptr) {
+		std::vector<unsigned char> chunk((size_t)READ_FRAMES
+			* stream->getFrameSize());
+		while (stream->read(chunk.data(), chunk.size()) == chunk.size()) {}
+		failed = stream->hasFailed();
+	}
+	stream.reset();
+	std::error_code error;
+	std::filesystem::remove(corruptName, error);
+	return failed;
+}
+
+bool AudioTest::checkPlayback(const std::string& fileName, double length) {
+	typedef std::chrono::steady_clock Clock;
+	std::string name = std::filesystem::path(fileName).filename().string();
+	AudioManager& audio = AudioManager::getInstance();
+	Clock::time_point start = Clock::now();
+	if (!audio.playMusic(fileName, false)) {
+		std::cout << "  " << name << ": could not be streamed" << std::endl;
+		return false;
+	}
+
+	// Wait for the track to start and then stay stopped, the audio manager
+	// restarts the source if it runs out of chunks part way through
+	bool started = false;
+	Clock::time_point stopped = start;
+	double time = 0.0;
+	while (true) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		Clock::time_point now = Clock::now();
+		time = std::chrono::duration<double>(now - start).count();
+		if (audio.isMusicPlaying()) {
+			started = true;
+			stopped = now;
+		}
+		else if (started && now - stopped
+			>= std::chrono::milliseconds(STOPPED_MILLISECONDS)) {
+			time = std::chrono::duration<double>(stopped - start).count();
+			break;
+		}
+		if (time > length + PLAYBACK_MARGIN_SECONDS) {
+			break;
+		}
+	}
+	audio.stopMusic();
+
+	std::cout << "  " << name << ": ";
+	if (!started) {
+		std::cout << "never started playing" << std::endl;
+		return false;
+	}
+	if (time > length + PLAYBACK_MARGIN_SECONDS) {
+		std::cout << "still playing after " << time << " seconds"
+			<< std::endl;
+		return false;
+	}
+	std::cout << "played for " << time << " of " << length << " seconds";
+	// The null backend plays in real time, a track which ends much sooner
+	// lost some of its chunks
+	if (time < length * 0.8) {
+		std::cout << ", ended early" << std::endl;
+		return false;
+	}
+	std::cout << std::endl;
+	return true;
+}
+
+double AudioTest::getSNR(const std::vector<unsigned char>& reference,
+	const std::vector<unsigned char>& decoded) {
+	double signal = 0.0, noise = 0.0;
+	size_t count = std::min(reference.size(), decoded.size()) / 2;
+	for (size_t i = 0; i < count; i++) {
+		double a = (std::int16_t)(reference[i * 2] | reference[i * 2 + 1] << 8);
+		double b = (std::int16_t)(decoded[i * 2] | decoded[i * 2 + 1] << 8);
+		signal += a * a;
+		noise += (a - b) * (a - b);
+	}
+	if (noise == 0.0) {
+		return 1000.0;
+	}
+	return 10.0 * std::log10(signal / noise);
+}
\ No newline at end of file
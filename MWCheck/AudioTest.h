@@ -0,0 +1,116 @@
+/*
+* File:		AudioTest.h
+* Author:	Keegan MacDonald (keeganm742@gmail.com)
+* Created:	2026.10.16
+*/
+
+#ifndef AUDIO_TEST_H
+#define AUDIO_TEST_H
+
+#include <Milkweed/MW.h>
+
+using namespace Milkweed;
+
+/*
+* The settings of an audio check, read from the command line
+*/
+struct AudioTestSettings {
+	// The directory of the sounds to check, each FLAC and Ogg Vorbis file is
+	// checked against the WAVE file of the same name
+	std::string path = "Assets/sound/";
+	// The OpenAL Soft backend to play the sounds through, "null" plays them
+	// without a sound device and "wave" writes them to the file set in
+	// alsoft.ini. "default" uses the default device
+	std::string driver = "null";
+	// Whether to play each sound through the audio manager after decoding it
+	bool play = true;
+	// The lowest signal to noise ratio in decibels an Ogg Vorbis file may
+	// decode to, compared with its WAVE file
+	double minVorbisSNR = 15.0;
+};
+
+/*
+* Decodes the compressed sound fixtures through AudioStream::open and compares
+* them with the WAVE files they were encoded from, then streams each of them
+* through AudioManager::playMusic(), so both decoders can be checked without a
+* game window or a sound device
+*/
+class AudioTest {
+public:
+	/*
+	* Run the check and print its report
+	*
+	* @param settings: The settings of the check
+	* @return Whether every sound decoded and played correctly
+	*/
+	bool run(const AudioTestSettings& settings);
+
+private:
+	/*
+	* The samples of a whole sound and their format
+	*/
+	struct DecodedSound {
+		// The OpenAL format of the samples
+		ALenum format = 0;
+		// The number of frames per second
+		ALsizei sampleRate = 0;
+		// The size of one sample of every channel in bytes
+		unsigned int frameSize = 0;
+		// The samples of every frame
+		std::vector<unsigned char> samples;
+
+		/*
+		* Get the length of the sound in seconds
+		*/
+		double getLength() const {
+			return (double)(samples.size() / frameSize) / sampleRate;
+		}
+	};
+
+	/*
+	* Decode a whole sound through AudioStream::open, then rewind the stream
+	* and decode it again to check that it decodes the same way twice
+	*
+	* @param fileName: The file name of the sound on disk
+	* @param sound: The decoded sound
+	* @return Whether the sound could be decoded
+	*/
+	bool decode(const std::string& fileName, DecodedSound& sound);
+	/*
+	* Decode a compressed sound and compare it with its WAVE file, FLAC files
+	* must match exactly and Ogg Vorbis files closely
+	*
+	* @param settings: The settings of the check
+	* @param fileName: The file name of the compressed sound
+	* @param sound: The decoded sound
+	* @return Whether the sound matched its WAVE file
+	*/
+	bool checkDecoding(const AudioTestSettings& settings,
+		const std::string& fileName, DecodedSound& sound);
+	/*
+	* Decode a copy of a lossless sound with one bit flipped, which must fail
+	* its CRC rather than play as noise
+	*
+	* @param fileName: The file name of the sound
+	* @return Whether the copy failed to decode
+	*/
+	bool checkCorruption(const std::string& fileName);
+	/*
+	* Stream a sound through the audio manager and wait for it to finish
+	*
+	* @param fileName: The file name of the sound
+	* @param length: The length of the sound in seconds
+	* @return Whether the sound started and played for about its length
+	*/
+	bool checkPlayback(const std::string& fileName, double length);
+	/*
+	* Get the signal to noise ratio of a 16 bit sound in decibels
+	*
+	* @param reference: The original samples
+	* @param decoded: The samples decoded from a lossy file
+	*/
+	static double getSNR(const std::vector<unsigned char>& reference,
+		const std::vector<unsigned char>& decoded);
+};
+
+#endif
\ No newline at end of file
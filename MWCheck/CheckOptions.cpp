@@ -0,0 +1,83 @@
+/*
+* File:		CheckOptions.cpp
+* Author:	Keegan MacDonald (keeganm742@gmail.com)
+* Created:	2026.10.16
+*/
+
+#include "CheckOptions.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+void CheckOptions::add(const std::string& name, const std::string& argument,
+	const std::string& description, unsigned int& value) {
+	m_options.push_back({ name, argument, description, std::to_string(value),
+		[&value](const std::string& text) { value = std::stoul(text); } });
+}
+
+void CheckOptions::add(const std::string& name, const std::string& argument,
+	const std::string& description, double& value) {
+	std::ostringstream defaultValue;
+	defaultValue << value;
+	m_options.push_back({ name, argument, description, defaultValue.str(),
+		[&value](const std::string& text) { value = std::stod(text); } });
+}
+
+void CheckOptions::add(const std::string& name, const std::string& argument,
+	const std::string& description, bool& value) {
+	m_options.push_back({ name, argument, description, value ? "1" : "0",
+		[&value](const std::string& text) { value = std::stoul(text) != 0; } });
+}
+
+void CheckOptions::add(const std::string& name, const std::string& argument,
+	const std::string& description, std::string& value) {
+	m_options.push_back({ name, argument, description, value,
+		[&value](const std::string& text) { value = text; } });
+}
+
+bool CheckOptions::parse(int argc, char** argv, int first) {
+	for (int i = first; i < argc; i++) {
+		std::string name = argv[i];
+		if (i + 1 >= argc) {
+			printUsage();
+			return false;
+		}
+		std::string value = argv[++i];
+		bool found = false;
+		for (const Option& option : m_options) {
+			if (option.name != name) {
+				continue;
+			}
+			try {
+				option.set(value);
+			}
+			catch (std::exception&) {
+				printUsage();
+				return false;
+			}
+			found = true;
+			break;
+		}
+		if (!found) {
+			printUsage();
+			return false;
+		}
+	}
+	return true;
+}
+
+void CheckOptions::printUsage() const {
+	size_t width = 0;
+	for (const Option& option : m_options) {
+		width = std::max(width, option.name.size() + option.argument.size());
+	}
+	std::cout << "Usage: MWCheck " << m_check << " [options]" << std::endl;
+	for (const Option& option : m_options) {
+		std::cout << "  " << option.name << " " << option.argument
+			<< std::string(width + 2 - option.name.size()
+				- option.argument.size(), ' ')
+			<< option.description << " (" << option.defaultValue << ")"
+			<< std::endl;
+	}
+}
\ No newline at end of file
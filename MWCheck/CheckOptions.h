@@ -0,0 +1,90 @@
+/*
+* File:		CheckOptions.h
+* Author:	Keegan MacDonald (keeganm742@gmail.com)
+* Created:	2026.10.16
+*/
+
+#ifndef CHECK_OPTIONS_H
+#define CHECK_OPTIONS_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+* The command line options of one check, each of which overwrites a field of
+* the check's settings when it is given
+*/
+class CheckOptions {
+public:
+	/*
+	* Start the options of a check
+	*
+	* @param check: The name the check is run by
+	*/
+	CheckOptions(const std::string& check) : m_check(check) {}
+
+	/*
+	* Add an option which sets a count
+	*
+	* @param name: The option's name, starting with "--"
+	* @param argument: The name of its value in the usage message
+	* @param description: What the option sets
+	* @param value: The setting to overwrite, its value is the default
+	*/
+	void add(const std::string& name, const std::string& argument,
+		const std::string& description, unsigned int& value);
+	/*
+	* Add an option which sets a number
+	*/
+	void add(const std::string& name, const std::string& argument,
+		const std::string& description, double& value);
+	/*
+	* Add an option which sets a switch, given as 0 or 1
+	*/
+	void add(const std::string& name, const std::string& argument,
+		const std::string& description, bool& value);
+	/*
+	* Add an option which sets a string
+	*/
+	void add(const std::string& name, const std::string& argument,
+		const std::string& description, std::string& value);
+	/*
+	* Read the options from the command line, printing the usage message if
+	* one is unknown or has no valid value
+	*
+	* @param argc: The number of command line arguments
+	* @param argv: The command line arguments
+	* @param first: The index of the first option in argv
+	* @return Whether every option was read
+	*/
+	bool parse(int argc, char** argv, int first);
+	/*
+	* Print the options with their defaults
+	*/
+	void printUsage() const;
+
+private:
+	/*
+	* An option and the setting it overwrites
+	*/
+	struct Option {
+		// The option's name, starting with "--"
+		std::string name;
+		// The name of its value in the usage message
+		std::string argument;
+		// What the option sets
+		std::string description;
+		// The setting's default, as given on the command line
+		std::string defaultValue;
+		// Parse a value and overwrite the setting, throws if it's invalid
+		std::function<void(const std::string&)> set;
+	};
+
+	// The name the check is run by
+	std::string m_check;
+	// The options in the order they were added
+	std::vector<Option> m_options;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,103 @@
+/*
+* File:		Main.cpp
+* Author:	Keegan MacDonald (keeganm742@gmail.com)
+* Created:	2026.10.16
+*/
+
+#include "AudioTest.h"
+#include "CheckOptions.h"
+#include "QueueTest.h"
+
+#include <iostream>
+
+/*
+* A check which can be run from the command line
+*/
+struct Check {
+	// The name the check is run by
+	std::string name;
+	// What the check does
+	std::string description;
+	// Read the check's options from argv, starting at the given index, and
+	// run it, returning whether it passed
+	bool (*run)(int argc, char** argv, int first);
+};
+
+/*
+* Stress the network inbox queues
+*/
+static bool runQueueTest(int argc, char** argv, int first) {
+	QueueTestSettings settings;
+	CheckOptions options("queue");
+	options.add("--producers", "N", "Threads pushing at once",
+		settings.producers);
+	options.add("--items", "N", "Items pushed by each producer",
+		settings.items);
+	options.add("--capacity", "N", "Most items the MPSCQueue holds",
+		settings.capacity);
+	options.add("--rounds", "N", "Times each queue is run", settings.rounds);
+	if (!options.parse(argc, argv, first)) {
+		return false;
+	}
+
+	QueueTest test;
+	return test.run(settings);
+}
+
+/*
+* Decode and play the sound fixtures
+*/
+static bool runAudioTest(int argc, char** argv, int first) {
+	AudioTestSettings settings;
+	CheckOptions options("audio");
+	options.add("--path", "DIR", "Directory of the FLAC, Ogg Vorbis and WAVE "
+		"files", settings.path);
+	options.add("--driver", "NAME", "OpenAL Soft backend, null, wave or "
+		"default", settings.driver);
+	options.add("--play", "0|1", "Whether to play the sounds after decoding "
+		"them", settings.play);
+	options.add("--snr", "DB", "Least signal to noise of Ogg Vorbis files",
+		settings.minVorbisSNR);
+	if (!options.parse(argc, argv, first)) {
+		return false;
+	}
+
+	AudioTest test;
+	return test.run(settings);
+}
+
+// Every check, in the order they're listed
+static const Check CHECKS[] = {
+	{ "queue", "Stress the MPSCQueue and time it against the TSQueue",
+		runQueueTest },
+	{ "audio", "Check the FLAC and Ogg Vorbis decoders against WAVE files",
+		runAudioTest }
+};
+
+/*
+* Print the checks which can be run
+*/
+static void printUsage() {
+	std::cout << "Usage: MWCheck <check> [options]" << std::endl;
+	for (const Check& check : CHECKS) {
+		std::cout << "  " << check.name << std::string(8 - check.name.size(),
+			' ') << check.description << std::endl;
+	}
+	std::cout << "Run MWCheck <check> --help to list a check's options"
+		<< std::endl;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		printUsage();
+		return -1;
+	}
+	std::string name = argv[1];
+	for (const Check& check : CHECKS) {
+		if (check.name == name) {
+			return check.run(argc, argv, 2) ? 0 : -1;
+		}
+	}
+	printUsage();
+	return -1;
+}
\ No newline at end of file
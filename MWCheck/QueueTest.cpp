@@ -0,0 +1,197 @@
+/*
+* File:		QueueTest.cpp
+* Author:	Keegan MacDonald (keeganm742@gmail.com)
+* Created:	2026.10.16
+*/
+
+#include "QueueTest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+// The capacity of the ring which forces the producers to wait on the consumer
+#define SMALL_CAPACITY 8
+
+void QueueTest::ItemChecker::check(const QueueItem& item) {
+	if (item.producer >= m_next.size()) {
+		m_errors++;
+		return;
+	}
+	unsigned int& next = m_next[item.producer];
+	if (item.sequence != next) {
+		m_errors++;
+	}
+	next = item.sequence + 1;
+}
+
+bool QueueTest::ItemChecker::passed(unsigned int items) const {
+	if (m_errors > 0) {
+		return false;
+	}
+	for (unsigned int next : m_next) {
+		if (next != items) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool QueueTest::run(const QueueTestSettings& settings) {
+	if (settings.producers == 0 || settings.items == 0) {
+		std::cout << "Nothing to push" << std::endl;
+		return false;
+	}
+
+	double bestMPSCTime = 0.0, bestTSTime = 0.0;
+	unsigned int failures = 0;
+	for (unsigned int i = 0; i < std::max(settings.rounds, 1u); i++) {
+		double time = 0.0;
+		if (!runMPSCQueue(settings, settings.capacity, time)) {
+			std::cout << "  Round " << i + 1 << ": the MPSCQueue lost or "
+				<< "reordered items" << std::endl;
+			failures++;
+		}
+		if (i == 0 || time < bestMPSCTime) {
+			bestMPSCTime = time;
+		}
+		if (!runTSQueue(settings, time)) {
+			std::cout << "  Round " << i + 1 << ": the TSQueue lost or "
+				<< "reordered items" << std::endl;
+			failures++;
+		}
+		if (i == 0 || time < bestTSTime) {
+			bestTSTime = time;
+		}
+	}
+
+	// Run a tiny ring so the producers keep finding it full and wrap around
+	// it many times
+	QueueTestSettings smallSettings = settings;
+	smallSettings.items = std::max(settings.items / 10, 1u);
+	double smallTime = 0.0;
+	bool smallPassed = runMPSCQueue(smallSettings, SMALL_CAPACITY, smallTime);
+	if (!smallPassed) {
+		failures++;
+	}
+
+	double items = (double)settings.producers * (double)settings.items;
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "Pushed " << settings.producers << " x " << settings.items
+		<< " items through each queue, fastest of " << settings.rounds
+		<< " rounds" << std::endl;
+	std::cout << "  MPSCQueue (" << MPSCQueue<QueueItem>(settings.capacity)
+		.capacity() << " items): " << bestMPSCTime * 1000.0 << " ms, "
+		<< items / bestMPSCTime / 1000000.0 << " M items/s" << std::endl;
+	std::cout << "  TSQueue:   " << bestTSTime * 1000.0 << " ms, "
+		<< items / bestTSTime / 1000000.0 << " M items/s" << std::endl;
+	std::cout << "  Speedup: " << bestTSTime / bestMPSCTime << "x"
+		<< std::endl;
+	std::cout << "  MPSCQueue (" << SMALL_CAPACITY << " items, "
+		<< settings.producers << " x " << smallSettings.items << " items): "
+		<< (smallPassed ? "passed" : "lost or reordered items") << std::endl;
+	std::cout << (failures == 0 ? "Every item arrived once and in order"
+		: "FAILED") << std::endl;
+
+	return failures == 0;
+}
+
+bool QueueTest::runMPSCQueue(const QueueTestSettings& settings,
+	unsigned int capacity, double& time) {
+	MPSCQueue<QueueItem> queue(capacity);
+	std::atomic<bool> started = false;
+	std::atomic<unsigned int> finished = 0;
+	std::vector<std::thread> producers;
+	for (unsigned int p = 0; p < settings.producers; p++) {
+		producers.emplace_back([&, p] {
+			while (!started.load(std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+			for (unsigned int i = 0; i < settings.items; i++) {
+				QueueItem item;
+				item.producer = p;
+				item.sequence = i;
+				queue.pushBack(std::move(item));
+			}
+			finished.fetch_add(1, std::memory_order_release);
+		});
+	}
+
+	// Drain the queue a batch at a time until every producer is done and
+	// nothing is left, so a lost item fails the test instead of hanging it
+	typedef std::chrono::steady_clock Clock;
+	ItemChecker checker(settings.producers);
+	std::vector<QueueItem> batch;
+	Clock::time_point start = Clock::now();
+	started.store(true, std::memory_order_release);
+	while (true) {
+		bool done = finished.load(std::memory_order_acquire)
+			== settings.producers;
+		batch.clear();
+		if (queue.popAll(batch) == 0) {
+			if (done) {
+				break;
+			}
+			std::this_thread::yield();
+			continue;
+		}
+		for (const QueueItem& item : batch) {
+			checker.check(item);
+		}
+	}
+	time = std::chrono::duration<double>(Clock::now() - start).count();
+
+	for (std::thread& producer : producers) {
+		producer.join();
+	}
+	return checker.passed(settings.items);
+}
+
+bool QueueTest::runTSQueue(const QueueTestSettings& settings, double& time) {
+	TSQueue<QueueItem> queue;
+	std::atomic<bool> started = false;
+	std::atomic<unsigned int> finished = 0;
+	std::vector<std::thread> producers;
+	for (unsigned int p = 0; p < settings.producers; p++) {
+		producers.emplace_back([&, p] {
+			while (!started.load(std::memory_order_acquire)) {
+				std::this_thread::yield();
+			}
+			for (unsigned int i = 0; i < settings.items; i++) {
+				QueueItem item;
+				item.producer = p;
+				item.sequence = i;
+				queue.pushBack(std::move(item));
+			}
+			finished.fetch_add(1, std::memory_order_release);
+		});
+	}
+
+	typedef std::chrono::steady_clock Clock;
+	ItemChecker checker(settings.producers);
+	Clock::time_point start = Clock::now();
+	started.store(true, std::memory_order_release);
+	while (true) {
+		bool done = finished.load(std::memory_order_acquire)
+			== settings.producers;
+		if (queue.empty()) {
+			if (done) {
+				break;
+			}
+			std::this_thread::yield();
+			continue;
+		}
+		while (!queue.empty()) {
+			checker.check(queue.popFront());
+		}
+	}
+	time = std::chrono::duration<double>(Clock::now() - start).count();
+
+	for (std::thread& producer : producers) {
+		producer.join();
+	}
+	return checker.passed(settings.items);
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+/*
+* File:		QueueTest.h
+* Author:	Keegan MacDonald (keeganm742@gmail.com)
+* Created:	2026.10.16
+*/
+
+#ifndef QUEUE_TEST_H
+#define QUEUE_TEST_H
+
+#include <Milkweed/MW.h>
+
+using namespace Milkweed;
+
+/*
+* The settings of a queue stress test, read from the command line
+*/
+struct QueueTestSettings {
+	// The number of threads pushing items at once
+	unsigned int producers = 4;
+	// The number of items each producer pushes
+	unsigned int items = 1000000;
+	// The most items the MPSCQueue holds at once
+	unsigned int capacity = 4096;
+	// The number of times each queue is run, the fastest run is reported
+	unsigned int rounds = 3;
+};
+
+/*
+* Pushes items into the network inbox queues from many threads while one
+* thread drains them, checking that every item arrives once and in the order
+* its producer pushed it, and times the MPSCQueue against the TSQueue it
+* replaced
+*/
+class QueueTest {
+public:
+	/*
+	* Run the test and print its report
+	*
+	* @param settings: The settings of the test
+	* @return Whether every run delivered every item once and in order
+	*/
+	bool run(const QueueTestSettings& settings);
+
+private:
+	/*
+	* An item pushed by a producer, numbered so the consumer can tell if any
+	* were lost, duplicated or reordered
+	*/
+	struct QueueItem {
+		// The index of the producer which pushed this item
+		unsigned int producer = 0;
+		// The number of items the producer pushed before this one
+		unsigned int sequence = 0;
+	};
+
+	/*
+	* Checks the items taken from a queue, one producer at a time
+	*/
+	class ItemChecker {
+	public:
+		/*
+		* Start checking the items of a number of producers
+		*/
+		ItemChecker(unsigned int producers) : m_next(producers, 0) {}
+		/*
+		* Check the next item taken from the queue
+		*/
+		void check(const QueueItem& item);
+		/*
+		* Test whether every producer's items arrived once and in order
+		*
+		* @param items: The number of items each producer pushed
+		*/
+		bool passed(unsigned int items) const;
+		/*
+		* Get the number of items which arrived out of order
+		*/
+		unsigned int getErrors() const { return m_errors; }
+
+	private:
+		// The sequence number expected next from each producer
+		std::vector<unsigned int> m_next;
+		// The number of items which arrived out of order
+		unsigned int m_errors = 0;
+	};
+
+	/*
+	* Push items into an MPSCQueue from every producer, draining it in
+	* batches as the game thread does
+	*
+	* @param capacity: The most items the queue holds at once
+	* @param time: The time taken in seconds
+	* @return Whether every item arrived once and in order
+	*/
+	bool runMPSCQueue(const QueueTestSettings& settings, unsigned int capacity,
+		double& time);
+	/*
+	* Push items into a TSQueue from every producer, polling empty() and
+	* popFront() as the game thread used to
+	*
+	* @param time: The time taken in seconds
+	* @return Whether every item arrived once and in order
+	*/
+	bool runTSQueue(const QueueTestSettings& settings, double& time);
+};
+
+#endif
\ No newline at end of file
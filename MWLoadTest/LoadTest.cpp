@@ -0,0 +1,576 @@
+/*
+* File:		LoadTest.cpp
+* Author:	Keegan MacDonald (keeganm742@gmail.com)
+* Created:	2026.10.16
+*/
+
+#include "LoadTest.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+// The rate the players' velocities are measured in, matching the server's
+// physics updates
+#define PHYSICS_UPS 60.0f
+// The longest time in seconds to wait for every client to connect
+#define MAX_CONNECT_TIME 10.0
+// The time in seconds the clients wait between checking their messages
+#define CLIENT_POLL_TIME 0.001
+// The time in milliseconds the server sleeps between steps
+#define SERVER_SLEEP_MS 1
+
+typedef std::chrono::steady_clock Clock;
+
+/*
+* Get the value at a percentile (0 - 1) of a list, reordering the list
+*/
+static double getPercentile(std::vector<double>& values, double percentile) {
+	if (values.empty()) {
+		return 0.0;
+	}
+	size_t index = (size_t)(percentile * (values.size() - 1));
+	std::nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
+
+void SimulatedClient::connect(
+	const asio::ip::tcp::resolver::results_type& endpoints,
+	const LoadTestSettings& settings, double now) {
+	// Each client makes its own connection without a NetClient, with its own
+	// queue and datagram channel
+	asio::ip::tcp::socket socket(m_context);
+	m_connection = std::make_shared<NetConnection>(m_context, socket);
+	m_connection->init(&m_messagesIn);
+	if (settings.datagrams) {
+		m_datagrams = std::make_shared<NetDatagramChannel>(m_context);
+		m_connection->setDatagramChannel(m_datagrams.get());
+	}
+	m_accepted = false;
+	m_playerID = 0;
+	m_leaveTime = 0.0;
+	m_position = PLAYER_SPAWNPOINT;
+	m_velocity = glm::vec2(0.0f, 0.0f);
+
+	// The connection belongs to its context's thread from now on
+	std::shared_ptr<NetConnection> connection = m_connection;
+	asio::post(m_context, [connection, endpoints]() {
+		connection->connectToServer(endpoints);
+	});
+}
+
+bool SimulatedClient::update(const LoadTestSettings& settings, double now,
+	LoadTestStats& stats) {
+	NetMessage message;
+	while (m_messagesIn.tryPop(message)) {
+		if (message.header.ID == NetMessageTypes::FAILED) {
+			// Failed connections have no owner
+			if (m_connection != nullptr && !m_accepted) {
+				stats.failures++;
+				disconnect();
+			}
+			continue;
+		}
+		if (m_connection == nullptr || message.owner != m_connection) {
+			// Left over from a connection this client has already closed
+			continue;
+		}
+
+		switch (message.header.ID) {
+		case NetMessageTypes::CONNECTED: {
+			break;
+		}
+		case NetMessageTypes::DISCONNECTED: {
+			// The server dropped this client
+			stats.failures++;
+			disconnect();
+			break;
+		}
+		case NetMessageTypes::SNAPSHOT: {
+			// Acknowledge the snapshot like a NetSnapshotReceiver would, the
+			// server's cost is the same without decoding it here
+			stats.messagesReceived++;
+			const NetMessageBody& body = message.body;
+			NetBitReader reader(body.data(), body.size());
+			unsigned int tick = reader.read(32);
+			if (!reader.hasFailed()) {
+				NetMessage ack(NetMessageTypes::SNAPSHOT_ACK);
+				NetWriter(ack).write(tick);
+				send(ack, stats, NetSendMode::UNRELIABLE);
+			}
+			break;
+		}
+		case MessageTypes::ACCEPT_PLAYER: {
+			stats.messagesReceived++;
+			if (!NetReader(message).readVarint(m_playerID)) {
+				break;
+			}
+			m_accepted = true;
+			stats.connections++;
+
+			NetMessage umsg;
+			umsg.header.ID = MessageTypes::USERNAME_REQUEST;
+			NetWriter(umsg).writeString("Bot" + std::to_string(m_playerID));
+			send(umsg, stats);
+
+			// Stay for a random time, and spread the clients' pings out
+			if (settings.averageLifetime > 0.0f) {
+				std::exponential_distribution<double> lifetime(
+					1.0 / settings.averageLifetime);
+				m_leaveTime = now + lifetime(m_random);
+			}
+			m_nextMovement = now;
+			if (settings.pingRate > 0.0f) {
+				std::uniform_real_distribution<double> offset(0.0,
+					1.0 / settings.pingRate);
+				m_nextPing = now + offset(m_random);
+			}
+			break;
+		}
+		case MessageTypes::PING: {
+			// Every client's ping is echoed to every client, only time this
+			// client's own
+			stats.messagesReceived++;
+			NetReader reader(message);
+			unsigned int playerID = 0;
+			double sentTime = 0.0;
+			if (reader.readVarint(playerID) && playerID == m_playerID
+				&& reader.read(sentTime)) {
+				stats.latencies.push_back(now - sentTime);
+			}
+			break;
+		}
+		default: {
+			stats.messagesReceived++;
+		}
+		}
+	}
+
+	if (m_connection == nullptr) {
+		return false;
+	}
+	if (!m_accepted) {
+		return true;
+	}
+	if (m_leaveTime > 0.0 && now >= m_leaveTime) {
+		disconnect();
+		return false;
+	}
+
+	// Send the messages which are due
+	if (settings.movementRate > 0.0f && now >= m_nextMovement) {
+		sendMovement(PHYSICS_UPS / settings.movementRate, stats);
+		m_nextMovement += 1.0 / settings.movementRate;
+		if (m_nextMovement < now) {
+			// Fell behind, don't send a burst to catch up
+			m_nextMovement = now;
+		}
+	}
+	if (settings.pingRate > 0.0f && now >= m_nextPing) {
+		NetMessage pmsg;
+		pmsg.header.ID = MessageTypes::PING;
+		NetWriter writer(pmsg);
+		writer.writeVarint(m_playerID);
+		writer.write(now);
+		send(pmsg, stats);
+		m_nextPing = now + 1.0 / settings.pingRate;
+	}
+
+	return true;
+}
+
+void SimulatedClient::disconnect() {
+	m_accepted = false;
+	if (m_connection == nullptr) {
+		return;
+	}
+
+	// Close the connection and its channel on their thread after anything
+	// already posted for them, the closed channel is freed with the handler
+	std::shared_ptr<NetConnection> connection = std::move(m_connection);
+	std::shared_ptr<NetDatagramChannel> datagrams = std::move(m_datagrams);
+	m_connection = nullptr;
+	m_datagrams = nullptr;
+	asio::post(m_context, [connection, datagrams]() {
+		connection->setDatagramChannel(nullptr);
+		connection->disconnect();
+		if (datagrams != nullptr) {
+			datagrams->close();
+		}
+	});
+}
+
+void SimulatedClient::sendMovement(float deltaTime, LoadTestStats& stats) {
+	// Walk towards one side of the town, turning around at its borders and
+	// now and then stopping or jumping
+	std::uniform_int_distribution<int> choice(0, 99);
+	int roll = choice(m_random);
+	unsigned int type = 0;
+	bool grounded = m_position.y <= TOWN_FLOOR_Y;
+	if (m_position.x <= TOWN_BORDER_LEFT) {
+		m_velocity.x = PLAYER_SPEED_X;
+		type = MessageTypes::MOVEMENT_RIGHT;
+	}
+	else if (m_position.x >= TOWN_BORDER_RIGHT) {
+		m_velocity.x = -PLAYER_SPEED_X;
+		type = MessageTypes::MOVEMENT_LEFT;
+	}
+	else if (roll < 2 && m_velocity.x != 0.0f) {
+		type = m_velocity.x < 0.0f ? MessageTypes::MOVEMENT_STOP_LEFT
+			: MessageTypes::MOVEMENT_STOP_RIGHT;
+		m_velocity.x = 0.0f;
+	}
+	else if (roll < 4 && grounded) {
+		m_velocity.y = PLAYER_JUMP_SPEED;
+		type = MessageTypes::MOVEMENT_JUMP;
+	}
+	else if (m_velocity.x == 0.0f) {
+		m_velocity.x = roll % 2 == 0 ? PLAYER_SPEED_X : -PLAYER_SPEED_X;
+		type = m_velocity.x < 0.0f ? MessageTypes::MOVEMENT_LEFT
+			: MessageTypes::MOVEMENT_RIGHT;
+	}
+	else {
+		type = m_velocity.x < 0.0f ? MessageTypes::MOVEMENT_LEFT
+			: MessageTypes::MOVEMENT_RIGHT;
+	}
+
+	// Move and fall back to the floor
+	m_position.x += m_velocity.x * deltaTime;
+	m_position.y += m_velocity.y * deltaTime;
+	m_velocity.y -= GRAVITY * deltaTime;
+	if (m_velocity.y < MIN_VELOCITY_Y) {
+		m_velocity.y = MIN_VELOCITY_Y;
+	}
+	if (m_position.y <= TOWN_FLOOR_Y) {
+		m_position.y = TOWN_FLOOR_Y;
+		m_velocity.y = 0.0f;
+	}
+
+	NetMessage moveMsg;
+	moveMsg.header.ID = type;
+	NetWriter writer(moveMsg, sizeof(glm::vec3) + sizeof(glm::vec2));
+	writer.write(m_position);
+	writer.write(m_velocity);
+	send(moveMsg, stats);
+}
+
+void SimulatedClient::send(const NetMessage& message, LoadTestStats& stats,
+	NetSendMode mode) {
+	if (m_connection != nullptr) {
+		m_connection->send(message, mode);
+		stats.messagesSent++;
+	}
+}
+
+bool LoadTest::run(const LoadTestSettings& settings) {
+	m_settings = settings;
+	size_t startMemory = getResidentMemory();
+	Clock::time_point startTime = Clock::now();
+	auto getTime = [startTime]() {
+		return std::chrono::duration<double>(Clock::now() - startTime).count();
+	};
+
+	// Start the server and wait to find out whether it could listen
+	m_serverThread = std::thread([this]() { runServer(); });
+	while (!m_serverReady) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	if (!m_serverStarted) {
+		m_serverThread.join();
+		std::cout << "Failed to start the server on port " << settings.port
+			<< std::endl;
+		return false;
+	}
+
+	// Start the clients' threads, kept running while they have nothing to do
+	std::vector<asio::executor_work_guard<asio::io_context::executor_type>>
+		guards;
+	unsigned int clientThreads = settings.clientThreads > 0
+		? settings.clientThreads : 1;
+	for (unsigned int i = 0; i < clientThreads; i++) {
+		m_contexts.emplace_back(new asio::io_context());
+		asio::io_context* context = m_contexts.back().get();
+		guards.push_back(asio::make_work_guard(*context));
+		m_threads.emplace_back([context]() { context->run(); });
+	}
+	asio::ip::tcp::resolver resolver(*m_contexts[0]);
+	asio::ip::tcp::resolver::results_type endpoints
+		= resolver.resolve("127.0.0.1", std::to_string(settings.port));
+
+	// Connect every client, replacing those which fail or leave
+	LoadTestStats stats;
+	double now = getTime();
+	for (unsigned int i = 0; i < settings.clientCount; i++) {
+		m_clients.emplace_back(new SimulatedClient(
+			*m_contexts[i % m_contexts.size()], i + 1));
+		m_clients.back()->connect(endpoints, settings, now);
+	}
+	auto updateClients = [&]() {
+		now = getTime();
+		for (std::unique_ptr<SimulatedClient>& client : m_clients) {
+			if (!client->update(settings, now, stats)) {
+				client->connect(endpoints, settings, now);
+			}
+		}
+		std::this_thread::sleep_for(
+			std::chrono::duration<double>(CLIENT_POLL_TIME));
+	};
+	double connectEnd = now + MAX_CONNECT_TIME;
+	unsigned int acceptedCount = 0;
+	while (now < connectEnd && acceptedCount < settings.clientCount) {
+		updateClients();
+		acceptedCount = 0;
+		for (std::unique_ptr<SimulatedClient>& client : m_clients) {
+			acceptedCount += client->isAccepted() ? 1 : 0;
+		}
+	}
+	double connectTime = now;
+
+	// Measure from here, with every client playing
+	stats = LoadTestStats();
+	size_t connectedMemory = getResidentMemory();
+	unsigned long long startSteps = m_serverSteps;
+	double startGameTime = 0.0, startNetworkTime = 0.0;
+	getServerCPUTime(startGameTime, startNetworkTime);
+	double measureStart = getTime();
+	while (now < measureStart + settings.duration) {
+		updateClients();
+	}
+	double elapsed = now - measureStart;
+	unsigned long long steps = m_serverSteps - startSteps;
+	double gameTime = 0.0, networkTime = 0.0;
+	getServerCPUTime(gameTime, networkTime);
+	gameTime -= startGameTime;
+	networkTime -= startNetworkTime;
+	size_t endMemory = getResidentMemory();
+
+	for (std::unique_ptr<SimulatedClient>& client : m_clients) {
+		client->disconnect();
+	}
+	guards.clear();
+	stop();
+
+	// Report the results
+	double p50 = getPercentile(stats.latencies, 0.5) * 1000.0;
+	double p99 = getPercentile(stats.latencies, 0.99) * 1000.0;
+	double gameLoad = elapsed > 0.0 ? gameTime / elapsed : 0.0;
+	double networkLoad = elapsed > 0.0 ? networkTime / elapsed : 0.0;
+	double clients = (double)std::max(settings.clientCount, 1u);
+	std::cout << "Load test of " << settings.clientCount << " clients for "
+		<< elapsed << " seconds" << std::endl;
+	std::cout << "  Connected " << acceptedCount << " clients in "
+		<< connectTime << " seconds" << std::endl;
+	std::cout << "  Messages sent per second:     "
+		<< stats.messagesSent / elapsed << std::endl;
+	std::cout << "  Messages received per second: "
+		<< stats.messagesReceived / elapsed << std::endl;
+	std::cout << "  Connections: " << stats.connections << ", failures: "
+		<< stats.failures << std::endl;
+	std::cout << "  Ping round trip (" << stats.latencies.size()
+		<< " pings): p50 " << p50 << " ms, p99 " << p99 << " ms" << std::endl;
+	std::cout << "  Server steps per second: " << steps / elapsed << std::endl;
+	std::cout << "  Server CPU, percent of one core: game thread "
+		<< gameLoad * 100.0 << ", " << m_serverNetworkThreads.size()
+		<< " networking threads " << networkLoad * 100.0 << std::endl;
+	std::cout << "  Server CPU per client: "
+		<< (gameLoad + networkLoad) * 1000000.0 / clients
+		<< " microseconds per second (game " << gameLoad * 1000000.0 / clients
+		<< ", networking " << networkLoad * 1000000.0 / clients << ")"
+		<< std::endl;
+	std::cout << "  Process memory, server and clients: " << startMemory / 1024
+		<< " KB at start, "
+		<< connectedMemory / 1024 << " KB connected, " << endMemory / 1024
+		<< " KB at end (growth "
+		<< ((long long)endMemory - (long long)connectedMemory) / 1024
+		<< " KB)" << std::endl;
+
+	return true;
+}
+
+void LoadTest::runServer() {
+	std::unique_ptr<TestServer> server;
+	try {
+		server.reset(new TestServer(m_settings.port));
+	}
+	catch (std::exception& e) {
+		std::cout << "Could not listen: " << e.what() << std::endl;
+	}
+	m_serverStarted = server != nullptr && server->init(1024,
+		m_settings.serverThreads, m_settings.datagrams);
+	if (m_serverStarted) {
+		m_serverNetworkThreads = server->getNetworkThreads();
+	}
+	m_serverReady = true;
+	if (!m_serverStarted) {
+		return;
+	}
+	// Keep the server's logging in its file and out of the report
+	LogManager::getInstance().setPrintToConsole(false);
+
+	// Step the server like its own program does
+	Clock::time_point last = Clock::now();
+	while (!m_serverStopping) {
+		Clock::time_point now = Clock::now();
+		server->step(std::chrono::duration<float>(now - last).count());
+		last = now;
+		m_serverSteps++;
+		std::this_thread::sleep_for(
+			std::chrono::milliseconds(SERVER_SLEEP_MS));
+	}
+	server.reset();
+}
+
+void LoadTest::stop() {
+	// Give the clients' threads a moment to close their connections
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	for (std::unique_ptr<asio::io_context>& context : m_contexts) {
+		context->stop();
+	}
+	for (std::thread& thread : m_threads) {
+		thread.join();
+	}
+	m_threads.clear();
+	m_clients.clear();
+	m_contexts.clear();
+
+	m_serverStopping = true;
+	if (m_serverThread.joinable()) {
+		m_serverThread.join();
+	}
+}
+
+void LoadTest::getServerCPUTime(double& gameTime, double& networkTime) {
+	// The server's game thread is the one running runServer()
+	gameTime = getThreadCPUTime(m_serverThread.native_handle());
+	networkTime = 0.0;
+	for (std::thread::native_handle_type thread : m_serverNetworkThreads) {
+		networkTime += getThreadCPUTime(thread);
+	}
+}
+
+size_t getResidentMemory() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+		sizeof(counters))) {
+		return counters.WorkingSetSize;
+	}
+	return 0;
+#else
+	std::ifstream statm("/proc/self/statm");
+	size_t pages = 0, resident = 0;
+	if (!(statm >> pages >> resident)) {
+		return 0;
+	}
+	return resident * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+double getThreadCPUTime(std::thread::native_handle_type thread) {
+#ifdef _WIN32
+	// Kernel and user times are counted in 100 nanosecond intervals
+	FILETIME creation, exit, kernel, user;
+	if (!GetThreadTimes((HANDLE)thread, &creation, &exit, &kernel, &user)) {
+		return 0.0;
+	}
+	ULARGE_INTEGER kernelTime, userTime;
+	kernelTime.LowPart = kernel.dwLowDateTime;
+	kernelTime.HighPart = kernel.dwHighDateTime;
+	userTime.LowPart = user.dwLowDateTime;
+	userTime.HighPart = user.dwHighDateTime;
+	return (double)(kernelTime.QuadPart + userTime.QuadPart) / 10000000.0;
+#else
+	// Read the thread's own CPU-time clock, like CLOCK_THREAD_CPUTIME_ID
+	// does for the calling thread
+	clockid_t clock;
+	timespec time;
+	if (pthread_getcpuclockid(thread, &clock) != 0
+		|| clock_gettime(clock, &time) != 0) {
+		return 0.0;
+	}
+	return (double)time.tv_sec + (double)time.tv_nsec / 1000000000.0;
+#endif
+}
+
+/*
+* Print the command line options of the load test
+*/
+static void printUsage() {
+	LoadTestSettings defaults;
+	std::cout << "Usage: MWLoadTest [options]" << std::endl
+		<< "  --clients N         Clients connected at once ("
+		<< defaults.clientCount << ")" << std::endl
+		<< "  --seconds S         Length of the test (" << defaults.duration
+		<< ")" << std::endl
+		<< "  --port P            Port to run the server on ("
+		<< defaults.port << ")" << std::endl
+		<< "  --server-threads N  Server networking threads ("
+		<< defaults.serverThreads << ")" << std::endl
+		<< "  --client-threads N  Client networking threads ("
+		<< defaults.clientThreads << ")" << std::endl
+		<< "  --movement-rate R   Movements per client per second ("
+		<< defaults.movementRate << ")" << std::endl
+		<< "  --ping-rate R       Pings per client per second ("
+		<< defaults.pingRate << ")" << std::endl
+		<< "  --lifetime S        Average seconds before a client reconnects, "
+		<< "0 for never (" << defaults.averageLifetime << ")" << std::endl
+		<< "  --no-datagrams      Send everything over TCP" << std::endl;
+}
+
+int main(int argc, char** argv) {
+	LoadTestSettings settings;
+	for (int i = 1; i < argc; i++) {
+		std::string option = argv[i];
+		if (option == "--no-datagrams") {
+			settings.datagrams = false;
+			continue;
+		}
+		if (i + 1 >= argc) {
+			printUsage();
+			return -1;
+		}
+		std::string value = argv[++i];
+		try {
+			if (option == "--clients") {
+				settings.clientCount = std::stoul(value);
+			}
+			else if (option == "--seconds") {
+				settings.duration = std::stof(value);
+			}
+			else if (option == "--port") {
+				settings.port = std::stoul(value);
+			}
+			else if (option == "--server-threads") {
+				settings.serverThreads = std::stoul(value);
+			}
+			else if (option == "--client-threads") {
+				settings.clientThreads = std::stoul(value);
+			}
+			else if (option == "--movement-rate") {
+				settings.movementRate = std::stof(value);
+			}
+			else if (option == "--ping-rate") {
+				settings.pingRate = std::stof(value);
+			}
+			else if (option == "--lifetime") {
+				settings.averageLifetime = std::stof(value);
+			}
+			else {
+				printUsage();
+				return -1;
+			}
+		}
+		catch (std::exception&) {
+			printUsage();
+			return -1;
+		}
+	}
+
+	LoadTest loadTest;
+	return loadTest.run(settings) ? 0 : -1;
+}
\ No newline at end of file
@@ -0,0 +1,198 @@
+/*
+* File:		LoadTest.h
+* Author:	Keegan MacDonald (keeganm742@gmail.com)
+* Created:	2026.10.16
+*/
+
+#ifndef LOAD_TEST_H
+#define LOAD_TEST_H
+
+#include <MWTestServer/TestServer.h>
+
+using namespace Milkweed;
+
+/*
+* The settings of a load test, read from the command line
+*/
+struct LoadTestSettings {
+	// The number of clients connected at once
+	unsigned int clientCount = 64;
+	// The length of the test in seconds, after every client has connected
+	float duration = 30.0f;
+	// The port to run the server on
+	unsigned int port = 2774;
+	// The number of threads the server does networking on
+	unsigned int serverThreads = 1;
+	// The number of threads the simulated clients share for networking
+	unsigned int clientThreads = 2;
+	// The number of movement messages each client sends per second
+	float movementRate = 60.0f;
+	// The number of pings each client sends per second to measure latency
+	float pingRate = 1.0f;
+	// The average number of seconds a client stays before disconnecting and
+	// connecting again, 0 to never disconnect
+	float averageLifetime = 20.0f;
+	// Whether the server and clients use datagrams for unreliable messages
+	bool datagrams = true;
+};
+
+/*
+* The counts taken while a load test runs
+*/
+struct LoadTestStats {
+	// The number of messages the simulated clients sent
+	unsigned long long messagesSent = 0;
+	// The number of messages the simulated clients received
+	unsigned long long messagesReceived = 0;
+	// The number of times a client connected and was accepted
+	unsigned int connections = 0;
+	// The number of times a client failed to connect or was dropped
+	unsigned int failures = 0;
+	// The round trip times of the clients' pings in seconds
+	std::vector<double> latencies;
+};
+
+/*
+* A headless client which connects to the server over loopback and sends the
+* same kinds of messages a player does
+*/
+class SimulatedClient {
+public:
+	/*
+	* Construct a disconnected client
+	*
+	* @param context: The ASIO context to do this client's networking in, run
+	* by a single thread
+	* @param seed: The seed of this client's random movement
+	*/
+	SimulatedClient(asio::io_context& context, unsigned int seed)
+		: m_context(context), m_messagesIn(1024), m_random(seed) {}
+	/*
+	* Start connecting to the server
+	*
+	* @param endpoints: The address of the server
+	* @param settings: The settings of the load test
+	* @param now: The current time in seconds
+	*/
+	void connect(const asio::ip::tcp::resolver::results_type& endpoints,
+		const LoadTestSettings& settings, double now);
+	/*
+	* Process the messages from the server and send this client's messages
+	* which are due
+	*
+	* @param settings: The settings of the load test
+	* @param now: The current time in seconds
+	* @param stats: The counts to add this client's messages to
+	* @return Whether this client is still connected or connecting
+	*/
+	bool update(const LoadTestSettings& settings, double now,
+		LoadTestStats& stats);
+	/*
+	* Disconnect from the server, the connection is cleaned up on the client's
+	* thread
+	*/
+	void disconnect();
+	/*
+	* Test whether the server has accepted this client
+	*/
+	bool isAccepted() const { return m_accepted; }
+
+private:
+	// The context this client's networking is done in
+	asio::io_context& m_context;
+	// The connection to the server, nullptr when disconnected
+	std::shared_ptr<NetConnection> m_connection;
+	// This connection's own datagram channel
+	std::shared_ptr<NetDatagramChannel> m_datagrams;
+	// The messages received from the server
+	MPSCQueue<NetMessage> m_messagesIn;
+	// The random numbers used to move and disconnect
+	std::mt19937 m_random;
+	// Whether the server has accepted this client
+	bool m_accepted = false;
+	// The player ID assigned by the server
+	unsigned int m_playerID = 0;
+	// The time to disconnect at, 0 to stay connected
+	double m_leaveTime = 0.0;
+	// The time the next movement and ping are due
+	double m_nextMovement = 0.0, m_nextPing = 0.0;
+	// The state of this client's player
+	glm::vec3 m_position = PLAYER_SPAWNPOINT;
+	glm::vec2 m_velocity = glm::vec2(0.0f, 0.0f);
+
+	/*
+	* Send the player's movement, walking back and forth across the town and
+	* sometimes stopping or jumping
+	*
+	* @param deltaTime: The physics updates passed since the last movement
+	*/
+	void sendMovement(float deltaTime, LoadTestStats& stats);
+	/*
+	* Send a message to the server if connected
+	*/
+	void send(const NetMessage& message, LoadTestStats& stats,
+		NetSendMode mode = NetSendMode::RELIABLE);
+};
+
+/*
+* Runs a TestServer and many simulated clients in one process and reports the
+* server's throughput, latency, processor time and the process's memory used
+*/
+class LoadTest {
+public:
+	/*
+	* Run a load test to the end and print its report
+	*
+	* @param settings: The settings of the test
+	* @return Whether the server could be started
+	*/
+	bool run(const LoadTestSettings& settings);
+
+private:
+	// The settings of the test
+	LoadTestSettings m_settings;
+	// The contexts the simulated clients do their networking in, one thread
+	// each
+	std::vector<std::unique_ptr<asio::io_context>> m_contexts;
+	// The threads running the clients' contexts
+	std::vector<std::thread> m_threads;
+	// The simulated clients, destroyed before their contexts
+	std::vector<std::unique_ptr<SimulatedClient>> m_clients;
+	// The thread running the server
+	std::thread m_serverThread;
+	// Whether the server has started, and whether it could
+	std::atomic<bool> m_serverReady{ false }, m_serverStarted{ false };
+	// Whether the server should stop
+	std::atomic<bool> m_serverStopping{ false };
+	// The number of server steps since the server started
+	std::atomic<unsigned long long> m_serverSteps{ 0 };
+	// The server's networking threads, set before m_serverReady
+	std::vector<std::thread::native_handle_type> m_serverNetworkThreads;
+
+	/*
+	* Create, step and destroy the server on its own thread
+	*/
+	void runServer();
+	/*
+	* Stop the clients' and server's threads
+	*/
+	void stop();
+	/*
+	* Get the processor time in seconds used so far by the server's game
+	* thread and by its networking threads together
+	*/
+	void getServerCPUTime(double& gameTime, double& networkTime);
+};
+
+/*
+* Get the memory the process is using in bytes, 0 if it is not known
+*/
+size_t getResidentMemory();
+/*
+* Get the processor time a thread has used in seconds, 0 if it is not known
+*
+* @param thread: The native handle of a running thread
+*/
+double getThreadCPUTime(std::thread::native_handle_type thread);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,39 @@
+#version 330 core
+
+in vec3 inPosition;
+in vec2 inSize;
+in float inRotation;
+in vec4 inTextureRect;
+in float inFlip;
+
+out vec2 textureCoords;
+
+uniform mat4 cameraMatrix;
+
+void main() {
+	// Find the corner of the quad this vertex is from the static quad indices,
+	// bottom left, bottom right, top right then top left
+	int corner = gl_VertexID % 4;
+	vec2 offset = vec2((corner == 1 || corner == 2) ? 1.0 : 0.0,
+		(corner >= 2) ? 1.0 : 0.0);
+
+	// Rotate the corner about the center of the sprite
+	vec2 center = inSize / 2.0;
+	vec2 point = offset * inSize - center;
+	float s = sin(inRotation);
+	float c = cos(inRotation);
+	point = vec2(c * point.x - s * point.y, s * point.x + c * point.y);
+	gl_Position = cameraMatrix * vec4(inPosition.xy + center + point, 0.0,
+		1.0);
+
+	// Flip the texture coordinates within the sprite if needed
+	int flip = int(inFlip);
+	if ((flip & 1) != 0) {
+		offset.x = 1.0 - offset.x;
+	}
+	if ((flip & 2) != 0) {
+		offset.y = 1.0 - offset.y;
+	}
+	textureCoords = vec2(inTextureRect.x + offset.x * inTextureRect.z,
+		inTextureRect.y + (1.0 - offset.y) * inTextureRect.w);
+}
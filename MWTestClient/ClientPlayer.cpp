@@ -98,7 +98,9 @@ void ClientPlayer::moveLeft(bool start) {
 		this->velocity.x = -PLAYER_SPEED_X;
 		NetMessage moveMsg;
 		moveMsg.header.ID = MOVEMENT_LEFT;
-		moveMsg << this->velocity << this->position;
+		NetWriter writer(moveMsg);
+		writer.write(this->position);
+		writer.write(this->velocity);
 		MW::NETWORK.send(moveMsg);
 	}
 	else {
@@ -107,7 +109,9 @@ void ClientPlayer::moveLeft(bool start) {
 		}
 		NetMessage moveMsg;
 		moveMsg.header.ID = MOVEMENT_STOP_LEFT;
-		moveMsg << this->velocity << this->position;
+		NetWriter writer(moveMsg);
+		writer.write(this->position);
+		writer.write(this->velocity);
 		MW::NETWORK.send(moveMsg);
 	}
 }
@@ -117,7 +121,9 @@ void ClientPlayer::moveRight(bool start) {
 		this->velocity.x = PLAYER_SPEED_X;
 		NetMessage moveMsg;
 		moveMsg.header.ID = MOVEMENT_RIGHT;
-		moveMsg << this->velocity << this->position;
+		NetWriter writer(moveMsg);
+		writer.write(this->position);
+		writer.write(this->velocity);
 		MW::NETWORK.send(moveMsg);
 	}
 	else {
@@ -126,7 +132,9 @@ void ClientPlayer::moveRight(bool start) {
 		}
 		NetMessage moveMsg;
 		moveMsg.header.ID = MOVEMENT_STOP_RIGHT;
-		moveMsg << this->velocity << this->position;
+		NetWriter writer(moveMsg);
+		writer.write(this->position);
+		writer.write(this->velocity);
 		MW::NETWORK.send(moveMsg);
 	}
 }
@@ -141,6 +149,8 @@ void ClientPlayer::jump() {
 	// Send the jump input to the server
 	NetMessage jmsg;
 	jmsg.header.ID = MessageTypes::MOVEMENT_JUMP;
-	jmsg << this->velocity << this->position;
+	NetWriter writer(jmsg);
+	writer.write(this->position);
+	writer.write(this->velocity);
 	MW::NETWORK.send(jmsg);
 }
\ No newline at end of file
@@ -21,6 +21,9 @@ public:
 	GameScene* parent = nullptr;
 	// The client ID of this player assigned by the server
 	unsigned int clientID = 0;
+	// Whether this player was in the last snapshot sampled from the server,
+	// players out of its range are neither simulated nor drawn
+	bool inRange = true;
 
 	/*
 	* Construct this client player with a client ID and sprite information.
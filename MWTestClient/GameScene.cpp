@@ -17,10 +17,12 @@ void GameScene::init() {
 	// Initialize the camera used to display sprites
 	m_spriteCamera.init();
 
-	// Initialize the shader used to display sprites
-	m_spriteShader.init("Assets/shader/sprite_vertex_shader.glsl",
+	// Initialize the shader used to display sprites, expanding one instance
+	// record per sprite into a quad on the GPU
+	m_spriteShader.init("Assets/shader/sprite_instanced_vertex_shader.glsl",
 		"Assets/shader/sprite_fragment_shader.glsl",
-		Shader::getDefaultVertexAttributes("inPosition", "inTextureCoords"),
+		Shader::getInstancedVertexAttributes("inPosition", "inSize",
+			"inRotation", "inTextureRect", "inFlip"),
 		"cameraMatrix", &m_spriteCamera);
 	m_spriteTextShader.init("Assets/shader/text_vertex_shader.glsl",
 		"Assets/shader/text_fragment_shader.glsl",
@@ -87,9 +89,15 @@ void GameScene::init() {
 	updateStatsArea();
 	m_statsArea.setEnabled(false);
 
+	// Show the profiler's overlay in the HUD's style while it is running
+	MW::PROFILER.setOverlay(m_font, &m_UITextShader, "textColor", textColor,
+		textScale);
+
 	m_floorSprite.init(glm::vec3(0.0f, -50.0f, 0.0f),
 		glm::vec2(TOWN_BORDER_RIGHT, 50.0f),
 		MW::RESOURCES.getTexture("Assets/texture/self.png"));
+
+	m_snapshots.init(getPlayerSnapshotFields(), SNAPSHOT_RATE);
 }
 
 void GameScene::enter() {
@@ -124,10 +132,12 @@ void GameScene::draw() {
 		m_pauseUIGroup.draw();
 	}
 
-	m_playerPointers.resize(m_players.size());
-	int i = 0;
+	m_playerPointers.clear();
 	for (const std::pair<unsigned int, ClientPlayer>& p : m_players) {
-		m_playerPointers[i++] = &(m_players[p.first]);
+		if (!p.second.inRange) {
+			continue;
+		}
+		m_playerPointers.push_back(&(m_players[p.first]));
 		// Draw the player's username
 		ClientPlayer* cp = &(m_players[p.first]);
 		float mid = cp->position.x + cp->dimensions.x / 2.0f;
@@ -174,6 +184,14 @@ void GameScene::processInput() {
 		MW::WINDOW.setFullScreen(!MW::WINDOW.isFullScreen());
 	}
 
+	// Toggle the profiler, writing out the frames it recorded when stopped
+	if (MW::INPUT.isKeyPressed(F_3)) {
+		MW::PROFILER.setEnabled(!MW::PROFILER.isEnabled());
+		if (!MW::PROFILER.isEnabled()) {
+			MW::PROFILER.exportChromeTrace("profile.json");
+		}
+	}
+
 	if (!(m_connected && m_accepted) || m_pauseMenuUp) {
 		return;
 	}
@@ -182,7 +200,7 @@ void GameScene::processInput() {
 	if (MW::INPUT.isKeyPressed(K_P)) {
 		NetMessage p;
 		p.header.ID = MessageTypes::PING;
-		p << m_playerID;
+		NetWriter(p).writeVarint(m_playerID);
 		MW::NETWORK.send(p);
 	}
 
@@ -221,30 +239,41 @@ void GameScene::processNetMessage(NetMessage& message) {
 		disconnect();
 		break;
 	}
+	case NetMessageTypes::SNAPSHOT: {
+		m_snapshots.processMessage(message);
+		break;
+	}
 	case MessageTypes::CONNECT_PLAYER: {
 		// Initialize a blank player with that ID
 		unsigned int playerID = 0;
-		message >> playerID;
+		if (!NetReader(message).readVarint(playerID)) {
+			break;
+		}
 		m_players.emplace(playerID, ClientPlayer());
 		m_players[playerID].init(this, playerID);
 		break;
 	}
 	case MessageTypes::ACCEPT_PLAYER: {
 		// Initialize this player
+		NetReader reader(message);
 		m_players.clear();
 		m_playerID = 0;
-		message >> m_playerID;
+		reader.readVarint(m_playerID);
 		m_players.emplace(m_playerID, ClientPlayer());
 		m_players[m_playerID].init(this, m_playerID);
 
 		// Initialize previously connected players
-		int otherCount = 0;
-		message >> otherCount;
-		for (int i = 0; i < otherCount; i++) {
+		unsigned int otherCount = 0;
+		reader.readVarint(otherCount);
+		for (unsigned int i = 0; i < otherCount; i++) {
 			unsigned int playerID = 0;
 			glm::vec3 pos = glm::vec3();
 			glm::vec2 vel = glm::vec2();
-			message >> playerID >> pos >> vel;
+			if (!reader.readVarint(playerID) || !reader.read(pos)
+				|| !reader.read(vel)) {
+				MWLOG(Warning, GameScene, "Received invalid player list");
+				break;
+			}
 			m_players.emplace(playerID, ClientPlayer());
 			m_players[playerID].init(this, playerID);
 			m_players[playerID].position = pos;
@@ -254,12 +283,7 @@ void GameScene::processNetMessage(NetMessage& message) {
 		// Send username request
 		NetMessage umsg;
 		umsg.header.ID = MessageTypes::USERNAME_REQUEST;
-		const char* usrName = m_username.c_str();
-		int length = m_username.length();
-		for (int i = length - 1; i >= 0; i--) {
-			umsg << usrName[i];
-		}
-		umsg << length;
+		NetWriter(umsg).writeString(m_username);
 		MW::NETWORK.send(umsg);
 
 		m_accepted = true;
@@ -268,42 +292,41 @@ void GameScene::processNetMessage(NetMessage& message) {
 	}
 	case MessageTypes::USERNAME_ASSIGNMENT: {
 		unsigned int clientID = 0;
-		int length = 0;
 		std::string username;
-		message >> clientID >> length;
-		if (length < 0) {
-			length = 0;
+		NetReader reader(message);
+		if (!reader.readVarint(clientID)
+			|| !reader.readString(username, MAX_USERNAME_LENGTH)) {
+			MWLOG(Warning, GameScene, "Received invalid username assignment");
 			break;
 		}
-		else if (length > 20) {
-			length = 20;
-		}
-		username.resize(length);
-		for (int i = 0; i < length; i++) {
-			message >> username[i];
-		}
 		MWLOG(Info, GameScene, "Received username \"", username, "\" (",
-			length, " characters) for client ", clientID);
+			username.length(), " characters) for client ", clientID);
 		m_players[clientID].username = username;
 		break;
 	}
 	case MessageTypes::PING: {
 		unsigned int playerID = 0;
-		message >> playerID;
+		NetReader(message).readVarint(playerID);
 		break;
 	}
 	case MessageTypes::PLAYER_PV_UPDATE: {
 		glm::vec2 velocity = glm::vec2();
 		glm::vec3 position = glm::vec3();
 		unsigned int playerID = 0;
-		message >> velocity >> position >> playerID;
+		NetReader reader(message);
+		if (!reader.readVarint(playerID) || !reader.read(position)
+			|| !reader.read(velocity)) {
+			break;
+		}
 		m_players[playerID].position = position;
 		m_players[playerID].velocity = velocity;
 		break;
 	}
 	case MessageTypes::DISCONNECT_PLAYER: {
 		unsigned int playerID = 0;
-		message >> playerID;
+		if (!NetReader(message).readVarint(playerID)) {
+			break;
+		}
 		// Search for the player with that ID and clear it out if found
 		std::map<unsigned int, ClientPlayer>::iterator it
 			= m_players.find(playerID);
@@ -358,7 +381,38 @@ void GameScene::update(float deltaTime) {
 	m_pauseUIGroup.update(deltaTime);
 
 	for (const std::pair<unsigned int, ClientPlayer>& player : m_players) {
-		m_players[player.first].update(deltaTime);
+		if (player.second.inRange) {
+			m_players[player.first].update(deltaTime);
+		}
+	}
+
+	// Place the other players where the server's snapshots put them, the
+	// delta time is in physics updates
+	m_snapshots.advance(deltaTime / 60.0f);
+	if (m_snapshots.sample(m_snapshotSample)) {
+		// The server leaves players out of the snapshots when they are out
+		// of this player's area of interest, hide them until they come back
+		// rather than letting them drift on their last velocity
+		for (std::pair<const unsigned int, ClientPlayer>& player : m_players) {
+			player.second.inRange = player.first == m_playerID
+				|| m_snapshotSample.findEntity(player.first) != (size_t)-1;
+		}
+		for (size_t i = 0; i < m_snapshotSample.getEntityCount(); i++) {
+			unsigned int playerID = m_snapshotSample.getEntityID(i);
+			std::map<unsigned int, ClientPlayer>::iterator it
+				= m_players.find(playerID);
+			if (playerID == m_playerID || it == m_players.end()) {
+				continue;
+			}
+			it->second.position.x = m_snapshotSample.getFloatField(playerID,
+				PLAYER_POSITION_X);
+			it->second.position.y = m_snapshotSample.getFloatField(playerID,
+				PLAYER_POSITION_Y);
+			it->second.velocity.x = m_snapshotSample.getFloatField(playerID,
+				PLAYER_VELOCITY_X);
+			it->second.velocity.y = m_snapshotSample.getFloatField(playerID,
+				PLAYER_VELOCITY_Y);
+		}
 	}
 	m_spriteCamera.position = m_players[m_playerID].position;
 
@@ -403,6 +457,7 @@ void GameScene::disconnect() {
 	m_accepted = false;
 	m_playerID = 0;
 	m_players.clear();
+	m_snapshots.reset();
 	MW::NETWORK.disconnect();
 	MW::SetScene(&TestClient::CONNECT_SCENE);
 }
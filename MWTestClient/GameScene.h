@@ -121,6 +121,10 @@ private:
 	UI::TextArea m_statsArea;
 	// The floor sprite
 	Sprite m_floorSprite;
+	// The snapshots of the other players received from the server
+	NetSnapshotReceiver m_snapshots;
+	// The players' state sampled from the snapshots each update
+	NetSnapshot m_snapshotSample;
 
 	/*
 	* Update the stats text area
@@ -8,6 +8,16 @@
 #include "IntroScene.h"
 
 void IntroScene::init() {
+	// Start loading the assets of the later scenes
+	const std::string textures[] = { "button.png", "cursor.png", "cycle.png",
+		"cycle_arrow.png", "other.png", "pause_background.png", "self.png",
+		"slider.png", "switch.png", "text_area.png", "text_box.png" };
+	for (const std::string& texture : textures) {
+		m_textures.push_back(MW::RESOURCES.loadTexture("Assets/texture/"
+			+ texture));
+	}
+	m_font = MW::RESOURCES.loadFont("Assets/font/arial.ttf");
+
 	MWLOG(Info, IntroScene, "Initialized");
 }
 
@@ -40,7 +50,18 @@ void IntroScene::updateWindowSize() {
 }
 
 void IntroScene::update(float deltaTime) {
-
+	if (m_loaded) {
+		return;
+	}
+	for (const ResourceHandle<Texture>& texture : m_textures) {
+		if (!texture.isDone()) {
+			return;
+		}
+	}
+	if (m_font.isDone()) {
+		m_loaded = true;
+		MWLOG(Info, IntroScene, "Loaded assets in the background");
+	}
 }
 
 void IntroScene::exit() {
@@ -28,6 +28,11 @@ public:
 
 protected:
 	unsigned int m_slide = 0;
+	// The textures and font used by the later scenes, loaded in the
+	// background while the slides are shown
+	std::vector<ResourceHandle<Texture>> m_textures;
+	ResourceHandle<Font> m_font;
+	bool m_loaded = false;
 
 	void incrementSlide();
 };
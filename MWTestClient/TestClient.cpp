@@ -20,6 +20,9 @@ int main(int argc, char** argv) {
 	if (!Options::LoadOptions()) {
 		MWLOG(Warning, TestClient Main, "Failed to load options file.");
 	}
+	// Read assets from the pack made by MWAssetPacker if there is one,
+	// falling back to the loose files in Assets
+	MW::RESOURCES.mountPack("Assets.mwpack");
 
 	Scene* initialScene = nullptr;
 	if (Options::INITIALIZED && !FORCE_INTRO) {
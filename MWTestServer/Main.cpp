@@ -0,0 +1,30 @@
+/*
+* File:		Main.cpp
+* Author:	Keegan MacDonald (keeganm742@gmail.com)
+* Created:	2026.10.16
+*/
+
+#include "TestServer.h"
+
+using namespace Milkweed;
+
+int main(int argc, char** argv) {
+	if (glfwInit() != GLFW_TRUE) {
+		std::cout << "Failed to initialize GLEW" << std::endl;
+		return -1;
+	}
+
+	TestServer testServer(2773);
+	if (!testServer.init(1024, 1, true)) {
+		std::cout << "Failed to initialize server" << std::endl;
+	}
+
+	double startTime = glfwGetTime();
+	while (testServer.isActive()) {
+		double now = glfwGetTime();
+		testServer.step((float)(now - startTime));
+		startTime = now;
+	}
+
+	return 0;
+}
\ No newline at end of file
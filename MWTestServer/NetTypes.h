@@ -12,88 +12,111 @@
 
 #include <iostream>
 #include <Milkweed/Sprite.h>
+#include <Milkweed/Replication.h>
 
 using namespace Milkweed;
 
 /*
-* Enumerates the types of messages to be send between clients and server
+* Enumerates the types of messages to be send between clients and server, the
+* contents of each are written with a NetWriter and read with a NetReader in
+* the order listed
 */
 enum MessageTypes : unsigned int {
 	/*
-	* Contents in unpacking order:
-	* - The ID of the newly connected player (unsigned int).
+	* Contents in order:
+	* - The ID of the newly connected player (varint).
 	*/
 	CONNECT_PLAYER = 0,
 	/*
-	* Contents in unpacking order:
-	* - The ID of the newly accepted player (unsigned int).
-	* - The count of other players on the server (int).
-	* - A series of the other players' player IDs (unsigned int),
+	* Contents in order:
+	* - The ID of the newly accepted player (varint).
+	* - The count of other players on the server (varint).
+	* - A series of the other players' player IDs (varint),
 	* positions (glm::vec3), and velocities (glm::vec2).
 	*/
 	ACCEPT_PLAYER = 1,
 	/*
-	* Contents in unpacking order:
-	* - The length of the requested username (int).
-	* - A series of characters of the requested username (char).
+	* Contents in order:
+	* - The requested username (string).
 	*/
 	USERNAME_REQUEST = 2,
 	/*
-	* Contents in unpacking order:
-	* - The ID of the player being assigned a username (unsigned int).
-	* - The length of the assigned username (int).
-	* - A series of characters of the assigned username (char).
+	* Contents in order:
+	* - The ID of the player being assigned a username (varint).
+	* - The assigned username (string).
 	*/
 	USERNAME_ASSIGNMENT = 3,
 	/*
-	* Contents in unpacking order:
-	* - None, but should be echoed back if the server is in a good mood.
+	* Contents in order:
+	* - The ID of the pinging player (varint), echoed back to every client if
+	* the server is in a good mood.
 	*/
 	PING = 4,
 	/*
-	* Contents in unpacking order:
-	* - The ID of the newly disconnected player.
+	* Contents in order:
+	* - The ID of the newly disconnected player (varint).
 	*/
 	DISCONNECT_PLAYER = 5,
 	/*
-	* Contents in unpacking order:
+	* Contents in order:
 	* - The position of the player after requesting a movement left.
 	* - The velocity of the player after requesting a movement left.
 	*/
 	MOVEMENT_LEFT = 6,
 	/*
-	* Contents in unpacking order:
+	* Contents in order:
 	* - The position of the player after requesting a movement right.
 	* - The velocity of the player after requesting a movement right.
 	*/
 	MOVEMENT_RIGHT = 7,
 	/*
-	* Contents in unpacking order:
+	* Contents in order:
 	* - The position of the player after stopping a movement left.
 	* - The velocity of the player after stopping a movement left.
 	*/
 	MOVEMENT_STOP_LEFT = 8,
 	/*
-	* Contents in unpacking order:
+	* Contents in order:
 	* - The position of the player after stopping a movement right.
 	* - The velocity of the player after stopping a movement right.
 	*/
 	MOVEMENT_STOP_RIGHT = 9,
 	/*
-	* Contents in unpacking order:
+	* Contents in order:
 	* - The position of the player after requesting a jump.
 	* - The velocity of the player after requesting a jump.
 	*/
 	MOVEMENT_JUMP = 10,
 	/*
-	* Contents in unpacking order:
-	* - The ID of the player being updated.
+	* Contents in order:
+	* - The ID of the player being updated (varint).
 	* - The position of the player.
 	* - The velocity of the player.
 	*/
 	PLAYER_PV_UPDATE = 11,
 };
 
+/*
+* Enumerates the fields of each player in the server's snapshots
+*/
+enum PlayerFields : unsigned int {
+	PLAYER_POSITION_X = 0,
+	PLAYER_POSITION_Y = 1,
+	PLAYER_VELOCITY_X = 2,
+	PLAYER_VELOCITY_Y = 3,
+	PLAYER_FIELD_COUNT = 4,
+};
+
+/*
+* Get the description of each player field in the server's snapshots, all of
+* which are floats to interpolate
+*/
+inline std::vector<NetSnapshotField> getPlayerSnapshotFields() {
+	NetSnapshotField field;
+	field.interpolate = true;
+	return std::vector<NetSnapshotField>(PLAYER_FIELD_COUNT, field);
+}
+
 // Shared definition for game qualities
 #define PLAYER_SPAWNPOINT glm::vec3(0.0f, 0.0f, 0.0f)
 #define PLAYER_DIMENSIONS glm::vec2(35.0f, 60.0f)
@@ -104,6 +127,12 @@ enum MessageTypes : unsigned int {
 #define TOWN_FLOOR_Y 0.0f
 #define TOWN_BORDER_LEFT 0.0f
 #define TOWN_BORDER_RIGHT 1500.0f
+// The number of snapshots of the players the server sends per second
+#define SNAPSHOT_RATE 20.0f
+// The longest username a player can have
+#define MAX_USERNAME_LENGTH 20
+// The distance around a player within which it is sent the other players
+#define INTEREST_RADIUS 1000.0f
 
 /*
 * Structure for all information representing a general player
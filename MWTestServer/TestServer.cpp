@@ -12,6 +12,35 @@ TestServer::~TestServer() {
 	destroy();
 }
 
+#define PHYSICS_UPS 60.0f
+#define MAX_PHYSICS_STEPS 10
+
+void TestServer::step(float elapsed) {
+	// Update the messages from the network
+	update(-1);
+
+	// Update the physics in steps of no more than one physics update
+	float deltaTime = elapsed * PHYSICS_UPS;
+	unsigned int physicsSteps = 0;
+	while (deltaTime > 1.0f && physicsSteps < MAX_PHYSICS_STEPS) {
+		updatePhysics(1.0f);
+		deltaTime -= 1.0f;
+		physicsSteps++;
+	}
+	updatePhysics(deltaTime);
+
+	// Send the players' state at a fixed rate
+	float snapshotSPU = 1.0f / SNAPSHOT_RATE;
+	m_snapshotTime += elapsed;
+	if (m_snapshotTime >= snapshotSPU) {
+		sendSnapshots();
+		m_snapshotTime -= snapshotSPU;
+		if (m_snapshotTime > snapshotSPU) {
+			m_snapshotTime = 0.0f;
+		}
+	}
+}
+
 void TestServer::updatePhysics(float deltaTime) {
 	for (std::map<unsigned int, ServerPlayer>::iterator it = m_players.begin();
 		it != m_players.end(); ++it) {
@@ -19,6 +48,39 @@ void TestServer::updatePhysics(float deltaTime) {
 	}
 }
 
+void TestServer::sendSnapshots() {
+	NetSnapshot& snapshot = m_snapshots.beginSnapshot();
+	std::vector<std::shared_ptr<NetConnection>> clients;
+	for (const std::pair<unsigned int, ServerPlayer>& player : m_players) {
+		const ServerPlayer& p = player.second;
+		snapshot.setField(player.first, PLAYER_POSITION_X, p.position.x);
+		snapshot.setField(player.first, PLAYER_POSITION_Y, p.position.y);
+		snapshot.setField(player.first, PLAYER_VELOCITY_X, p.velocity.x);
+		snapshot.setField(player.first, PLAYER_VELOCITY_Y, p.velocity.y);
+		// Each client's area of interest follows its player
+		setClientInterest(player.first, p.position.x, p.position.y);
+		clients.push_back(p.m_client);
+	}
+
+	// Messaging a client can disconnect it and remove its player, so message
+	// from a copy of the client list
+	for (std::shared_ptr<NetConnection>& client : clients) {
+		unsigned int clientID = client->getID();
+		std::map<unsigned int, ServerPlayer>::iterator player
+			= m_players.find(clientID);
+		if (player == m_players.end()) {
+			continue;
+		}
+		// Players and clients share ID numbers, so the clients near a player
+		// are the players it should see
+		getNearbyClients(player->second.position.x,
+			player->second.position.y, m_nearbyPlayers);
+		NetMessage message;
+		m_snapshots.writeSnapshot(clientID, message, &m_nearbyPlayers);
+		messageClient(client, message, NetSendMode::UNRELIABLE_SEQUENCED);
+	}
+}
+
 bool TestServer::onConnect(std::shared_ptr<NetConnection> client) {
 	SERVERLOG(Info, "Connected player with ID ", client->getID());
 	unsigned int newClientID = client->getID();
@@ -30,23 +92,25 @@ bool TestServer::onConnect(std::shared_ptr<NetConnection> client) {
 	// Notify other players
 	NetMessage omsg;
 	omsg.header.ID = MessageTypes::CONNECT_PLAYER;
-	omsg << newClientID;
+	NetWriter(omsg).writeVarint(newClientID);
 	messageAllClients(omsg, client);
 	SERVERLOG(Info, "Notified other players of connection");
 
 	// Notify the player of connection acceptance
 	NetMessage cmsg;
 	cmsg.header.ID = MessageTypes::ACCEPT_PLAYER;
+	unsigned int otherCount = (unsigned int)m_players.size() - 1;
+	NetWriter writer(cmsg, 10 + otherCount
+		* (5 + sizeof(glm::vec3) + sizeof(glm::vec2)));
+	writer.writeVarint(newClientID);
+	writer.writeVarint(otherCount);
 	for (const std::pair<unsigned int, ServerPlayer>& player : m_players) {
-		unsigned int clientID = player.first;
-		if (clientID != newClientID) {
-			cmsg << m_players[clientID].velocity
-				<< m_players[clientID].position << clientID;
+		if (player.first != newClientID) {
+			writer.writeVarint(player.first);
+			writer.write(player.second.position);
+			writer.write(player.second.velocity);
 		}
 	}
-	int otherCount = m_players.size() - 1;
-	cmsg << otherCount;
-	cmsg << newClientID;
 	messageClient(client, cmsg);
 
 	// Send all other players' usernames to the new player
@@ -60,31 +124,25 @@ bool TestServer::onConnect(std::shared_ptr<NetConnection> client) {
 }
 
 void TestServer::onMessage(NetMessage& message) {
+	if (m_snapshots.processMessage(message)) {
+		return;
+	}
+
 	switch (message.header.ID) {
 	case MessageTypes::USERNAME_REQUEST: {
 		unsigned int clientID = message.owner->getID();
-		int length = 0;
-		message >> length;
-		if (length < 0) {
-			length = 0;
+		std::string username;
+		NetReader reader(message);
+		if (!reader.readString(username)) {
+			SERVERLOG(Warning, "Received invalid username request from ",
+				"client ", clientID);
 			break;
 		}
-		else if (length > 20) {
-			length = 20;
-		}
-		std::string username;
-		username.resize(length);
-		char c;
-		for (int i = 0; i < length; i++) {
-			message >> c;
-			if (c == 0) {
-				username.resize(i);
-				break;
-			}
-			username[i] = c;
+		if (username.length() > MAX_USERNAME_LENGTH) {
+			username.resize(MAX_USERNAME_LENGTH);
 		}
-		SERVERLOG(Info, "Received username \"", username, "\" (", length,
-			" characters) from client ", clientID);
+		SERVERLOG(Info, "Received username \"", username, "\" (",
+			username.length(), " characters) from client ", clientID);
 		m_players[clientID].username = username;
 		publishPlayerUsername(clientID);
 		break;
@@ -129,9 +187,10 @@ void TestServer::onDisconnect(std::shared_ptr<NetConnection> client) {
 	// Notify all connected clients of the disconnect
 	NetMessage dmsg;
 	dmsg.header.ID = MessageTypes::DISCONNECT_PLAYER;
-	dmsg << oldClientID;
+	NetWriter(dmsg).writeVarint(oldClientID);
 	messageAllClients(dmsg, client);
 	SERVERLOG(Info, "Notified all clients of disconnect");
+	m_snapshots.forgetClient(oldClientID);
 
 	// Remove the player
 	std::map<unsigned int, ServerPlayer>::iterator it
@@ -146,13 +205,9 @@ void TestServer::publishPlayerUsername(unsigned int clientID, int destID) {
 	// Construct the username assignment message
 	NetMessage umsg;
 	umsg.header.ID = MessageTypes::USERNAME_ASSIGNMENT;
-	const char* username = m_players[clientID].username.c_str();
-	int length = m_players[clientID].username.length();
-	for (int i = length - 1; i >= 0; i--) {
-		umsg << username[i];
-	}
-	umsg << length;
-	umsg << clientID;
+	NetWriter writer(umsg);
+	writer.writeVarint(clientID);
+	writer.writeString(m_players[clientID].username);
 
 	if (destID == -1) {
 		SERVERLOG(Info, "Publishing username of ", clientID, " to all clients");
@@ -169,18 +224,17 @@ void TestServer::sendPlayerPVUpdate(NetMessage& message) {
 	unsigned int clientID = message.owner->getID();
 	glm::vec3 position = glm::vec3();
 	glm::vec2 velocity = glm::vec2();
-	message >> position >> velocity;
+	NetReader reader(message);
+	if (!reader.read(position) || !reader.read(velocity)) {
+		SERVERLOG(Warning, "Received invalid movement from client ", clientID);
+		return;
+	}
 
 	if (validatePlayerMovement(clientID, position, velocity)) {
 		m_players[clientID].position = position;
 		m_players[clientID].velocity = velocity;
 	}
-
-	NetMessage pvUpdate;
-	pvUpdate.header.ID = MessageTypes::PLAYER_PV_UPDATE;
-	pvUpdate << clientID << m_players[clientID].position
-		<< m_players[clientID].velocity;
-	messageAllClients(pvUpdate, m_players[clientID].m_client);
+	// Other clients see the change in the next snapshot
 }
 
 bool TestServer::validatePlayerMovement(unsigned int clientID,
@@ -188,39 +242,4 @@ bool TestServer::validatePlayerMovement(unsigned int clientID,
 	// Ensure that the requested movement is within the bounds of the player's
 	// abilities.
 	return true;
-}
-
-#define PHYSICS_UPS 60.0f
-
-int main(int argc, char** argv) {
-	if (glfwInit() != GLFW_TRUE) {
-		std::cout << "Failed to initialize GLEW" << std::endl;
-		return -1;
-	}
-
-	TestServer testServer(2773);
-	if (!testServer.init()) {
-		std::cout << "Failed to initialize server" << std::endl;
-	}
-
-	double startTime = glfwGetTime();
-	unsigned int physicsSteps = 0, maxPhysicsSteps = 10;
-	float physicsSPU = 1.0f / 60.0f;
-	while (testServer.isActive()) {
-		// Update the messages from the network
-		testServer.update(-1);
-		double now = glfwGetTime();
-		float elapsed = (float)(now - startTime);
-		startTime = now;
-		float deltaTime = elapsed / physicsSPU;
-		while (deltaTime > 1.0f && physicsSteps < maxPhysicsSteps) {
-			testServer.updatePhysics(1.0f);
-			deltaTime -= 1.0f;
-			physicsSteps++;
-		}
-		testServer.updatePhysics(deltaTime);
-		physicsSteps = 0;
-	}
-
-	return 0;
 }
\ No newline at end of file
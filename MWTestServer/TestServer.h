@@ -21,17 +21,32 @@ public:
 	/*
 	* Construct the TestServer with a port.
 	*/
-	TestServer(unsigned int port) : NetServer(port) {}
+	TestServer(unsigned int port) : NetServer(port) {
+		m_snapshots.init(getPlayerSnapshotFields());
+		setInterestArea(INTEREST_RADIUS, INTEREST_RADIUS);
+	}
 	/*
 	* Destroy this server on deletion.
 	*/
 	~TestServer();
 	/*
+	* Process the messages from clients, update the physics and send
+	* snapshots when they are due
+	*
+	* @param elapsed: The time in seconds since the last step
+	*/
+	void step(float elapsed);
+	/*
 	* Update the physics of the server
 	* 
 	* @param deltaTime: The elapsed time since the last frame
 	*/
 	void updatePhysics(float deltaTime);
+	/*
+	* Send every client the changes to the players near it since the last
+	* snapshot it received
+	*/
+	void sendSnapshots();
 
 protected:
 	/*
@@ -50,6 +65,12 @@ protected:
 private:
 	// Map from client ID numbers to player information structures
 	std::map<unsigned int, ServerPlayer> m_players;
+	// The snapshots of the players sent to clients
+	NetSnapshotSender m_snapshots;
+	// The players near the client being sent a snapshot
+	std::vector<unsigned int> m_nearbyPlayers;
+	// The time in seconds since the last snapshot was due
+	float m_snapshotTime = 0.0f;
 
 	void publishPlayerUsername(unsigned int clientID, int destID = -1);
 	void sendPlayerPVUpdate(NetMessage& message);
@@ -0,0 +1,358 @@
+/*
+* File: AssetPack.cpp
+* Author: Keegan MacDonald (keeganm742@gmail.com)
+* Created: 2026.10.16
+*/
+
+#include <fstream>
+#include <cstring>
+
+#include "MW.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Milkweed {
+	// The letters at the start of every asset pack
+	const char ASSET_PACK_MAGIC[4] = { 'M', 'W', 'P', 'K' };
+	// The alignment of each asset's data in a pack
+	const std::uint64_t ASSET_PACK_ALIGNMENT = 16;
+
+	static_assert(sizeof(AssetPackHeader) == 40, "Unexpected pack layout");
+	static_assert(sizeof(AssetPackEntry) == 56, "Unexpected pack layout");
+	static_assert(sizeof(AssetPackFont) == 24, "Unexpected pack layout");
+	static_assert(sizeof(AssetPackGlyph) == 48, "Unexpected pack layout");
+
+	bool AssetPack::open(const std::string& fileName) {
+		close();
+		m_fileName = fileName;
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ,
+			FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+			nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			MWLOG(Info, AssetPack, "No asset pack at ", fileName);
+			return false;
+		}
+		m_file = file;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			MWLOG(Warning, AssetPack, "Asset pack ", fileName, " is empty");
+			close();
+			return false;
+		}
+		m_size = (size_t)size.QuadPart;
+		m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0,
+			nullptr);
+		if (m_mapping != nullptr) {
+			m_data = (const unsigned char*)MapViewOfFile(m_mapping,
+				FILE_MAP_READ, 0, 0, 0);
+		}
+#else
+		int file = ::open(fileName.c_str(), O_RDONLY);
+		if (file < 0) {
+			MWLOG(Info, AssetPack, "No asset pack at ", fileName);
+			return false;
+		}
+		struct stat status;
+		if (fstat(file, &status) != 0 || status.st_size == 0) {
+			MWLOG(Warning, AssetPack, "Asset pack ", fileName, " is empty");
+			::close(file);
+			return false;
+		}
+		m_size = (size_t)status.st_size;
+		void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+		// The mapping keeps the file open
+		::close(file);
+		if (data != MAP_FAILED) {
+			m_data = (const unsigned char*)data;
+		}
+#endif
+		if (m_data == nullptr) {
+			MWLOG(Warning, AssetPack, "Failed to map asset pack ", fileName,
+				" into memory");
+			close();
+			return false;
+		}
+
+		if (!validate()) {
+			MWLOG(Warning, AssetPack, "Asset pack ", fileName, " is invalid");
+			close();
+			return false;
+		}
+		m_header = (const AssetPackHeader*)m_data;
+		m_entries = (const AssetPackEntry*)(m_data + m_header->entriesOffset);
+		m_slots = (const std::uint32_t*)(m_data + m_header->slotsOffset);
+		m_names = (const char*)(m_data + m_header->namesOffset);
+
+		MWLOG(Info, AssetPack, "Opened asset pack ", fileName, " with ",
+			m_header->entryCount, " assets");
+		return true;
+	}
+
+	bool AssetPack::validate() const {
+		if (m_size < sizeof(AssetPackHeader)) {
+			return false;
+		}
+		const AssetPackHeader* header = (const AssetPackHeader*)m_data;
+		if (std::memcmp(header->magic, ASSET_PACK_MAGIC, 4) != 0
+			|| header->version != VERSION) {
+			return false;
+		}
+		// The slot count must be a power of two larger than the entry count
+		// so every search reaches an empty slot
+		if (header->slotCount <= header->entryCount
+			|| (header->slotCount & (header->slotCount - 1)) != 0) {
+			return false;
+		}
+		if (header->entriesOffset % 8 != 0 || header->slotsOffset % 4 != 0
+			|| header->entriesOffset > m_size || header->entryCount
+			> (m_size - header->entriesOffset) / sizeof(AssetPackEntry)
+			|| header->slotsOffset > m_size || header->slotCount
+			> (m_size - header->slotsOffset) / sizeof(std::uint32_t)
+			|| header->namesOffset > m_size) {
+			return false;
+		}
+
+		const AssetPackEntry* entries
+			= (const AssetPackEntry*)(m_data + header->entriesOffset);
+		const std::uint32_t* slots
+			= (const std::uint32_t*)(m_data + header->slotsOffset);
+		std::uint64_t namesSize = m_size - header->namesOffset;
+		for (std::uint32_t i = 0; i < header->entryCount; i++) {
+			const AssetPackEntry& entry = entries[i];
+			if ((std::uint64_t)entry.nameOffset + entry.nameLength > namesSize
+				|| entry.dataOffset > m_size
+				|| entry.dataSize > m_size - entry.dataOffset) {
+				return false;
+			}
+		}
+		for (std::uint32_t i = 0; i < header->slotCount; i++) {
+			if (slots[i] > header->entryCount) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void AssetPack::close() {
+#ifdef _WIN32
+		if (m_data != nullptr) {
+			UnmapViewOfFile(m_data);
+		}
+		if (m_mapping != nullptr) {
+			CloseHandle(m_mapping);
+		}
+		if (m_file != nullptr) {
+			CloseHandle(m_file);
+		}
+#else
+		if (m_data != nullptr) {
+			munmap((void*)m_data, m_size);
+		}
+#endif
+		m_data = nullptr;
+		m_size = 0;
+		m_file = nullptr;
+		m_mapping = nullptr;
+		m_header = nullptr;
+		m_entries = nullptr;
+		m_slots = nullptr;
+		m_names = nullptr;
+	}
+
+	const AssetPackEntry* AssetPack::find(const std::string& name) const {
+		if (m_header == nullptr) {
+			return nullptr;
+		}
+
+		// Probe the slots from the one the name hashes to until the asset or
+		// an empty slot is found
+		std::uint64_t hash = hashName(name);
+		std::uint32_t mask = m_header->slotCount - 1;
+		for (std::uint32_t slot = (std::uint32_t)hash & mask; ;
+			slot = (slot + 1) & mask) {
+			std::uint32_t index = m_slots[slot];
+			if (index == 0) {
+				return nullptr;
+			}
+			const AssetPackEntry& entry = m_entries[index - 1];
+			if (entry.nameHash == hash && entry.nameLength == name.size()
+				&& std::memcmp(m_names + entry.nameOffset, name.data(),
+					name.size()) == 0) {
+				return &entry;
+			}
+		}
+	}
+
+	std::uint64_t AssetPack::hashName(const std::string& name) {
+		std::uint64_t hash = 14695981039346656037ull;
+		for (char c : name) {
+			hash ^= (unsigned char)c;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	void AssetPackWriter::addTexture(const std::string& name,
+		const glm::ivec2& dimensions, const unsigned char* pixels) {
+		PendingAsset& asset = addAsset(name, AssetType::TEXTURE);
+		asset.entry.params[0] = (std::uint32_t)dimensions.x;
+		asset.entry.params[1] = (std::uint32_t)dimensions.y;
+		asset.data.assign(pixels, pixels + (size_t)dimensions.x
+			* dimensions.y * 4);
+	}
+
+	void AssetPackWriter::addSound(const std::string& name, int format,
+		int sampleRate, const unsigned char* samples, size_t size) {
+		PendingAsset& asset = addAsset(name, AssetType::SOUND);
+		asset.entry.params[0] = (std::uint32_t)format;
+		asset.entry.params[1] = (std::uint32_t)sampleRate;
+		asset.data.assign(samples, samples + size);
+	}
+
+	void AssetPackWriter::addFont(const std::string& name, const Font& font,
+		const glm::ivec2& atlasDimensions, const unsigned char* atlas) {
+		PendingAsset& asset = addAsset(name, AssetType::FONT);
+
+		AssetPackFont header;
+		header.maxCharacterHeight = font.maxCharacterHeight;
+		header.minCharacterHeight = font.minCharacterHeight;
+		header.pointSize = font.pointSize;
+		header.glyphCount = (std::uint32_t)font.characters.size();
+		header.atlasWidth = atlasDimensions.x;
+		header.atlasHeight = atlasDimensions.y;
+		size_t atlasSize = (size_t)atlasDimensions.x * atlasDimensions.y;
+		asset.data.resize(sizeof(header) + header.glyphCount
+			* sizeof(AssetPackGlyph) + atlasSize);
+		unsigned char* data = asset.data.data();
+		std::memcpy(data, &header, sizeof(header));
+		data += sizeof(header);
+
+		for (const std::pair<const char, Character>& pair : font.characters) {
+			const Character& character = pair.second;
+			AssetPackGlyph glyph;
+			glyph.character = pair.first;
+			glyph.width = character.dimensions.x;
+			glyph.height = character.dimensions.y;
+			glyph.bearingX = character.bearing.x;
+			glyph.bearingY = character.bearing.y;
+			glyph.offset = character.offset;
+			glyph.textureWidth = character.texture.dimensions.x;
+			glyph.textureHeight = character.texture.dimensions.y;
+			glyph.textureCoords[0] = character.texture.textureCoords.x;
+			glyph.textureCoords[1] = character.texture.textureCoords.y;
+			glyph.textureCoords[2] = character.texture.textureCoords.z;
+			glyph.textureCoords[3] = character.texture.textureCoords.w;
+			std::memcpy(data, &glyph, sizeof(glyph));
+			data += sizeof(glyph);
+		}
+		std::memcpy(data, atlas, atlasSize);
+	}
+
+	bool AssetPackWriter::write(const std::string& fileName) const {
+		// Lay the file out: header, entries, slots, names, then the data of
+		// each asset on a 16 byte boundary
+		AssetPackHeader header;
+		std::memcpy(header.magic, ASSET_PACK_MAGIC, 4);
+		header.version = AssetPack::VERSION;
+		header.entryCount = (std::uint32_t)m_assets.size();
+		header.slotCount = 16;
+		while (header.slotCount < header.entryCount * 2) {
+			header.slotCount *= 2;
+		}
+		header.entriesOffset = sizeof(AssetPackHeader);
+		header.slotsOffset = header.entriesOffset
+			+ (std::uint64_t)header.entryCount * sizeof(AssetPackEntry);
+		header.namesOffset = header.slotsOffset
+			+ (std::uint64_t)header.slotCount * sizeof(std::uint32_t);
+
+		std::vector<AssetPackEntry> entries;
+		std::string names;
+		std::uint64_t dataOffset = 0;
+		for (const PendingAsset& asset : m_assets) {
+			AssetPackEntry entry = asset.entry;
+			entry.nameOffset = (std::uint32_t)names.size();
+			entry.nameLength = (std::uint32_t)asset.name.size();
+			names += asset.name;
+			entry.dataOffset = dataOffset;
+			entry.dataSize = asset.data.size();
+			dataOffset += (asset.data.size() + ASSET_PACK_ALIGNMENT - 1)
+				/ ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+			entries.push_back(entry);
+		}
+		std::uint64_t dataStart = (header.namesOffset + names.size()
+			+ ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT
+			* ASSET_PACK_ALIGNMENT;
+
+		// Build the hash index with linear probing
+		std::vector<std::uint32_t> slots(header.slotCount, 0);
+		std::uint32_t mask = header.slotCount - 1;
+		for (std::uint32_t i = 0; i < header.entryCount; i++) {
+			entries[i].dataOffset += dataStart;
+			std::uint32_t slot = (std::uint32_t)entries[i].nameHash & mask;
+			while (slots[slot] != 0) {
+				slot = (slot + 1) & mask;
+			}
+			slots[slot] = i + 1;
+		}
+
+		std::ofstream file(fileName, std::ios::out | std::ios::binary
+			| std::ios::trunc);
+		if (file.fail()) {
+			MWLOG(Warning, AssetPack, "Failed to open ", fileName,
+				" for writing");
+			return false;
+		}
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)entries.data(),
+			entries.size() * sizeof(AssetPackEntry));
+		file.write((const char*)slots.data(),
+			slots.size() * sizeof(std::uint32_t));
+		file.write(names.data(), names.size());
+		const char padding[ASSET_PACK_ALIGNMENT] = { 0 };
+		std::uint64_t position = header.namesOffset + names.size();
+		for (unsigned int i = 0; i < m_assets.size(); i++) {
+			file.write(padding, entries[i].dataOffset - position);
+			file.write((const char*)m_assets[i].data.data(),
+				m_assets[i].data.size());
+			position = entries[i].dataOffset + m_assets[i].data.size();
+		}
+		if (file.fail()) {
+			MWLOG(Warning, AssetPack, "Failed to write asset pack ", fileName);
+			return false;
+		}
+
+		MWLOG(Info, AssetPack, "Wrote ", header.entryCount, " assets to ",
+			fileName, " (", position / 1024, " KB)");
+		return true;
+	}
+
+	AssetPackWriter::PendingAsset& AssetPackWriter::addAsset(
+		const std::string& name, AssetType type) {
+		PendingAsset* asset = nullptr;
+		for (PendingAsset& existing : m_assets) {
+			if (existing.name == name) {
+				asset = &existing;
+				break;
+			}
+		}
+		if (asset == nullptr) {
+			m_assets.emplace_back();
+			asset = &m_assets.back();
+			asset->name = name;
+		}
+		std::memset(&asset->entry, 0, sizeof(asset->entry));
+		asset->entry.nameHash = AssetPack::hashName(name);
+		asset->entry.type = type;
+		asset->data.clear();
+		return *asset;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,242 @@
+/*
+* File: AssetPack.h
+* Author: Keegan MacDonald (keeganm742@gmail.com)
+* Created: 2026.10.16
+*/
+
+#ifndef MW_ASSET_PACK_H
+#define MW_ASSET_PACK_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace Milkweed {
+	struct Font;
+
+	/*
+	* The kinds of asset stored in an asset pack
+	*/
+	enum class AssetType : std::uint32_t {
+		TEXTURE = 1,
+		SOUND = 2,
+		FONT = 3,
+	};
+
+	/*
+	* The header at the start of an asset pack file
+	*
+	* Asset packs are little endian. The header is followed by the entries, the
+	* hash index, the names of the assets and then their data, each asset's
+	* data starting on a 16 byte boundary
+	*/
+	struct AssetPackHeader {
+		// The letters MWPK
+		char magic[4];
+		// The version of the format the pack was written in
+		std::uint32_t version;
+		// The number of assets in the pack
+		std::uint32_t entryCount;
+		// The number of slots in the hash index, a power of two
+		std::uint32_t slotCount;
+		// The offsets of the entries, hash index and names in the file
+		std::uint64_t entriesOffset;
+		std::uint64_t slotsOffset;
+		std::uint64_t namesOffset;
+	};
+
+	/*
+	* The description of an asset in an asset pack
+	*/
+	struct AssetPackEntry {
+		// The hash of the asset's name
+		std::uint64_t nameHash;
+		// The position of the asset's name in the names and its length
+		std::uint32_t nameOffset;
+		std::uint32_t nameLength;
+		// The kind of asset
+		AssetType type;
+		std::uint32_t reserved;
+		// The offset of the asset's data in the file and its size in bytes
+		std::uint64_t dataOffset;
+		std::uint64_t dataSize;
+		// The width and height of a texture's RGBA pixels, or the OpenAL
+		// format and sample rate of a sound's samples
+		std::uint32_t params[4];
+	};
+
+	/*
+	* The start of a font's data in an asset pack, followed by its glyphs and
+	* then the one byte pixels of its atlas
+	*/
+	struct AssetPackFont {
+		float maxCharacterHeight;
+		float minCharacterHeight;
+		std::uint32_t pointSize;
+		std::uint32_t glyphCount;
+		std::int32_t atlasWidth;
+		std::int32_t atlasHeight;
+	};
+
+	/*
+	* A character of a font in an asset pack
+	*/
+	struct AssetPackGlyph {
+		std::int32_t character;
+		float width, height;
+		std::int32_t bearingX, bearingY;
+		std::uint32_t offset;
+		std::int32_t textureWidth, textureHeight;
+		// The rectangle of the character in the font's atlas in texture space
+		float textureCoords[4];
+	};
+
+	/*
+	* An asset pack file mapped into memory, read by the ResourceManager in
+	* place of loose asset files
+	*
+	* Assets are found with a hash index and their data is used straight from
+	* the mapped file, so opening a pack reads nothing but its header and
+	* entries. Finding assets is thread-safe once the pack is open
+	*/
+	class AssetPack {
+	public:
+		// The version of the format packs are written in
+		const static std::uint32_t VERSION = 1;
+
+		AssetPack() {}
+		/*
+		* The copy constructor is disabled for this class
+		*/
+		AssetPack(const AssetPack& pack) = delete;
+		/*
+		* Close this pack's file
+		*/
+		~AssetPack() { close(); }
+
+		/*
+		* Map an asset pack file into memory
+		*
+		* @param fileName: The file name of the pack on disk
+		* @return Whether the file was opened and is a valid pack
+		*/
+		bool open(const std::string& fileName);
+		/*
+		* Find an asset in this pack by its name
+		*
+		* @param name: The name of the asset, its file name when it was packed
+		* @return The asset's entry, nullptr if it is not in this pack
+		*/
+		const AssetPackEntry* find(const std::string& name) const;
+		/*
+		* Get the data of an asset in this pack
+		*/
+		const unsigned char* getData(const AssetPackEntry& entry) const {
+			return m_data + entry.dataOffset;
+		}
+		/*
+		* Get the number of assets in this pack
+		*/
+		unsigned int getAssetCount() const {
+			return m_header != nullptr ? m_header->entryCount : 0;
+		}
+		/*
+		* Get the file name of this pack on disk
+		*/
+		const std::string& getFileName() const { return m_fileName; }
+		/*
+		* Unmap this pack's file, invalidating all of its data
+		*/
+		void close();
+
+		/*
+		* Hash the name of an asset with 64 bit FNV-1a
+		*/
+		static std::uint64_t hashName(const std::string& name);
+
+	private:
+		// The file name of this pack on disk
+		std::string m_fileName;
+		// The mapped contents of the file and its size in bytes
+		const unsigned char* m_data = nullptr;
+		size_t m_size = 0;
+		// The handles of the file and its mapping on Windows
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+		// The parts of the file
+		const AssetPackHeader* m_header = nullptr;
+		const AssetPackEntry* m_entries = nullptr;
+		const std::uint32_t* m_slots = nullptr;
+		const char* m_names = nullptr;
+
+		/*
+		* Check that every part of the mapped file is inside it
+		*/
+		bool validate() const;
+	};
+
+	/*
+	* Collects decoded assets and writes them into an asset pack file
+	*/
+	class AssetPackWriter {
+	public:
+		/*
+		* Add a texture's RGBA pixels to the pack
+		*/
+		void addTexture(const std::string& name, const glm::ivec2& dimensions,
+			const unsigned char* pixels);
+		/*
+		* Add a sound's samples to the pack
+		*
+		* @param format: The OpenAL format of the samples
+		* @param sampleRate: The number of samples per second
+		*/
+		void addSound(const std::string& name, int format, int sampleRate,
+			const unsigned char* samples, size_t size);
+		/*
+		* Add a font and its atlas to the pack, the texture coordinates of the
+		* font's characters must already point into the atlas
+		*
+		* @param name: The name of the font, its file name and point size
+		* @param font: The font's characters and metrics
+		* @param atlasDimensions: The dimensions of the atlas in pixels
+		* @param atlas: The atlas' one byte pixels
+		*/
+		void addFont(const std::string& name, const Font& font,
+			const glm::ivec2& atlasDimensions, const unsigned char* atlas);
+		/*
+		* Get the number of assets added to this writer
+		*/
+		unsigned int getAssetCount() const {
+			return (unsigned int)m_assets.size();
+		}
+		/*
+		* Write every asset added to this writer into a pack file
+		*
+		* @param fileName: The file name of the pack on disk
+		* @return Whether the file could be written
+		*/
+		bool write(const std::string& fileName) const;
+
+	private:
+		/*
+		* An asset waiting to be written
+		*/
+		struct PendingAsset {
+			std::string name;
+			AssetPackEntry entry;
+			std::vector<unsigned char> data;
+		};
+
+		// The assets added to this writer
+		std::vector<PendingAsset> m_assets;
+
+		/*
+		* Add an asset, replacing any asset added with the same name
+		*/
+		PendingAsset& addAsset(const std::string& name, AssetType type);
+	};
+}
+
+#endif
\ No newline at end of file
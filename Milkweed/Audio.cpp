@@ -4,6 +4,8 @@
 * Created: 2020.12.16
 */
 
+#include <chrono>
+
 #include "MW.h"
 
 namespace Milkweed {
@@ -34,8 +36,10 @@ namespace Milkweed {
 		MWLOG(Info, AudioManager, "Opened OpenAL audio device \"",
 			alcGetString(m_device, ALC_ALL_DEVICES_SPECIFIER), "\"");
 
-		// Set up the music audio source
+		// Set up the music audio source and the buffers music is streamed
+		// through
 		m_musicSourceID = createSource(true);
+		alGenBuffers(MUSIC_BUFFER_COUNT, m_musicBuffers);
 
 		// Set up 10 initial sources for sound effects (more can be added later
 		// in playSound()
@@ -71,21 +75,59 @@ namespace Milkweed {
 		if (music == nullptr) {
 			return;
 		}
+		alSourcei(m_musicSourceID, AL_LOOPING, AL_TRUE);
 		alSourcei(m_musicSourceID, AL_BUFFER, music->soundID);
 		playMusic();
 	}
 
+	bool AudioManager::playMusic(const std::string& fileName, bool looping) {
+		stopMusic();
+		m_musicStream = AudioStream::open(fileName);
+		if (m_musicStream == nullptr) {
+			MWLOG(Warning, AudioManager, "Failed to stream music ", fileName);
+			return false;
+		}
+		m_musicLooping = looping;
+		// The stream loops itself, looping the source would repeat the
+		// chunks queued on it
+		alSourcei(m_musicSourceID, AL_LOOPING, AL_FALSE);
+		startMusicStream();
+		return true;
+	}
+
 	void AudioManager::playMusic() {
+		if (m_musicStream != nullptr) {
+			std::unique_lock<std::mutex> lock(m_musicMtx);
+			m_musicPaused = false;
+			if (!m_musicStreamEnded) {
+				alSourcePlay(m_musicSourceID);
+				return;
+			}
+			lock.unlock();
+
+			// The streamed track has played to its end, stream it again from
+			// the start
+			stopMusicStream();
+			alSourcei(m_musicSourceID, AL_BUFFER, 0);
+			m_musicStream->rewind();
+			startMusicStream();
+			return;
+		}
 		alSourcePlay(m_musicSourceID);
 	}
 
 	void AudioManager::pauseMusic() {
+		std::lock_guard<std::mutex> lock(m_musicMtx);
+		m_musicPaused = true;
 		alSourcePause(m_musicSourceID);
 	}
 
 	void AudioManager::stopMusic() {
+		stopMusicStream();
 		alSourceStop(m_musicSourceID);
 		alSourcei(m_musicSourceID, AL_BUFFER, 0);
+		m_musicStream.reset();
+		m_musicPaused = false;
 	}
 
 	void AudioManager::playSound(const Sound* sound) {
@@ -122,6 +164,10 @@ namespace Milkweed {
 	}
 
 	void AudioManager::destroy() {
+		// Stop streaming music before its buffers are deleted
+		stopMusic();
+		alDeleteBuffers(MUSIC_BUFFER_COUNT, m_musicBuffers);
+
 		int count = 1;
 		// Delete the music and sound effect sources
 		alDeleteSources(1, &m_musicSourceID);
@@ -164,4 +210,98 @@ namespace Milkweed {
 		alGetSourcei(source, AL_SOURCE_STATE, &state);
 		return state;
 	}
+
+	void AudioManager::startMusicStream() {
+		m_stopMusicThread = false;
+		m_musicStreamEnded = false;
+		m_musicThread = std::thread([this]() { runMusicStream(); });
+	}
+
+	void AudioManager::stopMusicStream() {
+		if (!m_musicThread.joinable()) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_musicMtx);
+			m_stopMusicThread = true;
+		}
+		m_musicCV.notify_all();
+		m_musicThread.join();
+	}
+
+	void AudioManager::runMusicStream() {
+		// OpenAL's context is current on every thread, so the buffers can be
+		// filled and queued from here. Each buffer holds a fixed length of
+		// the track in whole frames
+		std::vector<unsigned char> chunk((size_t)m_musicStream->getSampleRate()
+			* MUSIC_BUFFER_MILLISECONDS / 1000 * m_musicStream->getFrameSize());
+		unsigned int queued = 0;
+		for (ALuint buffer : m_musicBuffers) {
+			if (!fillMusicBuffer(buffer, chunk)) {
+				break;
+			}
+			alSourceQueueBuffers(m_musicSourceID, 1, &buffer);
+			queued++;
+		}
+		bool ended = queued < MUSIC_BUFFER_COUNT;
+
+		while (true) {
+			// Refill the buffers which have finished playing and queue them
+			// again behind the rest
+			ALint processed = 0;
+			alGetSourcei(m_musicSourceID, AL_BUFFERS_PROCESSED, &processed);
+			for (ALint i = 0; i < processed; i++) {
+				ALuint buffer = 0;
+				alSourceUnqueueBuffers(m_musicSourceID, 1, &buffer);
+				queued--;
+				if (!ended && fillMusicBuffer(buffer, chunk)) {
+					alSourceQueueBuffers(m_musicSourceID, 1, &buffer);
+					queued++;
+				}
+				else {
+					ended = true;
+				}
+			}
+
+			std::unique_lock<std::mutex> lock(m_musicMtx);
+			if (queued == 0) {
+				// Every chunk of the track has been played
+				m_musicStreamEnded = true;
+				return;
+			}
+			// Start the source once the first chunks are queued, or again if
+			// it ran out of chunks before the next were decoded. A source only
+			// stops with every buffer processed, so wait for them to be
+			// refilled rather than replaying them
+			ALint state = getSourceState(m_musicSourceID);
+			alGetSourcei(m_musicSourceID, AL_BUFFERS_PROCESSED, &processed);
+			if (!m_musicPaused && processed == 0
+				&& (state == AL_INITIAL || state == AL_STOPPED)) {
+				alSourcePlay(m_musicSourceID);
+			}
+			if (m_musicCV.wait_for(lock, std::chrono::milliseconds(10),
+				[this]() { return m_stopMusicThread; })) {
+				return;
+			}
+		}
+	}
+
+	bool AudioManager::fillMusicBuffer(ALuint buffer,
+		std::vector<unsigned char>& chunk) {
+		size_t size = m_musicStream->read(chunk.data(), chunk.size());
+		// A track which turns out to be corrupt ends instead of looping
+		if (size < chunk.size() && m_musicLooping
+			&& !m_musicStream->hasFailed() && m_musicStream->rewind()) {
+			// Fill the rest of the chunk from the start of the track so it
+			// loops without a gap
+			size += m_musicStream->read(chunk.data() + size,
+				chunk.size() - size);
+		}
+		if (size == 0) {
+			return false;
+		}
+		alBufferData(buffer, m_musicStream->getFormat(), chunk.data(),
+			(ALsizei)size, m_musicStream->getSampleRate());
+		return true;
+	}
 }
\ No newline at end of file
@@ -9,8 +9,13 @@
 
 #include <AL/al.h>
 #include <AL/alc.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 #include "Resources.h"
+#include "AudioStream.h"
 
 namespace Milkweed {
 	/*
@@ -66,6 +71,19 @@ namespace Milkweed {
 		*/
 		void playMusic(const Sound* sound);
 		/*
+		* Stream a music track from a file, decoding it a chunk at a time on a
+		* background thread and queueing the chunks on the music source
+		*
+		* Only a few chunks of the track are in memory at once however long
+		* it is, and it starts playing as soon as the first chunks are
+		* decoded
+		*
+		* @param fileName: The file name of the track on disk
+		* @param looping: Whether to start the track again when it ends
+		* @return Whether the file could be opened
+		*/
+		bool playMusic(const std::string& fileName, bool looping = true);
+		/*
 		* Play the most recently played music track
 		*/
 		void playMusic();
@@ -111,6 +129,28 @@ namespace Milkweed {
 		// The audio sources for sound effects
 		std::vector<ALuint> m_effectSources;
 
+		// The number of buffers queued on the music source while streaming
+		const static unsigned int MUSIC_BUFFER_COUNT = 4;
+		// The length of the audio in each streaming buffer in milliseconds
+		const static unsigned int MUSIC_BUFFER_MILLISECONDS = 250;
+		// The buffers streamed music is decoded into in turn
+		ALuint m_musicBuffers[MUSIC_BUFFER_COUNT] = {};
+		// The music track being streamed, nullptr if none is
+		std::unique_ptr<AudioStream> m_musicStream;
+		// Whether the streamed track starts again when it ends
+		bool m_musicLooping = true;
+		// The thread which decodes and queues the streamed track
+		std::thread m_musicThread;
+		// Guards starting and pausing the music source between threads
+		std::mutex m_musicMtx;
+		std::condition_variable m_musicCV;
+		// Whether the music thread should stop
+		bool m_stopMusicThread = false;
+		// Whether the music was paused, so the music thread leaves it paused
+		bool m_musicPaused = false;
+		// Whether the streamed track has played to its end
+		bool m_musicStreamEnded = false;
+
 		/*
 		* Create a new OpenAL audio source to play a sound effect
 		*/
@@ -119,6 +159,29 @@ namespace Milkweed {
 		* Get the current state of an OpenAL audio source
 		*/
 		ALint getSourceState(ALuint source);
+		/*
+		* Start the music thread streaming the music track from its current
+		* position
+		*/
+		void startMusicStream();
+		/*
+		* Stop the music thread and wait for it to finish
+		*/
+		void stopMusicStream();
+		/*
+		* Decode and queue chunks of the music track until the music thread
+		* is stopped or the track ends
+		*/
+		void runMusicStream();
+		/*
+		* Decode the next chunk of the music track into a buffer, starting the
+		* track again if it ends and is looping
+		*
+		* @param buffer: The OpenAL buffer to fill
+		* @param chunk: The memory to decode into, as large as a chunk
+		* @return Whether there was any more of the track
+		*/
+		bool fillMusicBuffer(ALuint buffer, std::vector<unsigned char>& chunk);
 	};
 }
 
@@ -0,0 +1,428 @@
+/*
+* File: AudioStream.cpp
+* Author: Keegan MacDonald (keeganm742@gmail.com)
+* Created: 2026.10.16
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+// libFLAC is linked statically from Deps
+#define FLAC__NO_DLL
+#include <FLAC/stream_decoder.h>
+#define OV_EXCLUDE_STATIC_CALLBACKS
+#include <vorbis/vorbisfile.h>
+
+#include "MW.h"
+
+namespace Milkweed {
+	std::unique_ptr<AudioStream> AudioStream::open(
+		const std::string& fileName) {
+		std::string extension = fileName.substr(std::min(fileName.size(),
+			fileName.find_last_of('.')));
+		std::transform(extension.begin(), extension.end(), extension.begin(),
+			[](char c) { return (char)std::tolower(c); });
+
+		if (extension == ".wav") {
+			std::unique_ptr<WAVStream> stream = std::make_unique<WAVStream>();
+			if (!stream->open(fileName)) {
+				return nullptr;
+			}
+			return stream;
+		}
+		else if (extension == ".flac") {
+			std::unique_ptr<FLACStream> stream
+				= std::make_unique<FLACStream>();
+			if (!stream->open(fileName)) {
+				return nullptr;
+			}
+			return stream;
+		}
+		else if (extension == ".ogg") {
+			std::unique_ptr<VorbisStream> stream
+				= std::make_unique<VorbisStream>();
+			if (!stream->open(fileName)) {
+				return nullptr;
+			}
+			return stream;
+		}
+
+		MWLOG(Warning, AudioStream, "Can't decode audio file ", fileName,
+			", only WAV, FLAC and Ogg Vorbis files are supported");
+		return nullptr;
+	}
+
+	bool AudioStream::setFormat(unsigned int channels,
+		unsigned int bitsPerSample, unsigned int sampleRate) {
+		if (channels == 1 && bitsPerSample == 8) {
+			m_format = AL_FORMAT_MONO8;
+		}
+		else if (channels == 1 && bitsPerSample == 16) {
+			m_format = AL_FORMAT_MONO16;
+		}
+		else if (channels == 2 && bitsPerSample == 8) {
+			m_format = AL_FORMAT_STEREO8;
+		}
+		else if (channels == 2 && bitsPerSample == 16) {
+			m_format = AL_FORMAT_STEREO16;
+		}
+		else {
+			MWLOG(Warning, AudioStream, "OpenAL can't play ", channels,
+				" channels of ", bitsPerSample, " bit samples");
+			return false;
+		}
+		if (sampleRate == 0) {
+			MWLOG(Warning, AudioStream, "Audio has a sample rate of 0");
+			return false;
+		}
+		m_sampleRate = (ALsizei)sampleRate;
+		m_frameSize = channels * bitsPerSample / 8;
+		return true;
+	}
+
+	bool WAVStream::open(const std::string& fileName) {
+		m_file.open(fileName, std::ios::in | std::ios::binary);
+		if (!m_file.is_open()) {
+			MWLOG(Warning, AudioStream, "Failed to open WAV file ", fileName);
+			return false;
+		}
+
+		// Check the RIFF header
+		char header[12];
+		if (!m_file.read(header, 12) || std::strncmp(header, "RIFF", 4) != 0
+			|| std::strncmp(header + 8, "WAVE", 4) != 0) {
+			MWLOG(Warning, AudioStream, "File ", fileName, " is in invalid ",
+				"WAVE format");
+			return false;
+		}
+
+		// Walk the chunks until the format and the samples have been found,
+		// skipping any others such as LIST
+		bool formatFound = false;
+		while (true) {
+			char chunk[8];
+			if (!m_file.read(chunk, 8)) {
+				MWLOG(Warning, AudioStream, "WAV file ", fileName, " has no ",
+					formatFound ? "audio data" : "format chunk");
+				return false;
+			}
+			std::uint32_t chunkSize = 0;
+			std::memcpy(&chunkSize, chunk + 4, 4);
+
+			if (std::strncmp(chunk, "fmt ", 4) == 0) {
+				unsigned char format[16];
+				if (chunkSize < 16 || !m_file.read((char*)format, 16)) {
+					MWLOG(Warning, AudioStream, "Failed to read the format of ",
+						"WAV file ", fileName);
+					return false;
+				}
+				std::uint16_t audioFormat = (std::uint16_t)(format[0]
+					| format[1] << 8);
+				std::uint16_t channels = (std::uint16_t)(format[2]
+					| format[3] << 8);
+				std::uint32_t sampleRate = (std::uint32_t)format[4]
+					| (std::uint32_t)format[5] << 8
+					| (std::uint32_t)format[6] << 16
+					| (std::uint32_t)format[7] << 24;
+				std::uint16_t bitsPerSample = (std::uint16_t)(format[14]
+					| format[15] << 8);
+				// Only integer PCM samples can be played, 0xFFFE is the
+				// extensible form of the PCM format
+				if (audioFormat != 1 && audioFormat != 0xFFFE) {
+					MWLOG(Warning, AudioStream, "WAV file ", fileName,
+						" is not in PCM format");
+					return false;
+				}
+				if (!setFormat(channels, bitsPerSample, sampleRate)) {
+					MWLOG(Warning, AudioStream, "WAV file ", fileName,
+						" is in invalid format for OpenAL");
+					return false;
+				}
+				formatFound = true;
+				m_file.seekg(chunkSize - 16 + (chunkSize & 1), std::ios::cur);
+			}
+			else if (std::strncmp(chunk, "data", 4) == 0) {
+				if (!formatFound) {
+					MWLOG(Warning, AudioStream, "WAV file ", fileName,
+						" has audio data before its format");
+					return false;
+				}
+				m_dataStart = m_file.tellg();
+				m_dataSize = chunkSize - chunkSize % m_frameSize;
+				m_position = 0;
+				return true;
+			}
+			else {
+				m_file.seekg(chunkSize + (chunkSize & 1), std::ios::cur);
+			}
+		}
+	}
+
+	size_t WAVStream::read(unsigned char* out, size_t size) {
+		size_t count = (size_t)std::min<std::uint64_t>(size,
+			m_dataSize - m_position);
+		m_file.read((char*)out, count);
+		count = (size_t)m_file.gcount();
+		// Stop at the last whole frame if the file ends early
+		count -= count % m_frameSize;
+		m_position += count;
+		if (count < size) {
+			m_dataSize = m_position;
+		}
+		return count;
+	}
+
+	bool WAVStream::rewind() {
+		m_file.clear();
+		m_position = 0;
+		return m_file.seekg(m_dataStart, std::ios::beg).good();
+	}
+
+	/*
+	* The callbacks libFLAC decodes a FLACStream's file through, each is
+	* given the stream as its client data
+	*/
+	struct FLACStream::Callbacks {
+		static FLAC__StreamDecoderWriteStatus write(
+			const FLAC__StreamDecoder* decoder, const FLAC__Frame* frame,
+			const FLAC__int32* const buffer[], void* clientData) {
+			FLACStream* stream = (FLACStream*)clientData;
+			if (stream->m_lostSync && !stream->m_failed) {
+				MWLOG(Warning, AudioStream, "Stopped at corrupt FLAC data "
+					"between frames");
+				stream->m_failed = true;
+			}
+			if (stream->m_failed) {
+				// libFLAC still passes on a frame which failed its CRC, as
+				// silence, so drop it and stop
+				return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+			}
+			if (frame->header.channels != stream->m_channels
+				|| frame->header.bits_per_sample != stream->m_bitsPerSample) {
+				MWLOG(Warning, AudioStream, "FLAC frame has ",
+					frame->header.channels, " channels of ",
+					frame->header.bits_per_sample, " bit samples, unlike ",
+					"the rest of its file");
+				stream->m_failed = true;
+				return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+			}
+
+			unsigned int blockSize = frame->header.blocksize;
+			stream->m_samples.resize((size_t)stream->m_channels * blockSize);
+			for (unsigned int c = 0; c < stream->m_channels; c++) {
+				std::memcpy(stream->m_samples.data() + (size_t)c * blockSize,
+					buffer[c], blockSize * sizeof(std::int32_t));
+			}
+			stream->m_blockSize = blockSize;
+			stream->m_blockPosition = 0;
+			stream->m_samplesDecoded += blockSize;
+			return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+		}
+
+		static void metadata(const FLAC__StreamDecoder* decoder,
+			const FLAC__StreamMetadata* metadata, void* clientData) {
+			FLACStream* stream = (FLACStream*)clientData;
+			if (metadata->type == FLAC__METADATA_TYPE_STREAMINFO) {
+				const FLAC__StreamMetadata_StreamInfo& info
+					= metadata->data.stream_info;
+				stream->m_channels = info.channels;
+				stream->m_bitsPerSample = info.bits_per_sample;
+				stream->m_fileSampleRate = info.sample_rate;
+				stream->m_totalSamples = info.total_samples;
+			}
+		}
+
+		static void error(const FLAC__StreamDecoder* decoder,
+			FLAC__StreamDecoderErrorStatus status, void* clientData) {
+			FLACStream* stream = (FLACStream*)clientData;
+			if (status == FLAC__STREAM_DECODER_ERROR_STATUS_LOST_SYNC) {
+				// Data which isn't a frame is only corrupt if another frame
+				// follows it, otherwise it is a tag after the last frame
+				stream->m_lostSync = true;
+				return;
+			}
+			if (!stream->m_failed) {
+				MWLOG(Warning, AudioStream, "Stopped at corrupt FLAC data: ",
+					FLAC__StreamDecoderErrorStatusString[status]);
+			}
+			stream->m_failed = true;
+		}
+	};
+
+	FLACStream::~FLACStream() {
+		if (m_decoder != nullptr) {
+			FLAC__StreamDecoder* decoder = (FLAC__StreamDecoder*)m_decoder;
+			FLAC__stream_decoder_finish(decoder);
+			FLAC__stream_decoder_delete(decoder);
+		}
+	}
+
+	bool FLACStream::open(const std::string& fileName) {
+		FLAC__StreamDecoder* decoder = FLAC__stream_decoder_new();
+		if (decoder == nullptr) {
+			MWLOG(Warning, AudioStream, "Failed to create a FLAC decoder");
+			return false;
+		}
+		m_decoder = decoder;
+
+		// libFLAC checks the CRC of every frame's header and contents, and
+		// skips an ID3v2 tag in front of the stream
+		if (FLAC__stream_decoder_init_file(decoder, fileName.c_str(),
+			Callbacks::write, Callbacks::metadata, Callbacks::error, this)
+			!= FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+			MWLOG(Warning, AudioStream, "Failed to open FLAC file ", fileName);
+			return false;
+		}
+		if (!FLAC__stream_decoder_process_until_end_of_metadata(decoder)
+			|| m_failed || m_channels == 0) {
+			MWLOG(Warning, AudioStream, "File ", fileName, " is in invalid ",
+				"FLAC format");
+			return false;
+		}
+		if (m_bitsPerSample < 4 || m_bitsPerSample > 24
+			|| !setFormat(m_channels, m_bitsPerSample <= 8 ? 8 : 16,
+				m_fileSampleRate)) {
+			MWLOG(Warning, AudioStream, "FLAC file ", fileName, " has ",
+				m_channels, " channels of ", m_bitsPerSample, " bit samples, ",
+				"which can't be played");
+			return false;
+		}
+		return true;
+	}
+
+	size_t FLACStream::read(unsigned char* out, size_t size) {
+		FLAC__StreamDecoder* decoder = (FLAC__StreamDecoder*)m_decoder;
+		size_t frames = size / m_frameSize;
+		size_t written = 0;
+		while (written < frames) {
+			if (m_blockPosition >= m_blockSize) {
+				// Decode the next frame, which calls back with its samples
+				m_blockSize = 0;
+				m_blockPosition = 0;
+				if (m_failed) {
+					break;
+				}
+				bool decoded = FLAC__stream_decoder_process_single(decoder)
+					!= 0;
+				if (m_failed) {
+					break;
+				}
+				if (m_blockSize == 0) {
+					bool ended = FLAC__stream_decoder_get_state(decoder)
+						== FLAC__STREAM_DECODER_END_OF_STREAM;
+					if (decoded && !ended) {
+						// A metadata block, go on to the next frame
+						continue;
+					}
+					// A file cut short, or whose last frame is too corrupt to
+					// be found, has fewer samples than its STREAMINFO says
+					if (!ended || (m_totalSamples != 0
+						&& m_samplesDecoded < m_totalSamples)) {
+						MWLOG(Warning, AudioStream, "FLAC file ended after ",
+							m_samplesDecoded, " of its ", m_totalSamples,
+							" samples");
+						m_failed = true;
+					}
+					break;
+				}
+			}
+
+			// Interleave the channels of the frame, scaling the samples to
+			// the size they are played at
+			unsigned int count = (unsigned int)std::min<size_t>(
+				frames - written, m_blockSize - m_blockPosition);
+			for (unsigned int i = 0; i < count; i++) {
+				for (unsigned int c = 0; c < m_channels; c++) {
+					std::int32_t sample = m_samples[(size_t)c * m_blockSize
+						+ m_blockPosition + i];
+					if (m_bitsPerSample <= 8) {
+						// 8 bit samples are unsigned
+						*out++ = (unsigned char)(((std::uint32_t)sample
+							<< (8 - m_bitsPerSample)) + 128);
+						continue;
+					}
+					if (m_bitsPerSample > 16) {
+						sample >>= m_bitsPerSample - 16;
+					}
+					else {
+						sample = (std::int32_t)((std::uint32_t)sample
+							<< (16 - m_bitsPerSample));
+					}
+					*out++ = (unsigned char)(sample & 0xFF);
+					*out++ = (unsigned char)((sample >> 8) & 0xFF);
+				}
+			}
+			m_blockPosition += count;
+			written += count;
+		}
+		return written * m_frameSize;
+	}
+
+	bool FLACStream::rewind() {
+		// Resetting the decoder seeks its file back to the start and reads
+		// the metadata again on the next frame
+		FLAC__StreamDecoder* decoder = (FLAC__StreamDecoder*)m_decoder;
+		m_failed = false;
+		m_lostSync = false;
+		m_samplesDecoded = 0;
+		m_blockSize = 0;
+		m_blockPosition = 0;
+		return FLAC__stream_decoder_reset(decoder) != 0;
+	}
+
+	VorbisStream::VorbisStream() : m_file(std::make_unique<OggVorbis_File>()) {}
+
+	VorbisStream::~VorbisStream() {
+		if (m_opened) {
+			ov_clear(m_file.get());
+		}
+	}
+
+	bool VorbisStream::open(const std::string& fileName) {
+		if (ov_fopen(fileName.c_str(), m_file.get()) != 0) {
+			MWLOG(Warning, AudioStream, "File ", fileName, " is not a valid ",
+				"Ogg Vorbis file");
+			return false;
+		}
+		m_opened = true;
+
+		vorbis_info* info = ov_info(m_file.get(), -1);
+		if (info == nullptr || !setFormat((unsigned int)info->channels, 16,
+			(unsigned int)info->rate)) {
+			MWLOG(Warning, AudioStream, "Ogg Vorbis file ", fileName,
+				" is in invalid format for OpenAL");
+			return false;
+		}
+		return true;
+	}
+
+	size_t VorbisStream::read(unsigned char* out, size_t size) {
+		size_t written = 0;
+		while (written < size) {
+			// Decode little endian, signed 16 bit samples
+			int section = 0;
+			long count = ov_read(m_file.get(), (char*)out + written,
+				(int)std::min<size_t>(size - written, 1 << 30), 0, 2, 1,
+				&section);
+			if (count == OV_HOLE) {
+				// A gap in the data, keep going from after it
+				continue;
+			}
+			if (count < 0) {
+				MWLOG(Warning, AudioStream, "Stopped at corrupt Ogg Vorbis ",
+					"data");
+				m_failed = true;
+			}
+			if (count <= 0) {
+				break;
+			}
+			written += (size_t)count;
+		}
+		return written;
+	}
+
+	bool VorbisStream::rewind() {
+		m_failed = false;
+		return ov_pcm_seek(m_file.get(), 0) == 0;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,197 @@
+/*
+* File: AudioStream.h
+* Author: Keegan MacDonald (keeganm742@gmail.com)
+* Created: 2026.10.16
+*/
+
+#ifndef MW_AUDIO_STREAM_H
+#define MW_AUDIO_STREAM_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <memory>
+#include <cstdint>
+#include <AL/al.h>
+
+// The decoder state of libvorbisfile, from vorbis/vorbisfile.h
+struct OggVorbis_File;
+
+namespace Milkweed {
+	/*
+	* A sound file decoded into PCM samples a chunk at a time, so long tracks
+	* can be played without holding all of their samples in memory
+	*
+	* A stream is not thread-safe, but may be used from any one thread at a
+	* time
+	*/
+	class AudioStream {
+	public:
+		/*
+		* Open a sound file as a stream, choosing its decoder by its extension
+		*
+		* @param fileName: The file name of the sound on disk
+		* @return The stream, nullptr if the file could not be opened
+		*/
+		static std::unique_ptr<AudioStream> open(const std::string& fileName);
+
+		virtual ~AudioStream() {}
+		/*
+		* Decode the next samples of this stream
+		*
+		* @param out: The buffer to write the samples into
+		* @param size: The most bytes to write, a multiple of the frame size
+		* @return The number of bytes written, less than size only once the
+		* end of the stream is reached
+		*/
+		virtual size_t read(unsigned char* out, size_t size) = 0;
+		/*
+		* Go back to the start of this stream
+		*
+		* @return Whether the stream could be rewound
+		*/
+		virtual bool rewind() = 0;
+		/*
+		* Get the OpenAL format of this stream's samples
+		*/
+		ALenum getFormat() const { return m_format; }
+		/*
+		* Get the number of frames per second of this stream
+		*/
+		ALsizei getSampleRate() const { return m_sampleRate; }
+		/*
+		* Get the size of one sample of every channel in bytes
+		*/
+		unsigned int getFrameSize() const { return m_frameSize; }
+		/*
+		* Test whether this stream stopped part way through because the file
+		* is corrupt, the samples read before it stopped are still valid
+		*/
+		bool hasFailed() const { return m_failed; }
+
+	protected:
+		// The OpenAL format of the samples
+		ALenum m_format = 0;
+		// The number of frames per second
+		ALsizei m_sampleRate = 0;
+		// The size of one sample of every channel in bytes
+		unsigned int m_frameSize = 0;
+		// Whether decoding stopped because the file is corrupt
+		bool m_failed = false;
+
+		/*
+		* Set the format of this stream's samples from its header
+		*
+		* @return Whether OpenAL can play samples in the format
+		*/
+		bool setFormat(unsigned int channels, unsigned int bitsPerSample,
+			unsigned int sampleRate);
+	};
+
+	/*
+	* A stream of the PCM samples in a RIFF/WAVE file
+	*/
+	class WAVStream : public AudioStream {
+	public:
+		/*
+		* Open a WAVE file and read its header
+		*
+		* @param fileName: The file name of the sound on disk
+		* @return Whether the file is a WAVE file OpenAL can play
+		*/
+		bool open(const std::string& fileName);
+		size_t read(unsigned char* out, size_t size) override;
+		bool rewind() override;
+
+	private:
+		// The file being read
+		std::ifstream m_file;
+		// The position of the samples in the file and their size in bytes
+		std::streamoff m_dataStart = 0;
+		std::uint64_t m_dataSize = 0;
+		// The number of bytes of samples read so far
+		std::uint64_t m_position = 0;
+	};
+
+	/*
+	* A stream of the samples in a FLAC file, decoded by libFLAC a frame at a
+	* time
+	*
+	* Files of one or two channels of 4 to 24 bit samples are supported,
+	* samples of more than 8 bits are played as 16 bit samples. A frame whose
+	* header or contents fail their CRC ends the stream, as does anything
+	* between frames which isn't one or the file ending early
+	*/
+	class FLACStream : public AudioStream {
+	public:
+		/*
+		* Close the file
+		*/
+		~FLACStream();
+
+		/*
+		* Open a FLAC file and read its metadata
+		*
+		* @param fileName: The file name of the sound on disk
+		* @return Whether the file is a FLAC file OpenAL can play
+		*/
+		bool open(const std::string& fileName);
+		size_t read(unsigned char* out, size_t size) override;
+		bool rewind() override;
+
+	private:
+		// The functions libFLAC calls back with the file's metadata, frames
+		// and errors, defined with the decoder
+		struct Callbacks;
+
+		// The decoder of the file, a FLAC__StreamDecoder from libFLAC's
+		// stream_decoder.h, which can't be declared ahead as it is unnamed
+		void* m_decoder = nullptr;
+		// The format of the file from its STREAMINFO block
+		unsigned int m_channels = 0;
+		unsigned int m_bitsPerSample = 0;
+		unsigned int m_fileSampleRate = 0;
+		// The number of samples in each channel of the file, 0 if unknown,
+		// and the number decoded so far
+		std::uint64_t m_totalSamples = 0, m_samplesDecoded = 0;
+		// Whether the decoder has skipped data which isn't a frame
+		bool m_lostSync = false;
+		// The samples of each channel of the last frame decoded, one channel
+		// after the other
+		std::vector<std::int32_t> m_samples;
+		// The number of samples in each channel of the last frame and the
+		// number read from it so far
+		unsigned int m_blockSize = 0, m_blockPosition = 0;
+	};
+
+	/*
+	* A stream of the samples in an Ogg Vorbis file, decoded by libvorbisfile
+	* as 16 bit samples
+	*/
+	class VorbisStream : public AudioStream {
+	public:
+		VorbisStream();
+		/*
+		* Close the file
+		*/
+		~VorbisStream();
+
+		/*
+		* Open an Ogg Vorbis file and read its headers
+		*
+		* @param fileName: The file name of the sound on disk
+		* @return Whether the file is an Ogg Vorbis file OpenAL can play
+		*/
+		bool open(const std::string& fileName);
+		size_t read(unsigned char* out, size_t size) override;
+		bool rewind() override;
+
+	private:
+		// The decoder of the file
+		std::unique_ptr<OggVorbis_File> m_file;
+		// Whether the decoder has been opened
+		bool m_opened = false;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -13,6 +13,7 @@ namespace Milkweed {
 	LogManager LogManager::m_instance;
 
 	void LogManager::init(const std::string& dirName, bool printToConsole) {
+		std::scoped_lock lock(m_mtx);
 		// Set whether to print messages to the console
 		m_printToConsole = printToConsole;
 		
@@ -34,6 +35,7 @@ namespace Milkweed {
 
 	void LogManager::destroy() {
 		// Close the log file
+		std::scoped_lock lock(m_mtx);
 		m_logFile.close();
 	}
 
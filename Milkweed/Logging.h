@@ -9,6 +9,7 @@
 
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <vector>
 
 namespace Milkweed {
@@ -18,6 +19,34 @@ namespace Milkweed {
 	*/
 	class LogManager {
 	public:
+		/*
+		* A single logged message, which holds the log manager's lock from
+		* its first part to its last so that messages logged from several
+		* threads at once are not mixed together
+		*/
+		class Message {
+		public:
+			/*
+			* Start a message, waiting for any other thread's message to end
+			*/
+			Message(LogManager& log) : m_log(log), m_lock(log.m_mtx) {}
+			/*
+			* Push the next part of this message to the console and log file
+			*/
+			template <typename T>
+			Message& operator , (const T& t) {
+				m_log.write(t);
+				return *this;
+			}
+
+		private:
+			// The log manager this message is written to
+			LogManager& m_log;
+			// The lock held until the end of the statement logging this
+			// message
+			std::unique_lock<std::recursive_mutex> m_lock;
+		};
+
 		/*
 		* The copy constructor is disabled for this class
 		*/
@@ -38,23 +67,19 @@ namespace Milkweed {
 		*/
 		void init(const std::string& dirName, bool printToConsole = true);
 		/*
-		* Override for the bitshift left operator to push data to the console
-		* and log file simultaneously
+		* Start a message which keeps other threads from logging until the
+		* end of the statement it is made in, as MWLOG does
+		*/
+		Message startMessage() { return Message(*this); }
+		/*
+		* Override for the comma operator to push data to the console and log
+		* file simultaneously, use startMessage() to keep a message of several
+		* parts together
 		*/
 		template <typename T>
 		friend LogManager& operator , (LogManager& ls, const T& t) {
-			// TODO: Print timestamps at the beginning of each message
-			if (ls.m_printToConsole) {
-				std::cout << t;
-			}
-
-			if (ls.m_logFile.fail()) {
-				// The logging file is closed
-				return ls;
-			}
-			// The log file hasn't failed, write the log to it
-			ls.m_logFile << t;
-
+			std::scoped_lock lock(ls.m_mtx);
+			ls.write(t);
 			return ls;
 		}
 		/*
@@ -75,6 +100,14 @@ namespace Milkweed {
 			m_dateFormat = dateFormat;
 		}
 		/*
+		* Set whether to print new messages to the console as well as the log
+		* file
+		*/
+		void setPrintToConsole(bool printToConsole) {
+			std::scoped_lock lock(m_mtx);
+			m_printToConsole = printToConsole;
+		}
+		/*
 		* Close this log manager's log file and free its memory
 		*/
 		void destroy();
@@ -93,6 +126,28 @@ namespace Milkweed {
 		std::ofstream m_logFile;
 		// The format to print the date in
 		std::string m_dateFormat = "%Y.%m.%d.%H%M.%S";
+		// Lock for writing to the console and log file, recursive so that
+		// the parts of a message may themselves log
+		std::recursive_mutex m_mtx;
+
+		/*
+		* Write part of a message to the console and log file, with the lock
+		* held
+		*/
+		template <typename T>
+		void write(const T& t) {
+			// TODO: Print timestamps at the beginning of each message
+			if (m_printToConsole) {
+				std::cout << t;
+			}
+
+			if (m_logFile.fail()) {
+				// The logging file is closed
+				return;
+			}
+			// The log file hasn't failed, write the log to it
+			m_logFile << t;
+		}
 	};
 
 	/*
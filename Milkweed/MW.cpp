@@ -18,12 +18,14 @@ ResourceManager& MW::RESOURCES = ResourceManager::getInstance();
 LogManager& MW::LOG = LogManager::getInstance();
 NetClient& MW::NETWORK = NetClient::getInstance();
 AudioManager& MW::AUDIO = AudioManager::getInstance();
+Profiler& MW::PROFILER = Profiler::getInstance();
 bool MW::RUNNING = false;
 
 // Instantiate the application's private static members
 float MW::PHYSICS_SPU;
 std::vector<Scene*> MW::SCENES;
 Scene* MW::SCENE = nullptr;
+std::vector<NetMessage> MW::NET_MESSAGES;
 
 void Scene::init() {
 	m_initialized = true;
@@ -132,10 +134,20 @@ void MW::Run() {
 
 	// Start the game loop
 	while (RUNNING) {
+		PROFILER.beginFrame();
+
 		// Draw the application's graphics and process input
 		Draw();
+		PROFILER.beginScope("ProcessInput");
 		ProcessInput();
+		PROFILER.endScope();
+		PROFILER.beginScope("ProcessNetMessages");
 		ProcessNetMessages(maxNetMessages);
+		PROFILER.endScope();
+		// Upload the resources finished loading in the background
+		PROFILER.beginScope("Resources");
+		RESOURCES.update();
+		PROFILER.endScope();
 
 		// Find the elapsed time since last frame
 		double now = glfwGetTime();
@@ -147,6 +159,7 @@ void MW::Run() {
 		// Update while the delta time is greater than one and we haven't
 		// exceeded the maximum physics updates per frame (no more than 1.0f
 		// per update)
+		PROFILER.beginScope("Update");
 		while (deltaTime > 1.0f && physicsSteps < maxPhysicsSteps) {
 			Update(1.0f);
 			deltaTime -= 1.0f;
@@ -155,11 +168,14 @@ void MW::Run() {
 		// Update with the remaining delta time and reset the steps counter
 		Update(deltaTime);
 		physicsSteps = 0;
+		PROFILER.endScope();
 
 		// Test if the user has requested the window be closed
 		if (glfwWindowShouldClose(WINDOW.getWindowHandle())) {
 			RUNNING = false;
 		}
+
+		PROFILER.endFrame();
 	}
 
 	// The game loop has stopped, termimate the application
@@ -167,10 +183,22 @@ void MW::Run() {
 }
 
 void MW::Draw() {
+	PROFILER.beginScope("Draw");
 	RENDERER.begin();
+	PROFILER.beginScope("Scene::draw");
 	SCENE->draw();
+	PROFILER.drawOverlay();
+	PROFILER.endScope();
+	// Time the renderer's work on both the CPU and the GPU
+	PROFILER.beginScope("Renderer::end");
+	PROFILER.beginGPUTimer();
 	RENDERER.end();
+	PROFILER.endGPUTimer();
+	PROFILER.endScope();
+	PROFILER.beginScope("SwapBuffers");
 	glfwSwapBuffers(WINDOW.getWindowHandle());
+	PROFILER.endScope();
+	PROFILER.endScope();
 }
 
 void MW::ProcessInput() {
@@ -181,19 +209,13 @@ void MW::ProcessInput() {
 }
 
 void MW::ProcessNetMessages(unsigned int count) {
-	if (count == -1) {
-		while (!MW::NETWORK.getMessagesIn().empty()) {
-			NetMessage msg = MW::NETWORK.getMessagesIn().popFront();
-			SCENE->processNetMessage(msg);
-		}
-	}
-	else {
-		unsigned int m = 0;
-		while (!MW::NETWORK.getMessagesIn().empty() && m++ < count) {
-			NetMessage msg = MW::NETWORK.getMessagesIn().popFront();
-			SCENE->processNetMessage(msg);
-		}
+	// Take up to count messages from the network at once and process them
+	size_t maxMessages = (count == -1) ? (size_t)-1 : (size_t)count;
+	MW::NETWORK.getMessagesIn().popAll(NET_MESSAGES, maxMessages);
+	for (NetMessage& msg : NET_MESSAGES) {
+		SCENE->processNetMessage(msg);
 	}
+	NET_MESSAGES.clear();
 }
 
 void MW::Update(float deltaTime) {
@@ -217,6 +239,8 @@ void MW::Destroy() {
 	AUDIO.destroy();
 	// Stop the network client
 	NETWORK.destroy();
+	// Stop the profiler
+	PROFILER.destroy();
 	// Destroy the renderer
 	RENDERER.destroy();
 
@@ -12,16 +12,21 @@
 #include <vector>
 
 #include "Network.h"
+#include "Replication.h"
 #include "Window.h"
 #include "Input.h"
 #include "Renderer.h"
+#include "Profiler.h"
 #include "Resources.h"
+#include "PNGDecoder.h"
+#include "AssetPack.h"
 #include "Logging.h"
 #include "Audio.h"
+#include "AudioStream.h"
 #include "UI.h"
 
-#define MWLOG(LEVEL, SOURCE, ...) MW::LOG , MW::LOG.getDate(), ": [",\
-	#LEVEL, "] [", #SOURCE, "] ", __VA_ARGS__, "\n"
+#define MWLOG(LEVEL, SOURCE, ...) MW::LOG.startMessage(), MW::LOG.getDate(),\
+	": [", #LEVEL, "] [", #SOURCE, "] ", __VA_ARGS__, "\n"
 
 namespace Milkweed {
 	/*
@@ -107,6 +112,8 @@ namespace Milkweed {
 		static NetClient& NETWORK;
 		// The application audio player
 		static AudioManager& AUDIO;
+		// The application's frame profiler
+		static Profiler& PROFILER;
 		// Whether the application is still running
 		static bool RUNNING;
 
@@ -153,6 +160,9 @@ namespace Milkweed {
 		static std::vector<Scene*> SCENES;
 		// The active scene in this application
 		static Scene* SCENE;
+		// The messages taken from the network each frame, kept to reuse its
+		// memory
+		static std::vector<NetMessage> NET_MESSAGES;
 
 		/*
 		* The constructor is disabled for this class
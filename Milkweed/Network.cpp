@@ -7,19 +7,272 @@
 #include "MW.h"
 
 namespace Milkweed {
+	NetBufferPool NetBufferPool::m_instance;
+
+	NetBuffer* NetBufferPool::acquire(size_t capacity) {
+		NetBuffer* buffer = nullptr;
+		{
+			std::scoped_lock lock(m_mtx);
+			if (!m_free.empty()) {
+				buffer = m_free.back();
+				m_free.pop_back();
+			}
+		}
+		if (buffer == nullptr) {
+			buffer = new NetBuffer();
+		}
+
+		// Only grow the buffer, a reused buffer keeps its memory
+		if (buffer->data.size() < capacity) {
+			buffer->data.resize(capacity);
+		}
+		buffer->m_references = 1;
+		return buffer;
+	}
+
+	void NetBufferPool::release(NetBuffer* buffer) {
+		// Very large buffers are freed rather than held onto
+		if (buffer->data.size() <= MAX_POOLED_CAPACITY) {
+			std::scoped_lock lock(m_mtx);
+			if (m_free.size() < MAX_FREE_BUFFERS) {
+				m_free.push_back(buffer);
+				return;
+			}
+		}
+		delete buffer;
+	}
+
+	void NetBufferPool::clear() {
+		std::scoped_lock lock(m_mtx);
+		for (NetBuffer* buffer : m_free) {
+			delete buffer;
+		}
+		m_free.clear();
+	}
+
+	NetMessageBody::NetMessageBody(const NetMessageBody& body)
+		: m_buffer(body.m_buffer), m_size(body.m_size) {
+		if (m_buffer != nullptr) {
+			m_buffer->m_references++;
+		}
+	}
+
+	NetMessageBody::NetMessageBody(NetMessageBody&& body) noexcept
+		: m_buffer(body.m_buffer), m_size(body.m_size) {
+		body.m_buffer = nullptr;
+		body.m_size = 0;
+	}
+
+	NetMessageBody& NetMessageBody::operator=(const NetMessageBody& body) {
+		if (this != &body) {
+			// Take the new reference before releasing the old one in case
+			// they are the same buffer
+			if (body.m_buffer != nullptr) {
+				body.m_buffer->m_references++;
+			}
+			clear();
+			m_buffer = body.m_buffer;
+			m_size = body.m_size;
+		}
+		return *this;
+	}
+
+	NetMessageBody& NetMessageBody::operator=(NetMessageBody&& body) noexcept {
+		if (this != &body) {
+			clear();
+			m_buffer = body.m_buffer;
+			m_size = body.m_size;
+			body.m_buffer = nullptr;
+			body.m_size = 0;
+		}
+		return *this;
+	}
+
+	char* NetMessageBody::data() {
+		if (m_buffer == nullptr) {
+			return nullptr;
+		}
+		makeUnique(m_size);
+		return m_buffer->data.data();
+	}
+
+	void NetMessageBody::resize(size_t size) {
+		if (size > m_size) {
+			makeUnique(size);
+		}
+		m_size = size;
+	}
+
+	void NetMessageBody::clear() {
+		if (m_buffer != nullptr && --m_buffer->m_references == 0) {
+			NetBufferPool::getInstance().release(m_buffer);
+		}
+		m_buffer = nullptr;
+		m_size = 0;
+	}
+
+	void NetMessageBody::makeUnique(size_t capacity) {
+		if (m_buffer != nullptr && m_buffer->m_references == 1) {
+			// This body already owns its buffer, only grow it if needed
+			if (m_buffer->data.size() < capacity) {
+				m_buffer->data.resize(capacity);
+			}
+			return;
+		}
+
+		// Copy the bytes into a pooled buffer of this body's own
+		NetBuffer* buffer = NetBufferPool::getInstance().acquire(
+			std::max(capacity, m_size));
+		if (m_buffer != nullptr && m_size > 0) {
+			std::memcpy(buffer->data.data(), m_buffer->data.data(), m_size);
+		}
+		size_t size = m_size;
+		clear();
+		m_buffer = buffer;
+		m_size = size;
+	}
+
 	NetMessage::NetMessage(unsigned int ID,
 		std::shared_ptr<NetConnection> owner) {
 		header.ID = ID;
 		this->owner = owner;
 	}
 
-	void NetConnection::init(TSQueue<NetMessage>* messagesIn,
+	NetWriter::NetWriter(NetMessage& message, size_t reserve)
+		: m_message(message) {
+		if (reserve > 0) {
+			m_message.body.reserve(m_message.body.size() + reserve);
+		}
+	}
+
+	void NetWriter::writeVarint(unsigned int value) {
+		// 7 bits of the value per byte, the top bit marks another byte
+		char bytes[5];
+		size_t count = 0;
+		while (value >= 0x80) {
+			bytes[count++] = (char)((value & 0x7f) | 0x80);
+			value >>= 7;
+		}
+		bytes[count++] = (char)value;
+		std::memcpy(grow(count), bytes, count);
+	}
+
+	void NetWriter::writeSignedVarint(int value) {
+		// Interleave negative and positive values so both stay small
+		writeVarint(((unsigned int)value << 1) ^ (unsigned int)(value >> 31));
+	}
+
+	void NetWriter::writeQuantized(float value, float min, float max,
+		unsigned int bytes) {
+		bytes = std::min(std::max(bytes, 1u), 4u);
+		unsigned long long steps = (1ull << (bytes * 8)) - 1;
+		float t = (max > min) ? (value - min) / (max - min) : 0.0f;
+		t = std::min(std::max(t, 0.0f), 1.0f);
+		unsigned long long quantized
+			= (unsigned long long)std::llround((double)t * (double)steps);
+		// Lowest byte first so the encoding does not depend on the platform
+		char* out = grow(bytes);
+		for (unsigned int i = 0; i < bytes; i++) {
+			out[i] = (char)((quantized >> (i * 8)) & 0xff);
+		}
+	}
+
+	void NetWriter::writeString(const std::string& value) {
+		writeVarint((unsigned int)value.size());
+		if (!value.empty()) {
+			std::memcpy(grow(value.size()), value.data(), value.size());
+		}
+	}
+
+	char* NetWriter::grow(size_t bytes) {
+		NetMessageBody& body = m_message.body;
+		size_t size = body.size();
+		if (size + bytes > body.capacity() || body.isShared()) {
+			body.reserve(std::max(size + bytes, body.capacity() * 2));
+		}
+		body.resize(size + bytes);
+		m_message.header.size = (unsigned int)body.size();
+		return body.data() + size;
+	}
+
+	bool NetReader::readVarint(unsigned int& value) {
+		unsigned int result = 0;
+		// An unsigned int takes at most 5 bytes
+		for (unsigned int shift = 0; shift < 35; shift += 7) {
+			const char* byte = take(1);
+			if (byte == nullptr) {
+				return false;
+			}
+			unsigned int group = (unsigned char)*byte;
+			result |= (group & 0x7f) << shift;
+			if ((group & 0x80) == 0) {
+				value = result;
+				return true;
+			}
+		}
+		m_failed = true;
+		return false;
+	}
+
+	bool NetReader::readSignedVarint(int& value) {
+		unsigned int zigzag = 0;
+		if (!readVarint(zigzag)) {
+			return false;
+		}
+		value = (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+		return true;
+	}
+
+	bool NetReader::readQuantized(float& value, float min, float max,
+		unsigned int bytes) {
+		bytes = std::min(std::max(bytes, 1u), 4u);
+		const char* in = take(bytes);
+		if (in == nullptr) {
+			return false;
+		}
+		unsigned long long quantized = 0;
+		for (unsigned int i = 0; i < bytes; i++) {
+			quantized |= (unsigned long long)(unsigned char)in[i] << (i * 8);
+		}
+		unsigned long long steps = (1ull << (bytes * 8)) - 1;
+		value = min + (float)((double)quantized / (double)steps
+			* (double)(max - min));
+		return true;
+	}
+
+	bool NetReader::readString(std::string& value, size_t maxLength) {
+		unsigned int length = 0;
+		if (!readVarint(length)) {
+			return false;
+		}
+		if (length > maxLength || length > getRemaining()) {
+			m_failed = true;
+			return false;
+		}
+		if (length > 0) {
+			value.assign(take(length), length);
+		}
+		else {
+			value.clear();
+		}
+		return true;
+	}
+
+	const char* NetReader::take(size_t bytes) {
+		if (m_failed || bytes > m_size - m_position) {
+			m_failed = true;
+			return nullptr;
+		}
+		const char* data = m_data + m_position;
+		m_position += bytes;
+		return data;
+	}
+
+	void NetConnection::init(MPSCQueue<NetMessage>* messagesIn,
 		unsigned int maxMessageSize) {
-		// Set the context, message in TSQ, and let the owner of the temporary
-		// message be this connection
+		// Set the message in TSQ and the max message size
 		m_messagesIn = messagesIn;
 		m_maxMessageSize = maxMessageSize;
-		m_tempMessage.owner = this->shared_from_this();
 	}
 
 	void NetConnection::connectToServer(
@@ -27,29 +280,35 @@ namespace Milkweed {
 		// Attempt to asynchronously connect to the socket to the server at the
 		// given endpoint
 		asio::async_connect(m_socket, endpoints,
-			[this](std::error_code error,
+			[this, self = this->shared_from_this()](std::error_code error,
 				asio::ip::tcp::endpoint endpoint) {
 					if (!error) {
 						// The connection was successful, begin reading messages
+						// and forget any datagram channel from a past connection
 						m_connected = true;
+						m_datagramReady = false;
 						// Push a connected message to the client
 						NetMessage message(NetMessageTypes::CONNECTED,
 							this->shared_from_this());
-						m_messagesIn->pushBack(message);
+						m_messagesIn->pushBack(std::move(message));
 
 						// Begin receiving messages from the network
-						readHeader();
+						read();
 					}
 					else {
 						NetMessage msg;
 						msg.header.ID = NetMessageTypes::FAILED;
-						m_messagesIn->pushBack(msg);
+						m_messagesIn->pushBack(std::move(msg));
 						disconnect();
 					}
 			}
 		);
 	}
 
+	void NetConnection::setDatagramChannel(NetDatagramChannel* datagrams) {
+		m_datagrams = datagrams;
+	}
+
 	void NetConnection::connectToClient(unsigned int ID) {
 		// If the connection is open set the ID number
 		if (m_socket.is_open()) {
@@ -58,7 +317,7 @@ namespace Milkweed {
 			m_serverOwned = true;
 
 			// Begin receiving messages from the network
-			readHeader();
+			read();
 		}
 	}
 
@@ -71,19 +330,40 @@ namespace Milkweed {
 	}
 
 	void NetConnection::send(const NetMessage& message) {
+		// Copying the message only shares its body, so a message sent to many
+		// connections is serialized once and queued everywhere by reference
 		asio::post(m_context,
-			[this, message]() {
-				// Add the messsage to the out queue and if it was empty before
-				// adding the message tell ASIO to begin writing messages
-				bool messagesOutEmpty = m_messagesOut.empty();
-				m_messagesOut.pushBack(message);
-				if (messagesOutEmpty) {
-					writeHeader();
+			[this, self = this->shared_from_this(), message]() mutable {
+				// Add the messsage to the out queue and if no write is in
+				// progress or waiting tell ASIO to begin writing messages,
+				// otherwise it will be written along with the next batch
+				m_messagesOut.pushBack(std::move(message));
+				if (!m_writing && !m_flushPending) {
+					scheduleWrite();
 				}
 			}
 		);
 	}
 
+	void NetConnection::send(const NetMessage& message, NetSendMode mode) {
+		if (mode == NetSendMode::RELIABLE || m_datagrams == nullptr) {
+			send(message);
+		}
+		else {
+			m_datagrams->send(this->shared_from_this(), message,
+				mode == NetSendMode::UNRELIABLE_SEQUENCED);
+		}
+	}
+
+	void NetConnection::setFlushDelay(std::chrono::microseconds flushDelay) {
+		// The delay is read by the ASIO thread, so set it there
+		asio::post(m_context,
+			[this, self = this->shared_from_this(), flushDelay]() {
+				m_flushDelay = flushDelay;
+			}
+		);
+	}
+
 	void NetConnection::disconnect() {
 		// If the socket is connected, then tell the ASIO context to close it
 		// TODO: May need to fix the dereference here
@@ -92,15 +372,21 @@ namespace Milkweed {
 			m_connected = false;
 
 			// Send the disconnected message if the NetConnection isn't owned
-			// by a server
+			// by a server, without waiting for room since the thread which
+			// takes messages from the queue may be the one disconnecting
 			if (!m_serverOwned && m_messagesIn != nullptr) {
 				NetMessage message(NetMessageTypes::DISCONNECTED,
 					this->shared_from_this());
-				m_messagesIn->pushBack(message);
+				m_messagesIn->tryPush(std::move(message));
 			}
 
 			// Post the disconnect
-			asio::post(m_context, [this]() { m_socket.close(); });
+			asio::post(m_context,
+				[this, self = this->shared_from_this()]() {
+					m_flushTimer.cancel();
+					m_socket.close();
+				}
+			);
 		}
 	}
 
@@ -108,55 +394,58 @@ namespace Milkweed {
 		// Ensure this connection is not connected
 		disconnect();
 
-		// Reset the context, the messages in TSQ, the ID of this connection,
-		// and the max message size
-		for (unsigned int i = 0; i < m_messagesIn->size(); i++) {
-			m_messagesIn->at(i).owner.reset();
-		}
-		m_messagesIn->clear();
-		m_messagesIn = nullptr;
-		m_ID = 0;
-		m_maxMessageSize = 0;
+		// The messages in queue, the ID of this connection and the max
+		// message size are left alone, handlers still running on the ASIO
+		// threads may read them until they see the connection is closed
 
-		// Get rid of any messages waiting to be send and get rid of their
-		// owner pointers
-		for (unsigned int i = 0; i < m_messagesOut.size(); i++) {
-			m_messagesOut.at(i).owner.reset();
-		}
-		m_messagesOut.clear();
-
-		// Get rid of the contents of the temporary message
-		m_tempMessage.owner.reset();
-		m_tempMessage.header.ID = 0;
-		m_tempMessage.header.size = 0;
-		m_tempMessage.body.clear();
+		// Get rid of any messages waiting to be sent and any bytes which were
+		// never parsed into messages on the ASIO thread, after the socket has
+		// been closed
+		asio::post(m_context,
+			[this, self = this->shared_from_this()]() {
+				for (unsigned int i = 0; i < m_messagesOut.size(); i++) {
+					m_messagesOut.at(i).owner.reset();
+				}
+				m_messagesOut.clear();
+				m_receiveBuffer.clear();
+				m_receiveBegin = 0;
+				m_receiveEnd = 0;
+			}
+		);
 	}
 
-	void NetConnection::readHeader() {
-		asio::async_read(m_socket,
-			asio::buffer(&m_tempMessage.header, sizeof(NetMessageHeader)),
-			[this](std::error_code error, std::size_t length) {
+	void NetConnection::read() {
+		// Move the start of any partial message to the front of the receive
+		// buffer, and make sure the largest message accepted fits in it
+		if (m_receiveBegin > 0) {
+			std::memmove(m_receiveBuffer.data(),
+				m_receiveBuffer.data() + m_receiveBegin,
+				m_receiveEnd - m_receiveBegin);
+			m_receiveEnd -= m_receiveBegin;
+			m_receiveBegin = 0;
+		}
+		size_t capacity = sizeof(NetMessageHeader) + m_maxMessageSize;
+		if (capacity < RECEIVE_BUFFER_SIZE) {
+			capacity = RECEIVE_BUFFER_SIZE;
+		}
+		if (m_receiveBuffer.size() < capacity) {
+			m_receiveBuffer.resize(capacity);
+		}
+
+		// Read whatever has arrived on the socket into the rest of the buffer,
+		// each handler holds onto this connection so that it can be let go of
+		// while its operations are still running
+		m_socket.async_read_some(
+			asio::buffer(m_receiveBuffer.data() + m_receiveEnd,
+				m_receiveBuffer.size() - m_receiveEnd),
+			[this, self = this->shared_from_this()](std::error_code error,
+				std::size_t length) {
 				if (!error) {
-					if (m_tempMessage.header.size == 0) {
-						// There is no body, this message can be added without
-						// one
-						addMessageIn();
-					}
-					else {
-						if (m_tempMessage.header.size <= m_maxMessageSize) {
-							// There is a body to read for this message, read
-							// it in from the network
-							m_tempMessage.body.resize(
-								m_tempMessage.header.size);
-							readBody();
-						}
-						else {
-							// The connection won't take this message because
-							// its specified body size is too big, this is
-							// likely because a client has connected which is
-							// not the appropriate application
-							disconnect();
-						}
+					// Pull every complete message out of the buffer and wait
+					// for more bytes
+					m_receiveEnd += length;
+					if (parseMessages()) {
+						read();
 					}
 				}
 				else {
@@ -167,74 +456,350 @@ namespace Milkweed {
 		);
 	}
 
-	void NetConnection::readBody() {
-		asio::async_read(m_socket, asio::buffer(m_tempMessage.body.data(),
-			m_tempMessage.body.size()),
-			[this](std::error_code error, std::size_t length) {
+	bool NetConnection::parseMessages() {
+		std::shared_ptr<NetConnection> owner = this->shared_from_this();
+		while (m_receiveEnd - m_receiveBegin >= sizeof(NetMessageHeader)) {
+			NetMessageHeader header;
+			std::memcpy(&header, m_receiveBuffer.data() + m_receiveBegin,
+				sizeof(NetMessageHeader));
+			if (header.size > m_maxMessageSize) {
+				// The connection won't take this message because its
+				// specified body size is too big, this is likely because a
+				// client has connected which is not the appropriate
+				// application
+				disconnect();
+				return false;
+			}
+
+			// Wait for the rest of the message if its body has not arrived
+			size_t messageSize = sizeof(NetMessageHeader) + header.size;
+			if (m_receiveEnd - m_receiveBegin < messageSize) {
+				break;
+			}
+
+			// Copy the body straight into the message and move it onto the
+			// back of the messages in TSQ with this connection as its owner
+			NetMessage message(header.ID, owner);
+			message.header.size = header.size;
+			if (header.size > 0) {
+				message.body.resize(header.size);
+				std::memcpy(message.body.data(), m_receiveBuffer.data()
+					+ m_receiveBegin + sizeof(NetMessageHeader), header.size);
+			}
+			m_receiveBegin += messageSize;
+
+			if (header.ID == NetMessageTypes::DATAGRAM_TOKEN && !m_serverOwned
+				&& m_datagrams != nullptr) {
+				// The server offers a datagram channel, take this connection's
+				// ID and token and start the handshake on the server's port
+				NetReader reader(message);
+				reader.read(m_ID);
+				reader.read(m_datagramToken);
+				std::error_code error;
+				asio::ip::tcp::endpoint server = m_socket.remote_endpoint(error);
 				if (!error) {
-					// Add the message to the incoming message queue
-					addMessageIn();
+					m_datagrams->connect(owner, asio::ip::udp::endpoint(
+						server.address(), server.port()));
 				}
-				else {
-					// The socket has been disconnected
-					disconnect();
+				continue;
+			}
+			m_messagesIn->pushBack(std::move(message));
+		}
+
+		// Start from the front of the buffer if everything was parsed
+		if (m_receiveBegin == m_receiveEnd) {
+			m_receiveBegin = 0;
+			m_receiveEnd = 0;
+		}
+		return true;
+	}
+
+	void NetConnection::scheduleWrite() {
+		if (m_flushDelay.count() == 0) {
+			write();
+			return;
+		}
+
+		// Hold the messages for the flush delay so that any sent in the
+		// meantime are written together with them
+		m_flushPending = true;
+		m_flushTimer.expires_after(m_flushDelay);
+		m_flushTimer.async_wait(
+			[this, self = this->shared_from_this()](std::error_code error) {
+				m_flushPending = false;
+				if (!error) {
+					write();
 				}
 			}
 		);
 	}
 
-	void NetConnection::addMessageIn() {
-		// Push the temporary message onto the back of the messages in TSQ since
-		// it already has this NetConnection as its owner
-		m_messagesIn->pushBack(m_tempMessage);
-		readHeader();
-	}
+	void NetConnection::write() {
+		if (m_messagesOut.empty()) {
+			m_writing = false;
+			return;
+		}
+		m_writing = true;
 
-	void NetConnection::writeHeader() {
-		asio::async_write(m_socket, asio::buffer(&m_messagesOut.front().header,
-			sizeof(NetMessageHeader)),
-			[this](std::error_code error, std::size_t length) {
+		// Take every waiting message out of the queue so that the buffers
+		// handed to ASIO stay valid while new messages are sent
+		m_messagesWriting.clear();
+		while (!m_messagesOut.empty()
+			&& m_messagesWriting.size() < MAX_WRITE_MESSAGES) {
+			m_messagesWriting.push_back(m_messagesOut.popFront());
+		}
+
+		// Gather each message's header and body into one list of buffers,
+		// reading the bodies without taking copies of them
+		m_writeBuffers.clear();
+		for (const NetMessage& message : m_messagesWriting) {
+			m_writeBuffers.push_back(asio::buffer(&message.header,
+				sizeof(NetMessageHeader)));
+			if (!message.body.empty()) {
+				m_writeBuffers.push_back(asio::buffer(message.body.data(),
+					message.body.size()));
+			}
+		}
+
+		asio::async_write(m_socket, m_writeBuffers,
+			[this, self = this->shared_from_this()](std::error_code error,
+				std::size_t length) {
+				// The messages were written or dropped, get rid of them
+				m_messagesWriting.clear();
 				if (!error) {
-					// The data was written, check if the message has a body
-					if (m_messagesOut.front().body.size() > 0) {
-						// Write the body out
-						writeBody();
-					}
-					else {
-						// The message has no body, get rid of it
-						m_messagesOut.popFront();
-						// If there is another message to write, begin again at
-						// its header
-						if (!m_messagesOut.empty()) {
-							writeHeader();
-						}
-					}
+					// Write anything which was sent during this write straight
+					// away, it has already waited for a batch
+					write();
 				}
 				else {
 					// The socket has been disconnected
+					m_writing = false;
 					disconnect();
 				}
 			}
 		);
 	}
 
-	void NetConnection::writeBody() {
-		asio::async_write(m_socket,
-			asio::buffer(m_messagesOut.front().body.data(),
-				m_messagesOut.front().body.size()),
+	bool NetDatagramChannel::open(unsigned short port,
+		const std::function<std::shared_ptr<NetConnection>(unsigned int)>&
+		findConnection) {
+		return open(asio::ip::udp::endpoint(asio::ip::udp::v4(), port),
+			findConnection);
+	}
+
+	void NetDatagramChannel::connect(std::shared_ptr<NetConnection> connection,
+		const asio::ip::udp::endpoint& endpoint) {
+		// A client's channel only carries its one connection
+		if (!isOpen()) {
+			std::weak_ptr<NetConnection> client = connection;
+			if (!open(asio::ip::udp::endpoint(endpoint.protocol(), 0),
+				[client](unsigned int ID) { return client.lock(); })) {
+				// Unreliable messages will keep going over TCP
+				return;
+			}
+		}
+
+		// Start a fresh exchange with the server and shake hands until it
+		// answers
+		connection->m_datagramEndpoint = endpoint;
+		connection->m_datagramReady = false;
+		connection->m_datagramSendSequence = 0;
+		connection->m_datagramReceiveSequence = 0;
+		sendHandshake(connection, 0);
+	}
+
+	void NetDatagramChannel::send(std::shared_ptr<NetConnection> connection,
+		const NetMessage& message, bool sequenced) {
+		// The connection's datagram state belongs to the channel's thread
+		asio::post(m_socket.get_executor(),
+			[this, connection, message, sequenced]() {
+				size_t size = sizeof(NetDatagramHeader)
+					+ sizeof(NetMessageHeader) + message.body.size();
+				if (!isOpen() || !connection->m_datagramReady
+					|| size > MAX_DATAGRAM_SIZE) {
+					// UDP can't carry this message, send it reliably instead
+					connection->send(message);
+					return;
+				}
+
+				// Sequence numbers start from 1 since 0 means not sequenced
+				unsigned int sequence = 0;
+				if (sequenced) {
+					sequence = ++connection->m_datagramSendSequence;
+					if (sequence == 0) {
+						sequence = ++connection->m_datagramSendSequence;
+					}
+				}
+				write(*connection, message, sequence);
+			}
+		);
+	}
+
+	void NetDatagramChannel::close() {
+		std::error_code error;
+		m_handshakeTimer.cancel();
+		m_socket.close(error);
+		m_findConnection = nullptr;
+	}
+
+	bool NetDatagramChannel::open(const asio::ip::udp::endpoint& endpoint,
+		const std::function<std::shared_ptr<NetConnection>(unsigned int)>&
+		findConnection) {
+		std::error_code error;
+		m_socket.open(endpoint.protocol(), error);
+		if (!error) {
+			m_socket.bind(endpoint, error);
+		}
+		if (error) {
+			close();
+			return false;
+		}
+
+		// Begin receiving datagrams from the network
+		m_findConnection = findConnection;
+		read();
+		return true;
+	}
+
+	void NetDatagramChannel::read() {
+		m_socket.async_receive_from(
+			asio::buffer(m_receiveBuffer, MAX_DATAGRAM_SIZE), m_receiveEndpoint,
 			[this](std::error_code error, std::size_t length) {
+				if (error == asio::error::operation_aborted || !isOpen()) {
+					// The channel has been closed
+					return;
+				}
 				if (!error) {
-					// The body was written, get rid of it
-					m_messagesOut.popFront();
-					// If there are more messages to write, start at the next
-					// one's header
-					if (!m_messagesOut.empty()) {
-						writeHeader();
-					}
+					parseDatagram(length);
 				}
-				else {
-					// Couldn't write the body, the socket has been disconnected
-					disconnect();
+				// A failed datagram only loses that datagram, keep receiving
+				read();
+			}
+		);
+	}
+
+	void NetDatagramChannel::parseDatagram(size_t length) {
+		// Drop anything which is not a whole datagram
+		size_t headerSize = sizeof(NetDatagramHeader) + sizeof(NetMessageHeader);
+		if (length < headerSize) {
+			return;
+		}
+		NetDatagramHeader header;
+		NetMessageHeader messageHeader;
+		std::memcpy(&header, m_receiveBuffer, sizeof(NetDatagramHeader));
+		std::memcpy(&messageHeader, m_receiveBuffer + sizeof(NetDatagramHeader),
+			sizeof(NetMessageHeader));
+		if (messageHeader.size != length - headerSize) {
+			return;
+		}
+
+		// Drop datagrams which don't belong to a connected connection or don't
+		// carry its token, a connection may still be found for a moment after
+		// it disconnects
+		std::shared_ptr<NetConnection> connection
+			= m_findConnection(header.connectionID);
+		if (connection == nullptr || !connection->m_connected
+			|| header.connectionID != connection->m_ID
+			|| header.token != connection->m_datagramToken
+			|| messageHeader.size > connection->m_maxMessageSize) {
+			return;
+		}
+
+		if (connection->m_serverOwned) {
+			// The server learns where to send a client's datagrams from the
+			// client's own datagrams
+			connection->m_datagramEndpoint = m_receiveEndpoint;
+			if (messageHeader.ID == NetMessageTypes::DATAGRAM_HANDSHAKE) {
+				// Answer the handshake so the client knows UDP works both ways
+				connection->m_datagramReady = true;
+				NetMessage handshake(NetMessageTypes::DATAGRAM_HANDSHAKE);
+				write(*connection, handshake, 0);
+				return;
+			}
+		}
+		else {
+			// A client only takes datagrams from its server
+			if (m_receiveEndpoint != connection->m_datagramEndpoint) {
+				return;
+			}
+			if (messageHeader.ID == NetMessageTypes::DATAGRAM_HANDSHAKE) {
+				connection->m_datagramReady = true;
+				m_handshakeTimer.cancel();
+				return;
+			}
+		}
+
+		// Drop sequenced datagrams older than the newest one received
+		if (header.sequence != 0) {
+			if ((int)(header.sequence
+				- connection->m_datagramReceiveSequence) <= 0) {
+				return;
+			}
+			connection->m_datagramReceiveSequence = header.sequence;
+		}
+
+		// Add the message to the connection's messages in queue
+		NetMessage message(messageHeader.ID, connection);
+		message.header.size = messageHeader.size;
+		if (messageHeader.size > 0) {
+			message.body.resize(messageHeader.size);
+			std::memcpy(message.body.data(), m_receiveBuffer + headerSize,
+				messageHeader.size);
+		}
+		connection->m_messagesIn->pushBack(std::move(message));
+	}
+
+	void NetDatagramChannel::write(NetConnection& connection,
+		const NetMessage& message, unsigned int sequence) {
+		NetDatagramHeader header;
+		header.connectionID = connection.m_ID;
+		header.token = connection.m_datagramToken;
+		header.sequence = sequence;
+		NetMessageHeader messageHeader;
+		messageHeader.ID = message.header.ID;
+		messageHeader.size = (unsigned int)message.body.size();
+
+		// Pack the datagram into a pooled buffer which the send handler keeps
+		// alive until it has been sent
+		size_t size = sizeof(NetDatagramHeader) + sizeof(NetMessageHeader)
+			+ message.body.size();
+		NetMessageBody datagram;
+		datagram.resize(size);
+		char* data = datagram.data();
+		std::memcpy(data, &header, sizeof(NetDatagramHeader));
+		std::memcpy(data + sizeof(NetDatagramHeader), &messageHeader,
+			sizeof(NetMessageHeader));
+		if (!message.body.empty()) {
+			std::memcpy(data + sizeof(NetDatagramHeader)
+				+ sizeof(NetMessageHeader), message.body.data(),
+				message.body.size());
+		}
+
+		m_socket.async_send_to(asio::buffer(data, size),
+			connection.m_datagramEndpoint,
+			[datagram](std::error_code error, std::size_t length) {}
+		);
+	}
+
+	void NetDatagramChannel::sendHandshake(
+		std::weak_ptr<NetConnection> client, unsigned int attempt) {
+		std::shared_ptr<NetConnection> connection = client.lock();
+		if (connection == nullptr || connection->m_datagramReady || !isOpen()
+			|| attempt >= MAX_HANDSHAKES) {
+			// The handshake is done, or the server is not answering and
+			// unreliable messages will keep going over TCP
+			return;
+		}
+
+		NetMessage handshake(NetMessageTypes::DATAGRAM_HANDSHAKE);
+		write(*connection, handshake, 0);
+
+		// Try again if the server hasn't answered soon
+		m_handshakeTimer.expires_after(std::chrono::milliseconds(250));
+		m_handshakeTimer.async_wait(
+			[this, client, attempt](std::error_code error) {
+				if (!error) {
+					sendHandshake(client, attempt + 1);
 				}
 			}
 		);
@@ -245,6 +810,7 @@ namespace Milkweed {
 	void NetClient::init(unsigned int maxMessageSize) {
 		m_connection = std::make_shared<NetConnection>(m_context, m_socket);
 		m_connection->init(&m_messagesIn, maxMessageSize);
+		m_connection->m_datagrams = &m_datagrams;
 
 		MWLOG(Info, NetClient, "Initialized network client with max message ",
 			"size ", maxMessageSize, " bytes");
@@ -272,10 +838,10 @@ namespace Milkweed {
 		}
 	}
 
-	void NetClient::send(const NetMessage& message) {
+	void NetClient::send(const NetMessage& message, NetSendMode mode) {
 		// Send the message via the connection and test if we're still connected
 		if (isConnected()) {
-			m_connection->send(message);
+			m_connection->send(message, mode);
 		}
 		else {
 			MWLOG(Warning, NetClient, "Failed to send NetMessage");
@@ -294,6 +860,10 @@ namespace Milkweed {
 			m_ASIOThread.join();
 		}
 		m_context.reset();
+
+		// Close the datagram channel, it is opened again by the next server
+		// which offers one
+		m_datagrams.close();
 	}
 
 	void NetClient::destroy() {
@@ -304,15 +874,145 @@ namespace Milkweed {
 		m_messagesIn.clear();
 	}
 
-	bool NetServer::init(unsigned int maxMessageSize) {
+	void NetInterestGrid::init(float radius, float cellSize) {
+		clear();
+		m_radius = radius;
+		m_cellSize = (cellSize > 0.0f) ? cellSize : 1.0f;
+	}
+
+	void NetInterestGrid::setPosition(unsigned int ID, float x, float y) {
+		unsigned long long cell = getCell(x, y);
+		std::unordered_map<unsigned int, Entry>::iterator it
+			= m_entries.find(ID);
+		if (it == m_entries.end()) {
+			it = m_entries.emplace(ID, Entry()).first;
+		}
+		else if (it->second.cell != cell) {
+			// Move the ID number out of its old cell
+			std::vector<unsigned int>& oldCell = m_cells[it->second.cell];
+			oldCell.erase(std::find(oldCell.begin(), oldCell.end(), ID));
+			if (oldCell.empty()) {
+				m_cells.erase(it->second.cell);
+			}
+		}
+		else {
+			// Still in the same cell
+			it->second.x = x;
+			it->second.y = y;
+			return;
+		}
+
+		it->second.x = x;
+		it->second.y = y;
+		it->second.cell = cell;
+		m_cells[cell].push_back(ID);
+	}
+
+	void NetInterestGrid::remove(unsigned int ID) {
+		std::unordered_map<unsigned int, Entry>::iterator it
+			= m_entries.find(ID);
+		if (it == m_entries.end()) {
+			return;
+		}
+		std::vector<unsigned int>& cell = m_cells[it->second.cell];
+		cell.erase(std::find(cell.begin(), cell.end(), ID));
+		if (cell.empty()) {
+			m_cells.erase(it->second.cell);
+		}
+		m_entries.erase(it);
+	}
+
+	void NetInterestGrid::query(float x, float y,
+		std::vector<unsigned int>& IDs) const {
+		IDs.clear();
+		if (!isEnabled()) {
+			return;
+		}
+
+		// Search only the cells the circle around the point overlaps
+		int minX = (int)std::floor((x - m_radius) / m_cellSize);
+		int maxX = (int)std::floor((x + m_radius) / m_cellSize);
+		int minY = (int)std::floor((y - m_radius) / m_cellSize);
+		int maxY = (int)std::floor((y + m_radius) / m_cellSize);
+		float radiusSquared = m_radius * m_radius;
+		for (int cx = minX; cx <= maxX; cx++) {
+			for (int cy = minY; cy <= maxY; cy++) {
+				std::unordered_map<unsigned long long,
+					std::vector<unsigned int>>::const_iterator cell
+					= m_cells.find(((unsigned long long)(unsigned int)cx << 32)
+						| (unsigned int)cy);
+				if (cell == m_cells.end()) {
+					continue;
+				}
+				for (unsigned int ID : cell->second) {
+					const Entry& entry = m_entries.at(ID);
+					float dx = entry.x - x, dy = entry.y - y;
+					if (dx * dx + dy * dy <= radiusSquared) {
+						IDs.push_back(ID);
+					}
+				}
+			}
+		}
+		std::sort(IDs.begin(), IDs.end());
+	}
+
+	void NetInterestGrid::clear() {
+		m_entries.clear();
+		m_cells.clear();
+	}
+
+	unsigned long long NetInterestGrid::getCell(float x, float y) const {
+		int cx = (int)std::floor(x / m_cellSize);
+		int cy = (int)std::floor(y / m_cellSize);
+		return ((unsigned long long)(unsigned int)cx << 32) | (unsigned int)cy;
+	}
+
+	bool NetServer::init(unsigned int maxMessageSize,
+		unsigned int threadCount, bool datagrams) {
 		m_log.init("mwlog/");
 
 		m_maxMessageSize = maxMessageSize;
 
 		SERVERLOG(Info, "Initializing network server on port ", m_port,
-			" with maximum message size ", maxMessageSize, " bytes");
+			" with maximum message size ", maxMessageSize, " bytes and ",
+			threadCount, " networking threads");
 
 		try {
+			// Open the datagram channel on the same port before any clients
+			// connect, clients are found by the ID numbers in their datagrams
+			if (datagrams) {
+				if (m_datagrams.open(m_port,
+					[this](unsigned int ID) {
+						std::map<unsigned int, std::weak_ptr<NetConnection>>
+							::iterator it = m_datagramClients.find(ID);
+						if (it == m_datagramClients.end()) {
+							return std::shared_ptr<NetConnection>();
+						}
+						return it->second.lock();
+					})) {
+					SERVERLOG(Info, "Opened datagram channel on port ", m_port);
+				}
+				else {
+					SERVERLOG(Warning, "Failed to open datagram channel on ",
+						"port ", m_port, ", all messages will be sent over TCP");
+				}
+			}
+
+			// Start an extra context on its own thread for each thread past
+			// the listening thread, before any connection can be accepted and
+			// handed to one of them
+			for (unsigned int i = 1; i < threadCount; i++) {
+				m_contexts.push_back(std::make_unique<asio::io_context>());
+				asio::io_context* context = m_contexts.back().get();
+				m_contextWork.push_back(asio::make_work_guard(*context));
+				m_contextThreads.push_back(
+					std::thread([context]() { context->run(); }));
+			}
+			if (!m_contexts.empty()) {
+				SERVERLOG(Info, "Started ", m_contexts.size(),
+					" extra ASIO connection threads");
+			}
+
 			// Issue a task for waiting for a connection to the ASIO context
 			waitForConnection();
 
@@ -330,12 +1030,26 @@ namespace Milkweed {
 		return true;
 	}
 
+	std::vector<std::thread::native_handle_type> NetServer::getNetworkThreads() {
+		// The listening thread, then each extra context's thread
+		std::vector<std::thread::native_handle_type> threads;
+		if (m_ASIOThread.joinable()) {
+			threads.push_back(m_ASIOThread.native_handle());
+		}
+		for (std::thread& thread : m_contextThreads) {
+			if (thread.joinable()) {
+				threads.push_back(thread.native_handle());
+			}
+		}
+		return threads;
+	}
+
 	bool NetServer::messageClient(std::shared_ptr<NetConnection> client,
-		const NetMessage& message) {
+		const NetMessage& message, NetSendMode mode) {
 		if (client != nullptr) {
 			if (client->isConnected()) {
 				// The client exists and is connected, send the message
-				client->send(message);
+				client->send(message, mode);
 				return true;
 			}
 		}
@@ -343,6 +1057,7 @@ namespace Milkweed {
 		// The client either was passed as nullptr, or is not connected,
 		// remove it
 		SERVERLOG(Info, "Client ", client->getID(), " has disconnected");
+		forgetClient(client->getID());
 		onDisconnect(client);
 		client.reset();
 		m_clients.erase(std::remove(m_clients.begin(), m_clients.end(), client),
@@ -351,7 +1066,7 @@ namespace Milkweed {
 	}
 
 	void NetServer::messageAllClients(const NetMessage& message,
-		std::shared_ptr<NetConnection> ignoredClient) {
+		std::shared_ptr<NetConnection> ignoredClient, NetSendMode mode) {
 		// Send the message to all valid and connected clients
 		for (std::shared_ptr<NetConnection> client : m_clients) {
 			if (client) {
@@ -360,50 +1075,100 @@ namespace Milkweed {
 					if (client != ignoredClient) {
 						// The client is not to be ignored, send the message
 						// and go to the next clients
-						client->send(message);
+						client->send(message, mode);
 					}
 				}
 			}
 		}
 	}
 
+	void NetServer::setInterestArea(float radius, float cellSize) {
+		SERVERLOG(Info, "Limiting nearby messages to a radius of ", radius);
+		m_interest.init(radius, cellSize);
+	}
+
+	void NetServer::setClientInterest(unsigned int clientID, float x,
+		float y) {
+		m_interest.setPosition(clientID, x, y);
+	}
+
+	void NetServer::getNearbyClients(float x, float y,
+		std::vector<unsigned int>& clientIDs) const {
+		m_interest.query(x, y, clientIDs);
+	}
+
+	void NetServer::messageNearbyClients(const NetMessage& message, float x,
+		float y, std::shared_ptr<NetConnection> ignoredClient,
+		NetSendMode mode) {
+		// Only the clients in the cells around the point are looked at, so
+		// the cost follows the number of nearby clients, not all clients
+		m_interest.query(x, y, m_nearbyClients);
+		for (unsigned int ID : m_nearbyClients) {
+			std::unordered_map<unsigned int, std::weak_ptr<NetConnection>>
+				::iterator it = m_clientIDs.find(ID);
+			if (it == m_clientIDs.end()) {
+				continue;
+			}
+			std::shared_ptr<NetConnection> client = it->second.lock();
+			if (client && client != ignoredClient && client->isConnected()) {
+				client->send(message, mode);
+			}
+		}
+	}
+
 	void NetServer::update(int maxMessages) {
-		// Attempt to remove disconnected clients
-		for (std::shared_ptr<NetConnection> client : m_clients) {
-			if (client) {
-				if (client->isConnected()) {
+		// Add the clients accepted since the last update, only this thread
+		// touches the list of clients
+		std::vector<std::shared_ptr<NetConnection>> newClients;
+		{
+			std::scoped_lock lock(m_newClientsMtx);
+			newClients.swap(m_newClients);
+		}
+		for (std::shared_ptr<NetConnection>& client : newClients) {
+			if (onConnect(client)) {
+				// The program has decided to accept the client
+				SERVERLOG(Info, "Accepted client, assigned ID ",
+					client->getID());
+				m_clients.push_back(client);
+				m_clientIDs[client->getID()] = client;
+			}
+			else {
+				SERVERLOG(Info, "Rejected client ", client->getID());
+				forgetClient(client->getID());
+				client->disconnect();
+			}
+		}
+
+		// Remove the invalid / disconnected clients before telling the
+		// program about them, so that the list isn't changed while it is
+		// walked and the callbacks don't message them
+		std::vector<std::shared_ptr<NetConnection>> oldClients;
+		m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(),
+			[&oldClients](const std::shared_ptr<NetConnection>& client) {
+				if (client && client->isConnected()) {
 					// The client is still connected, move on
-					continue;
+					return false;
 				}
-				else {
-					// The client has disconnected, destroy it
-					SERVERLOG(Info, "Client ", client->getID(),
-						" has disconnected");
-					onDisconnect(client);
-					client->destroy();
+				if (client) {
+					oldClients.push_back(client);
 				}
-			}
-
-			// Remove the invalid / disconnected client
-			m_clients.erase(std::remove(m_clients.begin(), m_clients.end(),
-				client), m_clients.end());
+				return true;
+			}), m_clients.end());
+		for (std::shared_ptr<NetConnection>& client : oldClients) {
+			// The client has disconnected, destroy it
+			SERVERLOG(Info, "Client ", client->getID(), " has disconnected");
+			forgetClient(client->getID());
+			onDisconnect(client);
+			client->destroy();
 		}
 
-		if (maxMessages == -1) {
-			while (!m_messagesIn.empty()) {
-				NetMessage message = m_messagesIn.popFront();
-				onMessage(message);
-			}
-		}
-		else {
-			// Process up to maxMessages messages
-			int i = 0;
-			while (i <= maxMessages && !m_messagesIn.empty()) {
-				NetMessage message = m_messagesIn.popFront();
-				onMessage(message);
-				i++;
-			}
+		// Take up to maxMessages messages from the queue at once and process
+		// them
+		m_messagesIn.popAll(m_messageBatch, (size_t)maxMessages);
+		for (NetMessage& message : m_messageBatch) {
+			onMessage(message);
 		}
+		m_messageBatch.clear();
 	}
 
 	void NetServer::setMaxMessageSize(unsigned int maxMessageSize) {
@@ -417,6 +1182,16 @@ namespace Milkweed {
 		}
 	}
 
+	void NetServer::setFlushDelay(std::chrono::microseconds flushDelay) {
+		// Set the flush delay for all new and existing connections
+		m_flushDelay = flushDelay;
+		SERVERLOG(Info, "Updated flush delay to ", flushDelay.count(),
+			" microseconds");
+		for (std::shared_ptr<NetConnection> client : m_clients) {
+			client->setFlushDelay(flushDelay);
+		}
+	}
+
 	void NetServer::destroy() {
 		SERVERLOG(Info, "Stopping server, disconnecting all clients and ",
 			"stopping ASIO listening thread");
@@ -428,31 +1203,77 @@ namespace Milkweed {
 		}
 		m_clients.clear();
 
+		// Disconnect clients which were accepted but never added
+		{
+			std::scoped_lock lock(m_newClientsMtx);
+			for (std::shared_ptr<NetConnection>& client : m_newClients) {
+				client->disconnect();
+			}
+			m_newClients.clear();
+		}
+
 		// Stop the context and attempt to join its thread
 		m_context.stop();
 		if (m_ASIOThread.joinable()) {
 			m_ASIOThread.join();
 		}
+
+		// Stop the extra contexts and join their threads
+		m_contextWork.clear();
+		for (std::unique_ptr<asio::io_context>& context : m_contexts) {
+			context->stop();
+		}
+		for (std::thread& thread : m_contextThreads) {
+			if (thread.joinable()) {
+				thread.join();
+			}
+		}
+		m_contextThreads.clear();
+
+		// Close the datagram channel now that nothing is using it
+		m_datagrams.close();
+		m_datagramClients.clear();
+		m_clientIDs.clear();
+		m_interest.clear();
 	}
 
 	void NetServer::waitForConnection() {
-		m_acceptor.async_accept(
-			[this](std::error_code error, asio::ip::tcp::socket socket) {
+		// Open the next client's socket on the next context in turn so that
+		// connections are spread across the networking threads
+		asio::io_context& context = getNextContext();
+		m_acceptor.async_accept(context,
+			[this, &context](std::error_code error,
+				asio::ip::tcp::socket socket) {
 				if (!error) {
 					// Accept a new client
 					std::shared_ptr<NetConnection> client
-						= std::make_shared<NetConnection>(m_context, socket);
+						= std::make_shared<NetConnection>(context, socket);
 					client->init(&m_messagesIn, m_maxMessageSize);
+					client->setFlushDelay(m_flushDelay);
 					client->connectToClient(m_currentID++);
 
 					SERVERLOG(Info, "Found new client connection");
 
-					if (onConnect(client)) {
-						// The program has decided to accept the client
-						SERVERLOG(Info, "Accepted client, assigned ID ",
-							client->getID());
-						m_clients.push_back(client);
+					// Offer the client the datagram channel, this thread is
+					// the channel's thread
+					if (m_datagrams.isOpen()) {
+						unsigned int clientID = client->getID();
+						client->m_datagrams = &m_datagrams;
+						client->m_datagramToken = m_tokenGenerator();
+						m_datagramClients[clientID] = client;
+						NetMessage tokenMessage(
+							NetMessageTypes::DATAGRAM_TOKEN);
+						NetWriter writer(tokenMessage);
+						writer.write(clientID);
+						writer.write(client->m_datagramToken);
+						client->send(tokenMessage);
 					}
+
+					// Let the next update decide whether to accept the client,
+					// so that onConnect() runs on the same thread as the
+					// server's other callbacks
+					std::scoped_lock lock(m_newClientsMtx);
+					m_newClients.push_back(client);
 				}
 				else {
 					SERVERLOG(Warning, "Failed to find new client connection");
@@ -463,4 +1284,28 @@ namespace Milkweed {
 			}
 		);
 	}
+
+	void NetServer::forgetDatagramClient(unsigned int ID) {
+		// The list of datagram clients belongs to the listening thread
+		if (m_datagrams.isOpen()) {
+			asio::post(m_context,
+				[this, ID]() { m_datagramClients.erase(ID); });
+		}
+	}
+
+	void NetServer::forgetClient(unsigned int ID) {
+		forgetDatagramClient(ID);
+		m_clientIDs.erase(ID);
+		m_interest.remove(ID);
+	}
+
+	asio::io_context& NetServer::getNextContext() {
+		// The listening context takes a turn after the extra contexts, so the
+		// first connections go to threads which are not also accepting
+		unsigned int index = m_nextContext++ % (m_contexts.size() + 1);
+		if (index == m_contexts.size()) {
+			return m_context;
+		}
+		return *m_contexts[index];
+	}
 }
\ No newline at end of file
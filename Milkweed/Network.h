@@ -7,13 +7,25 @@
 #ifndef MW_NETWORK_H
 #define MW_NETWORK_H
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <ostream>
 #include <vector>
 #include <deque>
+#include <functional>
+#include <map>
 #include <mutex>
+#include <random>
+#include <string>
 #include <thread>
+#include <unordered_map>
 #include <memory>
+#include <type_traits>
 #include <condition_variable>
+#include <cstddef>
 
 #ifdef _WIN32
 #define _WIN32_WINNT 0x0A00
@@ -33,10 +45,33 @@ namespace Milkweed {
 		CONNECTED = 0xffffff00,
 		FAILED = 0xffffff01,
 		DISCONNECTED = 0xffffff02,
+		// Sent by a server over TCP to give a client its connection ID and the
+		// token to put in its datagrams
+		DATAGRAM_TOKEN = 0xffffff03,
+		// Sent over UDP by both sides until each has heard the other
+		DATAGRAM_HANDSHAKE = 0xffffff04,
+		// A delta-encoded snapshot from a NetSnapshotSender
+		SNAPSHOT = 0xffffff05,
+		// A client's acknowledgement of the newest snapshot it has received
+		SNAPSHOT_ACK = 0xffffff06,
 	};
 
-	// Forward declare NetConnection
+	/*
+	* The ways a NetMessage can be sent between a NetClient and a NetServer
+	*/
+	enum class NetSendMode {
+		// Over the TCP connection, always arrives and in order
+		RELIABLE,
+		// Over UDP, may be lost, duplicated or arrive out of order
+		UNRELIABLE,
+		// Over UDP, may be lost but never arrives after a newer sequenced
+		// message from the same sender
+		UNRELIABLE_SEQUENCED,
+	};
+
+	// Forward declare NetConnection and NetDatagramChannel
 	class NetConnection;
+	class NetDatagramChannel;
 
 	/*
 	* The header information of a NetMessage
@@ -48,6 +83,176 @@ namespace Milkweed {
 		unsigned int size = sizeof(NetMessageHeader);
 	};
 
+	/*
+	* A reference-counted block of message bytes, taken from and returned to the
+	* NetBufferPool so that its memory is reused between messages
+	*/
+	class NetBuffer {
+	public:
+		// The bytes in this buffer, its size is the buffer's capacity
+		std::vector<char> data;
+
+	private:
+		friend class NetBufferPool;
+		friend class NetMessageBody;
+
+		// The number of message bodies sharing this buffer
+		std::atomic<unsigned int> m_references { 0 };
+	};
+
+	/*
+	* A thread-safe pool of message buffers so that serializing, queueing and
+	* sending messages does not allocate memory once it has warmed up
+	*/
+	class NetBufferPool {
+	public:
+		/*
+		* The copy constructor is disabled for this class
+		*/
+		NetBufferPool(NetBufferPool& p) = delete;
+		/*
+		* Get the singleton instance of this class
+		*/
+		static NetBufferPool& getInstance() {
+			return m_instance;
+		}
+
+		/*
+		* Take a buffer from the pool, or allocate one if the pool is empty
+		*
+		* @param capacity: The minimum number of bytes the buffer must hold
+		* @return A buffer with a single reference and at least the given
+		* capacity
+		*/
+		NetBuffer* acquire(size_t capacity);
+		/*
+		* Return a buffer with no more references to the pool
+		*
+		* @param buffer: The buffer to return
+		*/
+		void release(NetBuffer* buffer);
+		/*
+		* Free every buffer waiting in the pool
+		*/
+		void clear();
+
+		// The number of free buffers the pool keeps before freeing them
+		const static unsigned int MAX_FREE_BUFFERS = 1024;
+		// The largest buffer in bytes the pool keeps for reuse
+		const static size_t MAX_POOLED_CAPACITY = 65536;
+
+	private:
+		// The singleton instance of this class
+		static NetBufferPool m_instance;
+		/*
+		* The constructor is disabled for this class
+		*/
+		NetBufferPool() {}
+		/*
+		* Free the buffers left in the pool
+		*/
+		~NetBufferPool() { clear(); }
+
+		// The buffers waiting to be reused
+		std::vector<NetBuffer*> m_free;
+		// The mutex used to lock the free buffers for thread-safety
+		std::mutex m_mtx;
+	};
+
+	/*
+	* The body of a NetMessage, a handle to a pooled buffer which copies of the
+	* message share until one of them is written to
+	*/
+	class NetMessageBody {
+	public:
+		/*
+		* Construct an empty body with no buffer
+		*/
+		NetMessageBody() {}
+		/*
+		* Share another body's buffer
+		*/
+		NetMessageBody(const NetMessageBody& body);
+		/*
+		* Take another body's buffer, leaving it empty
+		*/
+		NetMessageBody(NetMessageBody&& body) noexcept;
+		/*
+		* Release this body's buffer
+		*/
+		~NetMessageBody() { clear(); }
+		/*
+		* Share another body's buffer, releasing this one's
+		*/
+		NetMessageBody& operator=(const NetMessageBody& body);
+		/*
+		* Take another body's buffer, releasing this one's
+		*/
+		NetMessageBody& operator=(NetMessageBody&& body) noexcept;
+		/*
+		* Get the number of bytes in this body
+		*/
+		size_t size() const { return m_size; }
+		/*
+		* Test whether this body has no bytes
+		*/
+		bool empty() const { return m_size == 0; }
+		/*
+		* Get the bytes of this body for reading
+		*/
+		const char* data() const {
+			return (m_buffer != nullptr) ? m_buffer->data.data() : nullptr;
+		}
+		/*
+		* Get the bytes of this body for writing, copying them into a buffer of
+		* its own first if another body shares them
+		*/
+		char* data();
+		/*
+		* Change the number of bytes in this body, shrinking never copies and
+		* growing gives this body a buffer of its own
+		*
+		* @param size: The new number of bytes
+		*/
+		void resize(size_t size);
+		/*
+		* Get the number of bytes this body can grow to without moving to a
+		* larger buffer
+		*/
+		size_t capacity() const {
+			return (m_buffer != nullptr) ? m_buffer->data.size() : 0;
+		}
+		/*
+		* Make room for this body to grow to a number of bytes without moving to
+		* a larger buffer, giving this body a buffer of its own
+		*
+		* @param capacity: The number of bytes to make room for
+		*/
+		void reserve(size_t capacity) { makeUnique(capacity); }
+		/*
+		* Release this body's buffer and empty it
+		*/
+		void clear();
+		/*
+		* Test whether this body's buffer is shared with another body
+		*/
+		bool isShared() const {
+			return m_buffer != nullptr && m_buffer->m_references > 1;
+		}
+
+	private:
+		// The buffer holding this body's bytes, nullptr if there is none
+		NetBuffer* m_buffer = nullptr;
+		// The number of bytes at the start of the buffer in this body
+		size_t m_size = 0;
+
+		/*
+		* Make sure this body has a buffer of its own with at least the given
+		* capacity, copying its bytes into a new one if needed
+		*/
+		void makeUnique(size_t capacity);
+	};
+
 	/*
 	* A message to pass over the internet between NetClient's and servers
 	*/
@@ -57,8 +262,9 @@ namespace Milkweed {
 		std::shared_ptr<NetConnection> owner = nullptr;
 		// The header information of this message
 		NetMessageHeader header;
-		// The data contained in this message
-		std::vector<char> body;
+		// The data contained in this message, shared between copies of this
+		// message until one of them is changed
+		NetMessageBody body;
 
 		/*
 		* Construct this message with no owner connection
@@ -80,46 +286,204 @@ namespace Milkweed {
 				<< message.header.size << " bytes";
 			return os;
 		}
+	};
+
+	/*
+	* Writes values to the end of a message's body in the order they are
+	* written, growing the body ahead of the writes so that it is rarely moved
+	*/
+	class NetWriter {
+	public:
+		/*
+		* Construct a writer which appends to a message
+		*
+		* @param message: The message to write to, which must outlive the writer
+		* @param reserve: The number of bytes to make room for up front (0 by
+		* default)
+		*/
+		NetWriter(NetMessage& message, size_t reserve = 0);
 		/*
-		* Override for the bitshit left operator to push data from a variable
-		* into the body of this message
+		* Write a value's bytes as they are in memory
+		*
+		* @param value: The value to write, such as a number or a glm vector
 		*/
 		template<typename T>
-		friend NetMessage& operator<<(NetMessage& message, T& var) {
-			if (std::is_standard_layout<T>::value) {
-				// Cache the current body size and resize the message
-				size_t s = message.body.size();
-				message.body.resize(message.body.size() + sizeof(T));
-				// Copy the variable's data into the message body and recalculate
-				// the size in the header
-				std::memcpy(message.body.data() + s, &var, sizeof(T));
-				message.header.size = (unsigned int)message.body.size();
+		void write(const T& value) {
+			static_assert(std::is_trivially_copyable<T>::value,
+				"NetWriter can only write trivially copyable values");
+			std::memcpy(grow(sizeof(T)), &value, sizeof(T));
+		}
+		/*
+		* Write an unsigned number in 1 to 5 bytes, small values take fewer
+		*
+		* @param value: The value to write
+		*/
+		void writeVarint(unsigned int value);
+		/*
+		* Write a signed number in 1 to 5 bytes, values close to zero take fewer
+		*
+		* @param value: The value to write
+		*/
+		void writeSignedVarint(int value);
+		/*
+		* Write a float within a known range in fewer bytes, losing precision
+		*
+		* @param value: The value to write, clamped to the range
+		* @param min: The smallest value in the range
+		* @param max: The largest value in the range
+		* @param bytes: The number of bytes to write it in (1 - 4, 2 by default)
+		*/
+		void writeQuantized(float value, float min, float max,
+			unsigned int bytes = 2);
+		/*
+		* Write a string's length followed by its characters
+		*
+		* @param value: The string to write
+		*/
+		void writeString(const std::string& value);
+		/*
+		* Write a number of values followed by their bytes in one copy
+		*
+		* @param values: The values to write
+		* @param count: The number of values
+		*/
+		template<typename T>
+		void writeArray(const T* values, size_t count) {
+			static_assert(std::is_trivially_copyable<T>::value,
+				"NetWriter can only write trivially copyable values");
+			writeVarint((unsigned int)count);
+			if (count > 0) {
+				std::memcpy(grow(count * sizeof(T)), values, count * sizeof(T));
 			}
+		}
+		/*
+		* Write the number of values in a vector followed by their bytes
+		*/
+		template<typename T>
+		void writeArray(const std::vector<T>& values) {
+			writeArray(values.data(), values.size());
+		}
+
+	private:
+		// The message being written to
+		NetMessage& m_message;
+
+		/*
+		* Add bytes to the end of the message's body, doubling its capacity when
+		* it runs out
+		*
+		* @param bytes: The number of bytes to add
+		* @return A pointer to the bytes added
+		*/
+		char* grow(size_t bytes);
+	};
 
-			// Return the message so that this operator can be chained
-			return message;
+	/*
+	* Reads the values written by a NetWriter in the same order, failing
+	* instead of reading past the end of the message's body
+	*/
+	class NetReader {
+	public:
+		/*
+		* Construct a reader from the start of a message's body
+		*
+		* @param message: The message to read, which must outlive the reader
+		* and not change while it is read
+		*/
+		NetReader(const NetMessage& message) : m_data(message.body.data()),
+			m_size(message.body.size()) {}
+		/*
+		* Read a value written with NetWriter::write()
+		*
+		* @param value: The value to read into, left unchanged on failure
+		* @return Whether the value could be read
+		*/
+		template<typename T>
+		bool read(T& value) {
+			static_assert(std::is_trivially_copyable<T>::value,
+				"NetReader can only read trivially copyable values");
+			const char* bytes = take(sizeof(T));
+			if (bytes == nullptr) {
+				return false;
+			}
+			std::memcpy(&value, bytes, sizeof(T));
+			return true;
 		}
 		/*
-		* Override for the bitshift right operator to pull data from the body
-		* of this message into a variable
+		* Read a value written with NetWriter::writeVarint()
+		*/
+		bool readVarint(unsigned int& value);
+		/*
+		* Read a value written with NetWriter::writeSignedVarint()
+		*/
+		bool readSignedVarint(int& value);
+		/*
+		* Read a value written with NetWriter::writeQuantized(), with the same
+		* range and number of bytes
+		*/
+		bool readQuantized(float& value, float min, float max,
+			unsigned int bytes = 2);
+		/*
+		* Read a string written with NetWriter::writeString()
+		*
+		* @param value: The string to read into, left unchanged on failure
+		* @param maxLength: The longest string to accept (no limit by default)
+		* @return Whether the string could be read and was not too long
+		*/
+		bool readString(std::string& value, size_t maxLength = (size_t)-1);
+		/*
+		* Read values written with NetWriter::writeArray()
+		*
+		* @param values: The vector to read into, left unchanged on failure
+		* @param maxCount: The most values to accept (no limit by default)
+		* @return Whether the values could be read and were not too many
 		*/
 		template<typename T>
-		friend NetMessage& operator>>(NetMessage& message, T& var) {
-			if (std::is_standard_layout<T>::value
-				&& message.body.size() >= sizeof(T)) {
-				// Cache the location in the message body data that the variable's
-				// data begins
-				size_t s = message.body.size() - sizeof(T);
-				// Copy the data out of the message body and resize it
-				std::memcpy(&var, message.body.data() + s, sizeof(T));
-				message.body.resize(s);
-				// Recalculate the message size in the header
-				message.header.size = (unsigned int)message.body.size();
+		bool readArray(std::vector<T>& values, size_t maxCount = (size_t)-1) {
+			static_assert(std::is_trivially_copyable<T>::value,
+				"NetReader can only read trivially copyable values");
+			unsigned int count = 0;
+			if (!readVarint(count)) {
+				return false;
 			}
-
-			// Return the message so that this operator can be chained
-			return message;
+			if (count > maxCount || count > getRemaining() / sizeof(T)) {
+				m_failed = true;
+				return false;
+			}
+			const char* bytes = take(count * sizeof(T));
+			values.resize(count);
+			if (count > 0) {
+				std::memcpy(values.data(), bytes, count * sizeof(T));
+			}
+			return true;
 		}
+		/*
+		* Test whether any read has failed, every read after a failure fails
+		*/
+		bool hasFailed() const { return m_failed; }
+		/*
+		* Get the number of bytes left to read
+		*/
+		size_t getRemaining() const { return m_size - m_position; }
+
+	private:
+		// The bytes of the message's body
+		const char* m_data = nullptr;
+		// The number of bytes in the message's body
+		size_t m_size = 0;
+		// The number of bytes read so far
+		size_t m_position = 0;
+		// Whether a read has failed
+		bool m_failed = false;
+
+		/*
+		* Take the next bytes to read
+		*
+		* @param bytes: The number of bytes to take
+		* @return A pointer to the bytes, nullptr if there are not enough left
+		* or a read has already failed
+		*/
+		const char* take(size_t bytes);
 	};
 
 	/*
@@ -145,14 +509,14 @@ namespace Milkweed {
 		* Delete all items from this queue's memory
 		*/
 		void clear() {
-			std::scoped_lock(m_mtx);
+			std::scoped_lock lock(m_mtx);
 			m_DEQueue.clear();
 		}
 		/*
 		* Get the number of items in this queue
 		*/
 		size_t size() {
-			std::scoped_lock(m_mtx);
+			std::scoped_lock lock(m_mtx);
 			return m_DEQueue.size();
 		}
 		/*
@@ -162,14 +526,14 @@ namespace Milkweed {
 		* @return A reference to the element of this queue at the given index
 		*/
 		T& at(unsigned int index) {
-			std::scoped_lock(m_mtx);
+			std::scoped_lock lock(m_mtx);
 			return m_DEQueue.at(index);
 		}
 		/*
 		* Test whether this queue is empty
 		*/
 		bool empty() {
-			std::scoped_lock(m_mtx);
+			std::scoped_lock lock(m_mtx);
 			return m_DEQueue.empty();
 		}
 		/*
@@ -178,7 +542,7 @@ namespace Milkweed {
 		* @return A reference to the item at the front of the double-ended queue
 		*/
 		const T& front() {
-			std::scoped_lock(m_mtx);
+			std::scoped_lock lock(m_mtx);
 			return m_DEQueue.front();
 		}
 		/*
@@ -187,7 +551,7 @@ namespace Milkweed {
 		* @return The item at the front of this queue by value
 		*/
 		T popFront() {
-			std::scoped_lock(m_mtx);
+			std::scoped_lock lock(m_mtx);
 			T t = std::move(m_DEQueue.front());
 			m_DEQueue.pop_front();
 			return t;
@@ -198,7 +562,7 @@ namespace Milkweed {
 		* @return A reference to the item at the back of the double-ended queue
 		*/
 		const T& back() {
-			std::scoped_lock(m_mtx);
+			std::scoped_lock lock(m_mtx);
 			return m_DEQueue.back();
 		}
 		/*
@@ -207,7 +571,7 @@ namespace Milkweed {
 		* @return The item at the back of this queue by value
 		*/
 		T popBack() {
-			std::scoped_lock(m_mtx);
+			std::scoped_lock lock(m_mtx);
 			T t = std::move(m_DEQueue.back());
 			m_DEQueue.pop_back();
 			return t;
@@ -218,8 +582,8 @@ namespace Milkweed {
 		* @param t: A reference to the item to push onto the front of the queue
 		*/
 		void pushFront(const T& t) {
-			std::scoped_lock(m_mtx);
-			m_DEQueue.emplace_front(std::move(t));
+			std::scoped_lock lock(m_mtx);
+			m_DEQueue.emplace_front(t);
 		}
 		/*
 		* Add an item to the back of this queue
@@ -227,7 +591,16 @@ namespace Milkweed {
 		* @param t: A reference to the item to push onto the back of the queue
 		*/
 		void pushBack(const T& t) {
-			std::scoped_lock(m_mtx);
+			std::scoped_lock lock(m_mtx);
+			m_DEQueue.emplace_back(t);
+		}
+		/*
+		* Move an item onto the back of this queue
+		*
+		* @param t: The item to move onto the back of the queue
+		*/
+		void pushBack(T&& t) {
+			std::scoped_lock lock(m_mtx);
 			m_DEQueue.emplace_back(std::move(t));
 		}
 
@@ -238,6 +611,175 @@ namespace Milkweed {
 		std::mutex m_mtx;
 	};
 
+	/*
+	* A bounded lock-free queue which many threads can push to and a single
+	* thread can pop from, used for messages coming in from the network
+	*/
+	template <typename T>
+	class MPSCQueue {
+	public:
+		/*
+		* Construct an empty queue
+		*
+		* @param capacity: The most items this queue can hold at once, rounded
+		* up to a power of two (4096 by default)
+		*/
+		MPSCQueue(size_t capacity = 4096) {
+			size_t size = 2;
+			while (size < capacity) {
+				size *= 2;
+			}
+			m_cells.reset(new Cell[size]);
+			m_mask = size - 1;
+			for (size_t i = 0; i < size; i++) {
+				m_cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+		/*
+		* The copy constructor is disabled for this class
+		*/
+		MPSCQueue(const MPSCQueue<T>&) = delete;
+		/*
+		* Get the most items this queue can hold at once
+		*/
+		size_t capacity() const { return m_mask + 1; }
+		/*
+		* Attempt to move an item onto the back of this queue (any thread)
+		*
+		* @param t: The item to move onto the back of the queue
+		* @return Whether the item was added, false if the queue is full
+		*/
+		bool tryPush(T&& t) {
+			size_t position = m_tail.load(std::memory_order_relaxed);
+			Cell* cell = nullptr;
+			while (true) {
+				cell = &m_cells[position & m_mask];
+				size_t sequence = cell->sequence.load(std::memory_order_acquire);
+				std::ptrdiff_t difference = (std::ptrdiff_t)sequence
+					- (std::ptrdiff_t)position;
+				if (difference == 0) {
+					// The cell is free, claim it if no other producer has
+					if (m_tail.compare_exchange_weak(position, position + 1,
+						std::memory_order_relaxed)) {
+						break;
+					}
+				}
+				else if (difference < 0) {
+					// The consumer has not freed this cell yet, the queue is
+					// full
+					return false;
+				}
+				else {
+					// Another producer claimed this cell first, try the next
+					position = m_tail.load(std::memory_order_relaxed);
+				}
+			}
+
+			// Fill the claimed cell and publish it to the consumer
+			cell->item = std::move(t);
+			cell->sequence.store(position + 1, std::memory_order_release);
+			return true;
+		}
+		/*
+		* Move an item onto the back of this queue (any thread), waiting for the
+		* consumer to make room if the queue is full
+		*
+		* @param t: The item to move onto the back of the queue
+		*/
+		void pushBack(T&& t) {
+			while (!tryPush(std::move(t))) {
+				std::this_thread::yield();
+			}
+		}
+		/*
+		* Copy an item onto the back of this queue (any thread), waiting for the
+		* consumer to make room if the queue is full
+		*
+		* @param t: The item to copy onto the back of the queue
+		*/
+		void pushBack(const T& t) {
+			pushBack(T(t));
+		}
+		/*
+		* Attempt to take the item at the front of this queue (consumer only)
+		*
+		* @param t: The item to move the front of the queue into
+		* @return Whether there was an item to take
+		*/
+		bool tryPop(T& t) {
+			Cell& cell = m_cells[m_head & m_mask];
+			if (cell.sequence.load(std::memory_order_acquire) != m_head + 1) {
+				return false;
+			}
+
+			// Take the item and hand the cell back to the producers for the
+			// next lap around the queue
+			t = std::move(cell.item);
+			cell.sequence.store(m_head + m_mask + 1, std::memory_order_release);
+			m_head++;
+			return true;
+		}
+		/*
+		* Take every item waiting in this queue in one call (consumer only)
+		*
+		* @param items: The vector to append the items to in order
+		* @param maxItems: The most items to take (-1 for +inf)
+		* @return The number of items taken
+		*/
+		size_t popAll(std::vector<T>& items, size_t maxItems = -1) {
+			size_t count = 0;
+			while (count < maxItems) {
+				Cell& cell = m_cells[m_head & m_mask];
+				if (cell.sequence.load(std::memory_order_acquire)
+					!= m_head + 1) {
+					break;
+				}
+				items.push_back(std::move(cell.item));
+				cell.sequence.store(m_head + m_mask + 1,
+					std::memory_order_release);
+				m_head++;
+				count++;
+			}
+			return count;
+		}
+		/*
+		* Test whether this queue has no items ready to take (consumer only)
+		*/
+		bool empty() const {
+			return m_cells[m_head & m_mask].sequence.load(
+				std::memory_order_acquire) != m_head + 1;
+		}
+		/*
+		* Delete every item waiting in this queue (consumer only)
+		*/
+		void clear() {
+			T t;
+			while (tryPop(t)) {
+				t = T();
+			}
+		}
+
+	private:
+		/*
+		* A slot in the queue, its sequence number tells producers and the
+		* consumer which lap of the queue it is ready for
+		*/
+		struct Cell {
+			std::atomic<size_t> sequence;
+			T item;
+		};
+
+		// The ring of cells holding the items in this queue
+		std::unique_ptr<Cell[]> m_cells;
+		// The number of cells minus one, for wrapping positions into the ring
+		size_t m_mask = 0;
+		// The next position for a producer to claim, kept on its own cache
+		// line from the consumer's position
+		alignas(64) std::atomic<size_t> m_tail { 0 };
+		// The next position for the consumer to take from
+		alignas(64) size_t m_head = 0;
+	};
+
 	/*
 	* The interface which connects NetServer's and NetClient's to the internet
 	* via the ASIO library
@@ -252,17 +794,18 @@ namespace Milkweed {
 		* the internet
 		*/
 		NetConnection(asio::io_context& context, asio::ip::tcp::socket& socket)
-			: m_context(context), m_socket(std::move(socket)) {}
+			: m_context(context), m_socket(std::move(socket)),
+			m_flushTimer(context) {}
 		/*
 		* Initialize this connection with a context and a place to send incoming
 		* messages (for NetClient's)
 		*
-		* @param messagesIn: A pointer to a TSQueue of NetMessage's for this
+		* @param messagesIn: A pointer to a MPSCQueue of NetMessage's for this
 		* connection to push back incoming messages to
 		* @param maxMessageSize: The maximum message body size which can be
 		* received by this connection in bytes (1024 by default)
 		*/
-		void init(TSQueue<NetMessage>* messagesIn,
+		void init(MPSCQueue<NetMessage>* messagesIn,
 			unsigned int maxMessageSize = 1024);
 		/*
 		* Attach this connection to a remote server (for NetClient's only)
@@ -273,6 +816,16 @@ namespace Milkweed {
 		void connectToServer(
 			const asio::ip::tcp::resolver::results_type& endpoints);
 		/*
+		* Let this connection take up a server's offer of a datagram channel,
+		* for programs which make connections without a NetClient (call before
+		* connecting)
+		*
+		* @param datagrams: A closed channel for this connection alone, which
+		* must run on the same ASIO context and outlive the connection, or
+		* nullptr on that context's thread to let go of the channel
+		*/
+		void setDatagramChannel(NetDatagramChannel* datagrams);
+		/*
 		* Attach this connection to a remote client (for NetServer's only)
 		*
 		* @param ID: The unique ID number for this connection for identification
@@ -301,6 +854,23 @@ namespace Milkweed {
 		*/
 		void send(const NetMessage& message);
 		/*
+		* Send a message over this connection with a given send mode, unreliable
+		* messages go over UDP once the datagram channel has completed its
+		* handshake and over TCP until then
+		*
+		* @param message: The message to send over this connection
+		* @param mode: The way to send the message
+		*/
+		void send(const NetMessage& message, NetSendMode mode);
+		/*
+		* Set how long this connection waits after a message is sent for more
+		* messages to write along with it
+		*
+		* @param flushDelay: The time to hold messages before writing them, zero
+		* to write as soon as the connection is free (the default)
+		*/
+		void setFlushDelay(std::chrono::microseconds flushDelay);
+		/*
 		* Detach this connection from whatever remote machine it is connected to
 		*/
 		void disconnect();
@@ -310,8 +880,15 @@ namespace Milkweed {
 		void destroy();
 
 	private:
-		// Whether this connection is connected to a remote machine
-		bool m_connected = false;
+		// Let the datagram channel, client and server share this connection's
+		// datagram state
+		friend class NetDatagramChannel;
+		friend class NetClient;
+		friend class NetServer;
+
+		// Whether this connection is connected to a remote machine, read by
+		// the datagram channel's thread
+		std::atomic<bool> m_connected { false };
 		// The ASIO context to perform networking within
 		asio::io_context& m_context;
 		// The ASIO socket to read and write data with
@@ -319,27 +896,182 @@ namespace Milkweed {
 		// The ID number of this connection (for NetServer's only)
 		unsigned int m_ID = 0;
 		// A pointer to the queue to push incoming messages to
-		TSQueue<NetMessage>* m_messagesIn = nullptr;
+		MPSCQueue<NetMessage>* m_messagesIn = nullptr;
 		// The queue of messages waiting to be sent asynchronously with ASIO
 		TSQueue<NetMessage> m_messagesOut;
-		// Temporary message to be populated with data by readHeader() and
-		// readBody()
-		NetMessage m_tempMessage;
+		// The messages currently being written by ASIO, kept alive until the
+		// write completes
+		std::vector<NetMessage> m_messagesWriting;
+		// The headers and bodies of the messages being written, gathered into
+		// a single write
+		std::vector<asio::const_buffer> m_writeBuffers;
+		// Whether a write is currently in progress on the socket
+		bool m_writing = false;
+		// The time to wait for more messages before starting a write
+		std::chrono::microseconds m_flushDelay = std::chrono::microseconds(0);
+		// The timer used to wait out the flush delay
+		asio::steady_timer m_flushTimer;
+		// Whether the flush timer is waiting to start a write
+		bool m_flushPending = false;
+		// The bytes read from the socket which have not been parsed into
+		// messages yet
+		std::vector<char> m_receiveBuffer;
+		// The index of the first unparsed byte in the receive buffer
+		size_t m_receiveBegin = 0;
+		// The index after the last byte read into the receive buffer
+		size_t m_receiveEnd = 0;
 		// The maximum message body size in bytes this connection will accept
 		unsigned int m_maxMessageSize = 1024;
 		// Whether this connection belongs to a server
 		bool m_serverOwned = false;
 
-		// Read in a message header from the network asynchronously
-		void readHeader();
-		// Read in a message body from the network asynchronously
-		void readBody();
-		// Add a message to messages in queue
-		void addMessageIn();
-		// Write a message header from the messages out queue
-		void writeHeader();
-		// Write a message body from the messages out queue
-		void writeBody();
+		// Read as many bytes as are available from the network asynchronously
+		void read();
+		// Add every complete message in the receive buffer to the messages in
+		// queue, returns false if a message was too big to accept
+		bool parseMessages();
+		// Start a write now, or after the flush delay if there is one
+		void scheduleWrite();
+		// Write every message in the messages out queue in one gathered write
+		void write();
+
+		// The most messages to gather into one write, each takes two buffers
+		// and most systems will write at most 1024 buffers in one call
+		const static unsigned int MAX_WRITE_MESSAGES = 512;
+		// The smallest size of the receive buffer in bytes, it grows to fit the
+		// largest message this connection accepts
+		const static size_t RECEIVE_BUFFER_SIZE = 8192;
+
+		// The datagram channel for unreliable messages, nullptr if there is
+		// none, the following datagram state is only used on its thread
+		NetDatagramChannel* m_datagrams = nullptr;
+		// The UDP address of the remote machine
+		asio::ip::udp::endpoint m_datagramEndpoint;
+		// The token identifying this connection's datagrams, given by the
+		// server
+		unsigned int m_datagramToken = 0;
+		// Whether the datagram handshake has completed so UDP can be used
+		bool m_datagramReady = false;
+		// The sequence number of the last sequenced datagram sent
+		unsigned int m_datagramSendSequence = 0;
+		// The sequence number of the newest sequenced datagram received
+		unsigned int m_datagramReceiveSequence = 0;
+	};
+
+	/*
+	* The header at the start of every datagram sent by a NetDatagramChannel,
+	* followed by a NetMessageHeader and its body
+	*/
+	struct NetDatagramHeader {
+		// The ID number of the connection this datagram belongs to
+		unsigned int connectionID = 0;
+		// The token the server gave this connection, so that other machines
+		// cannot send datagrams as this connection
+		unsigned int token = 0;
+		// The sequence number of this datagram, 0 if it is not sequenced
+		unsigned int sequence = 0;
+	};
+
+	/*
+	* A UDP socket carrying unreliable messages for one or many NetConnection's
+	* alongside their TCP streams
+	*/
+	class NetDatagramChannel {
+	public:
+		/*
+		* Construct a closed datagram channel
+		*
+		* @param context: The ASIO context to do this channel's networking in
+		*/
+		NetDatagramChannel(asio::io_context& context)
+			: m_socket(context), m_handshakeTimer(context) {}
+		/*
+		* Open this channel's socket and start receiving datagrams
+		*
+		* @param port: The UDP port to receive datagrams on (0 for any port)
+		* @param findConnection: A function which finds the connection with a
+		* given ID, called on the channel's thread
+		* @return Whether the socket could be opened
+		*/
+		bool open(unsigned short port,
+			const std::function<std::shared_ptr<NetConnection>(unsigned int)>&
+			findConnection);
+		/*
+		* Test whether this channel's socket is open
+		*/
+		bool isOpen() const { return m_socket.is_open(); }
+		/*
+		* Start the datagram handshake with a server on a client's connection,
+		* must be called on the channel's thread
+		*
+		* @param connection: The client's connection, with its ID and token set
+		* @param endpoint: The UDP address of the server
+		*/
+		void connect(std::shared_ptr<NetConnection> connection,
+			const asio::ip::udp::endpoint& endpoint);
+		/*
+		* Send a message over UDP to a connection's remote machine, or over its
+		* TCP stream if the handshake is not complete or the message is too big
+		* for one datagram
+		*
+		* @param connection: The connection to send the message for
+		* @param message: The message to send
+		* @param sequenced: Whether the receiver should drop this message if a
+		* newer sequenced message has already arrived
+		*/
+		void send(std::shared_ptr<NetConnection> connection,
+			const NetMessage& message, bool sequenced);
+		/*
+		* Close this channel's socket, must not be called while its ASIO context
+		* is running on another thread
+		*/
+		void close();
+
+		// The largest datagram in bytes this channel will send, small enough
+		// to never be fragmented on common networks
+		const static size_t MAX_DATAGRAM_SIZE = 1200;
+		// The number of handshakes a client sends before giving up on UDP
+		const static unsigned int MAX_HANDSHAKES = 20;
+
+	private:
+		// The UDP socket to send and receive datagrams with
+		asio::ip::udp::socket m_socket;
+		// The timer used to repeat a client's handshake
+		asio::steady_timer m_handshakeTimer;
+		// The function used to find the connection a datagram belongs to
+		std::function<std::shared_ptr<NetConnection>(unsigned int)>
+			m_findConnection;
+		// The bytes of the datagram being received
+		char m_receiveBuffer[MAX_DATAGRAM_SIZE];
+		// The address of the datagram being received
+		asio::ip::udp::endpoint m_receiveEndpoint;
+
+		/*
+		* Open this channel's socket on a local address and start receiving
+		* datagrams
+		*/
+		bool open(const asio::ip::udp::endpoint& endpoint,
+			const std::function<std::shared_ptr<NetConnection>(unsigned int)>&
+			findConnection);
+		/*
+		* Receive the next datagram asynchronously
+		*/
+		void read();
+		/*
+		* Check a datagram which has arrived and add its message to its
+		* connection's messages in queue
+		*/
+		void parseDatagram(size_t length);
+		/*
+		* Write a message in a datagram to a connection's remote machine
+		*/
+		void write(NetConnection& connection, const NetMessage& message,
+			unsigned int sequence);
+		/*
+		* Send a client's handshake and repeat it until the server answers
+		*/
+		void sendHandshake(std::weak_ptr<NetConnection> connection,
+			unsigned int attempt);
 	};
 
 	/*
@@ -385,16 +1117,26 @@ namespace Milkweed {
 			m_connection->setMaxMessageSize(maxMessageSize);
 		}
 		/*
+		* Set how long this client's connection waits to gather messages into
+		* one write, zero by default
+		*/
+		void setFlushDelay(std::chrono::microseconds flushDelay) {
+			m_connection->setFlushDelay(flushDelay);
+		}
+		/*
 		* Send a message to the server this network client is connected to
 		*
 		* @param message: The NetMessage to send to the server
+		* @param mode: The way to send the message, unreliable messages are
+		* sent over UDP if the server offers it (reliable by default)
 		*/
-		void send(const NetMessage& message);
+		void send(const NetMessage& message,
+			NetSendMode mode = NetSendMode::RELIABLE);
 		/*
 		* Get a reference to the queue of messages coming into this client from
 		* the server
 		*/
-		TSQueue<NetMessage>& getMessagesIn() { return m_messagesIn; }
+		MPSCQueue<NetMessage>& getMessagesIn() { return m_messagesIn; }
 		/*
 		* Disconnect this client from a server if it is connected
 		*/
@@ -410,7 +1152,7 @@ namespace Milkweed {
 		/*
 		* The constructor is disabled for this class
 		*/
-		NetClient() : m_socket(m_context) {}
+		NetClient() : m_socket(m_context), m_datagrams(m_context) {}
 
 		// The ASIO context to do networking with
 		asio::io_context m_context;
@@ -420,13 +1162,88 @@ namespace Milkweed {
 		asio::ip::tcp::socket m_socket;
 		// The connection used to access the internet
 		std::shared_ptr<NetConnection> m_connection;
+		// The channel for unreliable messages to and from the server
+		NetDatagramChannel m_datagrams;
 		// The queue for the connection to push messages from the server into
 		// the back of
-		TSQueue<NetMessage> m_messagesIn;
+		MPSCQueue<NetMessage> m_messagesIn;
+	};
+
+	/*
+	* Finds the ID numbers placed within a fixed radius of a point, by keeping
+	* them in a uniform grid of square cells so that only nearby cells are
+	* searched
+	*/
+	class NetInterestGrid {
+	public:
+		/*
+		* Set the size of the area searched around each point, removing every
+		* ID number placed in this grid
+		*
+		* @param radius: The distance from a point to search within
+		* @param cellSize: The width of each square cell, usually around the
+		* radius
+		*/
+		void init(float radius, float cellSize);
+		/*
+		* Test whether init() has been called with a positive radius
+		*/
+		bool isEnabled() const { return m_radius > 0.0f; }
+		/*
+		* Get the distance from a point to search within
+		*/
+		float getRadius() const { return m_radius; }
+		/*
+		* Place or move an ID number in this grid
+		*
+		* @param ID: The ID number to place
+		* @param x, y: The position to place it at
+		*/
+		void setPosition(unsigned int ID, float x, float y);
+		/*
+		* Remove an ID number from this grid if it has been placed
+		*/
+		void remove(unsigned int ID);
+		/*
+		* Find the ID numbers placed within the radius of a point
+		*
+		* @param x, y: The point to search around
+		* @param IDs: The vector to write the ID numbers to in increasing
+		* order, cleared first
+		*/
+		void query(float x, float y, std::vector<unsigned int>& IDs) const;
+		/*
+		* Remove every ID number placed in this grid
+		*/
+		void clear();
+
+	private:
+		/*
+		* The position of an ID number placed in the grid
+		*/
+		struct Entry {
+			float x = 0.0f, y = 0.0f;
+			unsigned long long cell = 0;
+		};
+
+		// The distance from a point to search within
+		float m_radius = 0.0f;
+		// The width of each square cell
+		float m_cellSize = 1.0f;
+		// The position of each ID number placed by its ID number
+		std::unordered_map<unsigned int, Entry> m_entries;
+		// The ID numbers placed in each cell by the cell's packed coordinates
+		std::unordered_map<unsigned long long, std::vector<unsigned int>>
+			m_cells;
+
+		/*
+		* Get the packed coordinates of the cell a position is in
+		*/
+		unsigned long long getCell(float x, float y) const;
 	};
 
-#define SERVERLOG(LEVEL, ...) m_log, m_log.getDate(), "[", #LEVEL, "] ",\
-	"[NetServer] ", __VA_ARGS__, "\n"
+#define SERVERLOG(LEVEL, ...) m_log.startMessage(), m_log.getDate(), "[",\
+	#LEVEL, "] [NetServer] ", __VA_ARGS__, "\n"
 
 	/*
 	* A server which can manager connections over the internet from multiple
@@ -440,37 +1257,92 @@ namespace Milkweed {
 		* @param port: The port number to listen for new network connections on
 		*/
 		NetServer(unsigned int port) : m_acceptor(m_context,
-			asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port)), m_port(port) {}
+			asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port)),
+			m_datagrams(m_context), m_port(port) {}
 		/*
 		* Start listening for new clients connecting to this server
 		*
 		* @param maxMessageSize: The maximum message body size which can be
 		* received by a client in bytes (1024 by default)
+		* @param threadCount: The number of threads to do networking on, new
+		* connections are spread evenly across them (1 by default)
+		* @param datagrams: Whether to open a UDP channel on the same port for
+		* unreliable messages (false by default)
 		* @return Whether the server could be started
 		*/
-		bool init(unsigned int maxMessageSize = 1024);
+		bool init(unsigned int maxMessageSize = 1024,
+			unsigned int threadCount = 1, bool datagrams = false);
 		/*
 		* Test whether this server is still listening for new connections
 		*/
 		bool isActive() const { return m_acceptor.is_open(); }
 		/*
+		* Get the native handles of the threads this server does networking
+		* on, for measuring the processor time they use
+		*/
+		std::vector<std::thread::native_handle_type> getNetworkThreads();
+		/*
 		* Send a message to the given client over its connection
 		*
 		* @param client: A pointer to the client to send the message to
 		* @param message: A reference to the message to send
+		* @param mode: The way to send the message (reliable by default)
 		* @return Whether the message could be sent
 		*/
 		bool messageClient(std::shared_ptr<NetConnection> client,
-			const NetMessage& message);
+			const NetMessage& message,
+			NetSendMode mode = NetSendMode::RELIABLE);
 		/*
 		* Send a message to all clients except, optionally, for one client
 		*
 		* @param message: The message to broadcast
 		* @param ignoredClient: A pointer to a client to ignore when sending
 		* the message (nullptr by default)
+		* @param mode: The way to send the message (reliable by default)
 		*/
 		void messageAllClients(const NetMessage& message,
-			std::shared_ptr<NetConnection> ignoredClient = nullptr);
+			std::shared_ptr<NetConnection> ignoredClient = nullptr,
+			NetSendMode mode = NetSendMode::RELIABLE);
+		/*
+		* Give each client an area of interest, a circle around a point set with
+		* setClientInterest(), so that messages about a place only go to the
+		* clients near it
+		*
+		* @param radius: The radius of every client's area of interest
+		* @param cellSize: The width of the cells clients are sorted into,
+		* usually around the radius
+		*/
+		void setInterestArea(float radius, float cellSize);
+		/*
+		* Move the center of a client's area of interest
+		*
+		* @param clientID: The ID number of the client
+		* @param x, y: The center of the client's area of interest
+		*/
+		void setClientInterest(unsigned int clientID, float x, float y);
+		/*
+		* Find the clients whose areas of interest contain a point
+		*
+		* @param x, y: The point
+		* @param clientIDs: The vector to write the clients' ID numbers to in
+		* increasing order, cleared first
+		*/
+		void getNearbyClients(float x, float y,
+			std::vector<unsigned int>& clientIDs) const;
+		/*
+		* Send a message to the clients whose areas of interest contain a
+		* point, clients which have not been given an area of interest are
+		* skipped
+		*
+		* @param message: The message to send
+		* @param x, y: The point the message is about
+		* @param ignoredClient: A pointer to a client to ignore when sending
+		* the message (nullptr by default)
+		* @param mode: The way to send the message (reliable by default)
+		*/
+		void messageNearbyClients(const NetMessage& message, float x, float y,
+			std::shared_ptr<NetConnection> ignoredClient = nullptr,
+			NetSendMode mode = NetSendMode::RELIABLE);
 		/*
 		* Update this server and call onMessage for all new messages since the
 		* last update
@@ -484,6 +1356,11 @@ namespace Milkweed {
 		*/
 		void setMaxMessageSize(unsigned int maxMessageSize);
 		/*
+		* Set how long the clients' connections wait to gather messages into
+		* one write, zero by default
+		*/
+		void setFlushDelay(std::chrono::microseconds flushDelay);
+		/*
 		* Stop listening for new connections, close all existing connections and
 		* free this NetServer's memory
 		*/
@@ -491,12 +1368,13 @@ namespace Milkweed {
 
 	protected:
 		// The queue of messages in from the clients connected to this server
-		TSQueue<NetMessage> m_messagesIn;
+		MPSCQueue<NetMessage> m_messagesIn;
 		// The logging system for this server
 		LogManager& m_log = LogManager::getInstance();
 
 		/*
-		* A client has made a connection to this server
+		* A client has made a connection to this server, called from update()
+		* like the other callbacks
 		*
 		* @param client: A pointer to the new connection made by this client
 		* @return Whether to accept the connection to the server
@@ -521,16 +1399,53 @@ namespace Milkweed {
 	private:
 		// The currently active and valid clients connected to this server
 		std::deque<std::shared_ptr<NetConnection>> m_clients;
-		// The ASIO context for this server
+		// Clients accepted by the ASIO thread waiting to be added to the
+		// list of clients on the next update
+		std::vector<std::shared_ptr<NetConnection>> m_newClients;
+		// The mutex used to lock the new clients for thread-safety
+		std::mutex m_newClientsMtx;
+		// The messages taken from the messages in queue each update, kept to
+		// reuse its memory
+		std::vector<NetMessage> m_messageBatch;
+		// The active clients by their ID numbers
+		std::unordered_map<unsigned int, std::weak_ptr<NetConnection>>
+			m_clientIDs;
+		// The centers of the clients' areas of interest
+		NetInterestGrid m_interest;
+		// The clients found by the last search of the areas of interest, kept
+		// to reuse its memory
+		std::vector<unsigned int> m_nearbyClients;
+		// Extra ASIO contexts for connections, each runs on its own thread so
+		// that every connection's work stays on a single thread, declared
+		// first so that they outlive sockets waiting in the listening context
+		std::vector<std::unique_ptr<asio::io_context>> m_contexts;
+		// The ASIO context for this server, listens for new connections
 		asio::io_context m_context;
 		// The thread to let the ASIO context work in
 		std::thread m_ASIOThread;
+		// Keeps the extra ASIO contexts running while they have no connections
+		std::vector<asio::executor_work_guard<asio::io_context::executor_type>>
+			m_contextWork;
+		// The threads to let the extra ASIO contexts work in
+		std::vector<std::thread> m_contextThreads;
+		// The index of the context to give the next new connection
+		unsigned int m_nextContext = 0;
 		// The ASIO port to let new connections in on
 		asio::ip::tcp::acceptor m_acceptor;
+		// The channel for unreliable messages, runs on the listening thread
+		NetDatagramChannel m_datagrams;
+		// The clients which can send datagrams by their ID numbers, only used
+		// on the listening thread
+		std::map<unsigned int, std::weak_ptr<NetConnection>>
+			m_datagramClients;
+		// The generator for the tokens given to clients for their datagrams
+		std::mt19937 m_tokenGenerator { std::random_device()() };
 		// The current working ID of a new connection
 		unsigned int m_currentID = 100;
 		// The maximum size of any messages to receive from clients
 		unsigned int m_maxMessageSize = 1024;
+		// The time clients' connections wait to gather messages into one write
+		std::chrono::microseconds m_flushDelay = std::chrono::microseconds(0);
 		// The port number this server was constructed with
 		unsigned short m_port = 0;
 
@@ -539,6 +1454,23 @@ namespace Milkweed {
 		* NetConnection when one is found
 		*/
 		void waitForConnection();
+		/*
+		* Get the ASIO context to give a new connection to, taking turns
+		* between the listening context and the extra contexts
+		*/
+		asio::io_context& getNextContext();
+		/*
+		* Stop accepting datagrams from a client which has disconnected
+		*
+		* @param ID: The ID number of the client
+		*/
+		void forgetDatagramClient(unsigned int ID);
+		/*
+		* Forget everything kept about a client which has disconnected
+		*
+		* @param ID: The ID number of the client
+		*/
+		void forgetClient(unsigned int ID);
 	};
 }
 
@@ -0,0 +1,919 @@
+/*
+* File: PNGDecoder.cpp
+* Author: Keegan MacDonald (keeganm742@gmail.com)
+* Created: 2026.10.16
+*/
+
+#include <cstring>
+#include <cstdlib>
+
+#if defined(__SSE2__) || defined(_M_X64) \
+	|| (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MW_PNG_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "PNGDecoder.h"
+
+namespace Milkweed {
+	// The eight bytes every PNG file starts with
+	const unsigned char PNG_SIGNATURE[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	// The base lengths and extra bits of deflate's length symbols
+	const std::uint16_t INFLATE_LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10,
+		11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131,
+		163, 195, 227, 258 };
+	const std::uint8_t INFLATE_LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1,
+		1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	// The base distances and extra bits of deflate's distance symbols
+	const std::uint16_t INFLATE_DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13,
+		17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537,
+		2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const std::uint8_t INFLATE_DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2,
+		3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13,
+		13 };
+	// The order the lengths of the code length code are stored in
+	const std::uint8_t INFLATE_CODE_LENGTH_ORDER[19] = { 16, 17, 18, 0, 8, 7,
+		9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+	// The first pixel and the step between pixels of each Adam7 pass
+	const unsigned int ADAM7_X[7] = { 0, 4, 0, 2, 0, 1, 0 };
+	const unsigned int ADAM7_Y[7] = { 0, 0, 4, 0, 2, 0, 1 };
+	const unsigned int ADAM7_DX[7] = { 8, 8, 4, 4, 2, 2, 1 };
+	const unsigned int ADAM7_DY[7] = { 8, 8, 8, 4, 4, 2, 2 };
+
+	/*
+	* Read a big endian 32 bit integer
+	*/
+	std::uint32_t readPNGInt(const unsigned char* data) {
+		return ((std::uint32_t)data[0] << 24) | ((std::uint32_t)data[1] << 16)
+			| ((std::uint32_t)data[2] << 8) | (std::uint32_t)data[3];
+	}
+
+	/*
+	* Reverse the order of the lowest bits of a Huffman code, since deflate
+	* stores codes most significant bit first
+	*/
+	unsigned int reverseBits(unsigned int code, unsigned int length) {
+		unsigned int reversed = 0;
+		for (unsigned int i = 0; i < length; i++) {
+			reversed = (reversed << 1) | (code & 1);
+			code >>= 1;
+		}
+		return reversed;
+	}
+
+	/*
+	* PNG's Paeth predictor, the neighbour closest to left + above - corner
+	*/
+	unsigned char paethPredictor(int left, int above, int corner) {
+		int pa = std::abs(above - corner);
+		int pb = std::abs(left - corner);
+		int pc = std::abs(left + above - corner - corner);
+		if (pa <= pb && pa <= pc) {
+			return (unsigned char)left;
+		}
+		return (unsigned char)(pb <= pc ? above : corner);
+	}
+
+#ifdef MW_PNG_SSE2
+	/*
+	* Load a pixel of 3 or 4 bytes into the low bytes of an SSE2 register
+	*/
+	__m128i loadPixel(const unsigned char* pixel, unsigned int bpp) {
+		int value = 0;
+		std::memcpy(&value, pixel, bpp);
+		return _mm_cvtsi32_si128(value);
+	}
+
+	/*
+	* Store the low 3 or 4 bytes of an SSE2 register as a pixel
+	*/
+	void storePixel(unsigned char* pixel, __m128i value, unsigned int bpp) {
+		int data = _mm_cvtsi128_si32(value);
+		std::memcpy(pixel, &data, bpp);
+	}
+#endif
+
+	/*
+	* Undo the Sub filter, which subtracts the pixel to the left
+	*/
+	void unfilterSub(unsigned char* row, size_t size, unsigned int bpp) {
+		size_t i = bpp;
+#ifdef MW_PNG_SSE2
+		if (bpp == 4) {
+			// Add up four pixels at a time with a prefix sum, then add the
+			// last pixel of the previous four
+			__m128i last = _mm_setzero_si128();
+			for (i = 0; i + 16 <= size; i += 16) {
+				__m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+				x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+				x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+				x = _mm_add_epi8(x, last);
+				_mm_storeu_si128((__m128i*)(row + i), x);
+				last = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+			}
+			i = (i > 0) ? i : bpp;
+		}
+		else if (bpp == 3) {
+			__m128i left = loadPixel(row, 3);
+			for (; i + 3 <= size; i += 3) {
+				left = _mm_add_epi8(loadPixel(row + i, 3), left);
+				storePixel(row + i, left, 3);
+			}
+		}
+#endif
+		for (; i < size; i++) {
+			row[i] += row[i - bpp];
+		}
+	}
+
+	/*
+	* Undo the Up filter, which subtracts the pixel above
+	*/
+	void unfilterUp(unsigned char* row, const unsigned char* prev,
+		size_t size) {
+		size_t i = 0;
+#ifdef MW_PNG_SSE2
+		for (; i + 16 <= size; i += 16) {
+			__m128i x = _mm_loadu_si128((const __m128i*)(row + i));
+			__m128i b = _mm_loadu_si128((const __m128i*)(prev + i));
+			_mm_storeu_si128((__m128i*)(row + i), _mm_add_epi8(x, b));
+		}
+#endif
+		for (; i < size; i++) {
+			row[i] += prev[i];
+		}
+	}
+
+	/*
+	* Undo the Average filter, which subtracts the mean of the pixels to the
+	* left and above
+	*/
+	void unfilterAverage(unsigned char* row, const unsigned char* prev,
+		size_t size, unsigned int bpp) {
+#ifdef MW_PNG_SSE2
+		if (bpp == 3 || bpp == 4) {
+			// _mm_avg_epu8 rounds up, so take off the lowest bit it added
+			const __m128i ones = _mm_set1_epi8(1);
+			__m128i left = _mm_setzero_si128();
+			for (size_t i = 0; i + bpp <= size; i += bpp) {
+				__m128i above = loadPixel(prev + i, bpp);
+				__m128i average = _mm_avg_epu8(left, above);
+				average = _mm_sub_epi8(average,
+					_mm_and_si128(_mm_xor_si128(left, above), ones));
+				left = _mm_add_epi8(loadPixel(row + i, bpp), average);
+				storePixel(row + i, left, bpp);
+			}
+			return;
+		}
+#endif
+		size_t i = 0;
+		for (; i < bpp && i < size; i++) {
+			row[i] += prev[i] >> 1;
+		}
+		for (; i < size; i++) {
+			row[i] += (unsigned char)(((unsigned int)row[i - bpp]
+				+ prev[i]) >> 1);
+		}
+	}
+
+	/*
+	* Undo the Paeth filter, which subtracts the Paeth predictor of the
+	* pixels to the left, above and above to the left
+	*/
+	void unfilterPaeth(unsigned char* row, const unsigned char* prev,
+		size_t size, unsigned int bpp) {
+#ifdef MW_PNG_SSE2
+		if (bpp == 3 || bpp == 4) {
+			// Find the predictor of every channel at once in 16 bit lanes
+			const __m128i zero = _mm_setzero_si128();
+			__m128i left = zero, corner = zero;
+			for (size_t i = 0; i + bpp <= size; i += bpp) {
+				__m128i above = _mm_unpacklo_epi8(loadPixel(prev + i, bpp),
+					zero);
+				__m128i x = _mm_unpacklo_epi8(loadPixel(row + i, bpp), zero);
+
+				__m128i pa = _mm_sub_epi16(above, corner);
+				__m128i pb = _mm_sub_epi16(left, corner);
+				__m128i pc = _mm_add_epi16(pa, pb);
+				pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+				pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+				pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+				__m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+				// Pick the left pixel where pa is smallest, otherwise above
+				// where pb is, otherwise the corner
+				__m128i useLeft = _mm_cmpeq_epi16(smallest, pa);
+				__m128i useAbove = _mm_cmpeq_epi16(smallest, pb);
+				__m128i nearest = _mm_or_si128(_mm_and_si128(useAbove, above),
+					_mm_andnot_si128(useAbove, corner));
+				nearest = _mm_or_si128(_mm_and_si128(useLeft, left),
+					_mm_andnot_si128(useLeft, nearest));
+
+				x = _mm_and_si128(_mm_add_epi16(x, nearest),
+					_mm_set1_epi16(0xFF));
+				storePixel(row + i, _mm_packus_epi16(x, zero), bpp);
+				left = x;
+				corner = above;
+			}
+			return;
+		}
+#endif
+		size_t i = 0;
+		for (; i < bpp && i < size; i++) {
+			row[i] += prev[i];
+		}
+		for (; i < size; i++) {
+			row[i] += paethPredictor(row[i - bpp], prev[i], prev[i - bpp]);
+		}
+	}
+
+	bool PNGDecoder::readHeader(const unsigned char* png, size_t size,
+		glm::ivec2& dimensions) {
+		if (size < 33 || std::memcmp(png, PNG_SIGNATURE, 8) != 0) {
+			return fail("Not a PNG file");
+		}
+		if (readPNGInt(png + 8) != 13 || std::memcmp(png + 12, "IHDR", 4)
+			!= 0) {
+			return fail("The first chunk is not a valid IHDR chunk");
+		}
+		std::uint32_t width = readPNGInt(png + 16);
+		std::uint32_t height = readPNGInt(png + 20);
+		if (width == 0 || height == 0 || width > (1u << 24)
+			|| height > (1u << 24)
+			|| (std::uint64_t)width * height > (1u << 28)) {
+			return fail("Invalid image dimensions");
+		}
+
+		dimensions = glm::ivec2((int)width, (int)height);
+		return true;
+	}
+
+	bool PNGDecoder::decode(const unsigned char* png, size_t size,
+		unsigned char* out, size_t outSize) {
+		m_error.clear();
+		if (!readChunks(png, size)) {
+			return false;
+		}
+		if (outSize < (size_t)m_width * m_height * 4) {
+			return fail("The output buffer is too small");
+		}
+
+		// Find the size of the filtered scanlines of the image or of each of
+		// its interlaced passes
+		unsigned int bitsPerPixel = getBitsPerPixel();
+		size_t filteredSize = 0;
+		std::uint32_t passWidths[7] = { 0 }, passHeights[7] = { 0 };
+		if (m_interlace == 0) {
+			filteredSize = (size_t)m_height
+				* (1 + ((size_t)m_width * bitsPerPixel + 7) / 8);
+		}
+		else {
+			for (unsigned int p = 0; p < 7; p++) {
+				if (m_width > ADAM7_X[p] && m_height > ADAM7_Y[p]) {
+					passWidths[p] = (m_width - ADAM7_X[p] + ADAM7_DX[p] - 1)
+						/ ADAM7_DX[p];
+					passHeights[p] = (m_height - ADAM7_Y[p] + ADAM7_DY[p] - 1)
+						/ ADAM7_DY[p];
+				}
+				filteredSize += (size_t)passHeights[p]
+					* (1 + ((size_t)passWidths[p] * bitsPerPixel + 7) / 8);
+			}
+		}
+
+		m_filtered.resize(filteredSize);
+		if (!inflate(m_compressed.data(), m_compressed.size(),
+			m_filtered.data(), filteredSize)) {
+			return false;
+		}
+
+		if (m_colorType == 0 && m_bitDepth <= 8) {
+			// Look up low bit depth greys in the palette, scaled to 8 bits
+			unsigned int count = 1u << m_bitDepth;
+			for (unsigned int v = 0; v < count; v++) {
+				unsigned char grey = (unsigned char)(v * 255 / (count - 1));
+				m_palette[v * 4 + 0] = m_palette[v * 4 + 1]
+					= m_palette[v * 4 + 2] = grey;
+				m_palette[v * 4 + 3] = (m_keyDefined && v == m_keyR) ? 0 : 255;
+			}
+			m_paletteSize = count;
+		}
+
+		if (m_interlace == 0) {
+			size_t rowBytes = ((size_t)m_width * bitsPerPixel + 7) / 8;
+			if (!unfilter(m_filtered.data(), rowBytes, m_height)) {
+				return false;
+			}
+			for (std::uint32_t y = 0; y < m_height; y++) {
+				if (!convertRow(&m_filtered[y * (rowBytes + 1) + 1], m_width,
+					out + (size_t)y * m_width * 4, 1)) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// Unfilter each interlaced pass and spread its pixels over the image
+		unsigned char* pass = m_filtered.data();
+		for (unsigned int p = 0; p < 7; p++) {
+			if (passWidths[p] == 0 || passHeights[p] == 0) {
+				continue;
+			}
+			size_t rowBytes = ((size_t)passWidths[p] * bitsPerPixel + 7) / 8;
+			if (!unfilter(pass, rowBytes, passHeights[p])) {
+				return false;
+			}
+			for (std::uint32_t y = 0; y < passHeights[p]; y++) {
+				size_t outY = (size_t)y * ADAM7_DY[p] + ADAM7_Y[p];
+				if (!convertRow(pass + y * (rowBytes + 1) + 1, passWidths[p],
+					out + (outY * m_width + ADAM7_X[p]) * 4, ADAM7_DX[p])) {
+					return false;
+				}
+			}
+			pass += (size_t)passHeights[p] * (rowBytes + 1);
+		}
+		return true;
+	}
+
+	bool PNGDecoder::decode(const unsigned char* png, size_t size,
+		std::vector<unsigned char>& out, glm::ivec2& dimensions) {
+		if (!readHeader(png, size, dimensions)) {
+			return false;
+		}
+		out.resize((size_t)dimensions.x * dimensions.y * 4);
+		return decode(png, size, out.data(), out.size());
+	}
+
+	bool PNGDecoder::readChunks(const unsigned char* png, size_t size) {
+		glm::ivec2 dimensions;
+		if (!readHeader(png, size, dimensions)) {
+			return false;
+		}
+
+		m_compressed.clear();
+		m_paletteSize = 0;
+		m_keyDefined = false;
+		bool ended = false;
+		size_t pos = 8;
+		while (!ended && size - pos >= 12) {
+			std::uint32_t length = readPNGInt(png + pos);
+			const unsigned char* type = png + pos + 4;
+			const unsigned char* data = png + pos + 8;
+			if (length > size - pos - 12) {
+				return fail("A chunk runs past the end of the file");
+			}
+
+			if (std::memcmp(type, "IHDR", 4) == 0) {
+				m_width = readPNGInt(data);
+				m_height = readPNGInt(data + 4);
+				m_bitDepth = data[8];
+				m_colorType = data[9];
+				m_interlace = data[12];
+				if (data[10] != 0 || data[11] != 0 || m_interlace > 1) {
+					return fail("Unknown compression, filter or interlace "
+						"method");
+				}
+				bool valid = false;
+				switch (m_colorType) {
+				case 0:
+					valid = m_bitDepth == 1 || m_bitDepth == 2
+						|| m_bitDepth == 4 || m_bitDepth == 8
+						|| m_bitDepth == 16;
+					break;
+				case 3:
+					valid = m_bitDepth == 1 || m_bitDepth == 2
+						|| m_bitDepth == 4 || m_bitDepth == 8;
+					break;
+				case 2:
+				case 4:
+				case 6:
+					valid = m_bitDepth == 8 || m_bitDepth == 16;
+					break;
+				}
+				if (!valid) {
+					return fail("Invalid color type and bit depth");
+				}
+			}
+			else if (std::memcmp(type, "PLTE", 4) == 0) {
+				m_paletteSize = length / 3;
+				if (length % 3 != 0 || m_paletteSize == 0
+					|| m_paletteSize > 256) {
+					return fail("Invalid palette size");
+				}
+				for (unsigned int i = 0; i < m_paletteSize; i++) {
+					std::memcpy(&m_palette[i * 4], data + i * 3, 3);
+					m_palette[i * 4 + 3] = 255;
+				}
+			}
+			else if (std::memcmp(type, "tRNS", 4) == 0) {
+				if (m_colorType == 3) {
+					if (length > m_paletteSize) {
+						return fail("More transparent colors than palette "
+							"entries");
+					}
+					for (unsigned int i = 0; i < length; i++) {
+						m_palette[i * 4 + 3] = data[i];
+					}
+				}
+				else if (m_colorType == 0 && length == 2) {
+					m_keyDefined = true;
+					m_keyR = m_keyG = m_keyB
+						= (std::uint16_t)((data[0] << 8) | data[1]);
+				}
+				else if (m_colorType == 2 && length == 6) {
+					m_keyDefined = true;
+					m_keyR = (std::uint16_t)((data[0] << 8) | data[1]);
+					m_keyG = (std::uint16_t)((data[2] << 8) | data[3]);
+					m_keyB = (std::uint16_t)((data[4] << 8) | data[5]);
+				}
+				else {
+					return fail("Invalid transparency chunk");
+				}
+			}
+			else if (std::memcmp(type, "IDAT", 4) == 0) {
+				m_compressed.insert(m_compressed.end(), data, data + length);
+			}
+			else if (std::memcmp(type, "IEND", 4) == 0) {
+				ended = true;
+			}
+			else if (!(type[0] & 32)) {
+				// Chunks with an upper case first letter must be understood
+				return fail("Unknown critical chunk "
+					+ std::string((const char*)type, 4));
+			}
+
+			pos += 12 + (size_t)length;
+		}
+
+		if (m_compressed.empty()) {
+			return fail("No image data");
+		}
+		if (m_colorType == 3 && m_paletteSize == 0) {
+			return fail("Missing palette");
+		}
+		return true;
+	}
+
+	bool PNGDecoder::fail(const std::string& error) {
+		m_error = error;
+		return false;
+	}
+
+	unsigned int PNGDecoder::getBitsPerPixel() const {
+		switch (m_colorType) {
+		case 2:
+			return 3 * m_bitDepth;
+		case 4:
+			return 2 * m_bitDepth;
+		case 6:
+			return 4 * m_bitDepth;
+		default:
+			return m_bitDepth;
+		}
+	}
+
+	bool PNGDecoder::inflate(const unsigned char* in, size_t size,
+		unsigned char* out, size_t outSize) {
+		// Check the zlib header, deflate with no preset dictionary
+		if (size < 2 || (in[0] & 15) != 8 || (in[0] >> 4) > 7
+			|| ((in[0] << 8) | in[1]) % 31 != 0 || (in[1] & 32)) {
+			return fail("Invalid zlib header");
+		}
+		m_in = in + 2;
+		m_inEnd = in + size;
+		m_bits = 0;
+		m_bitCount = 0;
+
+		size_t pos = 0;
+		std::uint32_t final = 0;
+		do {
+			std::uint32_t header = 0;
+			if (!readBits(3, header)) {
+				return fail("The image data ends early");
+			}
+			final = header & 1;
+			std::uint32_t type = header >> 1;
+			if (type == 0) {
+				if (!copyStoredBlock(out, outSize, pos)) {
+					return false;
+				}
+				continue;
+			}
+			if (type == 1) {
+				// The fixed Huffman codes
+				std::uint8_t lengths[288 + 32];
+				std::memset(lengths, 8, 144);
+				std::memset(lengths + 144, 9, 112);
+				std::memset(lengths + 256, 7, 24);
+				std::memset(lengths + 280, 8, 8);
+				std::memset(lengths + 288, 5, 32);
+				if (!buildHuffman(m_lengths, lengths, 288)
+					|| !buildHuffman(m_distances, lengths + 288, 32)) {
+					return false;
+				}
+			}
+			else if (type == 2) {
+				if (!readDynamicTables()) {
+					return false;
+				}
+			}
+			else {
+				return fail("Invalid compressed block type");
+			}
+			if (!inflateBlock(out, outSize, pos)) {
+				return false;
+			}
+		} while (!final);
+
+		if (pos != outSize) {
+			return fail("The image data is the wrong size");
+		}
+		return true;
+	}
+
+	void PNGDecoder::refill() {
+		while (m_bitCount <= 56 && m_in < m_inEnd) {
+			m_bits |= (std::uint64_t)(*m_in++) << m_bitCount;
+			m_bitCount += 8;
+		}
+	}
+
+	bool PNGDecoder::readBits(unsigned int count, std::uint32_t& value) {
+		if (m_bitCount < count) {
+			refill();
+			if (m_bitCount < count) {
+				return false;
+			}
+		}
+		value = (std::uint32_t)(m_bits & ((1ull << count) - 1));
+		m_bits >>= count;
+		m_bitCount -= count;
+		return true;
+	}
+
+	bool PNGDecoder::buildHuffman(Huffman& huffman,
+		const std::uint8_t* lengths, unsigned int count) {
+		std::memset(huffman.fast, 0, sizeof(huffman.fast));
+		unsigned int sizes[17] = { 0 };
+		for (unsigned int i = 0; i < count; i++) {
+			sizes[lengths[i]]++;
+		}
+		sizes[0] = 0;
+
+		// Find the first code and symbol of each code length
+		std::uint32_t code = 0, symbol = 0;
+		std::uint32_t nextCode[16] = { 0 };
+		for (unsigned int i = 1; i < 16; i++) {
+			nextCode[i] = code;
+			huffman.firstCode[i] = (std::uint16_t)code;
+			huffman.firstSymbol[i] = (std::uint16_t)symbol;
+			code += sizes[i];
+			if (sizes[i] > 0 && code - 1 >= (1u << i)) {
+				return fail("Invalid Huffman code lengths");
+			}
+			huffman.maxCode[i] = code << (16 - i);
+			code <<= 1;
+			symbol += sizes[i];
+		}
+		huffman.maxCode[16] = 0x10000;
+
+		// Put each symbol in canonical order, and short codes in the fast
+		// table under every index starting with their reversed bits
+		for (unsigned int i = 0; i < count; i++) {
+			unsigned int length = lengths[i];
+			if (length == 0) {
+				continue;
+			}
+			unsigned int c = nextCode[length] - huffman.firstCode[length]
+				+ huffman.firstSymbol[length];
+			huffman.sizes[c] = (std::uint8_t)length;
+			huffman.symbols[c] = (std::uint16_t)i;
+			if (length <= Huffman::FAST_BITS) {
+				std::uint16_t entry = (std::uint16_t)((length << 9) | i);
+				for (unsigned int j = reverseBits(nextCode[length], length);
+					j < (1u << Huffman::FAST_BITS); j += 1u << length) {
+					huffman.fast[j] = entry;
+				}
+			}
+			nextCode[length]++;
+		}
+		return true;
+	}
+
+	int PNGDecoder::decodeSymbol(const Huffman& huffman) {
+		if (m_bitCount < 16) {
+			refill();
+		}
+		std::uint16_t entry = huffman.fast[m_bits
+			& ((1u << Huffman::FAST_BITS) - 1)];
+		if (entry != 0) {
+			unsigned int length = entry >> 9;
+			if (length > m_bitCount) {
+				return -1;
+			}
+			m_bits >>= length;
+			m_bitCount -= length;
+			return entry & 511;
+		}
+
+		// The code is longer than the fast table, find its length by
+		// comparing it to the last code of each length
+		unsigned int code = reverseBits((unsigned int)(m_bits & 0xFFFF), 16);
+		unsigned int length = Huffman::FAST_BITS + 1;
+		while (code >= huffman.maxCode[length]) {
+			length++;
+		}
+		if (length >= 16 || length > m_bitCount) {
+			return -1;
+		}
+		unsigned int c = (code >> (16 - length)) - huffman.firstCode[length]
+			+ huffman.firstSymbol[length];
+		if (c >= 288 || huffman.sizes[c] != length) {
+			return -1;
+		}
+		m_bits >>= length;
+		m_bitCount -= length;
+		return huffman.symbols[c];
+	}
+
+	bool PNGDecoder::readDynamicTables() {
+		std::uint32_t literalCount = 0, distanceCount = 0, codeLengthCount = 0;
+		if (!readBits(5, literalCount) || !readBits(5, distanceCount)
+			|| !readBits(4, codeLengthCount)) {
+			return fail("The image data ends early");
+		}
+		literalCount += 257;
+		distanceCount += 1;
+		codeLengthCount += 4;
+		if (literalCount > 286 || distanceCount > 30) {
+			return fail("Invalid Huffman table sizes");
+		}
+
+		// Read the code which the other code lengths are compressed with
+		std::uint8_t codeLengths[19] = { 0 };
+		for (unsigned int i = 0; i < codeLengthCount; i++) {
+			std::uint32_t length = 0;
+			if (!readBits(3, length)) {
+				return fail("The image data ends early");
+			}
+			codeLengths[INFLATE_CODE_LENGTH_ORDER[i]] = (std::uint8_t)length;
+		}
+		Huffman codeLengthHuffman;
+		if (!buildHuffman(codeLengthHuffman, codeLengths, 19)) {
+			return false;
+		}
+
+		// Read the literal/length and distance code lengths, with runs
+		std::uint8_t lengths[286 + 30];
+		unsigned int total = literalCount + distanceCount, n = 0;
+		while (n < total) {
+			int symbol = decodeSymbol(codeLengthHuffman);
+			if (symbol < 0) {
+				return fail("Invalid Huffman table");
+			}
+			if (symbol < 16) {
+				lengths[n++] = (std::uint8_t)symbol;
+				continue;
+			}
+			std::uint32_t repeat = 0;
+			std::uint8_t fill = 0;
+			bool read = false;
+			if (symbol == 16) {
+				// Repeat the previous length
+				if (n == 0) {
+					return fail("Invalid Huffman table");
+				}
+				fill = lengths[n - 1];
+				read = readBits(2, repeat);
+				repeat += 3;
+			}
+			else if (symbol == 17) {
+				read = readBits(3, repeat);
+				repeat += 3;
+			}
+			else {
+				read = readBits(7, repeat);
+				repeat += 11;
+			}
+			if (!read || repeat > total - n) {
+				return fail("Invalid Huffman table");
+			}
+			std::memset(lengths + n, fill, repeat);
+			n += repeat;
+		}
+		if (lengths[256] == 0) {
+			return fail("Missing end of block code");
+		}
+
+		return buildHuffman(m_lengths, lengths, literalCount)
+			&& buildHuffman(m_distances, lengths + literalCount,
+				distanceCount);
+	}
+
+	bool PNGDecoder::inflateBlock(unsigned char* out, size_t outSize,
+		size_t& pos) {
+		while (true) {
+			int symbol = decodeSymbol(m_lengths);
+			if (symbol < 256) {
+				if (symbol < 0) {
+					return fail("Corrupt image data");
+				}
+				if (pos >= outSize) {
+					return fail("The image data is the wrong size");
+				}
+				out[pos++] = (unsigned char)symbol;
+				continue;
+			}
+			if (symbol == 256) {
+				return true;
+			}
+
+			// Copy a run of earlier output
+			symbol -= 257;
+			if (symbol >= 29) {
+				return fail("Corrupt image data");
+			}
+			std::uint32_t extra = 0;
+			if (!readBits(INFLATE_LENGTH_EXTRA[symbol], extra)) {
+				return fail("The image data ends early");
+			}
+			size_t length = INFLATE_LENGTH_BASE[symbol] + extra;
+			int distanceSymbol = decodeSymbol(m_distances);
+			if (distanceSymbol < 0 || distanceSymbol >= 30) {
+				return fail("Corrupt image data");
+			}
+			if (!readBits(INFLATE_DISTANCE_EXTRA[distanceSymbol], extra)) {
+				return fail("The image data ends early");
+			}
+			size_t distance = INFLATE_DISTANCE_BASE[distanceSymbol] + extra;
+			if (distance > pos || length > outSize - pos) {
+				return fail("Corrupt image data");
+			}
+
+			unsigned char* dest = out + pos;
+			const unsigned char* source = dest - distance;
+			if (distance == 1) {
+				std::memset(dest, *source, length);
+			}
+			else if (distance >= length) {
+				std::memcpy(dest, source, length);
+			}
+			else {
+				// The run overlaps itself
+				for (size_t i = 0; i < length; i++) {
+					dest[i] = source[i];
+				}
+			}
+			pos += length;
+		}
+	}
+
+	bool PNGDecoder::copyStoredBlock(unsigned char* out, size_t outSize,
+		size_t& pos) {
+		// Stored blocks start on a byte boundary
+		unsigned int skip = m_bitCount % 8;
+		m_bits >>= skip;
+		m_bitCount -= skip;
+		std::uint32_t length = 0, inverse = 0;
+		if (!readBits(16, length) || !readBits(16, inverse)) {
+			return fail("The image data ends early");
+		}
+		if ((length ^ 0xFFFF) != inverse) {
+			return fail("Corrupt image data");
+		}
+		if (length > outSize - pos) {
+			return fail("The image data is the wrong size");
+		}
+
+		// Take the bytes already in the bit buffer, then copy the rest
+		while (length > 0 && m_bitCount >= 8) {
+			out[pos++] = (unsigned char)(m_bits & 0xFF);
+			m_bits >>= 8;
+			m_bitCount -= 8;
+			length--;
+		}
+		if ((size_t)(m_inEnd - m_in) < length) {
+			return fail("The image data ends early");
+		}
+		std::memcpy(out + pos, m_in, length);
+		m_in += length;
+		pos += length;
+		return true;
+	}
+
+	bool PNGDecoder::unfilter(unsigned char* rows, size_t rowBytes,
+		std::uint32_t height) {
+		unsigned int bpp = getBitsPerPixel() / 8;
+		if (bpp == 0) {
+			bpp = 1;
+		}
+		if (m_zeroRow.size() < rowBytes) {
+			m_zeroRow.assign(rowBytes, 0);
+		}
+
+		const unsigned char* prev = m_zeroRow.data();
+		for (std::uint32_t y = 0; y < height; y++) {
+			unsigned char* row = rows + 1;
+			switch (rows[0]) {
+			case 0:
+				break;
+			case 1:
+				unfilterSub(row, rowBytes, bpp);
+				break;
+			case 2:
+				unfilterUp(row, prev, rowBytes);
+				break;
+			case 3:
+				unfilterAverage(row, prev, rowBytes, bpp);
+				break;
+			case 4:
+				unfilterPaeth(row, prev, rowBytes, bpp);
+				break;
+			default:
+				return fail("Invalid filter type");
+			}
+			prev = row;
+			rows += rowBytes + 1;
+		}
+		return true;
+	}
+
+	bool PNGDecoder::convertRow(const unsigned char* row, std::uint32_t width,
+		unsigned char* out, unsigned int step) {
+		size_t stride = (size_t)step * 4;
+		if (m_colorType == 6 && m_bitDepth == 8) {
+			if (step == 1) {
+				std::memcpy(out, row, (size_t)width * 4);
+				return true;
+			}
+			for (std::uint32_t x = 0; x < width; x++) {
+				std::memcpy(out + x * stride, row + x * 4, 4);
+			}
+			return true;
+		}
+
+		if (m_colorType == 3 || (m_colorType == 0 && m_bitDepth <= 8)) {
+			// Look each pixel up in the palette
+			unsigned int depth = m_bitDepth;
+			unsigned int mask = (1u << depth) - 1;
+			for (std::uint32_t x = 0; x < width; x++) {
+				size_t bit = (size_t)x * depth;
+				unsigned int index = (row[bit / 8] >> (8 - depth - bit % 8))
+					& mask;
+				if (index >= m_paletteSize) {
+					return fail("A palette index is out of range");
+				}
+				std::memcpy(out + x * stride, &m_palette[index * 4], 4);
+			}
+			return true;
+		}
+
+		// Take the high byte of 16 bit channels
+		unsigned int channelBytes = m_bitDepth / 8;
+		for (std::uint32_t x = 0; x < width; x++) {
+			unsigned char* pixel = out + x * stride;
+			switch (m_colorType) {
+			case 0: {
+				const unsigned char* in = row + (size_t)x * 2;
+				pixel[0] = pixel[1] = pixel[2] = in[0];
+				pixel[3] = (m_keyDefined && ((in[0] << 8) | in[1]) == m_keyR)
+					? 0 : 255;
+				break;
+			}
+			case 2: {
+				const unsigned char* in = row + (size_t)x * 3 * channelBytes;
+				pixel[0] = in[0];
+				pixel[1] = in[channelBytes];
+				pixel[2] = in[channelBytes * 2];
+				pixel[3] = 255;
+				if (m_keyDefined) {
+					bool key = channelBytes == 1
+						? (in[0] == m_keyR && in[1] == m_keyG
+							&& in[2] == m_keyB)
+						: (((in[0] << 8) | in[1]) == m_keyR
+							&& ((in[2] << 8) | in[3]) == m_keyG
+							&& ((in[4] << 8) | in[5]) == m_keyB);
+					if (key) {
+						pixel[3] = 0;
+					}
+				}
+				break;
+			}
+			case 4: {
+				const unsigned char* in = row + (size_t)x * 2 * channelBytes;
+				pixel[0] = pixel[1] = pixel[2] = in[0];
+				pixel[3] = in[channelBytes];
+				break;
+			}
+			case 6: {
+				const unsigned char* in = row + (size_t)x * 8;
+				pixel[0] = in[0];
+				pixel[1] = in[2];
+				pixel[2] = in[4];
+				pixel[3] = in[6];
+				break;
+			}
+			}
+		}
+		return true;
+	}
+}
\ No newline at end of file
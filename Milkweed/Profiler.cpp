@@ -0,0 +1,374 @@
+/*
+* File: Profiler.cpp
+* Author: Keegan MacDonald (keeganm742@gmail.com)
+* Created: 2026.10.16
+*/
+
+#include <cstdio>
+#include <iomanip>
+
+#include "MW.h"
+
+namespace Milkweed {
+	/*
+	* Format a time in seconds as milliseconds with two decimal places
+	*/
+	std::string formatMilliseconds(double seconds) {
+		char buffer[32];
+		std::snprintf(buffer, sizeof(buffer), "%.2f ms", seconds * 1000.0);
+		return buffer;
+	}
+
+	/*
+	* Write a string to a JSON file as a quoted, escaped string
+	*/
+	void writeJSONString(std::ofstream& file, const char* string) {
+		file << '"';
+		for (const char* c = string; *c != '\0'; c++) {
+			if (*c == '"' || *c == '\\') {
+				file << '\\';
+			}
+			file << *c;
+		}
+		file << '"';
+	}
+
+	Profiler Profiler::m_instance;
+
+	void Profiler::setEnabled(bool enabled) {
+		if (enabled == m_enabled) {
+			return;
+		}
+
+		if (enabled) {
+			// Start a fresh history with times relative to now
+			m_frames.assign(FRAME_HISTORY, ProfileFrame());
+			m_frame = 0;
+			m_frameCount = 0;
+			m_frameNumber = 0;
+			m_inFrame = false;
+			m_scopeStack.clear();
+			m_startTime = glfwGetTime();
+			m_overlayAge = OVERLAY_INTERVAL;
+
+			// Create the timer queries if OpenGL supports them
+			if (GLEW_VERSION_3_3 || GLEW_ARB_timer_query) {
+				glGenQueries(GPU_QUERIES, m_queries);
+			}
+			else {
+				MWLOG(Warning, Profiler, "Timer queries unavailable, GPU ",
+					"times will not be recorded");
+			}
+			m_query = 0;
+			m_queryActive = false;
+			for (unsigned int i = 0; i < GPU_QUERIES; i++) {
+				m_queryFrames[i] = 0;
+			}
+			m_enabled = true;
+			MWLOG(Info, Profiler, "Started profiling");
+			return;
+		}
+
+		// Stop any running query and free them, keeping the history so it can
+		// still be exported
+		if (m_queryActive) {
+			glEndQuery(GL_TIME_ELAPSED);
+			m_queryActive = false;
+		}
+		if (m_queries[0] != 0) {
+			glDeleteQueries(GPU_QUERIES, m_queries);
+		}
+		for (unsigned int i = 0; i < GPU_QUERIES; i++) {
+			m_queries[i] = 0;
+			m_queryFrames[i] = 0;
+		}
+		m_inFrame = false;
+		m_scopeStack.clear();
+		m_enabled = false;
+		MWLOG(Info, Profiler, "Stopped profiling");
+	}
+
+	void Profiler::beginFrame() {
+		if (!m_enabled) {
+			return;
+		}
+
+		// Collect the GPU times of earlier frames which have come in
+		for (unsigned int i = 0; i < GPU_QUERIES; i++) {
+			readGPUTimer(i, false);
+		}
+
+		// Reuse the oldest frame in the ring, keeping its memory
+		ProfileFrame& frame = m_frames[m_frame];
+		frame.number = ++m_frameNumber;
+		frame.start = glfwGetTime() - m_startTime;
+		frame.duration = 0.0;
+		frame.gpuDuration = -1.0;
+		frame.gpuStart = 0.0;
+		frame.samples.clear();
+		for (unsigned int& counter : frame.counters) {
+			counter = 0;
+		}
+		m_scopeStack.clear();
+		m_inFrame = true;
+	}
+
+	void Profiler::endFrame() {
+		if (!m_enabled || !m_inFrame) {
+			return;
+		}
+
+		// Close any scopes left open and finish the frame
+		while (!m_scopeStack.empty()) {
+			endScope();
+		}
+		ProfileFrame& frame = m_frames[m_frame];
+		frame.duration = glfwGetTime() - m_startTime - frame.start;
+
+		// Move on to the next frame in the ring
+		m_frame = (m_frame + 1) % FRAME_HISTORY;
+		if (m_frameCount < FRAME_HISTORY) {
+			m_frameCount++;
+		}
+		m_overlayAge++;
+		m_inFrame = false;
+	}
+
+	void Profiler::beginScope(const char* name) {
+		if (!m_enabled || !m_inFrame) {
+			return;
+		}
+
+		ProfileSample sample;
+		sample.name = name;
+		sample.depth = (unsigned int)m_scopeStack.size();
+		sample.start = glfwGetTime() - m_startTime;
+		std::vector<ProfileSample>& samples = m_frames[m_frame].samples;
+		m_scopeStack.push_back((unsigned int)samples.size());
+		samples.push_back(sample);
+	}
+
+	void Profiler::endScope() {
+		if (!m_enabled || m_scopeStack.empty()) {
+			return;
+		}
+
+		ProfileSample& sample = m_frames[m_frame].samples[m_scopeStack.back()];
+		sample.duration = glfwGetTime() - m_startTime - sample.start;
+		m_scopeStack.pop_back();
+	}
+
+	void Profiler::beginGPUTimer() {
+		if (!m_enabled || !m_inFrame || m_queryActive
+			|| m_queries[m_query] == 0) {
+			return;
+		}
+
+		// The query is reused from a few frames ago, make sure its result has
+		// been read first
+		readGPUTimer(m_query, true);
+		m_frames[m_frame].gpuStart = glfwGetTime() - m_startTime;
+		glBeginQuery(GL_TIME_ELAPSED, m_queries[m_query]);
+		m_queryFrames[m_query] = m_frames[m_frame].number;
+		m_queryActive = true;
+	}
+
+	void Profiler::endGPUTimer() {
+		if (!m_queryActive) {
+			return;
+		}
+
+		glEndQuery(GL_TIME_ELAPSED);
+		m_query = (m_query + 1) % GPU_QUERIES;
+		m_queryActive = false;
+	}
+
+	const ProfileFrame* Profiler::getFrame(unsigned int age) const {
+		if (age >= m_frameCount) {
+			return nullptr;
+		}
+		return &m_frames[(m_frame + FRAME_HISTORY - 1 - age) % FRAME_HISTORY];
+	}
+
+	void Profiler::setOverlay(Font* font, Shader* textShader,
+		const std::string& textColorUniform, const glm::vec3& textColor,
+		float textScale) {
+		m_overlayFont = font;
+		m_overlayShader = textShader;
+		m_overlayColorUniform = textColorUniform;
+		m_overlayColor = textColor;
+		m_overlayScale = textScale;
+		m_overlayAge = OVERLAY_INTERVAL;
+		for (TextLayout& line : m_overlayLines) {
+			line.markDirty();
+		}
+	}
+
+	void Profiler::drawOverlay() {
+		if (!m_enabled || m_overlayFont == nullptr
+			|| m_overlayShader == nullptr) {
+			return;
+		}
+
+		// Only rebuild the text every few frames so it is readable and its
+		// layout can be reused in between
+		if (m_overlayAge >= OVERLAY_INTERVAL) {
+			updateOverlayText();
+			m_overlayAge = 0;
+		}
+
+		// Stack the lines down from the top left of the window above
+		// everything else
+		glm::vec2 dims = MW::WINDOW.getDimensions();
+		float lineHeight = (m_overlayFont->maxCharacterHeight
+			- m_overlayFont->minCharacterHeight) * m_overlayScale;
+		m_overlayLines.resize(m_overlayText.size());
+		m_overlayShader->upload3fVector(m_overlayColorUniform, m_overlayColor);
+		for (unsigned int i = 0; i < m_overlayText.size(); i++) {
+			m_overlayLines[i].update(m_overlayText[i], glm::vec3(0.0f,
+				dims.y - lineHeight * (i + 1), 100.0f),
+				glm::vec4(0.0f, 0.0f, dims.x, dims.y), m_overlayScale,
+				m_overlayFont, Justification::LEFT, Justification::BOTTOM);
+			MW::RENDERER.submit(&m_overlayLines[i], m_overlayShader);
+		}
+	}
+
+	bool Profiler::exportChromeTrace(const std::string& fileName) const {
+		std::ofstream file(fileName);
+		if (file.fail()) {
+			MWLOG(Warning, Profiler, "Failed to open trace file ", fileName);
+			return false;
+		}
+
+		// Times are written in microseconds
+		file << std::fixed << std::setprecision(3);
+		file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+			<< "\"args\":{\"name\":\"CPU\"}},\n";
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,"
+			<< "\"args\":{\"name\":\"GPU\"}}";
+
+		// Write the frames from oldest to newest
+		for (unsigned int age = m_frameCount; age > 0; age--) {
+			const ProfileFrame* frame = getFrame(age - 1);
+			file << ",\n{\"name\":\"Frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+				<< "\"ts\":" << frame->start * 1000000.0 << ",\"dur\":"
+				<< frame->duration * 1000000.0 << ",\"args\":{\"number\":"
+				<< frame->number << "}}";
+			for (const ProfileSample& sample : frame->samples) {
+				file << ",\n{\"name\":";
+				writeJSONString(file, sample.name);
+				file << ",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+					<< sample.start * 1000000.0 << ",\"dur\":"
+					<< sample.duration * 1000000.0 << "}";
+			}
+			// The GPU time is shown from when its work was submitted
+			if (frame->gpuDuration >= 0.0) {
+				file << ",\n{\"name\":\"Render\",\"ph\":\"X\",\"pid\":1,"
+					<< "\"tid\":2,\"ts\":" << frame->gpuStart * 1000000.0
+					<< ",\"dur\":" << frame->gpuDuration * 1000000.0 << "}";
+			}
+			file << ",\n{\"name\":\"Counters\",\"ph\":\"C\",\"pid\":1,"
+				<< "\"ts\":" << frame->start * 1000000.0 << ",\"args\":{"
+				<< "\"drawCalls\":"
+				<< frame->counters[(int)ProfileCounter::DRAW_CALLS]
+				<< ",\"batches\":"
+				<< frame->counters[(int)ProfileCounter::BATCHES]
+				<< ",\"sprites\":"
+				<< frame->counters[(int)ProfileCounter::SPRITES]
+				<< ",\"textureBinds\":"
+				<< frame->counters[(int)ProfileCounter::TEXTURE_BINDS] << "}}";
+		}
+		file << "\n]}\n";
+		file.close();
+
+		MWLOG(Info, Profiler, "Exported ", m_frameCount, " frames to ",
+			fileName);
+		return true;
+	}
+
+	void Profiler::destroy() {
+		setEnabled(false);
+		m_frames.clear();
+		m_frameCount = 0;
+		m_overlayFont = nullptr;
+		m_overlayShader = nullptr;
+		for (TextLayout& line : m_overlayLines) {
+			line.destroy();
+		}
+		m_overlayLines.clear();
+		m_overlayText.clear();
+	}
+
+	void Profiler::readGPUTimer(unsigned int query, bool wait) {
+		if (m_queryFrames[query] == 0) {
+			return;
+		}
+
+		// Leave the query for a later frame if the GPU has not finished it
+		if (!wait) {
+			GLint available = GL_FALSE;
+			glGetQueryObjectiv(m_queries[query], GL_QUERY_RESULT_AVAILABLE,
+				&available);
+			if (available == GL_FALSE) {
+				return;
+			}
+		}
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(m_queries[query], GL_QUERY_RESULT, &nanoseconds);
+
+		// Store the result if its frame is still in the history
+		unsigned long long number = m_queryFrames[query];
+		ProfileFrame& frame = m_frames[(number - 1) % FRAME_HISTORY];
+		if (frame.number == number) {
+			frame.gpuDuration = (double)nanoseconds / 1000000000.0;
+		}
+		m_queryFrames[query] = 0;
+	}
+
+	void Profiler::updateOverlayText() {
+		m_overlayText.clear();
+		const ProfileFrame* last = getFrame(0);
+		if (last == nullptr) {
+			m_overlayText.push_back("Profiling...");
+			return;
+		}
+
+		// Average the CPU and GPU times over the frames since the last update
+		double cpu = 0.0, gpu = 0.0;
+		unsigned int cpuFrames = 0, gpuFrames = 0;
+		for (unsigned int age = 0; age < OVERLAY_INTERVAL; age++) {
+			const ProfileFrame* frame = getFrame(age);
+			if (frame == nullptr) {
+				break;
+			}
+			cpu += frame->duration;
+			cpuFrames++;
+			if (frame->gpuDuration >= 0.0) {
+				gpu += frame->gpuDuration;
+				gpuFrames++;
+			}
+		}
+		cpu /= cpuFrames;
+		std::string line = "Frame: " + formatMilliseconds(cpu) + " ("
+			+ std::to_string((int)(cpu > 0.0 ? 1.0 / cpu : 0.0)) + " FPS)";
+		if (gpuFrames > 0) {
+			line += "  GPU: " + formatMilliseconds(gpu / gpuFrames);
+		}
+		m_overlayText.push_back(line);
+
+		// Show the last frame's counters and scope timings
+		m_overlayText.push_back("Draws: "
+			+ std::to_string(last->counters[(int)ProfileCounter::DRAW_CALLS])
+			+ "  Batches: "
+			+ std::to_string(last->counters[(int)ProfileCounter::BATCHES])
+			+ "  Sprites: "
+			+ std::to_string(last->counters[(int)ProfileCounter::SPRITES])
+			+ "  Binds: " + std::to_string(
+				last->counters[(int)ProfileCounter::TEXTURE_BINDS]));
+		for (const ProfileSample& sample : last->samples) {
+			m_overlayText.push_back(std::string(sample.depth * 2, ' ')
+				+ sample.name + ": " + formatMilliseconds(sample.duration));
+		}
+	}
+}
\ No newline at end of file
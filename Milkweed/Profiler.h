@@ -0,0 +1,273 @@
+/*
+* File: Profiler.h
+* Author: Keegan MacDonald (keeganm742@gmail.com)
+* Created: 2026.10.16
+*/
+
+#ifndef MW_PROFILER_H
+#define MW_PROFILER_H
+
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+#include "Renderer.h"
+
+namespace Milkweed {
+	/*
+	* The events counted by the profiler each frame
+	*/
+	enum class ProfileCounter {
+		DRAW_CALLS, BATCHES, SPRITES, TEXTURE_BINDS, COUNT
+	};
+
+	/*
+	* A timed scope of code recorded by the profiler in a frame
+	*/
+	struct ProfileSample {
+		// The name of this scope, a string which outlives the profiler
+		const char* name = "";
+		// The number of scopes this one is nested inside
+		unsigned int depth = 0;
+		// The time this scope started in seconds since the profiler started
+		double start = 0.0;
+		// The time spent in this scope in seconds
+		double duration = 0.0;
+	};
+
+	/*
+	* The timings and counters recorded by the profiler for a single frame
+	*/
+	struct ProfileFrame {
+		// The number of this frame since the profiler was enabled
+		unsigned long long number = 0;
+		// The time this frame started in seconds since the profiler started
+		double start = 0.0;
+		// The CPU time taken by this frame in seconds
+		double duration = 0.0;
+		// The time the GPU spent on this frame's rendering in seconds, less
+		// than 0 if it is not known yet
+		double gpuDuration = -1.0;
+		// The time the GPU timer was started in seconds since the profiler
+		// started
+		double gpuStart = 0.0;
+		// The scopes timed in this frame in the order they started
+		std::vector<ProfileSample> samples;
+		// The events counted in this frame
+		unsigned int counters[(int)ProfileCounter::COUNT] = {};
+	};
+
+	/*
+	* The Milkweed framework's utility for measuring the time spent in each
+	* part of a frame on the CPU and the GPU
+	*/
+	class Profiler {
+	public:
+		/*
+		* The copy constructor is disabled for this class
+		*/
+		Profiler(Profiler& p) = delete;
+		/*
+		* Get the singleton instance of this class
+		*/
+		static Profiler& getInstance() {
+			return m_instance;
+		}
+
+		/*
+		* Start recording frames, or stop and free the profiler's queries
+		*
+		* @param enabled: Whether to record frames
+		*/
+		void setEnabled(bool enabled);
+		/*
+		* Test whether frames are being recorded
+		*/
+		bool isEnabled() const { return m_enabled; }
+		/*
+		* Start recording a new frame
+		*/
+		void beginFrame();
+		/*
+		* Finish recording the current frame
+		*/
+		void endFrame();
+		/*
+		* Start timing a scope of code nested in any scopes already started
+		*
+		* @param name: The name of the scope, a string literal or other string
+		* which outlives the profiler
+		*/
+		void beginScope(const char* name);
+		/*
+		* Stop timing the most recently started scope
+		*/
+		void endScope();
+		/*
+		* Start timing the GPU's work for this frame with an OpenGL timer
+		* query, only one may be running at a time
+		*/
+		void beginGPUTimer();
+		/*
+		* Stop timing the GPU's work for this frame, its result is read a few
+		* frames later to avoid waiting on the GPU
+		*/
+		void endGPUTimer();
+		/*
+		* Add to one of the counters of the current frame
+		*
+		* @param counter: The counter to add to
+		* @param count: The amount to add, 1 by default
+		*/
+		void count(ProfileCounter counter, unsigned int count = 1) {
+			if (m_enabled) {
+				m_frames[m_frame].counters[(int)counter] += count;
+			}
+		}
+		/*
+		* Get the number of frames recorded in the history, at most
+		* FRAME_HISTORY
+		*/
+		unsigned int getFrameCount() const { return m_frameCount; }
+		/*
+		* Get a recorded frame from the history
+		*
+		* @param age: The number of frames before the last finished frame to
+		* get, 0 for the last finished frame
+		* @return The recorded frame, nullptr if it is not in the history
+		*/
+		const ProfileFrame* getFrame(unsigned int age) const;
+		/*
+		* Draw a summary of recent frames on the screen with the text renderer
+		* each frame while the profiler is enabled
+		*
+		* @param font: The font to draw the summary in, nullptr to hide it
+		* @param textShader: The text shader to draw the summary with
+		* @param textColorUniform: The name of the text shader's color uniform
+		* @param textColor: The color to draw the summary in
+		* @param textScale: The scale to draw the summary's text at
+		*/
+		void setOverlay(Font* font, Shader* textShader,
+			const std::string& textColorUniform, const glm::vec3& textColor,
+			float textScale);
+		/*
+		* Submit the overlay's text to the renderer for this frame if there is
+		* one
+		*/
+		void drawOverlay();
+		/*
+		* Write the frames in the history to a file in the Chrome trace event
+		* format, to be opened in chrome://tracing or Perfetto
+		*
+		* @param fileName: The path to the file to write
+		* @return Whether the file could be written
+		*/
+		bool exportChromeTrace(const std::string& fileName) const;
+		/*
+		* Free this profiler's memory and stop using it
+		*/
+		void destroy();
+
+		// The number of recent frames kept in the history
+		const static unsigned int FRAME_HISTORY = 240;
+
+	private:
+		// Singleton instance of this class
+		static Profiler m_instance;
+		/*
+		* The constructor is disabled for this class
+		*/
+		Profiler() {}
+
+		// The number of timer queries cycled through, so a query's result is
+		// read this many frames after it was issued
+		const static unsigned int GPU_QUERIES = 4;
+		// The number of frames between updates of the overlay's text
+		const static unsigned int OVERLAY_INTERVAL = 30;
+
+		// Whether frames are being recorded
+		bool m_enabled = false;
+		// The time the profiler was enabled, which recorded times are relative
+		// to
+		double m_startTime = 0.0;
+		// The ring of recorded frames
+		std::vector<ProfileFrame> m_frames;
+		// The index in the ring of the frame being recorded
+		unsigned int m_frame = 0;
+		// The number of finished frames in the ring
+		unsigned int m_frameCount = 0;
+		// The number of the frame being recorded
+		unsigned long long m_frameNumber = 0;
+		// Whether a frame is being recorded
+		bool m_inFrame = false;
+		// The indices of the samples of the scopes started but not stopped
+		std::vector<unsigned int> m_scopeStack;
+		// The OpenGL IDs of the timer queries
+		GLuint m_queries[GPU_QUERIES] = {};
+		// The number of the frame each timer query was issued in, 0 if it has
+		// no result to be read
+		unsigned long long m_queryFrames[GPU_QUERIES] = {};
+		// The timer query which is next to be issued
+		unsigned int m_query = 0;
+		// Whether a timer query is running
+		bool m_queryActive = false;
+		// The font the overlay is drawn in, nullptr if it is hidden
+		Font* m_overlayFont = nullptr;
+		// The text shader the overlay is drawn with
+		Shader* m_overlayShader = nullptr;
+		// The name of the text shader's color uniform
+		std::string m_overlayColorUniform = "";
+		// The color the overlay is drawn in
+		glm::vec3 m_overlayColor = glm::vec3(1.0f);
+		// The scale the overlay's text is drawn at
+		float m_overlayScale = 1.0f;
+		// The laid out lines of the overlay's text
+		std::vector<TextLayout> m_overlayLines;
+		// The text of each line of the overlay
+		std::vector<std::string> m_overlayText;
+		// The number of frames since the overlay's text was updated
+		unsigned int m_overlayAge = OVERLAY_INTERVAL;
+
+		/*
+		* Read the result of a timer query into the frame it was issued in
+		*
+		* @param query: The index of the timer query to read
+		* @param wait: Whether to wait for the GPU to finish the query if its
+		* result is not available yet
+		*/
+		void readGPUTimer(unsigned int query, bool wait);
+		/*
+		* Build the overlay's text from the frames in the history
+		*/
+		void updateOverlayText();
+	};
+
+	/*
+	* Times the scope it is declared in with the profiler until it goes out of
+	* scope
+	*/
+	class ProfileScope {
+	public:
+		/*
+		* Start timing a scope
+		*
+		* @param name: The name of the scope, a string literal or other string
+		* which outlives the profiler
+		*/
+		ProfileScope(const char* name) {
+			Profiler::getInstance().beginScope(name);
+		}
+		/*
+		* The copy constructor is disabled for this class
+		*/
+		ProfileScope(ProfileScope& s) = delete;
+		/*
+		* Stop timing the scope
+		*/
+		~ProfileScope() {
+			Profiler::getInstance().endScope();
+		}
+	};
+}
+
+#endif
\ No newline at end of file
@@ -6,95 +6,360 @@
 
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <GL/glew.h>
 
 #include "MW.h"
 
 namespace Milkweed {
-	Renderer Renderer::m_instance;
+	bool StreamBuffer::init(GLenum target, GLsizeiptr sectionSize,
+		unsigned int sectionCount) {
+		m_target = target;
+		m_sectionSize = sectionSize;
+		m_sectionCount = sectionCount;
+		m_section = 0;
+		m_sectionOffset = 0;
+		m_fences.assign(sectionCount, nullptr);
+		GLsizeiptr size = sectionSize * sectionCount;
+
+		// Create the buffer and leave it bound to its target
+		glGenBuffers(1, &m_bufferID);
+		glBindBuffer(m_target, m_bufferID);
+
+		if (GLEW_ARB_buffer_storage) {
+			// Allocate immutable storage and map it once for the life of the
+			// buffer
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT
+				| GL_MAP_COHERENT_BIT;
+			glBufferStorage(m_target, size, nullptr, flags);
+			m_data = (char*)glMapBufferRange(m_target, 0, size, flags);
+			m_persistent = (m_data != nullptr);
+			return m_persistent;
+		}
 
-	bool Renderer::init() {
-		// Give the window the OpenGL context
-		glfwMakeContextCurrent(MW::WINDOW.getWindowHandle());
+		// Persistent mapping is unavailable, allocate the storage once and map
+		// each reserved range without synchronization instead
+		m_persistent = false;
+		glBufferData(m_target, size, nullptr, GL_STREAM_DRAW);
+		return glGetError() == GL_NO_ERROR;
+	}
 
-		// Initialize GLEW and get the running OpenGL version
-		if (glewInit() != GLEW_OK) {
-			// GLEW could not be initialize
-			MWLOG(Error, Renderer, "Failed to initialize GLEW");
-			return false;
+	void* StreamBuffer::map(GLsizeiptr minSize, GLintptr& offset,
+		GLsizeiptr& available, GLsizeiptr alignment) {
+		if (minSize <= 0 || minSize > m_sectionSize || alignment <= 0) {
+			return nullptr;
 		}
 
-		const GLubyte* version = glGetString(GL_VERSION);
-		MWLOG(Info, Renderer, "Initialized GLEW, OpenGL version: ", version);
+		// Start the mapping on the next multiple of the alignment, moving on
+		// to the next section if too little of this one is left
+		m_sectionOffset = (m_sectionOffset + alignment - 1) / alignment
+			* alignment;
+		if (m_sectionOffset + minSize > m_sectionSize) {
+			nextSection();
+		}
+		offset = (GLintptr)m_section * m_sectionSize + m_sectionOffset;
+		available = m_sectionSize - m_sectionOffset;
 
-		// Set the clear color
-		glClearColor(m_clearColor.x, m_clearColor.y, m_clearColor.z, 1.0f);
+		if (m_persistent) {
+			return m_data + offset;
+		}
+		// The section is known to be free, so the driver does not need to
+		// synchronize the mapping
+		glBindBuffer(m_target, m_bufferID);
+		return glMapBufferRange(m_target, offset, available, GL_MAP_WRITE_BIT
+			| GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+			| GL_MAP_FLUSH_EXPLICIT_BIT);
+	}
 
-		// Enable alpha blending
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	void StreamBuffer::unmap(GLsizeiptr size) {
+		// Only the bytes actually written are used up in the section
+		m_sectionOffset += size;
+		if (!m_persistent) {
+			if (size > 0) {
+				glFlushMappedBufferRange(m_target, 0, size);
+			}
+			glUnmapBuffer(m_target);
+		}
+	}
 
-		// Disable byte-alignment restriction for text rendering
-		glPixelStorei(GL_UNPACK_ALIGNMENT, GL_TRUE);
+	void StreamBuffer::destroy() {
+		// Release any fences still waiting on the GPU
+		for (GLsync fence : m_fences) {
+			if (fence != nullptr) {
+				glDeleteSync(fence);
+			}
+		}
+		m_fences.clear();
 
-		// Create and bind the VAO, VBO, and IBO
-		glGenVertexArrays(1, &m_VAOID);
-		glBindVertexArray(m_VAOID);
-		glGenBuffers(1, &m_VBOID);
-		glBindBuffer(GL_ARRAY_BUFFER, m_VBOID);
-		glGenBuffers(1, &m_IBOID);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IBOID);
+		// Unmap and delete the buffer's storage
+		glBindBuffer(m_target, m_bufferID);
+		if (m_persistent) {
+			glUnmapBuffer(m_target);
+		}
+		glBindBuffer(m_target, 0);
+		glDeleteBuffers(1, &m_bufferID);
+		m_bufferID = 0;
+		m_data = nullptr;
+		m_persistent = false;
+	}
 
-		// Default to texture slot 0
-		// TODO: This should probably be changed later
-		glActiveTexture(GL_TEXTURE0);
+	void StreamBuffer::nextSection() {
+		// Mark the end of the GPU's reads from the current section
+		m_fences[m_section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 
-		return true;
+		// Advance to the next section and wait for the GPU to finish with it
+		m_section = (m_section + 1) % m_sectionCount;
+		m_sectionOffset = 0;
+		GLsync fence = m_fences[m_section];
+		if (fence == nullptr) {
+			return;
+		}
+		GLenum status = GL_TIMEOUT_EXPIRED;
+		while (status == GL_TIMEOUT_EXPIRED) {
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+				1000000);
+		}
+		glDeleteSync(fence);
+		m_fences[m_section] = nullptr;
 	}
 
-	void Renderer::begin() {
-		// Clear the color buffer to the clearColor and the sprites from last
-		// frame
-		glClear(GL_COLOR_BUFFER_BIT);
+	/*
+	* Generate the indices of count consecutive sprite quads
+	*/
+	template <typename T>
+	std::vector<T> generateQuadIndices(unsigned int count) {
+		std::vector<T> indices;
+		indices.reserve(count * Sprite::SPRITE_INDICES.size());
+		for (unsigned int s = 0; s < count; s++) {
+			for (unsigned int i : Sprite::SPRITE_INDICES) {
+				indices.push_back((T)(i + 4 * s));
+			}
+		}
+		return indices;
 	}
 
-	void Renderer::submit(const std::vector<Sprite*>& sprites, Shader* shader) {
-		// If there are no sprites or shader do nothing
-		if (sprites.empty() || shader == nullptr) {
+	/*
+	* Upload a set of indices to the bound index buffer as immutable data
+	*/
+	template <typename T>
+	void uploadQuadIndices(const std::vector<T>& indices) {
+		GLsizeiptr size = sizeof(T) * indices.size();
+		if (GLEW_ARB_buffer_storage) {
+			glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, size, indices.data(), 0);
+		}
+		else {
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, indices.data(),
+				GL_STATIC_DRAW);
+		}
+	}
+
+	/*
+	* Convert a depth to an unsigned integer which sorts in the same order
+	*/
+	std::uint32_t depthSortBits(float depth) {
+		if (depth == 0.0f) {
+			// Sort negative zero with positive zero
+			depth = 0.0f;
+		}
+		std::uint32_t bits = 0;
+		std::memcpy(&bits, &depth, sizeof(bits));
+		// Flip all bits of negative values and the sign bit of positive ones
+		return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+	}
+
+	/*
+	* Get the number of floats a sprite takes up in a buffer read by a shader,
+	* a full quad of vertices or a single instance record
+	*/
+	unsigned int spriteFloats(const Shader* shader) {
+		return shader->isInstanced() ? Sprite::INSTANCE_FLOATS
+			: Sprite::VERTEX_FLOATS;
+	}
+
+	/*
+	* Write a sprite's data in the form the given shader reads it
+	*/
+	void writeSpriteData(Sprite* sprite, const Shader* shader, float* data) {
+		if (shader->isInstanced()) {
+			sprite->writeInstanceData(data);
+		}
+		else {
+			sprite->writeVertexData(data);
+		}
+	}
+
+	/*
+	* Get the key a sprite in a layer is ordered by, its depth then texture
+	*/
+	std::uint64_t layerSortKey(const Sprite* sprite) {
+		return ((std::uint64_t)depthSortBits(sprite->position.z) << 32)
+			| sprite->texture->textureID;
+	}
+
+	void SpriteLayer::init(Shader* shader) {
+		m_shader = shader;
+		m_rebuild = true;
+	}
+
+	void SpriteLayer::add(Sprite* sprite) {
+		// Sprites must have a texture and may only be added once
+		if (sprite == nullptr || sprite->texture == nullptr
+			|| m_slots.find(sprite) != m_slots.end()) {
 			return;
 		}
+		// The sprite is given its real slot when the layer is rebuilt
+		m_slots[sprite] = (unsigned int)m_sprites.size();
+		m_sprites.push_back(sprite);
+		m_rebuild = true;
+	}
 
-		// Add the sprites to their shader
+	void SpriteLayer::add(const std::vector<Sprite*>& sprites) {
 		for (Sprite* sprite : sprites) {
-			if (sprite == nullptr) {
-				continue;
-			}
-			// Make sure the sprite has a texture, not nullptr
-			if (sprite->texture == nullptr) {
-				continue;
-			}
-			// Add the sprite to the frame
-			sprite->m_shader = shader;
-			m_sprites.push_back(sprite);
+			add(sprite);
 		}
 	}
 
-	void Renderer::submit(const std::string& text, const glm::vec3& position,
-		const glm::vec4& bounds, float scale, Font* font, Shader* shader,
-		Justification hJustification, Justification vJustification) {
-		// Make sure text has been submitted
-		if (text.empty() || font == nullptr || shader == nullptr) {
+	void SpriteLayer::remove(Sprite* sprite) {
+		std::unordered_map<Sprite*, unsigned int>::iterator it
+			= m_slots.find(sprite);
+		if (it == m_slots.end()) {
+			return;
+		}
+		m_slots.erase(it);
+		m_sprites.erase(std::find(m_sprites.begin(), m_sprites.end(), sprite));
+		m_rebuild = true;
+	}
+
+	void SpriteLayer::markDirty(Sprite* sprite) {
+		if (m_slots.find(sprite) != m_slots.end()) {
+			m_dirty.push_back(sprite);
+		}
+	}
+
+	void SpriteLayer::destroy() {
+		if (m_VAOID != 0) {
+			glDeleteBuffers(1, &m_VBOID);
+			glDeleteVertexArrays(1, &m_VAOID);
+		}
+		m_VAOID = m_VBOID = 0;
+		m_capacity = 0;
+		m_sprites.clear();
+		m_slots.clear();
+		m_keys.clear();
+		m_ranges.clear();
+		m_dirty.clear();
+		m_rebuild = true;
+		m_depth = 0.0f;
+	}
+
+	void SpriteLayer::upload(GLuint indexBufferID) {
+		if (m_VAOID == 0) {
+			// Create this layer's vertex array, sharing the renderer's quad
+			// indices and laid out for this layer's shader
+			glGenVertexArrays(1, &m_VAOID);
+			glBindVertexArray(m_VAOID);
+			glGenBuffers(1, &m_VBOID);
+			glBindBuffer(GL_ARRAY_BUFFER, m_VBOID);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+			m_shader->bindVertexAttributes();
+			m_capacity = 0;
+			m_rebuild = true;
+		}
+		if (!m_rebuild && m_dirty.empty()) {
+			// Nothing has changed since the last upload
+			return;
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, m_VBOID);
+		// A sprite which changed depth or texture moves in the buffer, so
+		// the whole layer must be sorted again
+		for (unsigned int i = 0; i < m_dirty.size() && !m_rebuild; i++) {
+			Sprite* sprite = m_dirty[i];
+			if (sprite->texture == nullptr
+				|| layerSortKey(sprite) != m_keys[m_slots[sprite]]) {
+				m_rebuild = true;
+			}
+		}
+		if (m_rebuild) {
+			rebuild();
 			return;
 		}
 
-		// Attempt to find the shader in the text map
-		std::unordered_map<Shader*, std::vector<Sprite>>::iterator it
-			= m_text.find(shader);
-		if (it == m_text.end()) {
-			// Not found, add one
-			m_text[shader] = std::vector<Sprite>(0);
+		// Only re-upload the vertex data of the changed sprites
+		float vertices[Sprite::VERTEX_FLOATS];
+		GLsizeiptr spriteSize = spriteFloats(m_shader) * sizeof(float);
+		for (Sprite* sprite : m_dirty) {
+			writeSpriteData(sprite, m_shader, vertices);
+			glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)m_slots[sprite]
+				* spriteSize, spriteSize, vertices);
 		}
+		m_dirty.clear();
+	}
 
+	void SpriteLayer::rebuild() {
+		// Drop sprites which have lost their texture
+		for (unsigned int i = 0; i < m_sprites.size();) {
+			if (m_sprites[i]->texture == nullptr) {
+				m_slots.erase(m_sprites[i]);
+				m_sprites.erase(m_sprites.begin() + i);
+			}
+			else {
+				i++;
+			}
+		}
+
+		// Order the sprites by depth, then texture to bind as few textures as
+		// possible
+		std::stable_sort(m_sprites.begin(), m_sprites.end(),
+			[](const Sprite* a, const Sprite* b) {
+			return layerSortKey(a) < layerSortKey(b);
+		});
+		m_keys.resize(m_sprites.size());
+		m_ranges.clear();
+		unsigned int floats = spriteFloats(m_shader);
+		std::vector<float> vertices(m_sprites.size() * floats);
+		for (unsigned int i = 0; i < m_sprites.size(); i++) {
+			Sprite* sprite = m_sprites[i];
+			m_slots[sprite] = i;
+			m_keys[i] = layerSortKey(sprite);
+			writeSpriteData(sprite, m_shader, &vertices[i * floats]);
+			// Extend the last range or start a new one on a new texture
+			if (m_ranges.empty()
+				|| m_ranges.back().textureID != sprite->texture->textureID) {
+				Range range;
+				range.textureID = sprite->texture->textureID;
+				range.first = i;
+				m_ranges.push_back(range);
+			}
+			m_ranges.back().count++;
+		}
+		m_depth = m_sprites.empty() ? 0.0f : m_sprites[0]->position.z;
+
+		// Grow the buffer if the sprites no longer fit, then upload them all
+		if (m_sprites.size() > m_capacity) {
+			m_capacity = std::max((unsigned int)m_sprites.size(),
+				m_capacity * 2);
+			glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)m_capacity
+				* floats * sizeof(float), nullptr,
+				GL_STATIC_DRAW);
+		}
+		if (!vertices.empty()) {
+			glBufferSubData(GL_ARRAY_BUFFER, 0,
+				(GLsizeiptr)(vertices.size() * sizeof(float)), &vertices[0]);
+		}
+
+		m_dirty.clear();
+		m_rebuild = false;
+	}
+
+	/*
+	* Lay out a string of text as positioned character sprites, adding those
+	* inside the bounds to the given set
+	*/
+	void layoutText(const std::string& text, const glm::vec3& position,
+		const glm::vec4& bounds, float scale, Font* font,
+		Justification hJustification, Justification vJustification,
+		std::vector<Sprite>& characters) {
 		// Calculate the width and height of the text clamped to the boundaries
 		// of the characters
 		float labelWidth = 0.0f, max = font->maxCharacterHeight * scale,
@@ -172,18 +437,173 @@ namespace Milkweed {
 				&& ch.position.x + ch.dimensions.x <= bounds.x + bounds.z * 1.1f
 				&& ch.position.y >= bounds.y
 				&& ch.position.y + ch.dimensions.y <= bounds.y + bounds.w) {
-				m_text[shader].push_back(ch);
+				characters.push_back(ch);
 			}
 		}
 	}
-	
-	bool compareSpriteDepth(const Sprite* a, const Sprite* b) {
-		if (a == nullptr || b == nullptr) {
+
+	bool TextLayout::update(const std::string& text, const glm::vec3& position,
+		const glm::vec4& bounds, float scale, Font* font,
+		Justification hJustification, Justification vJustification) {
+		// Keep the last layout if nothing it depends on has changed
+		if (!m_dirty && font == m_font && scale == m_scale
+			&& position == m_position && bounds == m_bounds
+			&& hJustification == m_hJustification
+			&& vJustification == m_vJustification && text == m_text) {
+			return false;
+		}
+
+		m_text = text;
+		m_position = position;
+		m_bounds = bounds;
+		m_scale = scale;
+		m_font = font;
+		m_hJustification = hJustification;
+		m_vJustification = vJustification;
+		m_dirty = false;
+		m_characters.clear();
+		if (!text.empty() && font != nullptr) {
+			layoutText(text, position, bounds, scale, font, hJustification,
+				vJustification, m_characters);
+		}
+		return true;
+	}
+
+	void TextLayout::destroy() {
+		m_text = "";
+		m_font = nullptr;
+		m_characters.clear();
+		m_dirty = true;
+	}
+
+	Renderer Renderer::m_instance;
+
+	bool Renderer::init() {
+		// Give the window the OpenGL context
+		glfwMakeContextCurrent(MW::WINDOW.getWindowHandle());
+
+		// Initialize GLEW and get the running OpenGL version
+		if (glewInit() != GLEW_OK) {
+			// GLEW could not be initialize
+			MWLOG(Error, Renderer, "Failed to initialize GLEW");
+			return false;
+		}
+
+		const GLubyte* version = glGetString(GL_VERSION);
+		MWLOG(Info, Renderer, "Initialized GLEW, OpenGL version: ", version);
+
+		// Set the clear color
+		glClearColor(m_clearColor.x, m_clearColor.y, m_clearColor.z, 1.0f);
+
+		// Enable alpha blending
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		// Disable byte-alignment restriction for text rendering
+		glPixelStorei(GL_UNPACK_ALIGNMENT, GL_TRUE);
+
+		// Create and bind the VAO, then allocate the streaming vertex buffer
+		// once with room for a few batches
+		glGenVertexArrays(1, &m_VAOID);
+		glBindVertexArray(m_VAOID);
+		if (!m_vertexBuffer.init(GL_ARRAY_BUFFER,
+			BATCH_CAPACITY * Sprite::VERTEX_FLOATS * sizeof(float),
+			STREAM_SECTIONS)) {
+			MWLOG(Error, Renderer, "Failed to allocate streaming buffers");
 			return false;
 		}
-		return a->position.z < b->position.z;
+		if (m_vertexBuffer.isPersistent()) {
+			MWLOG(Info, Renderer, "Using persistently mapped streaming ",
+				"buffers");
+		}
+		else {
+			MWLOG(Info, Renderer, "Persistent buffer mapping unavailable, ",
+				"using unsynchronized streaming buffers");
+		}
+
+		// Build the quad indices for a full batch once, with 16-bit indices
+		// if every vertex in a batch can be addressed by one
+		glGenBuffers(1, &m_IBOID);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IBOID);
+		if (BATCH_CAPACITY * 4 <= 65536) {
+			m_indexType = GL_UNSIGNED_SHORT;
+			uploadQuadIndices(generateQuadIndices<GLushort>(BATCH_CAPACITY));
+		}
+		else {
+			m_indexType = GL_UNSIGNED_INT;
+			uploadQuadIndices(generateQuadIndices<GLuint>(BATCH_CAPACITY));
+		}
+
+		// Default to texture slot 0
+		// TODO: This should probably be changed later
+		glActiveTexture(GL_TEXTURE0);
+
+		return true;
+	}
+
+	void Renderer::begin() {
+		// Clear the color buffer to the clearColor and the sprites from last
+		// frame
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+
+	void Renderer::submit(const std::vector<Sprite*>& sprites, Shader* shader) {
+		// If there are no sprites or shader do nothing
+		if (sprites.empty() || shader == nullptr) {
+			return;
+		}
+
+		// Add the sprites to their shader
+		for (Sprite* sprite : sprites) {
+			if (sprite == nullptr) {
+				continue;
+			}
+			// Make sure the sprite has a texture, not nullptr
+			if (sprite->texture == nullptr) {
+				continue;
+			}
+			// Add the sprite to the frame
+			sprite->m_shader = shader;
+			m_sprites.push_back(sprite);
+		}
+	}
+
+	void Renderer::submit(SpriteLayer* layer) {
+		if (layer == nullptr || layer->getShader() == nullptr) {
+			return;
+		}
+		m_layers.push_back(layer);
+	}
+
+	void Renderer::submit(const std::string& text, const glm::vec3& position,
+		const glm::vec4& bounds, float scale, Font* font, Shader* shader,
+		Justification hJustification, Justification vJustification) {
+		// Make sure text has been submitted
+		if (text.empty() || font == nullptr || shader == nullptr) {
+			return;
+		}
+
+		// Lay out the characters into the text drawn with this shader
+		layoutText(text, position, bounds, scale, font, hJustification,
+			vJustification, m_text[shader]);
 	}
 
+	void Renderer::submit(TextLayout* layout, Shader* shader) {
+		if (layout == nullptr || shader == nullptr) {
+			return;
+		}
+
+		// The layout's characters stay in memory, so they are submitted as
+		// they are without being laid out or copied again
+		for (Sprite& character : layout->m_characters) {
+			if (character.texture == nullptr) {
+				continue;
+			}
+			character.m_shader = shader;
+			m_sprites.push_back(&character);
+		}
+	}
+	
 	void Renderer::end() {
 		if (m_dumpFrame) {
 			MWLOG(Info, Renderer, "Renderer frame info dump:");
@@ -210,55 +630,73 @@ namespace Milkweed {
 			submit(sprites, shader);
 		}
 
+		// Bring the buffers of the layers in this frame up to date, then
+		// restore the renderer's own buffers for the shaders to be laid out on
+		for (SpriteLayer* layer : m_layers) {
+			layer->upload(m_IBOID);
+		}
+		glBindVertexArray(m_VAOID);
+		glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer.getBufferID());
+
 		// Do not sort if no sprites
-		if (m_sprites.empty()) {
+		if (m_sprites.empty() && m_layers.empty()) {
+			m_text.clear();
 			return;
 		}
 
-		// Sort all the sprites by their depth
-		std::stable_sort(m_sprites.begin(), m_sprites.end(), compareSpriteDepth);
+		// Sort all the sprites by their depth, then shader and texture
+		sortRenderQueue();
 		if (m_dumpFrame) {
-			MWLOG(Info, Renderer, "Sorted sprites by depth");
+			MWLOG(Info, Renderer, "Sorted sprites by depth, shader and ",
+				"texture");
 		}
 
-		// Initialize the sprite data
-		std::vector<float> vertexData;
-		std::vector<unsigned int> indices;
-		unsigned int spriteCount = 0;
-
 		Shader* shader = nullptr;
-		// Bind the first texture
-		GLuint currentTextureID = m_sprites[0]->texture->textureID;
+		// No texture is bound until the first sprite is drawn
+		GLuint currentTextureID = 0;
 		glBindTexture(GL_TEXTURE_2D, currentTextureID);
-		// Go through the sprites in this frame
-		for (Sprite* sprite : m_sprites) {
+		// Go through the sprites and layers in this frame
+		for (const RenderCommand& command : m_renderQueue) {
+			Sprite* sprite = command.sprite;
+			Shader* commandShader = (sprite != nullptr) ? sprite->m_shader
+				: command.layer->getShader();
 			// Check if there is a new shader
-			if (shader != sprite->m_shader) {
+			if (shader != commandShader) {
 				if (m_dumpFrame) {
 					MWLOG(Info, Renderer, "New shader group found");
 				}
 				// New shader, draw out all current vertices and change shaders
 				if (shader != nullptr) {
-					if (spriteCount > 0) {
-						if (m_dumpFrame) {
-							MWLOG(Info, Renderer, spriteCount, " sprites were ",
-								"drawn with the last shader and must be ",
-								"rendered out");
-						}
-						drawVertices(vertexData, indices);
-						vertexData.clear();
-						indices.clear();
+					if (m_dumpFrame && m_batchCount > 0) {
+						MWLOG(Info, Renderer, m_batchCount, " sprites were ",
+							"drawn with the last shader and must be ",
+							"rendered out");
 					}
+					flushBatch();
 					shader->end();
 				}
 				// Start the new shader
 				if (m_dumpFrame) {
 					MWLOG(Info, Renderer, "Starting new shader group");
 				}
-				shader = sprite->m_shader;
+				shader = commandShader;
 				shader->begin();
-				spriteCount = 0;
+				// Lay out the vertex array for the new shader, a shader reading
+				// instance records may have left it laid out differently
+				shader->bindVertexAttributes();
+			}
+
+			// Draw layers from their own buffers after the sprites before them
+			if (command.layer != nullptr) {
+				if (m_dumpFrame) {
+					MWLOG(Info, Renderer, "Drawing sprite layer of ",
+						command.layer->getSpriteCount(), " sprites");
+				}
+				flushBatch();
+				drawLayer(command.layer, currentTextureID);
+				continue;
 			}
+
 			// Check if there is a new texture
 			if (currentTextureID != sprite->texture->textureID) {
 				if (m_dumpFrame) {
@@ -266,46 +704,41 @@ namespace Milkweed {
 						sprite->texture->textureID);
 				}
 				// A new texture was found, draw out all old sprites
-				if (spriteCount > 0) {
-					if (m_dumpFrame) {
-						MWLOG(Info, Renderer, "Sprites were drawn with the ",
-							"last texture ID and must be rendered out");
-					}
-					drawVertices(vertexData, indices);
-					vertexData.clear();
-					indices.clear();
+				if (m_dumpFrame && m_batchCount > 0) {
+					MWLOG(Info, Renderer, "Sprites were drawn with the ",
+						"last texture ID and must be rendered out");
 				}
+				flushBatch();
 				// Update the texture ID
 				if (m_dumpFrame) {
 					MWLOG(Info, Renderer, "Starting new texture ID group");
 				}
 				currentTextureID = sprite->texture->textureID;
 				glBindTexture(GL_TEXTURE_2D, currentTextureID);
-				spriteCount = 0;
+				MW::PROFILER.count(ProfileCounter::TEXTURE_BINDS);
 			}
 
-			// Add the next sprite's data to the group
-			if (m_dumpFrame) {
-				MWLOG(Info, Renderer, "Adding new sprite vertex and ",
-					"index data to the new texture frame");
-			}
-			int count = 0;
-			for (float f : sprite->getVertexData()) {
-				vertexData.push_back(f);
-				count++;
-			}
-			if (m_dumpFrame) {
-				MWLOG(Info, Renderer, "Added ", count, " vertex data points");
-			}
-			count = 0;
-			for (unsigned int i : Sprite::SPRITE_INDICES) {
-				indices.push_back(i + 4 * spriteCount);
-				count++;
+			// Draw out the batch and start a new one if it is full or there is
+			// no batch yet
+			if (m_batchCount == m_batchCapacity) {
+				if (m_dumpFrame && m_batchCount > 0) {
+					MWLOG(Info, Renderer, "Batch capacity reached, rendering ",
+						"out sprites");
+				}
+				flushBatch();
+				if (!beginBatch(shader)) {
+					continue;
+				}
 			}
+
+			// Write the next sprite's data straight into the batch
 			if (m_dumpFrame) {
-				MWLOG(Info, Renderer, "Added ", count, " indices");
+				MWLOG(Info, Renderer, "Writing new sprite vertex data to the ",
+					"new texture frame");
 			}
-			spriteCount++;
+			writeSpriteData(sprite, shader, m_batchVertices
+				+ m_batchCount * m_batchStride);
+			m_batchCount++;
 		}
 
 		// Draw the last of the data for this frame
@@ -313,11 +746,13 @@ namespace Milkweed {
 			MWLOG(Info, Renderer, "Rendering out remaining vertex data ",
 				"and ending the frame");
 		}
-		drawVertices(vertexData, indices);
-		shader->end();
-		vertexData.clear();
-		indices.clear();
+		flushBatch();
+		if (shader != nullptr) {
+			shader->end();
+		}
 		m_sprites.clear();
+		m_layers.clear();
+		m_renderQueue.clear();
 		m_text.clear();
 
 		if (m_dumpFrame) {
@@ -326,31 +761,198 @@ namespace Milkweed {
 		}
 	}
 
-	void Renderer::drawVertices(const std::vector<float>& vertexData,
-		const std::vector<unsigned int>& indices) {
-		if (m_dumpFrame) {
-			MWLOG(Info, Renderer, "Drawing ", vertexData.size(), " float ",
-				"vertex data points with ", indices.size(), " indices using ",
-				"glDrawElements");
+	void Renderer::sortRenderQueue() {
+		// Build the key of each sprite in submission order
+		m_frameShaders.clear();
+		m_renderQueue.resize(m_sprites.size());
+		for (unsigned int i = 0; i < m_sprites.size(); i++) {
+			Sprite* sprite = m_sprites[i];
+			// Only the low bits of the texture ID are needed to group
+			// sprites, IDs sharing them are still told apart when drawing
+			m_renderQueue[i].key
+				= ((std::uint64_t)depthSortBits(sprite->position.z) << 32)
+				| ((getShaderIndex(sprite->m_shader) & 0xFFFF) << 16)
+				| (sprite->texture->textureID & 0xFFFF);
+			m_renderQueue[i].sprite = sprite;
+			m_renderQueue[i].layer = nullptr;
+		}
+		// Add each layer as a single command at its lowest depth
+		for (SpriteLayer* layer : m_layers) {
+			if (layer->getSpriteCount() == 0) {
+				continue;
+			}
+			RenderCommand command;
+			command.key = ((std::uint64_t)depthSortBits(layer->m_depth) << 32)
+				| ((getShaderIndex(layer->getShader()) & 0xFFFF) << 16);
+			command.layer = layer;
+			m_renderQueue.push_back(command);
+		}
+		if (m_renderQueue.empty()) {
+			return;
 		}
-		// Upload the vertex data to OpenGL
-		glBufferData(GL_ARRAY_BUFFER,
-			sizeof(float) * vertexData.size(),
-			&(vertexData[0]), GL_STATIC_DRAW);
-		// Upload the indices to OpenGL
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-			sizeof(unsigned int) * indices.size(),
-			&(indices[0]), GL_STATIC_DRAW);
 
-		// Draw the indices with OpenGL
-		glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(),
-			GL_UNSIGNED_INT, nullptr);
+		// Count the occurrences of each value of each byte of the keys
+		const unsigned int passes = sizeof(std::uint64_t);
+		std::vector<unsigned int> counts(passes * 256, 0);
+		for (const RenderCommand& command : m_renderQueue) {
+			for (unsigned int pass = 0; pass < passes; pass++) {
+				counts[pass * 256 + ((command.key >> (pass * 8)) & 0xFF)]++;
+			}
+		}
+
+		// Sort by each byte from least to most significant, keeping equal
+		// keys in submission order
+		m_sortBuffer.resize(m_renderQueue.size());
+		for (unsigned int pass = 0; pass < passes; pass++) {
+			unsigned int* count = &counts[pass * 256];
+			unsigned int shift = pass * 8;
+			// Skip bytes which are the same in every key
+			if (count[(m_renderQueue[0].key >> shift) & 0xFF]
+				== m_renderQueue.size()) {
+				continue;
+			}
+			// Turn the counts into the first index of each value
+			unsigned int offset = 0;
+			for (unsigned int i = 0; i < 256; i++) {
+				unsigned int c = count[i];
+				count[i] = offset;
+				offset += c;
+			}
+			for (const RenderCommand& command : m_renderQueue) {
+				m_sortBuffer[count[(command.key >> shift) & 0xFF]++] = command;
+			}
+			m_renderQueue.swap(m_sortBuffer);
+		}
+	}
+
+	std::uint64_t Renderer::getShaderIndex(Shader* shader) {
+		std::vector<Shader*>::iterator it = std::find(m_frameShaders.begin(),
+			m_frameShaders.end(), shader);
+		if (it == m_frameShaders.end()) {
+			m_frameShaders.push_back(shader);
+			return m_frameShaders.size() - 1;
+		}
+		return (std::uint64_t)(it - m_frameShaders.begin());
+	}
+
+	bool Renderer::beginBatch(Shader* shader) {
+		// Map whatever is left of the current section of the vertex ring, as
+		// long as it fits at least one sprite
+		m_batchShader = shader;
+		m_batchStride = spriteFloats(shader);
+		GLsizeiptr spriteSize = m_batchStride * sizeof(float);
+		GLintptr offset = 0;
+		GLsizeiptr available = 0;
+		// Vertex batches start on a whole vertex so they can be drawn with a
+		// base vertex
+		GLsizeiptr alignment = shader->isInstanced() ? sizeof(float)
+			: 5 * sizeof(float);
+		m_batchVertices = (float*)m_vertexBuffer.map(spriteSize, offset,
+			available, alignment);
+		if (m_batchVertices == nullptr) {
+			MWLOG(Warning, Renderer, "Failed to map vertex buffer");
+			m_batchCapacity = 0;
+			return false;
+		}
+		m_batchCount = 0;
+		m_batchCapacity = (unsigned int)(available / spriteSize);
+		m_batchOffset = offset;
+		return true;
+	}
+
+	void Renderer::flushBatch() {
+		if (m_batchVertices == nullptr) {
+			return;
+		}
+
+		// Release the written part of the mapping
+		m_vertexBuffer.unmap(m_batchCount * m_batchStride * sizeof(float));
+		if (m_batchCount > 0 && m_batchShader->isInstanced()) {
+			if (m_dumpFrame) {
+				MWLOG(Info, Renderer, "Drawing ", m_batchCount, " sprite ",
+					"instances using glDrawElementsInstanced");
+			}
+			// Point the instance attributes at the batch's records and expand
+			// each into the first quad of the static indices
+			m_batchShader->bindVertexAttributes(m_batchOffset);
+			glDrawElementsInstanced(GL_TRIANGLES,
+				(GLsizei)Sprite::SPRITE_INDICES.size(), m_indexType, nullptr,
+				(GLsizei)m_batchCount);
+			MW::PROFILER.count(ProfileCounter::DRAW_CALLS);
+		}
+		else if (m_batchCount > 0) {
+			GLsizei indexCount = (GLsizei)(m_batchCount
+				* Sprite::SPRITE_INDICES.size());
+			if (m_dumpFrame) {
+				MWLOG(Info, Renderer, "Drawing ", m_batchCount, " sprites ",
+					"with ", indexCount, " indices using ",
+					"glDrawElementsBaseVertex");
+			}
+			// Draw the start of the static quad indices with OpenGL, offset to
+			// where the batch's vertices were written in the ring
+			glDrawElementsBaseVertex(GL_TRIANGLES, indexCount, m_indexType,
+				nullptr, (GLint)(m_batchOffset / (5 * sizeof(float))));
+			MW::PROFILER.count(ProfileCounter::DRAW_CALLS);
+		}
+		if (m_batchCount > 0) {
+			MW::PROFILER.count(ProfileCounter::BATCHES);
+			MW::PROFILER.count(ProfileCounter::SPRITES, m_batchCount);
+		}
+
+		m_batchVertices = nullptr;
+		m_batchShader = nullptr;
+		m_batchCount = 0;
+		m_batchCapacity = 0;
+	}
+
+	void Renderer::drawLayer(SpriteLayer* layer, GLuint& currentTextureID) {
+		glBindVertexArray(layer->m_VAOID);
+		Shader* shader = layer->getShader();
+		if (shader->isInstanced()) {
+			glBindBuffer(GL_ARRAY_BUFFER, layer->m_VBOID);
+		}
+		for (const SpriteLayer::Range& range : layer->m_ranges) {
+			if (currentTextureID != range.textureID) {
+				currentTextureID = range.textureID;
+				glBindTexture(GL_TEXTURE_2D, currentTextureID);
+				MW::PROFILER.count(ProfileCounter::TEXTURE_BINDS);
+			}
+			MW::PROFILER.count(ProfileCounter::BATCHES);
+			MW::PROFILER.count(ProfileCounter::SPRITES, range.count);
+			if (shader->isInstanced()) {
+				// Draw the whole range as instances of one quad
+				shader->bindVertexAttributes((GLintptr)range.first
+					* Sprite::INSTANCE_FLOATS * sizeof(float));
+				glDrawElementsInstanced(GL_TRIANGLES,
+					(GLsizei)Sprite::SPRITE_INDICES.size(), m_indexType,
+					nullptr, (GLsizei)range.count);
+				MW::PROFILER.count(ProfileCounter::DRAW_CALLS);
+				continue;
+			}
+			// Draw the range in pieces no larger than the quad index buffer
+			for (unsigned int drawn = 0; drawn < range.count;) {
+				unsigned int count = range.count - drawn;
+				if (count > BATCH_CAPACITY) {
+					count = BATCH_CAPACITY;
+				}
+				glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)(count
+					* Sprite::SPRITE_INDICES.size()), m_indexType, nullptr,
+					(GLint)((range.first + drawn) * 4));
+				MW::PROFILER.count(ProfileCounter::DRAW_CALLS);
+				drawn += count;
+			}
+		}
+		glBindVertexArray(m_VAOID);
+		if (shader->isInstanced()) {
+			glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer.getBufferID());
+		}
 	}
 
 	void Renderer::destroy() {
-		// Unbind and delete the VAO and VBO
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glDeleteBuffers(1, &m_VBOID);
+		// Unbind and delete the VAO and streaming buffers
+		m_vertexBuffer.destroy();
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		glDeleteBuffers(1, &m_IBOID);
 		glBindVertexArray(0);
 		glDeleteVertexArrays(1, &m_VAOID);
 
@@ -7,6 +7,7 @@
 #ifndef MW_RENDERER_H
 #define MW_RENDERER_H
 
+#include <cstdint>
 #include <unordered_map>
 
 #include "Camera.h"
@@ -21,6 +22,259 @@ namespace Milkweed {
 		LEFT, CENTER, RIGHT, TOP, BOTTOM
 	};
 
+	/*
+	* A ring of OpenGL buffer storage allocated once and written in successive
+	* sections, fenced so that data the GPU is still reading is never
+	* overwritten
+	*/
+	class StreamBuffer {
+	public:
+		/*
+		* Allocate this buffer's storage in OpenGL and bind it to its target
+		*
+		* @param target: The OpenGL target to bind this buffer to
+		* @param sectionSize: The size in bytes of each section of the ring
+		* @param sectionCount: The number of sections in the ring
+		* @return Whether the buffer's storage could be allocated
+		*/
+		bool init(GLenum target, GLsizeiptr sectionSize,
+			unsigned int sectionCount);
+		/*
+		* Map the free space left in the current section of the ring for
+		* writing, moving on to the next section if too little is left
+		*
+		* @param minSize: The minimum number of bytes which must be free, no
+		* larger than a section
+		* @param offset: Set to the byte offset of the mapped space in the
+		* buffer
+		* @param available: Set to the number of bytes which may be written
+		* @param alignment: The number of bytes the offset of the mapped space
+		* must be a multiple of, 1 by default
+		* @return A pointer to write up to available bytes to, nullptr if the
+		* space could not be mapped
+		*/
+		void* map(GLsizeiptr minSize, GLintptr& offset,
+			GLsizeiptr& available, GLsizeiptr alignment = 1);
+		/*
+		* Finish writing to the space mapped by the last call to map()
+		*
+		* @param size: The number of bytes actually written
+		*/
+		void unmap(GLsizeiptr size);
+		/*
+		* Release this buffer's storage and fences from OpenGL
+		*/
+		void destroy();
+		/*
+		* Get the OpenGL ID of this buffer
+		*/
+		GLuint getBufferID() const { return m_bufferID; }
+		/*
+		* Test whether this buffer is persistently mapped
+		*/
+		bool isPersistent() const { return m_persistent; }
+
+	private:
+		// The OpenGL target this buffer is bound to
+		GLenum m_target = 0;
+		// The OpenGL ID of this buffer
+		GLuint m_bufferID = 0;
+		// The size in bytes of each section of the ring
+		GLsizeiptr m_sectionSize = 0;
+		// The number of sections in the ring
+		unsigned int m_sectionCount = 0;
+		// The section currently being written to
+		unsigned int m_section = 0;
+		// The number of bytes already written to the current section
+		GLsizeiptr m_sectionOffset = 0;
+		// The fences placed after the last draw reading from each section
+		std::vector<GLsync> m_fences;
+		// Whether the storage is mapped once for the life of the buffer
+		bool m_persistent = false;
+		// The persistently mapped storage of this buffer
+		char* m_data = nullptr;
+
+		/*
+		* Fence the current section and wait until the GPU has finished
+		* reading the next one
+		*/
+		void nextSection();
+	};
+
+	/*
+	* A retained set of sprites uploaded to their own vertex buffer and drawn
+	* by the renderer as a unit, only re-uploaded when members change
+	*/
+	class SpriteLayer {
+	public:
+		/*
+		* Prepare this layer to hold sprites drawn with the given shader
+		* 
+		* @param shader: A pointer to the shader to render this layer with
+		*/
+		void init(Shader* shader);
+		/*
+		* Add a sprite to this layer, it must stay in memory while it is in
+		* this layer
+		* 
+		* @param sprite: A pointer to the sprite to add
+		*/
+		void add(Sprite* sprite);
+		/*
+		* Add a set of sprites to this layer
+		* 
+		* @param sprites: Pointers to the sprites to add
+		*/
+		void add(const std::vector<Sprite*>& sprites);
+		/*
+		* Remove a sprite from this layer
+		* 
+		* @param sprite: A pointer to the sprite to remove
+		*/
+		void remove(Sprite* sprite);
+		/*
+		* Mark a sprite in this layer as changed so its vertex data is
+		* re-uploaded before the layer is next drawn
+		* 
+		* @param sprite: A pointer to the sprite which has changed
+		*/
+		void markDirty(Sprite* sprite);
+		/*
+		* Mark every sprite in this layer as changed
+		*/
+		void markDirty() { m_rebuild = true; }
+		/*
+		* Get the number of sprites in this layer
+		*/
+		unsigned int getSpriteCount() const {
+			return (unsigned int)m_sprites.size();
+		}
+		/*
+		* Get a pointer to the shader this layer is rendered with
+		*/
+		Shader* getShader() const { return m_shader; }
+		/*
+		* Remove all sprites from this layer and free its buffers in OpenGL
+		*/
+		void destroy();
+
+	private:
+		friend class Renderer;
+
+		/*
+		* A run of sprites in this layer's buffer sharing a texture
+		*/
+		struct Range {
+			// The OpenGL ID of the texture of the sprites in this range
+			GLuint textureID = 0;
+			// The index of the first sprite of this range in the buffer
+			unsigned int first = 0;
+			// The number of sprites in this range
+			unsigned int count = 0;
+		};
+
+		// The shader this layer is rendered with
+		Shader* m_shader = nullptr;
+		// The vertex array of this layer
+		GLuint m_VAOID = 0;
+		// The vertex buffer holding every sprite of this layer
+		GLuint m_VBOID = 0;
+		// The number of sprites the vertex buffer has room for
+		unsigned int m_capacity = 0;
+		// The sprites in this layer in the order they are in the buffer
+		std::vector<Sprite*> m_sprites;
+		// The index in the buffer of each sprite in this layer
+		std::unordered_map<Sprite*, unsigned int> m_slots;
+		// The depth and texture of each sprite when it was last uploaded
+		std::vector<std::uint64_t> m_keys;
+		// The runs of sprites sharing a texture in the buffer
+		std::vector<Range> m_ranges;
+		// The sprites marked as changed since the last upload
+		std::vector<Sprite*> m_dirty;
+		// Whether every sprite must be sorted and uploaded again
+		bool m_rebuild = true;
+		// The lowest depth of any sprite in this layer
+		float m_depth = 0.0f;
+
+		/*
+		* Upload this layer's changed sprites to its vertex buffer, creating
+		* its buffers in OpenGL if needed
+		* 
+		* @param indexBufferID: The OpenGL ID of the renderer's static quad
+		* index buffer
+		*/
+		void upload(GLuint indexBufferID);
+		/*
+		* Sort every sprite in this layer and upload them all
+		*/
+		void rebuild();
+	};
+
+	/*
+	* A string of text laid out once into positioned character sprites, only
+	* laid out again when the text or how it is drawn changes
+	*/
+	class TextLayout {
+	public:
+		/*
+		* Lay out a string of text if it or any of the parameters it is drawn
+		* with differ from the last layout
+		* 
+		* @param text: The text to lay out
+		* @param position: The position to draw this text at
+		* @param bounds: The position and dimensions of the rectangle to draw
+		* the text within
+		* @param scale: The factor to scale the size of the characters in font
+		* by when drawing text
+		* @param font: The typeface to draw the text in
+		* @param hJustification: The justification of the text within its
+		* bounds on the x-axis
+		* @param vJustification: The justification of the text within its
+		* bounds on the y-axis
+		* @return Whether the text had to be laid out again
+		*/
+		bool update(const std::string& text, const glm::vec3& position,
+			const glm::vec4& bounds, float scale, Font* font,
+			Justification hJustification, Justification vJustification);
+		/*
+		* Force the text to be laid out again on the next update, such as
+		* after its font has been reloaded
+		*/
+		void markDirty() { m_dirty = true; }
+		/*
+		* Get the sprites of the characters in this layout
+		*/
+		const std::vector<Sprite>& getCharacters() const {
+			return m_characters;
+		}
+		/*
+		* Free this layout's memory
+		*/
+		void destroy();
+
+	private:
+		friend class Renderer;
+
+		// The text laid out
+		std::string m_text = "";
+		// The position the text was laid out at
+		glm::vec3 m_position = glm::vec3();
+		// The bounds the text was laid out in
+		glm::vec4 m_bounds = glm::vec4();
+		// The scale the text was laid out at
+		float m_scale = 1.0f;
+		// The font the text was laid out in
+		Font* m_font = nullptr;
+		// The justification the text was laid out with on the x-axis
+		Justification m_hJustification = Justification::LEFT;
+		// The justification the text was laid out with on the y-axis
+		Justification m_vJustification = Justification::BOTTOM;
+		// Whether the text must be laid out again regardless of its parameters
+		bool m_dirty = true;
+		// The sprites of the characters of the laid out text
+		std::vector<Sprite> m_characters;
+	};
+
 	/*
 	* The Milkweed framework's utility for drawing graphics
 	*/
@@ -56,6 +310,13 @@ namespace Milkweed {
 		*/
 		void submit(const std::vector<Sprite*>& sprites, Shader* shader);
 		/*
+		* Submit a retained layer of sprites to be rendered this frame, the
+		* layer is drawn at the depth of its lowest sprite
+		* 
+		* @param layer: A pointer to the sprite layer to render
+		*/
+		void submit(SpriteLayer* layer);
+		/*
 		* Submit a string of text to be converted to sprites and rendered this
 		* frame in the given color
 		* 
@@ -76,6 +337,14 @@ namespace Milkweed {
 			const glm::vec4& bounds, float scale, Font* font, Shader* shader,
 			Justification hJustification, Justification vJustification);
 		/*
+		* Submit text which has already been laid out to be rendered this
+		* frame, the layout must stay in memory until the frame ends
+		* 
+		* @param layout: A pointer to the laid out text to draw
+		* @param shader: The text shader to use to draw this text
+		*/
+		void submit(TextLayout* layout, Shader* shader);
+		/*
 		* End a frame and draw it on the screen
 		*/
 		void end();
@@ -107,26 +376,96 @@ namespace Milkweed {
 		*/
 		Renderer() {}
 
+		// The maximum number of sprites drawn in a single batch
+		const static unsigned int BATCH_CAPACITY = 4096;
+		// The number of batch-sized sections in the streaming buffers
+		const static unsigned int STREAM_SECTIONS = 3;
+
 		// Whether to dump the next frame's rendering information to the log
 		bool m_dumpFrame = false;
 		// The vertex array for this renderer
 		GLuint m_VAOID = 0;
-		// The vertex data buffer for this renderer
-		GLuint m_VBOID = 0;
-		// The index buffer for this renderer
+		// The streaming vertex data buffer for this renderer
+		StreamBuffer m_vertexBuffer;
+		// The static quad index buffer for this renderer
 		GLuint m_IBOID = 0;
+		// The OpenGL type of the indices in the index buffer
+		GLenum m_indexType = GL_UNSIGNED_INT;
+		// The mapped vertex data of the batch being written, nullptr if there
+		// is none
+		float* m_batchVertices = nullptr;
+		// The number of sprites written to the current batch
+		unsigned int m_batchCount = 0;
+		// The number of sprites which fit in the current batch
+		unsigned int m_batchCapacity = 0;
+		// The shader the current batch is written for
+		Shader* m_batchShader = nullptr;
+		// The number of floats each sprite takes up in the current batch
+		unsigned int m_batchStride = Sprite::VERTEX_FLOATS;
+		// The byte offset of the current batch in the vertex buffer
+		GLintptr m_batchOffset = 0;
+		/*
+		* A sprite queued for drawing with the key it is sorted by, packed as
+		* its depth in the upper 32 bits, then its shader and texture
+		*/
+		struct RenderCommand {
+			// The sort key of this command
+			std::uint64_t key = 0;
+			// The sprite to draw, nullptr if this command draws a layer
+			Sprite* sprite = nullptr;
+			// The sprite layer to draw, nullptr if this command draws a sprite
+			SpriteLayer* layer = nullptr;
+		};
+
 		// The sprites to be rendered this frame
 		std::vector<Sprite*> m_sprites;
+		// The sprite layers to be rendered this frame
+		std::vector<SpriteLayer*> m_layers;
+		// The sort keys and sprites of this frame in submission order
+		std::vector<RenderCommand> m_renderQueue;
+		// The scratch space the render queue is radix sorted through
+		std::vector<RenderCommand> m_sortBuffer;
+		// The shaders used this frame in the order they were first seen,
+		// giving each a small number to sort by
+		std::vector<Shader*> m_frameShaders;
 		// The text characters to render this frame
 		std::unordered_map<Shader*, std::vector<Sprite>> m_text;
 		// Normalized RGB color to clear the screen to
 		glm::vec3 m_clearColor = glm::vec3();
 
 		/*
-		* Draw a set of sprites with a single texture
+		* Build the sort key of every sprite this frame and sort them with a
+		* stable radix sort into the order they are drawn in
+		*/
+		void sortRenderQueue();
+		/*
+		* Get the number a shader is sorted by this frame
+		* 
+		* @param shader: A pointer to the shader
+		* @return The order the shader was first seen in this frame
+		*/
+		std::uint64_t getShaderIndex(Shader* shader);
+		/*
+		* Map space in the vertex buffer for a new batch of sprites
+		*
+		* @param shader: The shader the batch is drawn with, deciding whether
+		* sprites are written as vertices or instance records
+		* @return Whether space for at least one sprite could be mapped
+		*/
+		bool beginBatch(Shader* shader);
+		/*
+		* Draw the current batch of sprites with a single texture, as one
+		* instanced draw if its shader reads instance records
+		*/
+		void flushBatch();
+		/*
+		* Draw a sprite layer from its own buffers
+		* 
+		* @param layer: A pointer to the sprite layer to draw
+		* @param currentTextureID: The bound texture, updated to the last
+		* texture the layer binds
 		*/
-		void drawVertices(const std::vector<float>& vertexData,
-			const std::vector<unsigned int>& indices);
+		void drawLayer(SpriteLayer* layer, GLuint& currentTextureID);
 	};
 }
 
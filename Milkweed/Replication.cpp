@@ -0,0 +1,488 @@
+/*
+* File: Replication.cpp
+* Author: Keegan MacDonald (keeganm742@gmail.com)
+* Created: 2026.10.16
+*/
+
+#include <cmath>
+
+#include "MW.h"
+
+namespace Milkweed {
+	void NetBitWriter::clear() {
+		m_bytes.clear();
+		m_bitCount = 0;
+	}
+
+	void NetBitWriter::write(unsigned int value, unsigned int bits) {
+		// Fill the rest of the last byte, then whole bytes, lowest bits first
+		while (bits > 0) {
+			size_t byte = m_bitCount / 8;
+			unsigned int offset = (unsigned int)(m_bitCount % 8);
+			if (byte == m_bytes.size()) {
+				m_bytes.push_back(0);
+			}
+			unsigned int count = std::min(8 - offset, bits);
+			unsigned int mask = (1u << count) - 1;
+			m_bytes[byte] |= (char)((value & mask) << offset);
+			value = (count < 32) ? (value >> count) : 0;
+			bits -= count;
+			m_bitCount += count;
+		}
+	}
+
+	void NetBitWriter::writeVarint(unsigned int value) {
+		// 7 bits of the value per group, the top bit marks another group
+		while (value >= 0x80) {
+			write((value & 0x7f) | 0x80, 8);
+			value >>= 7;
+		}
+		write(value, 8);
+	}
+
+	unsigned int NetBitReader::read(unsigned int bits) {
+		if (m_failed || m_bitCount + bits > m_size * 8) {
+			m_failed = true;
+			return 0;
+		}
+
+		unsigned int value = 0, shift = 0;
+		while (bits > 0) {
+			size_t byte = m_bitCount / 8;
+			unsigned int offset = (unsigned int)(m_bitCount % 8);
+			unsigned int count = std::min(8 - offset, bits);
+			unsigned int mask = (1u << count) - 1;
+			value |= (((unsigned char)m_data[byte] >> offset) & mask) << shift;
+			shift += count;
+			bits -= count;
+			m_bitCount += count;
+		}
+		return value;
+	}
+
+	unsigned int NetBitReader::readVarint() {
+		unsigned int value = 0;
+		// An unsigned int takes at most 5 groups
+		for (unsigned int shift = 0; shift < 35; shift += 7) {
+			unsigned int group = read(8);
+			value |= (group & 0x7f) << shift;
+			if ((group & 0x80) == 0) {
+				return value;
+			}
+		}
+		m_failed = true;
+		return 0;
+	}
+
+	void NetSnapshot::reset(unsigned int fieldCount, unsigned int tick) {
+		m_fieldCount = fieldCount;
+		m_tick = tick;
+		m_IDs.clear();
+		m_fields.clear();
+	}
+
+	size_t NetSnapshot::findEntity(unsigned int entityID) const {
+		std::vector<unsigned int>::const_iterator it
+			= std::lower_bound(m_IDs.begin(), m_IDs.end(), entityID);
+		if (it == m_IDs.end() || *it != entityID) {
+			return (size_t)-1;
+		}
+		return it - m_IDs.begin();
+	}
+
+	size_t NetSnapshot::addEntity(unsigned int entityID) {
+		// Entities are usually added in order, so check the end first
+		if (m_IDs.empty() || m_IDs.back() < entityID) {
+			m_IDs.push_back(entityID);
+			m_fields.resize(m_fields.size() + m_fieldCount, 0);
+			return m_IDs.size() - 1;
+		}
+
+		std::vector<unsigned int>::iterator it
+			= std::lower_bound(m_IDs.begin(), m_IDs.end(), entityID);
+		size_t index = it - m_IDs.begin();
+		if (*it != entityID) {
+			m_IDs.insert(it, entityID);
+			m_fields.insert(m_fields.begin() + index * m_fieldCount,
+				m_fieldCount, 0);
+		}
+		return index;
+	}
+
+	void NetSnapshot::removeEntity(unsigned int entityID) {
+		size_t index = findEntity(entityID);
+		if (index != (size_t)-1) {
+			m_IDs.erase(m_IDs.begin() + index);
+			m_fields.erase(m_fields.begin() + index * m_fieldCount,
+				m_fields.begin() + (index + 1) * m_fieldCount);
+		}
+	}
+
+	void NetSnapshot::setField(unsigned int entityID, unsigned int field,
+		unsigned int value) {
+		if (field < m_fieldCount) {
+			m_fields[addEntity(entityID) * m_fieldCount + field] = value;
+		}
+	}
+
+	void NetSnapshot::setField(unsigned int entityID, unsigned int field,
+		float value) {
+		unsigned int bits = 0;
+		std::memcpy(&bits, &value, sizeof(float));
+		setField(entityID, field, bits);
+	}
+
+	unsigned int NetSnapshot::getField(unsigned int entityID,
+		unsigned int field) const {
+		size_t index = findEntity(entityID);
+		if (index == (size_t)-1 || field >= m_fieldCount) {
+			return 0;
+		}
+		return m_fields[index * m_fieldCount + field];
+	}
+
+	float NetSnapshot::getFloatField(unsigned int entityID,
+		unsigned int field) const {
+		unsigned int bits = getField(entityID, field);
+		float value = 0.0f;
+		std::memcpy(&value, &bits, sizeof(float));
+		return value;
+	}
+
+	void NetSnapshotSender::init(const std::vector<NetSnapshotField>& fields,
+		unsigned int historySize) {
+		m_fields = fields;
+		m_history.resize(historySize);
+		m_tick = 0;
+	}
+
+	NetSnapshot& NetSnapshotSender::beginSnapshot() {
+		// Reuse the oldest snapshot in the history
+		m_tick++;
+		NetSnapshot& snapshot = m_history[m_tick % m_history.size()];
+		snapshot.reset((unsigned int)m_fields.size(), m_tick);
+		return snapshot;
+	}
+
+	void NetSnapshotSender::writeSnapshot(unsigned int clientID,
+		NetMessage& message, const std::vector<unsigned int>* entityIDs) {
+		const NetSnapshot* snapshot = getSnapshot(m_tick);
+		if (snapshot == nullptr) {
+			return;
+		}
+
+		// Encode against the last snapshot the client acknowledged, or against
+		// nothing if it has not acknowledged one still in the history
+		Client& client = m_clients[clientID];
+		client.frames.resize(m_history.size());
+		const NetSnapshot* baseline = getSnapshot(client.ack);
+		const ClientFrame* baselineFrame
+			= &client.frames[client.ack % m_history.size()];
+		if (baselineFrame->tick != client.ack) {
+			baseline = nullptr;
+		}
+
+		// Entities outside of the client's list are left out as though they
+		// were not in the snapshot, both now and in the baseline
+		const std::vector<unsigned int>* baselineIDs
+			= (baseline != nullptr && baselineFrame->filtered)
+			? &baselineFrame->entityIDs : nullptr;
+		auto isSent = [](const std::vector<unsigned int>* IDs,
+			unsigned int ID) {
+			return IDs == nullptr
+				|| std::binary_search(IDs->begin(), IDs->end(), ID);
+		};
+
+		m_writer.clear();
+		m_writer.write(snapshot->getTick(), 32);
+		m_writer.write((baseline != nullptr) ? baseline->getTick() : 0, 32);
+
+		// Walk both snapshots' entities in order of ID number, writing the
+		// entities which were removed, added or changed
+		unsigned int fieldCount = (unsigned int)m_fields.size();
+		size_t i = 0, j = 0;
+		size_t count = snapshot->getEntityCount();
+		size_t baselineCount = (baseline != nullptr)
+			? baseline->getEntityCount() : 0;
+		unsigned int previousID = 0;
+		while (true) {
+			while (i < count && !isSent(entityIDs, snapshot->getEntityID(i))) {
+				i++;
+			}
+			while (j < baselineCount
+				&& !isSent(baselineIDs, baseline->getEntityID(j))) {
+				j++;
+			}
+			if (i == count && j == baselineCount) {
+				break;
+			}
+
+			if (j < baselineCount && (i == count
+				|| baseline->getEntityID(j) < snapshot->getEntityID(i))) {
+				// The entity has been removed since the baseline
+				unsigned int ID = baseline->getEntityID(j++);
+				m_writer.write(1, 1);
+				m_writer.writeVarint(ID - previousID);
+				m_writer.write(1, 1);
+				previousID = ID;
+				continue;
+			}
+
+			unsigned int ID = snapshot->getEntityID(i);
+			const unsigned int* fields = snapshot->getFields(i++);
+			const unsigned int* baselineFields = nullptr;
+			if (j < baselineCount && baseline->getEntityID(j) == ID) {
+				baselineFields = baseline->getFields(j++);
+			}
+
+			// Find the fields which differ from the baseline, new entities
+			// start with every field zero
+			unsigned int changed = 0;
+			for (unsigned int f = 0; f < fieldCount; f++) {
+				unsigned int previous = (baselineFields != nullptr)
+					? baselineFields[f] : 0;
+				if (fields[f] != previous) {
+					changed |= 1u << f;
+				}
+			}
+			if (baselineFields != nullptr && changed == 0) {
+				continue;
+			}
+
+			m_writer.write(1, 1);
+			m_writer.writeVarint(ID - previousID);
+			m_writer.write(0, 1);
+			previousID = ID;
+			for (unsigned int f = 0; f < fieldCount; f++) {
+				m_writer.write((changed >> f) & 1, 1);
+			}
+			for (unsigned int f = 0; f < fieldCount; f++) {
+				if ((changed >> f) & 1) {
+					m_writer.write(fields[f], m_fields[f].bits);
+				}
+			}
+		}
+		m_writer.write(0, 1);
+
+		// Remember what the client was sent in case it becomes its baseline
+		ClientFrame& frame = client.frames[m_tick % m_history.size()];
+		frame.tick = m_tick;
+		frame.filtered = (entityIDs != nullptr);
+		if (frame.filtered) {
+			frame.entityIDs = *entityIDs;
+		}
+
+		// Copy the packed bits into the message
+		const std::vector<char>& bytes = m_writer.getBytes();
+		message.header.ID = NetMessageTypes::SNAPSHOT;
+		message.body.resize(bytes.size());
+		std::memcpy(message.body.data(), bytes.data(), bytes.size());
+		message.header.size = (unsigned int)bytes.size();
+	}
+
+	bool NetSnapshotSender::processMessage(NetMessage& message) {
+		if (message.header.ID != NetMessageTypes::SNAPSHOT_ACK
+			|| message.owner == nullptr) {
+			return false;
+		}
+
+		// Acknowledgements may arrive out of order, keep the newest
+		unsigned int tick = 0;
+		NetReader reader(message);
+		if (!reader.read(tick)) {
+			return true;
+		}
+		std::map<unsigned int, Client>::iterator client
+			= m_clients.find(message.owner->getID());
+		if (client != m_clients.end() && tick <= m_tick
+			&& tick > client->second.ack) {
+			client->second.ack = tick;
+		}
+		return true;
+	}
+
+	void NetSnapshotSender::forgetClient(unsigned int clientID) {
+		m_clients.erase(clientID);
+	}
+
+	void NetSnapshotSender::destroy() {
+		m_fields.clear();
+		m_history.clear();
+		m_clients.clear();
+		m_writer.clear();
+		m_tick = 0;
+	}
+
+	const NetSnapshot* NetSnapshotSender::getSnapshot(unsigned int tick) const {
+		if (tick == 0 || m_history.empty() || tick > m_tick
+			|| m_tick - tick >= m_history.size()) {
+			return nullptr;
+		}
+		return &m_history[tick % m_history.size()];
+	}
+
+	void NetSnapshotReceiver::init(const std::vector<NetSnapshotField>& fields,
+		float tickRate, float interpolationDelay, unsigned int historySize) {
+		m_fields = fields;
+		m_tickRate = tickRate;
+		m_interpolationDelay = interpolationDelay;
+		m_history.resize(historySize);
+		reset();
+	}
+
+	bool NetSnapshotReceiver::processMessage(NetMessage& message) {
+		if (message.header.ID != NetMessageTypes::SNAPSHOT) {
+			return false;
+		}
+
+		const NetMessageBody& body = message.body;
+		NetBitReader reader(body.data(), body.size());
+		unsigned int tick = reader.read(32);
+		unsigned int baselineTick = reader.read(32);
+		if (reader.hasFailed() || tick == 0 || tick <= m_latestTick
+			|| m_history.empty()) {
+			// Sequenced messages can still arrive late over TCP
+			return true;
+		}
+
+		// Start from the baseline the sender encoded against, which this
+		// receiver must still have
+		unsigned int fieldCount = (unsigned int)m_fields.size();
+		NetSnapshot snapshot;
+		snapshot.reset(fieldCount, tick);
+		if (baselineTick != 0) {
+			const NetSnapshot* baseline = getSnapshot(baselineTick);
+			if (baseline == nullptr) {
+				return true;
+			}
+			snapshot.m_IDs = baseline->m_IDs;
+			snapshot.m_fields = baseline->m_fields;
+		}
+
+		// Apply each removed, added or changed entity
+		unsigned int ID = 0;
+		while (reader.read(1) == 1) {
+			ID += reader.readVarint();
+			if (reader.read(1) == 1) {
+				snapshot.removeEntity(ID);
+				continue;
+			}
+			unsigned int changed = 0;
+			for (unsigned int f = 0; f < fieldCount; f++) {
+				changed |= reader.read(1) << f;
+			}
+			size_t index = snapshot.addEntity(ID);
+			for (unsigned int f = 0; f < fieldCount; f++) {
+				if ((changed >> f) & 1) {
+					snapshot.m_fields[index * fieldCount + f]
+						= reader.read(m_fields[f].bits);
+				}
+			}
+		}
+		if (reader.hasFailed()) {
+			return true;
+		}
+
+		// Keep the snapshot and tell the server it can be used as a baseline
+		m_history[tick % m_history.size()] = std::move(snapshot);
+		if (m_latestTick == 0) {
+			m_sampleTick = tick - m_interpolationDelay;
+		}
+		m_latestTick = tick;
+
+		NetMessage ack(NetMessageTypes::SNAPSHOT_ACK);
+		NetWriter(ack).write(tick);
+		NetClient::getInstance().send(ack, NetSendMode::UNRELIABLE);
+		return true;
+	}
+
+	void NetSnapshotReceiver::advance(float seconds) {
+		if (m_latestTick == 0) {
+			return;
+		}
+
+		// Follow the sender's clock, but jump back into place if packet loss
+		// or a hitch has left the sample time far from where it should be
+		m_sampleTick += seconds * m_tickRate;
+		double target = (double)m_latestTick - m_interpolationDelay;
+		if (std::abs(m_sampleTick - target) > m_interpolationDelay * 2.0) {
+			m_sampleTick = target;
+		}
+		if (m_sampleTick > m_latestTick) {
+			m_sampleTick = m_latestTick;
+		}
+	}
+
+	bool NetSnapshotReceiver::sample(NetSnapshot& snapshot) const {
+		if (m_latestTick == 0) {
+			return false;
+		}
+
+		// Find the snapshots on either side of the sample time
+		const NetSnapshot* from = nullptr;
+		const NetSnapshot* to = nullptr;
+		for (const NetSnapshot& s : m_history) {
+			if (s.getTick() == 0) {
+				continue;
+			}
+			if (s.getTick() <= m_sampleTick) {
+				if (from == nullptr || s.getTick() > from->getTick()) {
+					from = &s;
+				}
+			}
+			else if (to == nullptr || s.getTick() < to->getTick()) {
+				to = &s;
+			}
+		}
+		if (from == nullptr) {
+			// The sample time is older than every snapshot kept
+			from = to;
+			to = nullptr;
+		}
+		snapshot = *from;
+		if (to == nullptr) {
+			return true;
+		}
+
+		// Interpolate the float fields of entities in both snapshots
+		float t = (float)((m_sampleTick - from->getTick())
+			/ (double)(to->getTick() - from->getTick()));
+		unsigned int fieldCount = (unsigned int)m_fields.size();
+		for (size_t i = 0; i < snapshot.getEntityCount(); i++) {
+			size_t j = to->findEntity(snapshot.getEntityID(i));
+			if (j == (size_t)-1) {
+				continue;
+			}
+			const unsigned int* toFields = to->getFields(j);
+			for (unsigned int f = 0; f < fieldCount; f++) {
+				if (!m_fields[f].interpolate) {
+					continue;
+				}
+				unsigned int& bits = snapshot.m_fields[i * fieldCount + f];
+				float a = 0.0f, b = 0.0f;
+				std::memcpy(&a, &bits, sizeof(float));
+				std::memcpy(&b, &toFields[f], sizeof(float));
+				float value = a + (b - a) * t;
+				std::memcpy(&bits, &value, sizeof(float));
+			}
+		}
+		return true;
+	}
+
+	void NetSnapshotReceiver::reset() {
+		for (NetSnapshot& snapshot : m_history) {
+			snapshot.reset((unsigned int)m_fields.size(), 0);
+		}
+		m_latestTick = 0;
+		m_sampleTick = 0.0;
+	}
+
+	const NetSnapshot* NetSnapshotReceiver::getSnapshot(
+		unsigned int tick) const {
+		if (tick == 0 || m_history.empty()) {
+			return nullptr;
+		}
+		const NetSnapshot& snapshot = m_history[tick % m_history.size()];
+		return (snapshot.getTick() == tick) ? &snapshot : nullptr;
+	}
+}
\ No newline at end of file
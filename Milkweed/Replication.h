@@ -0,0 +1,378 @@
+/*
+* File: Replication.h
+* Author: Keegan MacDonald (keeganm742@gmail.com)
+* Created: 2026.10.16
+*/
+
+#ifndef MW_REPLICATION_H
+#define MW_REPLICATION_H
+
+#include <map>
+#include <vector>
+
+#include "Network.h"
+
+namespace Milkweed {
+	/*
+	* Packs unsigned values into bytes using only as many bits as each needs
+	*/
+	class NetBitWriter {
+	public:
+		/*
+		* Remove all the bits written so far
+		*/
+		void clear();
+		/*
+		* Write the lowest bits of a value
+		*
+		* @param value: The value to write
+		* @param bits: The number of bits of the value to write (1 - 32)
+		*/
+		void write(unsigned int value, unsigned int bits);
+		/*
+		* Write a value in 8 bit groups, small values take fewer groups
+		*
+		* @param value: The value to write
+		*/
+		void writeVarint(unsigned int value);
+		/*
+		* Get the bytes written, the last one padded with zero bits
+		*/
+		const std::vector<char>& getBytes() const { return m_bytes; }
+
+	private:
+		// The bytes written so far
+		std::vector<char> m_bytes;
+		// The number of bits written so far
+		size_t m_bitCount = 0;
+	};
+
+	/*
+	* Unpacks the values written by a NetBitWriter, without reading past the
+	* end of its bytes
+	*/
+	class NetBitReader {
+	public:
+		/*
+		* Construct a reader over a block of bytes
+		*
+		* @param data: The bytes to read, which must outlive the reader
+		* @param size: The number of bytes to read
+		*/
+		NetBitReader(const char* data, size_t size)
+			: m_data(data), m_size(size) {}
+		/*
+		* Read a value written with NetBitWriter::write()
+		*
+		* @param bits: The number of bits in the value (1 - 32)
+		* @return The value read, 0 if there were not enough bits left
+		*/
+		unsigned int read(unsigned int bits);
+		/*
+		* Read a value written with NetBitWriter::writeVarint()
+		*
+		* @return The value read, 0 if it was not valid
+		*/
+		unsigned int readVarint();
+		/*
+		* Test whether a read has gone past the end of the bytes or found an
+		* invalid value
+		*/
+		bool hasFailed() const { return m_failed; }
+
+	private:
+		// The bytes to read
+		const char* m_data = nullptr;
+		// The number of bytes to read
+		size_t m_size = 0;
+		// The number of bits read so far
+		size_t m_bitCount = 0;
+		// Whether a read has failed
+		bool m_failed = false;
+	};
+
+	/*
+	* The description of one field of every entity in a snapshot
+	*/
+	struct NetSnapshotField {
+		// The number of bits the field's values are sent with (1 - 32)
+		unsigned int bits = 32;
+		// Whether the field holds a float which receivers should interpolate
+		// between snapshots, needs all 32 bits
+		bool interpolate = false;
+	};
+
+	/*
+	* The state of a set of entities at a single tick, each entity has an ID
+	* number and the same number of fields
+	*/
+	class NetSnapshot {
+	public:
+		/*
+		* Remove every entity and set the number of fields per entity
+		*
+		* @param fieldCount: The number of fields each entity has
+		* @param tick: The tick this snapshot describes
+		*/
+		void reset(unsigned int fieldCount, unsigned int tick);
+		/*
+		* Get the tick this snapshot describes
+		*/
+		unsigned int getTick() const { return m_tick; }
+		/*
+		* Get the number of fields each entity has
+		*/
+		unsigned int getFieldCount() const { return m_fieldCount; }
+		/*
+		* Get the number of entities in this snapshot
+		*/
+		size_t getEntityCount() const { return m_IDs.size(); }
+		/*
+		* Get the ID number of an entity
+		*
+		* @param index: The index of the entity, entities are sorted by ID
+		*/
+		unsigned int getEntityID(size_t index) const { return m_IDs[index]; }
+		/*
+		* Get the fields of an entity
+		*
+		* @param index: The index of the entity, entities are sorted by ID
+		*/
+		const unsigned int* getFields(size_t index) const {
+			return m_fields.data() + index * m_fieldCount;
+		}
+		/*
+		* Find the index of an entity
+		*
+		* @param entityID: The ID number of the entity
+		* @return The index of the entity, or -1 if it is not in this snapshot
+		*/
+		size_t findEntity(unsigned int entityID) const;
+		/*
+		* Add an entity with all of its fields zero, if it is not already in
+		* this snapshot
+		*
+		* @param entityID: The ID number of the entity
+		* @return The index of the entity
+		*/
+		size_t addEntity(unsigned int entityID);
+		/*
+		* Remove an entity from this snapshot if it is in it
+		*
+		* @param entityID: The ID number of the entity
+		*/
+		void removeEntity(unsigned int entityID);
+		/*
+		* Set a field of an entity, adding the entity if it is not in this
+		* snapshot
+		*
+		* @param entityID: The ID number of the entity
+		* @param field: The index of the field
+		* @param value: The value of the field
+		*/
+		void setField(unsigned int entityID, unsigned int field,
+			unsigned int value);
+		/*
+		* Set a float field of an entity, adding the entity if it is not in this
+		* snapshot
+		*/
+		void setField(unsigned int entityID, unsigned int field, float value);
+		/*
+		* Get a field of an entity
+		*
+		* @return The value of the field, 0 if the entity is not in this
+		* snapshot
+		*/
+		unsigned int getField(unsigned int entityID, unsigned int field) const;
+		/*
+		* Get a float field of an entity
+		*
+		* @return The value of the field, 0.0f if the entity is not in this
+		* snapshot
+		*/
+		float getFloatField(unsigned int entityID, unsigned int field) const;
+
+	private:
+		// Let the sender and receiver build snapshots in place
+		friend class NetSnapshotReceiver;
+
+		// The tick this snapshot describes
+		unsigned int m_tick = 0;
+		// The number of fields each entity has
+		unsigned int m_fieldCount = 0;
+		// The ID numbers of the entities in increasing order
+		std::vector<unsigned int> m_IDs;
+		// The fields of each entity, in the same order as the ID numbers
+		std::vector<unsigned int> m_fields;
+	};
+
+	/*
+	* Produces a snapshot each tick on a server and sends each client only the
+	* fields which have changed since the last snapshot it acknowledged
+	*/
+	class NetSnapshotSender {
+	public:
+		/*
+		* Set up this sender with the fields each entity has
+		*
+		* @param fields: The description of each field of an entity
+		* @param historySize: The number of past snapshots to keep as baselines,
+		* clients which fall further behind are sent whole snapshots (32 by
+		* default)
+		*/
+		void init(const std::vector<NetSnapshotField>& fields,
+			unsigned int historySize = 32);
+		/*
+		* Start the snapshot for the next tick
+		*
+		* @return An empty snapshot to fill with every entity's state, valid
+		* until the next call
+		*/
+		NetSnapshot& beginSnapshot();
+		/*
+		* Get the tick of the latest snapshot
+		*/
+		unsigned int getTick() const { return m_tick; }
+		/*
+		* Encode the latest snapshot for a client against the last snapshot it
+		* acknowledged
+		*
+		* @param clientID: The ID number of the client's connection
+		* @param message: The message to write the snapshot into
+		* @param entityIDs: The ID numbers of the only entities the client
+		* should see in increasing order, such as those found by
+		* NetServer::getNearbyClients(), entities leaving the list are removed
+		* on the client (nullptr for every entity by default)
+		*/
+		void writeSnapshot(unsigned int clientID, NetMessage& message,
+			const std::vector<unsigned int>* entityIDs = nullptr);
+		/*
+		* Process a message from a client if it acknowledges a snapshot
+		*
+		* @param message: The message from the client
+		* @return Whether the message was a snapshot acknowledgement
+		*/
+		bool processMessage(NetMessage& message);
+		/*
+		* Forget the snapshots a client has acknowledged
+		*
+		* @param clientID: The ID number of the client's connection
+		*/
+		void forgetClient(unsigned int clientID);
+		/*
+		* Free this sender's memory
+		*/
+		void destroy();
+
+	private:
+		/*
+		* The entities a client was sent at one tick
+		*/
+		struct ClientFrame {
+			// The tick the entities were sent at
+			unsigned int tick = 0;
+			// Whether the client was only sent some of the entities
+			bool filtered = false;
+			// The ID numbers of the entities the client was sent, if filtered
+			std::vector<unsigned int> entityIDs;
+		};
+		/*
+		* What is known about each client
+		*/
+		struct Client {
+			// The last tick the client has acknowledged
+			unsigned int ack = 0;
+			// The entities sent to the client, indexed like the history
+			std::vector<ClientFrame> frames;
+		};
+
+		// The description of each field of an entity
+		std::vector<NetSnapshotField> m_fields;
+		// The past snapshots, indexed by their tick modulo the history size
+		std::vector<NetSnapshot> m_history;
+		// The tick of the latest snapshot, 0 before the first one
+		unsigned int m_tick = 0;
+		// What is known about each client by its ID number
+		std::map<unsigned int, Client> m_clients;
+		// The writer used to encode snapshots, kept to reuse its memory
+		NetBitWriter m_writer;
+
+		/*
+		* Get a past snapshot if it is still in the history
+		*/
+		const NetSnapshot* getSnapshot(unsigned int tick) const;
+	};
+
+	/*
+	* Rebuilds the snapshots sent by a NetSnapshotSender on a client,
+	* acknowledges them and interpolates between them
+	*/
+	class NetSnapshotReceiver {
+	public:
+		/*
+		* Set up this receiver with the fields each entity has, which must match
+		* the sender's
+		*
+		* @param fields: The description of each field of an entity
+		* @param tickRate: The number of snapshots the sender makes per second
+		* @param interpolationDelay: The number of ticks to stay behind the
+		* latest snapshot, so that there is usually a newer one to interpolate
+		* towards (2 by default)
+		* @param historySize: The number of past snapshots to keep as baselines,
+		* at least the sender's (32 by default)
+		*/
+		void init(const std::vector<NetSnapshotField>& fields, float tickRate,
+			float interpolationDelay = 2.0f, unsigned int historySize = 32);
+		/*
+		* Process a message from the server if it carries a snapshot,
+		* acknowledging the snapshot to the server
+		*
+		* @param message: The message from the server
+		* @return Whether the message was a snapshot
+		*/
+		bool processMessage(NetMessage& message);
+		/*
+		* Move the time to sample snapshots at forward
+		*
+		* @param seconds: The time passed since the last call
+		*/
+		void advance(float seconds);
+		/*
+		* Get the state of the entities at the current sample time,
+		* interpolating between the snapshots on either side of it
+		*
+		* @param snapshot: The snapshot to write the state into
+		* @return Whether any snapshot has been received
+		*/
+		bool sample(NetSnapshot& snapshot) const;
+		/*
+		* Get the tick of the newest snapshot received, 0 before the first one
+		*/
+		unsigned int getLatestTick() const { return m_latestTick; }
+		/*
+		* Forget every snapshot received, for when the client disconnects
+		*/
+		void reset();
+
+	private:
+		// The description of each field of an entity
+		std::vector<NetSnapshotField> m_fields;
+		// The received snapshots, indexed by their tick modulo the history size
+		std::vector<NetSnapshot> m_history;
+		// The number of snapshots the sender makes per second
+		float m_tickRate = 1.0f;
+		// The number of ticks to stay behind the latest snapshot
+		float m_interpolationDelay = 2.0f;
+		// The tick of the newest snapshot received
+		unsigned int m_latestTick = 0;
+		// The tick to sample snapshots at, between whole ticks
+		double m_sampleTick = 0.0;
+
+		/*
+		* Get a past snapshot if it is still in the history
+		*/
+		const NetSnapshot* getSnapshot(unsigned int tick) const;
+	};
+}
+
+#endif
\ No newline at end of file
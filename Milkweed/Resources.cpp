@@ -5,13 +5,122 @@
 */
 
 #include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
 
 #include "MW.h"
 
 namespace Milkweed {
+	void AtlasPacker::init(const glm::ivec2& dimensions) {
+		m_dimensions = dimensions;
+		// Start with a single segment on the floor spanning the whole page
+		m_skyline.clear();
+		Segment floor;
+		floor.width = dimensions.x;
+		m_skyline.push_back(floor);
+	}
+
+	bool AtlasPacker::pack(const glm::ivec2& dimensions,
+		glm::ivec2& position) {
+		if (dimensions.x <= 0 || dimensions.y <= 0) {
+			return false;
+		}
+
+		// Find the segment which keeps the top of the rectangle lowest,
+		// preferring narrower segments to waste less space
+		int bestIndex = -1, bestTop = 0, bestWidth = 0, bestY = 0;
+		for (unsigned int i = 0; i < m_skyline.size(); i++) {
+			int y = 0;
+			if (!fits(i, dimensions, y)) {
+				continue;
+			}
+			int top = y + dimensions.y;
+			if (bestIndex == -1 || top < bestTop
+				|| (top == bestTop && m_skyline[i].width < bestWidth)) {
+				bestIndex = (int)i;
+				bestTop = top;
+				bestWidth = m_skyline[i].width;
+				bestY = y;
+			}
+		}
+		if (bestIndex == -1) {
+			// There is no room left in this page for the rectangle
+			return false;
+		}
+		position = glm::ivec2(m_skyline[bestIndex].x, bestY);
+
+		// Raise the skyline over the new rectangle
+		Segment segment;
+		segment.x = position.x;
+		segment.y = bestTop;
+		segment.width = dimensions.x;
+		m_skyline.insert(m_skyline.begin() + bestIndex, segment);
+
+		// Shrink or remove the segments now covered by the new one
+		for (unsigned int i = bestIndex + 1; i < m_skyline.size();) {
+			const Segment& previous = m_skyline[i - 1];
+			int previousEnd = previous.x + previous.width;
+			if (m_skyline[i].x >= previousEnd) {
+				break;
+			}
+			int overlap = previousEnd - m_skyline[i].x;
+			m_skyline[i].x += overlap;
+			m_skyline[i].width -= overlap;
+			if (m_skyline[i].width > 0) {
+				break;
+			}
+			m_skyline.erase(m_skyline.begin() + i);
+		}
+
+		// Merge neighbouring segments at the same height
+		for (unsigned int i = 0; i + 1 < m_skyline.size();) {
+			if (m_skyline[i].y == m_skyline[i + 1].y) {
+				m_skyline[i].width += m_skyline[i + 1].width;
+				m_skyline.erase(m_skyline.begin() + i + 1);
+			}
+			else {
+				i++;
+			}
+		}
+
+		return true;
+	}
+
+	bool AtlasPacker::fits(unsigned int index, const glm::ivec2& dimensions,
+		int& y) {
+		if (m_skyline[index].x + dimensions.x > m_dimensions.x) {
+			// The rectangle would hang off the right of the page
+			return false;
+		}
+
+		// The rectangle must rest on the highest segment beneath it
+		int widthLeft = dimensions.x;
+		y = 0;
+		for (unsigned int i = index; widthLeft > 0; i++) {
+			if (i >= m_skyline.size()) {
+				return false;
+			}
+			y = std::max(y, m_skyline[i].y);
+			if (y + dimensions.y > m_dimensions.y) {
+				// The rectangle would hang off the top of the page
+				return false;
+			}
+			widthLeft -= m_skyline[i].width;
+		}
+
+		return true;
+	}
+
 	ResourceManager ResourceManager::m_instance;
 
-	void ResourceManager::init() {
+	void ResourceManager::init(unsigned int loaderCount) {
+		// Start the threads which load resources in the background
+		m_stopLoaders = false;
+		for (unsigned int i = 0; i < loaderCount; i++) {
+			m_loaders.push_back(std::thread([this]() { runLoader(); }));
+		}
+
 		// Initialize freetype
 		if (FT_Init_FreeType(&m_freeTypeLibrary) != FT_Err_Ok) {
 			m_fontLoadingEnabled = false;
@@ -23,6 +132,177 @@ namespace Milkweed {
 		m_fontLoadingEnabled = true;
 	}
 
+	bool ResourceManager::mountPack(const std::string& fileName) {
+		std::unique_ptr<AssetPack> pack = std::make_unique<AssetPack>();
+		if (!pack->open(fileName)) {
+			return false;
+		}
+		m_packs.push_back(std::move(pack));
+		return true;
+	}
+
+	bool ResourceManager::buildPack(const std::string& packFileName,
+		const std::vector<std::string>& fileNames,
+		const std::vector<unsigned int>& fontPointSizes) {
+		AssetPackWriter writer;
+		bool succeeded = true;
+		for (const std::string& fileName : fileNames) {
+			std::string extension = fileName.substr(std::min(fileName.size(),
+				fileName.find_last_of('.')));
+			std::transform(extension.begin(), extension.end(),
+				extension.begin(), [](char c) { return (char)std::tolower(c); });
+
+			DecodedResource resource;
+			resource.fileName = fileName;
+			resource.name = fileName;
+			if (extension == ".png") {
+				resource.type = ResourceType::TEXTURE;
+				if (!decodeTexture(resource)) {
+					succeeded = false;
+					continue;
+				}
+				writer.addTexture(resource.name, resource.dimensions,
+					resource.getBytes());
+			}
+			else if (extension == ".wav" || extension == ".flac"
+				|| extension == ".ogg") {
+				resource.type = ResourceType::SOUND;
+				if (!decodeSound(resource)) {
+					succeeded = false;
+					continue;
+				}
+				writer.addSound(resource.name, resource.format,
+					resource.sampleRate, resource.getBytes(),
+					resource.getSize());
+			}
+			else if (extension == ".ttf") {
+				if (!m_fontLoadingEnabled) {
+					MWLOG(Warning, ResourceManager, "Can't pack font ",
+						fileName, " because font loading is disabled");
+					succeeded = false;
+					continue;
+				}
+				// Render the font once for each point size it is used at
+				for (unsigned int pointSize : fontPointSizes) {
+					DecodedResource font;
+					font.type = ResourceType::FONT;
+					font.fileName = fileName;
+					font.name = fileName + ":" + std::to_string(pointSize);
+					font.pointSize = pointSize;
+					if (!decodeFont(font)) {
+						succeeded = false;
+						continue;
+					}
+					writer.addFont(font.name, font.font, font.dimensions,
+						font.getBytes());
+				}
+			}
+			else {
+				MWLOG(Warning, ResourceManager, "Can't pack ", fileName,
+					", only PNG, WAV, FLAC, Ogg Vorbis and TTF files can be ",
+					"packed");
+				succeeded = false;
+			}
+		}
+
+		if (!succeeded) {
+			MWLOG(Warning, ResourceManager, "Not writing asset pack ",
+				packFileName, " because some resources failed to load");
+			return false;
+		}
+		return writer.write(packFileName);
+	}
+
+	bool ResourceManager::readPacked(DecodedResource& resource) {
+		// Search the packs mounted last first so they take precedence
+		const AssetPack* pack = nullptr;
+		const AssetPackEntry* entry = nullptr;
+		for (size_t i = m_packs.size(); i > 0 && entry == nullptr; i--) {
+			pack = m_packs[i - 1].get();
+			entry = pack->find(resource.name);
+		}
+		if (entry == nullptr) {
+			return false;
+		}
+		const unsigned char* data = pack->getData(*entry);
+
+		switch (resource.type) {
+		case ResourceType::TEXTURE:
+			if (entry->type != AssetType::TEXTURE || entry->dataSize
+				!= (std::uint64_t)entry->params[0] * entry->params[1] * 4) {
+				break;
+			}
+			resource.dimensions = glm::ivec2(entry->params[0],
+				entry->params[1]);
+			resource.mapped = data;
+			resource.mappedSize = (size_t)entry->dataSize;
+			return true;
+		case ResourceType::SOUND:
+			if (entry->type != AssetType::SOUND) {
+				break;
+			}
+			resource.format = (ALenum)entry->params[0];
+			resource.sampleRate = (ALsizei)entry->params[1];
+			resource.mapped = data;
+			resource.mappedSize = (size_t)entry->dataSize;
+			return true;
+		case ResourceType::FONT: {
+			if (entry->type != AssetType::FONT
+				|| entry->dataSize < sizeof(AssetPackFont)) {
+				break;
+			}
+			AssetPackFont header;
+			std::memcpy(&header, data, sizeof(header));
+			std::uint64_t glyphsSize = (std::uint64_t)header.glyphCount
+				* sizeof(AssetPackGlyph);
+			std::uint64_t atlasSize = (std::uint64_t)header.atlasWidth
+				* header.atlasHeight;
+			if (header.atlasWidth <= 0 || header.atlasHeight <= 0
+				|| entry->dataSize != sizeof(header) + glyphsSize + atlasSize) {
+				break;
+			}
+
+			Font& font = resource.font;
+			font.maxCharacterHeight = header.maxCharacterHeight;
+			font.minCharacterHeight = header.minCharacterHeight;
+			font.pointSize = header.pointSize;
+			const unsigned char* glyphs = data + sizeof(header);
+			for (std::uint32_t i = 0; i < header.glyphCount; i++) {
+				AssetPackGlyph glyph;
+				std::memcpy(&glyph, glyphs + i * sizeof(glyph), sizeof(glyph));
+				Texture texture;
+				texture.dimensions = glm::ivec2(glyph.textureWidth,
+					glyph.textureHeight);
+				texture.textureCoords = glm::vec4(glyph.textureCoords[0],
+					glyph.textureCoords[1], glyph.textureCoords[2],
+					glyph.textureCoords[3]);
+				font.characters[(char)glyph.character] = Character(
+					glm::vec2(glyph.width, glyph.height),
+					glm::ivec2(glyph.bearingX, glyph.bearingY), glyph.offset,
+					texture);
+			}
+			resource.dimensions = glm::ivec2(header.atlasWidth,
+				header.atlasHeight);
+			resource.mapped = glyphs + glyphsSize;
+			resource.mappedSize = (size_t)atlasSize;
+			return true;
+		}
+		}
+
+		MWLOG(Warning, ResourceManager, "Asset ", resource.name, " in pack ",
+			pack->getFileName(), " is invalid");
+		return false;
+	}
+
+	bool ResourceManager::isPacked(const std::string& name) const {
+		for (const std::unique_ptr<AssetPack>& pack : m_packs) {
+			if (pack->find(name) != nullptr) {
+				return true;
+			}
+		}
+		return false;
+	}
+
 	Texture* ResourceManager::getTexture(const std::string& fileName) {
 		std::unordered_map<std::string, Texture>::iterator it
 			= m_textures.find(fileName);
@@ -32,12 +312,27 @@ namespace Milkweed {
 		}
 
 		// The texture is not present in memory and must be loaded
+		DecodedResource resource;
+		resource.type = ResourceType::TEXTURE;
+		resource.fileName = fileName;
+		resource.name = fileName;
+		if (!decodeTexture(resource)) {
+			return nullptr;
+		}
+		return uploadTexture(resource);
+	}
+
+	bool ResourceManager::decodeTexture(DecodedResource& resource) {
+		if (readPacked(resource)) {
+			return true;
+		}
+		const std::string& fileName = resource.fileName;
 		std::ifstream textureFile(fileName.c_str(), std::ios::in
 			| std::ios::binary | std::ios::ate);
 		if (textureFile.fail()) {
 			MWLOG(Warning, ResourceManager, "Failed to load texture file ",
 				fileName);
-			return nullptr;
+			return false;
 		}
 		std::streamsize fileSize = 0;
 		if (textureFile.seekg(0, std::ios::end).good()) {
@@ -58,19 +353,50 @@ namespace Milkweed {
 			// The file could not be read
 			MWLOG(Warning, ResourceManager, "Failed to load texture file ",
 				fileName);
-			return nullptr;
+			return false;
 		}
 
-		// Decode the texture file's data with picoPNG's decodePNG function
-		std::vector<unsigned char> textureData;
-		unsigned long textureWidth = 0, textureHeight = 0;
-		int status = decodePNG(textureData, textureWidth, textureHeight,
-			&buffer[0], (size_t)fileSize);
-		if (status != 0) {
+		// Decode the texture file's data straight into the buffer it is
+		// uploaded from
+		PNGDecoder decoder;
+		if (!decoder.readHeader(&buffer[0], buffer.size(),
+			resource.dimensions)) {
+			MWLOG(Warning, ResourceManager, "Failed to decode PNG file ",
+				fileName, ", ", decoder.getError());
+			return false;
+		}
+		resource.data.resize((size_t)resource.dimensions.x
+			* resource.dimensions.y * 4);
+		if (!decoder.decode(&buffer[0], buffer.size(), resource.data.data(),
+			resource.data.size())) {
 			// The texture could not be decoded in PNG format
 			MWLOG(Warning, ResourceManager, "Failed to decode PNG file ",
-				fileName, ", may be in invalid format");
-			return nullptr;
+				fileName, ", ", decoder.getError());
+			return false;
+		}
+
+		return true;
+	}
+
+	Texture* ResourceManager::uploadTexture(DecodedResource& resource) {
+		const std::string& fileName = resource.name;
+		std::unordered_map<std::string, Texture>::iterator it
+			= m_textures.find(fileName);
+		if (it != m_textures.end()) {
+			return &it->second;
+		}
+
+		if (m_atlasEnabled) {
+			// Pack this texture into the atlas so it can share a batch with
+			// other textures
+			Texture texture;
+			if (packTexture(resource.getBytes(), resource.dimensions,
+				texture)) {
+				m_textures[fileName] = texture;
+				return &m_textures[fileName];
+			}
+			MWLOG(Warning, ResourceManager, "Texture ", fileName, " does not ",
+				"fit in an atlas page, loading it separately");
 		}
 
 		// Create this texture and upload its data to OpenGL
@@ -81,18 +407,82 @@ namespace Milkweed {
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, textureWidth, textureHeight,
-			0, GL_RGBA, GL_UNSIGNED_BYTE, &textureData[0]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, resource.dimensions.x,
+			resource.dimensions.y, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+			resource.getBytes());
 		glGenerateMipmap(GL_TEXTURE_2D);
 		glBindTexture(GL_TEXTURE_2D, 0);
 
 		// Add this texture to the map of textures in memory
-		m_textures[fileName] = Texture(textureID,
-			glm::ivec2((unsigned int)textureWidth,
-			(unsigned int)textureHeight));
+		m_textures[fileName] = Texture(textureID, resource.dimensions);
 		return &m_textures[fileName];
 	}
 
+	bool ResourceManager::packTexture(const unsigned char* data,
+		const glm::ivec2& dimensions, Texture& texture) {
+		glm::ivec2 paddedDimensions = dimensions
+			+ glm::ivec2(ATLAS_PADDING * 2, ATLAS_PADDING * 2);
+
+		// Find the first page with room for this texture
+		AtlasPage* page = nullptr;
+		glm::ivec2 position = glm::ivec2();
+		for (AtlasPage& p : m_atlasPages) {
+			if (p.packer.pack(paddedDimensions, position)) {
+				page = &p;
+				break;
+			}
+		}
+
+		if (page == nullptr) {
+			if (paddedDimensions.x > m_atlasPageSize.x
+				|| paddedDimensions.y > m_atlasPageSize.y) {
+				// This texture will not fit even in an empty page
+				return false;
+			}
+
+			// Create a new, transparent page for this texture
+			AtlasPage newPage;
+			newPage.packer.init(m_atlasPageSize);
+			std::vector<unsigned char> clear(
+				(size_t)m_atlasPageSize.x * m_atlasPageSize.y * 4, 0);
+			glGenTextures(1, &newPage.textureID);
+			glBindTexture(GL_TEXTURE_2D, newPage.textureID);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_atlasPageSize.x,
+				m_atlasPageSize.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, &clear[0]);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			m_atlasPages.push_back(newPage);
+
+			MWLOG(Info, ResourceManager, "Created texture atlas page ",
+				m_atlasPages.size(), " (", m_atlasPageSize.x, "x",
+				m_atlasPageSize.y, ")");
+
+			page = &m_atlasPages.back();
+			if (!page->packer.pack(paddedDimensions, position)) {
+				return false;
+			}
+		}
+
+		// Upload the texture into its place inside the padding
+		position += glm::ivec2(ATLAS_PADDING, ATLAS_PADDING);
+		glBindTexture(GL_TEXTURE_2D, page->textureID);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, position.x, position.y,
+			dimensions.x, dimensions.y, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		// Refer to the texture's rectangle in the page in texture space
+		glm::vec2 pageSize = glm::vec2((float)page->packer.getDimensions().x,
+			(float)page->packer.getDimensions().y);
+		texture = Texture(page->textureID, dimensions, glm::vec4(
+			(float)position.x / pageSize.x, (float)position.y / pageSize.y,
+			(float)dimensions.x / pageSize.x,
+			(float)dimensions.y / pageSize.y));
+		return true;
+	}
+
 	Sound* ResourceManager::getSound(const std::string& fileName) {
 		// Attempt to find the sound in memory
 		std::unordered_map<std::string, Sound>::iterator it
@@ -103,317 +493,542 @@ namespace Milkweed {
 		}
 
 		// The sound was not found in memory and must be loaded from the disk
-		// Get the header information and the sound data
-		std::uint8_t channels;
-		std::int32_t sampleRate;
-		std::uint8_t bitsPerSample;
-		ALsizei size;
-		char* soundData = loadWAV(fileName, channels, sampleRate,
-			bitsPerSample, size);
-		if (soundData == nullptr) {
-			MWLOG(Warning, ResourceManager, "Failed to load audio file ",
-				fileName);
+		DecodedResource resource;
+		resource.type = ResourceType::SOUND;
+		resource.fileName = fileName;
+		resource.name = fileName;
+		if (!decodeSound(resource)) {
 			return nullptr;
 		}
+		return uploadSound(resource);
+	}
 
-		// Derive the sound's OpenAL format from the header info
-		ALenum format;
-		if (channels == 1 && bitsPerSample == 8) {
-			format = AL_FORMAT_MONO8;
-		}
-		else if (channels == 1 && bitsPerSample == 16) {
-			format = AL_FORMAT_MONO16;
+	bool ResourceManager::decodeSound(DecodedResource& resource) {
+		if (readPacked(resource)) {
+			return true;
 		}
-		else if (channels == 2 && bitsPerSample == 8) {
-			format = AL_FORMAT_STEREO8;
+		const std::string& fileName = resource.fileName;
+		std::unique_ptr<AudioStream> stream = AudioStream::open(fileName);
+		if (stream == nullptr) {
+			MWLOG(Warning, ResourceManager, "Failed to load audio file ",
+				fileName);
+			return false;
 		}
-		else if (channels == 2 && bitsPerSample == 16) {
-			format = AL_FORMAT_STEREO16;
+		resource.format = stream->getFormat();
+		resource.sampleRate = stream->getSampleRate();
+
+		// Decode the whole sound a second of samples at a time
+		size_t chunkSize = (size_t)stream->getSampleRate()
+			* stream->getFrameSize();
+		size_t size = 0;
+		while (true) {
+			resource.data.resize(size + chunkSize);
+			size_t count = stream->read(&resource.data[size], chunkSize);
+			size += count;
+			if (count < chunkSize) {
+				break;
+			}
 		}
-		else {
+		resource.data.resize(size);
+		if (stream->hasFailed()) {
 			MWLOG(Warning, ResourceManager, "Audio file ", fileName,
-				" is in invalid format for OpenAL");
-			return nullptr;
+				" is corrupt");
+			return false;
 		}
 
-		// Create the sound buffer and upload the sound data to it, then remove
-		// the sound data from RAM
+		return true;
+	}
+
+	Sound* ResourceManager::uploadSound(DecodedResource& resource) {
+		std::unordered_map<std::string, Sound>::iterator it
+			= m_sounds.find(resource.name);
+		if (it != m_sounds.end()) {
+			return &it->second;
+		}
+
+		// Create the sound buffer and upload the sound data to it, the sound
+		// data is removed from RAM with the decoded resource
 		Sound sound;
 		alGenBuffers(1, &sound.soundID);
-		alBufferData(sound.soundID, format, soundData, size, sampleRate);
-		delete soundData;
+		alBufferData(sound.soundID, resource.format, resource.getBytes(),
+			(ALsizei)resource.getSize(), resource.sampleRate);
 
 		// Place the new sound into the map and return it
-		m_sounds[fileName] = sound;
-		return &m_sounds[fileName];
+		m_sounds[resource.name] = sound;
+		return &m_sounds[resource.name];
 	}
 
 	Font* ResourceManager::getFont(const std::string& fileName) {
-		if (!m_fontLoadingEnabled) {
+		// Fonts are stored once for each point size they are loaded at
+		std::string fontName = fileName + ":"
+			+ std::to_string(m_fontPointSize);
+		if (!m_fontLoadingEnabled && !isPacked(fontName)) {
 			// If font loading is disabled because FT could not be initialized,
-			// do not attempt to load this font
+			// only fonts already rendered into a pack can be loaded
 			MWLOG(Warning, ResourceManager, "Failed to load font ", fileName,
 				" because font loading is disabled");
 			return nullptr;
 		}
-
 		std::unordered_map<std::string, Font>::iterator it
-			= m_fonts.find(fileName);
+			= m_fonts.find(fontName);
 		if (it != m_fonts.end()) {
 			// The font was found in memory, return it
-			return &m_fonts[fileName];
+			return &m_fonts[fontName];
 		}
 
 		// The font was not found in memory and must be loaded from the disk
-		FT_Face face;
-		if (FT_New_Face(m_freeTypeLibrary, fileName.c_str(), 0, &face)
-			!= FT_Err_Ok) {
-			// The font could not be loaded from disk
-			MWLOG(Warning, ResourceManager, "Failed to read font ", fileName);
+		DecodedResource resource;
+		resource.type = ResourceType::FONT;
+		resource.fileName = fileName;
+		resource.name = fontName;
+		resource.pointSize = m_fontPointSize;
+		if (!decodeFont(resource)) {
 			return nullptr;
 		}
-		// Set the point size to load the font at
-		FT_Set_Pixel_Sizes(face, 0, m_fontPointSize);
-
-		// Create a new font object
-		Font font;
-		// Iterate over the first 128 characters
-		for (unsigned char c = 0; c < 128; c++) {
-			// Load the character
-			FT_Error error = FT_Load_Char(face, c, FT_LOAD_RENDER);
-			if (error != FT_Err_Ok) {
-				// This character is not in the font
-				MWLOG(Warning, ResourceManager, "Failed to load character ", c,
-					" from font ", fileName);
-				continue;
-			}
-			// Allocate a new texture for this character and upload FreeType
-			// data to it in OpenGL
-			Texture texture;
-			glGenTextures(1, &texture.textureID);
-			glBindTexture(GL_TEXTURE_2D, texture.textureID);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, face->glyph->bitmap.width,
-				face->glyph->bitmap.rows, 0, GL_RED, GL_UNSIGNED_BYTE,
-				face->glyph->bitmap.buffer);
-			texture.dimensions.x = face->glyph->bitmap.width;
-			texture.dimensions.y = face->glyph->bitmap.rows;
-			// Add the character to the font's character map
-			font.characters[c] = Character(glm::vec2(texture.dimensions.x,
-				texture.dimensions.y), glm::ivec2(face->glyph->bitmap_left,
-					face->glyph->bitmap_top), face->glyph->advance.x >> 6,
-				texture);
-
-			// Test if the max character height needs to be reset
-			if (font.characters[c].bearing.y > font.maxCharacterHeight) {
-				font.maxCharacterHeight = (float)font.characters[c].bearing.y;
-			}
-			if (font.minCharacterHeight > -(font.characters[c].dimensions.y
-				- font.characters[c].bearing.y)) {
-				font.minCharacterHeight = -(font.characters[c].dimensions.y
-					- font.characters[c].bearing.y);
-			}
-		}
-
-		FT_Done_Face(face);
-		m_fonts[fileName] = font;
-		return &m_fonts[fileName];
+		return uploadFont(resource);
 	}
 
-	void ResourceManager::destroy() {
-		MWLOG(Info, ResourceManager, "Destroying resources loading from disk");
-
-		int count = 0;
-		// Delete all of the textures loaded into memory from OpenGL
-		for (std::pair<std::string, Texture> pair : m_textures) {
-			glDeleteTextures(1, &pair.second.textureID);
-			count++;
+	bool ResourceManager::decodeFont(DecodedResource& resource) {
+		if (readPacked(resource)) {
+			return true;
 		}
-		m_textures.clear();
+		if (!m_fontLoadingEnabled) {
+			MWLOG(Warning, ResourceManager, "Failed to load font ",
+				resource.fileName, " because font loading is disabled");
+			return false;
+		}
+		const std::string& fileName = resource.fileName;
+		Font& font = resource.font;
+		font.pointSize = resource.pointSize;
+		// The rendered bitmap of each character, packed into the atlas after
+		// all characters are loaded
+		std::vector<std::vector<unsigned char>> bitmaps(128);
+		{
+			// FreeType's library may only load one face at a time
+			std::lock_guard<std::mutex> lock(m_freeTypeMtx);
+			FT_Face face;
+			if (FT_New_Face(m_freeTypeLibrary, fileName.c_str(), 0, &face)
+				!= FT_Err_Ok) {
+				// The font could not be loaded from disk
+				MWLOG(Warning, ResourceManager, "Failed to read font ",
+					fileName);
+				return false;
+			}
+			// Set the point size to load the font at
+			FT_Set_Pixel_Sizes(face, 0, font.pointSize);
 
-		MWLOG(Info, ResourceManager, "Deleted ", count, " textures from ",
-			"OpenGL");
+			// Iterate over the first 128 characters
+			for (unsigned char c = 0; c < 128; c++) {
+				// Load the character
+				FT_Error error = FT_Load_Char(face, c, FT_LOAD_RENDER);
+				if (error != FT_Err_Ok) {
+					// This character is not in the font
+					MWLOG(Warning, ResourceManager, "Failed to load character ",
+						c, " from font ", fileName);
+					continue;
+				}
+				// Copy FreeType's bitmap of this character row by row, since
+				// its rows may be padded
+				const FT_Bitmap& bitmap = face->glyph->bitmap;
+				bitmaps[c].resize((size_t)bitmap.width * bitmap.rows);
+				for (unsigned int row = 0; row < bitmap.rows; row++) {
+					std::memcpy(&bitmaps[c][(size_t)row * bitmap.width],
+						bitmap.buffer + (std::ptrdiff_t)row * bitmap.pitch,
+						bitmap.width);
+				}
+				// Add the character to the font's character map, its texture
+				// is set once it has been packed
+				Texture texture;
+				texture.dimensions.x = bitmap.width;
+				texture.dimensions.y = bitmap.rows;
+				font.characters[c] = Character(glm::vec2(texture.dimensions.x,
+					texture.dimensions.y), glm::ivec2(face->glyph->bitmap_left,
+						face->glyph->bitmap_top), face->glyph->advance.x >> 6,
+					texture);
 
-		count = 0;
-		// Delete all the sounds loaded into memory from OpenAL
-		for (std::pair<std::string, Sound> pair : m_sounds) {
-			alDeleteBuffers(1, &pair.second.soundID);
-			count++;
+				// Test if the max character height needs to be reset
+				if (font.characters[c].bearing.y > font.maxCharacterHeight) {
+					font.maxCharacterHeight
+						= (float)font.characters[c].bearing.y;
+				}
+				if (font.minCharacterHeight > -(font.characters[c].dimensions.y
+					- font.characters[c].bearing.y)) {
+					font.minCharacterHeight = -(font.characters[c].dimensions.y
+						- font.characters[c].bearing.y);
+				}
+			}
+			FT_Done_Face(face);
 		}
-		m_sounds.clear();
 
-		MWLOG(Info, ResourceManager, "Deleted ", count, " sound buffers from ",
-			"OpenAL");
+		// Pack the tallest characters first to waste less space in the atlas
+		std::vector<char> order;
+		for (const std::pair<char, Character>& pair : font.characters) {
+			if (pair.second.texture.dimensions.x > 0
+				&& pair.second.texture.dimensions.y > 0) {
+				order.push_back(pair.first);
+			}
+		}
+		std::stable_sort(order.begin(), order.end(), [&](char a, char b) {
+			return font.characters[a].texture.dimensions.y
+				> font.characters[b].texture.dimensions.y;
+		});
 
-		if (!m_fontLoadingEnabled) {
-			MWLOG(Info, ResourceManager, "No fonts to delete");
-			return;
+		// Find the smallest atlas all of the characters fit into, growing it
+		// one dimension at a time
+		glm::ivec2 atlasSize = glm::ivec2(128, 128);
+		std::vector<glm::ivec2> positions(128);
+		while (true) {
+			AtlasPacker packer;
+			packer.init(atlasSize);
+			bool packed = true;
+			for (char c : order) {
+				if (!packer.pack(font.characters[c].texture.dimensions
+					+ glm::ivec2(ATLAS_PADDING * 2, ATLAS_PADDING * 2),
+					positions[c])) {
+					packed = false;
+					break;
+				}
+			}
+			if (packed) {
+				break;
+			}
+			if (atlasSize.x <= atlasSize.y) {
+				atlasSize.x *= 2;
+			}
+			else {
+				atlasSize.y *= 2;
+			}
+			if (atlasSize.x > MAX_FONT_ATLAS_SIZE) {
+				MWLOG(Warning, ResourceManager, "Font ", fileName, " at size ",
+					font.pointSize, " does not fit in a character atlas");
+				return false;
+			}
 		}
-		count = 0;
-		// Delete all fonts loaded into memory and dispose of the FreeType lib
-		for (const std::pair<std::string, Font>& pair : m_fonts) {
-			for (const std::pair<char, Character>& c : pair.second.characters) {
-				glDeleteTextures(1, &c.second.texture.textureID);
+
+		// Copy every character's bitmap into its place in the atlas
+		resource.data.assign((size_t)atlasSize.x * atlasSize.y, 0);
+		resource.dimensions = atlasSize;
+		for (char c : order) {
+			const glm::ivec2& dimensions = font.characters[c].texture.dimensions;
+			glm::ivec2 position = positions[c]
+				+ glm::ivec2(ATLAS_PADDING, ATLAS_PADDING);
+			for (int row = 0; row < dimensions.y; row++) {
+				std::memcpy(&resource.data[(size_t)(position.y + row)
+					* atlasSize.x + position.x],
+					&bitmaps[c][(size_t)row * dimensions.x], dimensions.x);
 			}
-			count++;
 		}
-		m_fonts.clear();
-		FT_Done_FreeType(m_freeTypeLibrary);
 
-		MWLOG(Info, ResourceManager, "Deleted ", count, " font character sets ",
-			"from OpenGL");
-	}
+		// Point every character at its rectangle in the atlas so text in this
+		// font can be drawn with a single texture
+		glm::vec2 size = glm::vec2((float)atlasSize.x, (float)atlasSize.y);
+		for (std::pair<const char, Character>& pair : font.characters) {
+			Texture& texture = pair.second.texture;
+			glm::ivec2 position = positions[pair.first]
+				+ glm::ivec2(ATLAS_PADDING, ATLAS_PADDING);
+			texture.textureCoords = glm::vec4((float)position.x / size.x,
+				(float)position.y / size.y,
+				(float)texture.dimensions.x / size.x,
+				(float)texture.dimensions.y / size.y);
+		}
+
+		MWLOG(Info, ResourceManager, "Packed ", order.size(), " characters ",
+			"of font ", fileName, " into a ", atlasSize.x, "x", atlasSize.y,
+			" atlas");
 
-	std::int32_t ResourceManager::toInt(char* buffer, std::size_t len) {
-		std::int32_t a = 0;
-		std::memcpy(&a, buffer, len);
-		return a;
+		return true;
 	}
 
-	bool ResourceManager::loadWAVHeader(std::ifstream& file,
-		std::uint8_t& channels, std::int32_t& sampleRate,
-		std::uint8_t& bitsPerSample, ALsizei& size) {
-		char buffer[4];
-		if (!file.is_open()) {
-			MWLOG(Warning, ResourceManager, "Failed to open WAV file header");
-			return false;
+	Font* ResourceManager::uploadFont(DecodedResource& resource) {
+		std::unordered_map<std::string, Font>::iterator it
+			= m_fonts.find(resource.name);
+		if (it != m_fonts.end()) {
+			return &it->second;
 		}
 
-		// Check the "RIFF" header (chunkID)
-		if (!file.read(buffer, 4)) {
-			MWLOG(Warning, ResourceManager, "Failed to read RIFF");
-			return false;
-		}
-		if (std::strncmp(buffer, "RIFF", 4) != 0) {
-			MWLOG(Warning, ResourceManager, "File is in invalid WAVE format");
-			return false;
+		// Upload the atlas to OpenGL
+		Font& font = resource.font;
+		glGenTextures(1, &font.textureID);
+		glBindTexture(GL_TEXTURE_2D, font.textureID);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, resource.dimensions.x,
+			resource.dimensions.y, 0, GL_RED, GL_UNSIGNED_BYTE,
+			resource.getBytes());
+		glBindTexture(GL_TEXTURE_2D, 0);
+		for (std::pair<const char, Character>& pair : font.characters) {
+			pair.second.texture.textureID = font.textureID;
 		}
 
-		// Discard the size of the file (chunkSize)
-		if (!file.read(buffer, 4)) {
-			MWLOG(Warning, ResourceManager, "Failed to read file size");
-			return false;
-		}
+		m_fonts[resource.name] = font;
+		return &m_fonts[resource.name];
+	}
 
-		// Check the "WAVE" header (format)
-		if (!file.read(buffer, 4)) {
-			MWLOG(Warning, ResourceManager, "Failed to read WAVE");
-			return false;
+	ResourceHandle<Texture> ResourceManager::loadTexture(
+		const std::string& fileName) {
+		ResourceHandle<Texture> handle;
+		std::unordered_map<std::string, Texture>::iterator it
+			= m_textures.find(fileName);
+		if (it != m_textures.end()) {
+			// The texture is already present in memory
+			handle.m_state->done = true;
+			handle.m_state->resource = &it->second;
+			return handle;
 		}
-		if (std::strncmp(buffer, "WAVE", 4) != 0) {
-			MWLOG(Warning, ResourceManager, "File is in invalid WAVE format");
-			return false;
+		std::unordered_map<std::string, std::shared_ptr<
+			ResourceHandle<Texture>::State>>::iterator pending
+			= m_pendingTextures.find(fileName);
+		if (pending != m_pendingTextures.end()) {
+			// The texture is already loading, share its progress
+			handle.m_state = pending->second;
+			return handle;
 		}
 
-		// Check the "fmt" header (subchunk1ID)
-		if (!file.read(buffer, 4)) {
-			MWLOG(Warning, ResourceManager, "Failed to read fmt");
-			return false;
+		m_pendingTextures[fileName] = handle.m_state;
+		DecodedResource resource;
+		resource.type = ResourceType::TEXTURE;
+		resource.fileName = fileName;
+		resource.name = fileName;
+		queueLoad(std::move(resource));
+		return handle;
+	}
+
+	ResourceHandle<Sound> ResourceManager::loadSound(
+		const std::string& fileName) {
+		ResourceHandle<Sound> handle;
+		std::unordered_map<std::string, Sound>::iterator it
+			= m_sounds.find(fileName);
+		if (it != m_sounds.end()) {
+			// The sound is already present in memory
+			handle.m_state->done = true;
+			handle.m_state->resource = &it->second;
+			return handle;
 		}
-		if (std::strncmp(buffer, "fmt", 3) != 0) {
-			MWLOG(Warning, ResourceManager, "File is in invalid WAVE format");
-			return false;
+		std::unordered_map<std::string, std::shared_ptr<
+			ResourceHandle<Sound>::State>>::iterator pending
+			= m_pendingSounds.find(fileName);
+		if (pending != m_pendingSounds.end()) {
+			// The sound is already loading, share its progress
+			handle.m_state = pending->second;
+			return handle;
 		}
 
-		// Discard the size of the format chunk (subchunk1Size)
-		if (!file.read(buffer, 4)) {
-			MWLOG(Warning, ResourceManager, "Failed to read format chunk size");
-			return false;
-		}
+		m_pendingSounds[fileName] = handle.m_state;
+		DecodedResource resource;
+		resource.type = ResourceType::SOUND;
+		resource.fileName = fileName;
+		resource.name = fileName;
+		queueLoad(std::move(resource));
+		return handle;
+	}
 
-		// Discard the audio format which should be 1 for PCM (audioFormat)
-		if (!file.read(buffer, 2)) {
-			MWLOG(Warning, ResourceManager, "Failed to read audio format");
-			return false;
+	ResourceHandle<Font> ResourceManager::loadFont(
+		const std::string& fileName) {
+		ResourceHandle<Font> handle;
+		std::string fontName = fileName + ":"
+			+ std::to_string(m_fontPointSize);
+		if (!m_fontLoadingEnabled && !isPacked(fontName)) {
+			MWLOG(Warning, ResourceManager, "Failed to load font ", fileName,
+				" because font loading is disabled");
+			handle.m_state->done = true;
+			return handle;
 		}
-
-		// Get the number of channels (numChannels)
-		if (!file.read(buffer, 2)) {
-			MWLOG(Warning, ResourceManager, "Failed to read channel count");
-			return false;
+		std::unordered_map<std::string, Font>::iterator it
+			= m_fonts.find(fontName);
+		if (it != m_fonts.end()) {
+			// The font is already present in memory
+			handle.m_state->done = true;
+			handle.m_state->resource = &it->second;
+			return handle;
+		}
+		std::unordered_map<std::string, std::shared_ptr<
+			ResourceHandle<Font>::State>>::iterator pending
+			= m_pendingFonts.find(fontName);
+		if (pending != m_pendingFonts.end()) {
+			// The font is already loading, share its progress
+			handle.m_state = pending->second;
+			return handle;
 		}
-		channels = toInt(buffer, 2);
 
-		// Get the sample rate (sampleRate)
-		if (!file.read(buffer, 4)) {
-			MWLOG(Warning, ResourceManager, "Failed to read the sample rate");
-			return false;
+		m_pendingFonts[fontName] = handle.m_state;
+		DecodedResource resource;
+		resource.type = ResourceType::FONT;
+		resource.fileName = fileName;
+		resource.name = fontName;
+		resource.pointSize = m_fontPointSize;
+		queueLoad(std::move(resource));
+		return handle;
+	}
+
+	void ResourceManager::update() {
+		size_t uploaded = 0;
+		unsigned int count = 0;
+		while (true) {
+			// Take the next decoded resource, always uploading at least one
+			// so large resources still finish
+			DecodedResource resource;
+			{
+				std::lock_guard<std::mutex> lock(m_uploadQueueMtx);
+				if (m_uploadQueue.empty()
+					|| (count > 0 && uploaded >= m_uploadBudget)) {
+					break;
+				}
+				resource = std::move(m_uploadQueue.front());
+				m_uploadQueue.pop_front();
+			}
+			uploaded += resource.getSize();
+			count++;
+
+			switch (resource.type) {
+			case ResourceType::TEXTURE:
+				finishLoad(m_pendingTextures, resource.name, resource.decoded
+					? uploadTexture(resource) : nullptr);
+				break;
+			case ResourceType::SOUND:
+				finishLoad(m_pendingSounds, resource.name, resource.decoded
+					? uploadSound(resource) : nullptr);
+				break;
+			case ResourceType::FONT:
+				finishLoad(m_pendingFonts, resource.name, resource.decoded
+					? uploadFont(resource) : nullptr);
+				break;
+			}
 		}
-		sampleRate = toInt(buffer, 4);
+	}
 
-		// Discard the byte rate (byteRate)
-		if (!file.read(buffer, 4)) {
-			MWLOG(Warning, ResourceManager, "Failed to read the byte rate");
-			return false;
+	void ResourceManager::queueLoad(DecodedResource&& resource) {
+		if (m_loaders.empty()) {
+			// There are no loader threads, decode the resource now and leave
+			// it to be uploaded with the rest
+			switch (resource.type) {
+			case ResourceType::TEXTURE:
+				resource.decoded = decodeTexture(resource);
+				break;
+			case ResourceType::SOUND:
+				resource.decoded = decodeSound(resource);
+				break;
+			case ResourceType::FONT:
+				resource.decoded = decodeFont(resource);
+				break;
+			}
+			std::lock_guard<std::mutex> lock(m_uploadQueueMtx);
+			m_uploadQueue.push_back(std::move(resource));
+			return;
 		}
 
-		// Discard the block alignment (blockAlign)
-		if (!file.read(buffer, 2)) {
-			MWLOG(Warning, ResourceManager, "Failed to read the block ",
-				"alignment");
-			return false;
+		{
+			std::lock_guard<std::mutex> lock(m_loadQueueMtx);
+			m_loadQueue.push_back(std::move(resource));
 		}
+		m_loadQueueCV.notify_one();
+	}
 
-		// Get the bits in each sample (bitsPerSample)
-		if (!file.read(buffer, 2)) {
-			MWLOG(Warning, ResourceManager, "Failed to read the bit count of ",
-				"each audio sample");
-			return false;
+	void ResourceManager::runLoader() {
+		while (true) {
+			// Wait for a resource to load or for the loaders to be stopped
+			DecodedResource resource;
+			{
+				std::unique_lock<std::mutex> lock(m_loadQueueMtx);
+				m_loadQueueCV.wait(lock, [this]() {
+					return m_stopLoaders || !m_loadQueue.empty();
+				});
+				if (m_stopLoaders) {
+					return;
+				}
+				resource = std::move(m_loadQueue.front());
+				m_loadQueue.pop_front();
+			}
+
+			switch (resource.type) {
+			case ResourceType::TEXTURE:
+				resource.decoded = decodeTexture(resource);
+				break;
+			case ResourceType::SOUND:
+				resource.decoded = decodeSound(resource);
+				break;
+			case ResourceType::FONT:
+				resource.decoded = decodeFont(resource);
+				break;
+			}
+
+			std::lock_guard<std::mutex> lock(m_uploadQueueMtx);
+			m_uploadQueue.push_back(std::move(resource));
 		}
-		bitsPerSample = toInt(buffer, 2);
+	}
 
-		// Check the "data" header (subchunk2ID)
-		if (!file.read(buffer, 4)) {
-			MWLOG(Warning, ResourceManager, "Failed to read the data header");
-			return false;
+	void ResourceManager::destroy() {
+		MWLOG(Info, ResourceManager, "Destroying resources loading from disk");
+
+		// Stop the loader threads and abandon the loads not done yet
+		{
+			std::lock_guard<std::mutex> lock(m_loadQueueMtx);
+			m_stopLoaders = true;
 		}
-		if (std::strncmp(buffer, "data", 4) != 0) {
-			MWLOG(Warning, ResourceManager, "File is in invalid WAVE format");
-			return false;
+		m_loadQueueCV.notify_all();
+		for (std::thread& loader : m_loaders) {
+			loader.join();
 		}
+		m_loaders.clear();
+		m_loadQueue.clear();
+		m_uploadQueue.clear();
+		m_pendingTextures.clear();
+		m_pendingSounds.clear();
+		m_pendingFonts.clear();
 
-		// Get the size of the audio data (subchunk2Size)
-		if (!file.read(buffer, 4)) {
-			MWLOG(Warning, ResourceManager, "Failed to read the size of the ",
-				"audio data");
-			return false;
-		}
-		size = toInt(buffer, 4);
+		// Nothing refers to the packs' data now the loads are abandoned
+		m_packs.clear();
 
-		if (file.eof()) {
-			MWLOG(Warning, ResourceManager, "File contains no audio data");
-			return false;
+		int count = 0;
+		// Delete all of the textures loaded into memory from OpenGL, leaving
+		// those packed into the atlas to be deleted with their pages
+		for (std::pair<std::string, Texture> pair : m_textures) {
+			bool packed = false;
+			for (const AtlasPage& page : m_atlasPages) {
+				if (page.textureID == pair.second.textureID) {
+					packed = true;
+					break;
+				}
+			}
+			if (!packed) {
+				glDeleteTextures(1, &pair.second.textureID);
+			}
+			count++;
 		}
-		if (file.fail()) {
-			//MW::LOG << "File could not be read further\n";
-			MWLOG(Warning, ResourceManager, "Failed to read audio file past ",
-				"header data");
-			return false;
+		m_textures.clear();
+		for (AtlasPage& page : m_atlasPages) {
+			glDeleteTextures(1, &page.textureID);
 		}
+		m_atlasPages.clear();
 
-		return true;
-	}
+		MWLOG(Info, ResourceManager, "Deleted ", count, " textures from ",
+			"OpenGL");
 
-	char* ResourceManager::loadWAV(const std::string& fileName,
-		std::uint8_t& channels, std::int32_t& sampleRate,
-		std::uint8_t& bitsPerSample, ALsizei& size) {
-		std::ifstream in(fileName, std::ios::binary);
-		if (!in.is_open()) {
-			MWLOG(Warning, ResourceManager, "Failed to open file ", fileName);
-			return nullptr;
+		count = 0;
+		// Delete all the sounds loaded into memory from OpenAL
+		for (std::pair<std::string, Sound> pair : m_sounds) {
+			alDeleteBuffers(1, &pair.second.soundID);
+			count++;
 		}
-		if (!loadWAVHeader(in, channels, sampleRate, bitsPerSample, size)) {
-			MWLOG(Warning, ResourceManager, "Failed to read file header for ",
-				fileName);
-			return nullptr;
+		m_sounds.clear();
+
+		MWLOG(Info, ResourceManager, "Deleted ", count, " sound buffers from ",
+			"OpenAL");
+
+		count = 0;
+		// Delete all fonts loaded into memory and dispose of the FreeType lib
+		for (const std::pair<std::string, Font>& pair : m_fonts) {
+			glDeleteTextures(1, &pair.second.textureID);
+			count++;
+		}
+		m_fonts.clear();
+		if (m_fontLoadingEnabled) {
+			FT_Done_FreeType(m_freeTypeLibrary);
+			m_fontLoadingEnabled = false;
 		}
 
-		char* data = new char[size];
-		in.read(data, size);
-		in.close();
-		return data;
+		MWLOG(Info, ResourceManager, "Deleted ", count, " font character sets ",
+			"from OpenGL");
 	}
 }
\ No newline at end of file
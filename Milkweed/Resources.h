@@ -12,20 +12,17 @@
 #include <string>
 #include <unordered_map>
 #include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 #include <AL/al.h>
 #include <ft2build.h>
 #include <freetype/freetype.h>
 
 #include "Sprite.h"
-
-/*
-* The decodePNG function is found in picoPNG.cpp, all documentation for it and
-* copyright information can be found at the top of the picoPNG.cpp file or in
-* the Deps/license/picoPNG/ directory of this project
-*/
-extern int decodePNG(std::vector<unsigned char>& out_image,
-	unsigned long& image_width, unsigned long& image_height,
-	const unsigned char* in_png, size_t in_size, bool convert_to_rgba32 = true);
+#include "AssetPack.h"
 
 namespace Milkweed {
 	/*
@@ -36,11 +33,16 @@ namespace Milkweed {
 		GLuint textureID = 0;
 		// The dimensions of this texture in pixels
 		glm::ivec2 dimensions = glm::ivec2();
+		// The rectangle (x, y, width, height) this texture occupies within
+		// its OpenGL texture in texture space, smaller than the whole texture
+		// if this texture was packed into an atlas page
+		glm::vec4 textureCoords = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
 
 		/*
 		* Make a blank texture with no ID, width, or height
 		*/
-		Texture() : textureID(0), dimensions(glm::ivec2()) {}
+		Texture() : textureID(0), dimensions(glm::ivec2()),
+			textureCoords(glm::vec4(0.0f, 0.0f, 1.0f, 1.0f)) {}
 		/*
 		* Make a texture with the given ID, width, and height
 		* 
@@ -48,7 +50,80 @@ namespace Milkweed {
 		* @param dimensions: The dimensions of this texture in pixels
 		*/
 		Texture(GLuint TextureID, const glm::ivec2& Dimensions) :
-			textureID(TextureID), dimensions(Dimensions) {}
+			textureID(TextureID), dimensions(Dimensions),
+			textureCoords(glm::vec4(0.0f, 0.0f, 1.0f, 1.0f)) {}
+		/*
+		* Make a texture occupying a sub-rectangle of the given OpenGL texture
+		* 
+		* @param textureID: The ID number of the OpenGL texture containing
+		* this texture
+		* @param dimensions: The dimensions of this texture in pixels
+		* @param textureCoords: The rectangle this texture occupies in the
+		* OpenGL texture in texture space
+		*/
+		Texture(GLuint TextureID, const glm::ivec2& Dimensions,
+			const glm::vec4& TextureCoords) : textureID(TextureID),
+			dimensions(Dimensions), textureCoords(TextureCoords) {}
+	};
+
+	/*
+	* A rectangle bin packer which places rectangles into a fixed-size page
+	* using the skyline bottom-left heuristic
+	*/
+	class AtlasPacker {
+	public:
+		/*
+		* Prepare this packer to place rectangles into an empty page
+		* 
+		* @param dimensions: The dimensions of the page in pixels
+		*/
+		void init(const glm::ivec2& dimensions);
+		/*
+		* Find a place for a rectangle in this packer's page and reserve it
+		* 
+		* @param dimensions: The dimensions of the rectangle in pixels
+		* @param position: Set to the corner of the reserved space nearest to
+		* the page's origin
+		* @return Whether there was room for the rectangle in this page
+		*/
+		bool pack(const glm::ivec2& dimensions, glm::ivec2& position);
+		/*
+		* Get the dimensions of this packer's page in pixels
+		*/
+		const glm::ivec2& getDimensions() const { return m_dimensions; }
+
+	private:
+		/*
+		* A horizontal segment of the skyline of packed rectangles
+		*/
+		struct Segment {
+			int x = 0, y = 0, width = 0;
+		};
+
+		// The dimensions of the page in pixels
+		glm::ivec2 m_dimensions = glm::ivec2();
+		// The segments of the skyline ordered from left to right
+		std::vector<Segment> m_skyline;
+
+		/*
+		* Test whether a rectangle fits with its left edge on a segment
+		* 
+		* @param index: The index of the segment to place the rectangle on
+		* @param dimensions: The dimensions of the rectangle in pixels
+		* @param y: Set to the lowest y the rectangle can be placed at
+		* @return Whether the rectangle fits in the page at this segment
+		*/
+		bool fits(unsigned int index, const glm::ivec2& dimensions, int& y);
+	};
+
+	/*
+	* A single OpenGL texture which many textures are packed into
+	*/
+	struct AtlasPage {
+		// The OpenGL ID of this page's texture
+		GLuint textureID = 0;
+		// The packer tracking the free space in this page
+		AtlasPacker packer;
 	};
 
 	/*
@@ -104,6 +179,52 @@ namespace Milkweed {
 	struct Font {
 		std::map<char, Character> characters;
 		float maxCharacterHeight = 0.0f, minCharacterHeight = 0.0f;
+		// The OpenGL ID of the atlas texture all of this font's characters
+		// are packed into
+		GLuint textureID = 0;
+		// The point size this font was loaded at
+		unsigned int pointSize = 0;
+	};
+
+	/*
+	* A resource being loaded in the background by a ResourceManager, which
+	* can be checked each frame until the load is done
+	*/
+	template <typename T>
+	class ResourceHandle {
+	public:
+		/*
+		* Make a handle to a load which has not finished
+		*/
+		ResourceHandle() : m_state(std::make_shared<State>()) {}
+		/*
+		* Test whether the load has finished, successfully or not
+		*/
+		bool isDone() const { return m_state->done; }
+		/*
+		* Get the loaded resource
+		*
+		* @return The resource, nullptr if it is still loading or could not be
+		* loaded
+		*/
+		T* get() const { return m_state->resource; }
+
+	private:
+		// Let the resource manager finish loads
+		friend class ResourceManager;
+
+		/*
+		* The progress of a load, shared by every handle to it
+		*/
+		struct State {
+			// Whether the load has finished
+			bool done = false;
+			// The resource once it has been loaded
+			T* resource = nullptr;
+		};
+
+		// The progress of this handle's load
+		std::shared_ptr<State> m_state;
 	};
 
 	/*
@@ -125,8 +246,37 @@ namespace Milkweed {
 
 		/*
 		* Prepare this resource manager to load textures, sounds, and fonts
+		*
+		* @param loaderCount: The number of threads to read and decode
+		* resources loaded in the background on (2 by default)
+		*/
+		void init(unsigned int loaderCount = 2);
+		/*
+		* Mount an asset pack, so the resources in it are read from the pack
+		* instead of from their files on disk
+		*
+		* Packs are looked up by the name a resource is loaded with, its file
+		* name or for fonts its file name and point size. Packs mounted later
+		* take precedence over earlier ones. Mount packs before loading
+		* resources, not while loads are running in the background
+		*
+		* @param fileName: The file name of the pack on disk
+		* @return Whether the pack could be opened
+		*/
+		bool mountPack(const std::string& fileName);
+		/*
+		* Decode resources from their files on disk and write them into an
+		* asset pack which can be mounted with mountPack()
+		*
+		* @param packFileName: The file name to write the pack to
+		* @param fileNames: The file names of the PNG textures, WAV, FLAC and
+		* Ogg Vorbis sounds and TTF fonts to pack
+		* @param fontPointSizes: The point sizes to pack each font at
+		* @return Whether every resource was decoded and the pack was written
 		*/
-		void init();
+		bool buildPack(const std::string& packFileName,
+			const std::vector<std::string>& fileNames,
+			const std::vector<unsigned int>& fontPointSizes);
 		/*
 		* Get a PNG texture from memory or the disk
 		*
@@ -136,7 +286,8 @@ namespace Milkweed {
 		*/
 		Texture* getTexture(const std::string& fileName);
 		/*
-		* Get a WAV sound from memory or the disk
+		* Get a WAV, FLAC or Ogg Vorbis sound from memory or the disk, decoded
+		* into PCM samples
 		*
 		* @param fileName: The file name of this sound on disk
 		* @return The sound either from memory or the disk if found, nullptr
@@ -144,7 +295,8 @@ namespace Milkweed {
 		*/
 		Sound* getSound(const std::string& fileName);
 		/*
-		* Get a font from memory or the disk
+		* Get a font at the current font point size from memory or the disk,
+		* with all of its characters packed into a single texture
 		*
 		* @param fileName: The file name of this TTF font on disk
 		* @return The font either from memory or the disk if found, nullptr
@@ -152,6 +304,61 @@ namespace Milkweed {
 		*/
 		Font* getFont(const std::string& fileName);
 		/*
+		* Start loading a PNG texture in the background, its file is read and
+		* decoded on a loader thread and it is uploaded to OpenGL by update()
+		*
+		* Getting the texture with getTexture() before the load is done loads
+		* it straight away instead
+		*
+		* @param fileName: The file name of the texture on disk
+		* @return A handle to the texture, done straight away if it is already
+		* in memory
+		*/
+		ResourceHandle<Texture> loadTexture(const std::string& fileName);
+		/*
+		* Start loading a WAV, FLAC or Ogg Vorbis sound in the background, like
+		* loadTexture(), decoding it on a loader thread
+		*
+		* @param fileName: The file name of the sound on disk
+		* @return A handle to the sound
+		*/
+		ResourceHandle<Sound> loadSound(const std::string& fileName);
+		/*
+		* Start loading a font at the current font point size in the
+		* background, like loadTexture()
+		*
+		* @param fileName: The file name of the TTF font on disk
+		* @return A handle to the font
+		*/
+		ResourceHandle<Font> loadFont(const std::string& fileName);
+		/*
+		* Upload the resources finished by the loader threads to OpenGL and
+		* OpenAL, on the thread which owns the OpenGL context once per frame
+		*
+		* Stops once the upload budget has been spent, leaving the rest for
+		* the next frames
+		*/
+		void update();
+		/*
+		* Get the number of background loads which are not done yet
+		*/
+		unsigned int getLoadingCount() const {
+			return (unsigned int)(m_pendingTextures.size()
+				+ m_pendingSounds.size() + m_pendingFonts.size());
+		}
+		/*
+		* Get the most bytes of finished resources update() uploads in one
+		* frame
+		*/
+		size_t getUploadBudget() const { return m_uploadBudget; }
+		/*
+		* Set the most bytes of finished resources update() uploads in one
+		* frame, at least one resource is always uploaded
+		*/
+		void setUploadBudget(size_t uploadBudget) {
+			m_uploadBudget = uploadBudget;
+		}
+		/*
 		* Test whether this resource manager can load TTF files
 		*/
 		bool isFontLoadingEnabled() const { return m_fontLoadingEnabled; }
@@ -166,6 +373,36 @@ namespace Milkweed {
 			m_fontPointSize = fontPointSize;
 		}
 		/*
+		* Test whether textures are packed into shared atlas pages when loaded
+		*/
+		bool isAtlasEnabled() const { return m_atlasEnabled; }
+		/*
+		* Set whether textures loaded from now on are packed into shared atlas
+		* pages, allowing sprites with different textures to be drawn together
+		* 
+		* Textures in an atlas page cannot repeat, texture coordinates outside
+		* of 0 to 1 will sample neighbouring textures
+		*/
+		void setAtlasEnabled(bool atlasEnabled) {
+			m_atlasEnabled = atlasEnabled;
+		}
+		/*
+		* Get the dimensions of new atlas pages in pixels
+		*/
+		const glm::ivec2& getAtlasPageSize() const { return m_atlasPageSize; }
+		/*
+		* Set the dimensions of atlas pages created from now on in pixels
+		*/
+		void setAtlasPageSize(const glm::ivec2& atlasPageSize) {
+			m_atlasPageSize = atlasPageSize;
+		}
+		/*
+		* Get the number of atlas pages textures have been packed into
+		*/
+		unsigned int getAtlasPageCount() const {
+			return (unsigned int)m_atlasPages.size();
+		}
+		/*
 		* Delete all resources loaded into memory by this resource manager
 		*/
 		void destroy();
@@ -182,7 +419,8 @@ namespace Milkweed {
 		std::unordered_map<std::string, Texture> m_textures;
 		// The map of sounds in memory with their file names on disk
 		std::unordered_map<std::string, Sound> m_sounds;
-		// The map of fonts in memory with their file names on disk
+		// The map of fonts in memory with their file names on disk and point
+		// sizes
 		std::unordered_map<std::string, Font> m_fonts;
 		// The instance of the FreeType library to load fonts with
 		FT_Library m_freeTypeLibrary = nullptr;
@@ -190,23 +428,167 @@ namespace Milkweed {
 		bool m_fontLoadingEnabled = false;
 		// The default point size of fonts
 		FT_UInt m_fontPointSize = 48;
+		// The asset packs mounted, in the order they were mounted
+		std::vector<std::unique_ptr<AssetPack>> m_packs;
+		// The pages of the texture atlas
+		std::vector<AtlasPage> m_atlasPages;
+		// Whether textures are packed into the atlas when loaded
+		bool m_atlasEnabled = false;
+		// The dimensions of new atlas pages in pixels
+		glm::ivec2 m_atlasPageSize = glm::ivec2(2048, 2048);
+		// The empty border in pixels left around each texture in the atlas to
+		// keep neighbours from bleeding into each other
+		const static int ATLAS_PADDING = 1;
+		// The largest dimension of a font's character atlas in pixels
+		const static int MAX_FONT_ATLAS_SIZE = 8192;
 
 		/*
-		* Convert a char* buffer to little-endian integer
+		* The kinds of resource which can be loaded in the background
+		*/
+		enum class ResourceType {
+			TEXTURE,
+			SOUND,
+			FONT,
+		};
+		/*
+		* A resource read from the disk and decoded, ready to upload to OpenGL
+		* or OpenAL
+		*/
+		struct DecodedResource {
+			// The kind of resource
+			ResourceType type = ResourceType::TEXTURE;
+			// The file name of the resource on disk
+			std::string fileName;
+			// The name of the resource in its map
+			std::string name;
+			// The point size to load a font at
+			unsigned int pointSize = 0;
+			// Whether the resource was decoded
+			bool decoded = false;
+			// The RGBA pixels of a texture, the one byte pixels of a font's
+			// atlas or the samples of a sound
+			std::vector<unsigned char> data;
+			// The dimensions of a texture or a font's atlas in pixels
+			glm::ivec2 dimensions = glm::ivec2();
+			// The OpenAL format and sample rate of a sound
+			ALenum format = 0;
+			ALsizei sampleRate = 0;
+			// A font's characters, pointed at its atlas once uploaded
+			Font font;
+			// The data of a resource read from a mounted asset pack, used in
+			// place of data without being copied
+			const unsigned char* mapped = nullptr;
+			size_t mappedSize = 0;
+
+			/*
+			* Get the pixels or samples of this resource
+			*/
+			const unsigned char* getBytes() const {
+				return mapped != nullptr ? mapped : data.data();
+			}
+			/*
+			* Get the size of this resource's pixels or samples in bytes
+			*/
+			size_t getSize() const {
+				return mapped != nullptr ? mappedSize : data.size();
+			}
+		};
+
+		// The threads which decode resources loaded in the background
+		std::vector<std::thread> m_loaders;
+		// The resources waiting for a loader thread
+		std::deque<DecodedResource> m_loadQueue;
+		std::mutex m_loadQueueMtx;
+		std::condition_variable m_loadQueueCV;
+		// Whether the loader threads should stop
+		bool m_stopLoaders = false;
+		// The resources decoded by the loader threads waiting to be uploaded
+		std::deque<DecodedResource> m_uploadQueue;
+		std::mutex m_uploadQueueMtx;
+		// The most bytes of resources to upload in one frame
+		size_t m_uploadBudget = 4 * 1024 * 1024;
+		// The progress of the background loads not done yet, by name
+		std::unordered_map<std::string,
+			std::shared_ptr<ResourceHandle<Texture>::State>> m_pendingTextures;
+		std::unordered_map<std::string,
+			std::shared_ptr<ResourceHandle<Sound>::State>> m_pendingSounds;
+		std::unordered_map<std::string,
+			std::shared_ptr<ResourceHandle<Font>::State>> m_pendingFonts;
+		// Guards the FreeType library, which can't load two fonts at once
+		std::mutex m_freeTypeMtx;
+
+		/*
+		* Read and decode resources until the loader threads are stopped
+		*/
+		void runLoader();
+		/*
+		* Hand a resource to the loader threads, or decode it straight away
+		* if there are none
+		*/
+		void queueLoad(DecodedResource&& resource);
+		/*
+		* Read a resource from the disk and decode it, on any thread
+		*
+		* @param resource: The resource to decode, with its type, file name,
+		* name and point size set
+		* @return Whether the resource was decoded
+		*/
+		bool decodeTexture(DecodedResource& resource);
+		bool decodeSound(DecodedResource& resource);
+		bool decodeFont(DecodedResource& resource);
+		/*
+		* Find a resource in the mounted asset packs and point it at its data
+		* in the pack, on any thread
+		*
+		* @param resource: The resource to find, with its type and name set
+		* @return Whether the resource was found in a pack
 		*/
-		std::int32_t toInt(char* buffer, std::size_t len);
+		bool readPacked(DecodedResource& resource);
 		/*
-		* Load the header information of a WAVE audio file
+		* Test whether a resource is in any of the mounted asset packs
 		*/
-		bool loadWAVHeader(std::ifstream& file, std::uint8_t& channels,
-			std::int32_t& sampleRate, std::uint8_t& bitsPerSample,
-			ALsizei& size);
+		bool isPacked(const std::string& name) const;
 		/*
-		* Load a WAVE audio file
+		* Upload a decoded resource and add it to its map, on the OpenGL
+		* context's thread
+		*
+		* @param resource: The decoded resource
+		* @return The resource in memory, the one already there if it was
+		* loaded some other way in the meantime
+		*/
+		Texture* uploadTexture(DecodedResource& resource);
+		Sound* uploadSound(DecodedResource& resource);
+		Font* uploadFont(DecodedResource& resource);
+		/*
+		* Mark a background load as done for every handle to it
+		*/
+		template <typename T>
+		void finishLoad(std::unordered_map<std::string,
+			std::shared_ptr<typename ResourceHandle<T>::State>>& pending,
+			const std::string& name, T* resource) {
+			typename std::unordered_map<std::string, std::shared_ptr<
+				typename ResourceHandle<T>::State>>::iterator it
+				= pending.find(name);
+			if (it == pending.end()) {
+				return;
+			}
+			it->second->done = true;
+			it->second->resource = resource;
+			pending.erase(it);
+		}
+
+		/*
+		* Pack decoded RGBA image data into the first atlas page with room for
+		* it, creating a new page if none have room
+		* 
+		* @param data: The RGBA pixels of the image
+		* @param dimensions: The dimensions of the image in pixels
+		* @param texture: Set to the texture referring to the packed image
+		* @return Whether the image could be packed, false if it is larger than
+		* a page
 		*/
-		char* loadWAV(const std::string& fileName, std::uint8_t& channels,
-			std::int32_t& sampleRate, std::uint8_t& bitsPerSample,
-			ALsizei& size);
+		bool packTexture(const unsigned char* data,
+			const glm::ivec2& dimensions, Texture& texture);
 	};
 }
 
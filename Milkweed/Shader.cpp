@@ -85,8 +85,13 @@ namespace Milkweed {
 
 		// Add all the vertex attributes to the program
 		m_attributeCount = (unsigned int)attributes.size();
+		m_attributes = attributes;
+		m_instanced = false;
 		glUseProgram(m_programID);
 		for (VertexAttribute attribute : attributes) {
+			if (attribute.m_divisor != 0) {
+				m_instanced = true;
+			}
 			GLint position = glGetAttribLocation(m_programID,
 				attribute.m_name.c_str());
 			glVertexAttribPointer(position, attribute.m_componentCount,
@@ -97,6 +102,21 @@ namespace Milkweed {
 		return true;
 	}
 
+	void Shader::bindVertexAttributes(GLintptr offset) {
+		for (const VertexAttribute& attribute : m_attributes) {
+			GLint position = glGetAttribLocation(m_programID,
+				attribute.m_name.c_str());
+			if (position == -1) {
+				continue;
+			}
+			glVertexAttribPointer(position, attribute.m_componentCount,
+				attribute.m_type, attribute.m_normalized, attribute.m_stride,
+				(void*)(offset + attribute.m_offset));
+			glVertexAttribDivisor(position, attribute.m_divisor);
+			glEnableVertexAttribArray(position);
+		}
+	}
+
 	void Shader::begin() {
 		// Tell OpenGL to use this shader and enable vertex attributes
 		glUseProgram(m_programID);
@@ -28,12 +28,15 @@ namespace Milkweed {
 		* attribute in the VAO passed to the shader
 		* @param offset: The number of bytes before the first instance of this
 		* attribute in the VAO
+		* @param divisor: The number of instances drawn before this attribute
+		* advances, 0 if it advances every vertex
 		*/
 		VertexAttribute(const std::string& name, unsigned int componentCount,
 			int type, bool normalized, unsigned int stride,
-			unsigned int offset) : m_name(name), m_componentCount(componentCount),
-			m_type(type), m_normalized(normalized), m_stride(stride),
-			m_offset(offset) {}
+			unsigned int offset, unsigned int divisor = 0) : m_name(name),
+			m_componentCount(componentCount), m_type(type),
+			m_normalized(normalized), m_stride(stride), m_offset(offset),
+			m_divisor(divisor) {}
 
 	private:
 		friend class Shader;
@@ -52,6 +55,9 @@ namespace Milkweed {
 		// The number of bytes before the first instance of this attribute
 		// in the VAO
 		unsigned int m_offset = 0;
+		// The number of instances drawn before this attribute advances, 0 if
+		// it advances every vertex
+		unsigned int m_divisor = 0;
 	};
 
 	/*
@@ -78,6 +84,37 @@ namespace Milkweed {
 			};
 		}
 		/*
+		* Generated vertex attributes for an instanced 2D sprite shader, read
+		* once per sprite and expanded into a quad in the vertex shader (3D
+		* position, 2D size, rotation in radians, texture coordinate rectangle
+		* and flip bits, 1 for horizontal and 2 for vertical)
+		* 
+		* @param positionName: The name of the position input in this shader
+		* @param sizeName: The name of the size input in this shader
+		* @param rotationName: The name of the rotation input in this shader
+		* @param textureRectName: The name of the texture coordinate rectangle
+		* input in this shader
+		* @param flipName: The name of the flip bits input in this shader
+		*/
+		static std::vector<VertexAttribute> getInstancedVertexAttributes(
+			const std::string& positionName, const std::string& sizeName,
+			const std::string& rotationName,
+			const std::string& textureRectName,
+			const std::string& flipName) {
+			return {
+				VertexAttribute(positionName, 3, GL_FLOAT, GL_FALSE,
+					11 * sizeof(float), 0, 1),
+				VertexAttribute(sizeName, 2, GL_FLOAT, GL_FALSE,
+					11 * sizeof(float), 3 * sizeof(float), 1),
+				VertexAttribute(rotationName, 1, GL_FLOAT, GL_FALSE,
+					11 * sizeof(float), 5 * sizeof(float), 1),
+				VertexAttribute(textureRectName, 4, GL_FLOAT, GL_FALSE,
+					11 * sizeof(float), 6 * sizeof(float), 1),
+				VertexAttribute(flipName, 1, GL_FLOAT, GL_FALSE,
+					11 * sizeof(float), 10 * sizeof(float), 1),
+			};
+		}
+		/*
 		* Locate this shader's GLSL source code, compile it, and create this
 		* shader with OpenGL
 		* 
@@ -96,6 +133,14 @@ namespace Milkweed {
 			const std::vector<VertexAttribute>& attributes,
 			const std::string& cameraUniformName, Camera* camera);
 		/*
+		* Point this shader's vertex attributes at the bound array buffer and
+		* enable them in the bound vertex array
+		* 
+		* @param offset: The number of bytes to skip at the start of the
+		* buffer, 0 by default
+		*/
+		void bindVertexAttributes(GLintptr offset = 0);
+		/*
 		* Use this shader to draw graphics
 		*/
 		void begin();
@@ -163,6 +208,11 @@ namespace Milkweed {
 		* Set this shader's camera
 		*/
 		void setCamera(Camera* camera) { m_camera = camera; }
+		/*
+		* Test whether this shader reads one record per sprite instance rather
+		* than four vertices per sprite
+		*/
+		bool isInstanced() const { return m_instanced; }
 
 	private:
 		// The OpenGL ID of the vertex shader
@@ -173,6 +223,10 @@ namespace Milkweed {
 		GLuint m_programID = 0;
 		// The number of attributes this shader uses
 		unsigned int m_attributeCount = 0;
+		// The vertex attributes this shader uses
+		std::vector<VertexAttribute> m_attributes;
+		// Whether this shader's attributes advance once per instance
+		bool m_instanced = false;
 		// The camera this shader gets its projection matrix from
 		Camera* m_camera = nullptr;
 		// The uniform name of the camera's projection matrix in this shader
@@ -4,7 +4,9 @@
 * Created: 2020.11.15
 */
 
-#include "Sprite.h"
+#include <utility>
+
+#include "Resources.h"
 
 #define PI 3.141592f
 
@@ -29,7 +31,7 @@ namespace Milkweed {
 		position.y += (velocity.y * deltaTime);
 	}
 
-	std::vector<float> Sprite::getVertexData() {
+	void Sprite::writeVertexData(float* vertices) {
 		glm::vec3 bl = glm::vec3(position.x, position.y, position.z);
 		glm::vec3 br = glm::vec3(position.x + dimensions.x, position.y,
 			position.z);
@@ -45,40 +47,79 @@ namespace Milkweed {
 			tl = rotatePoint(tl);
 		}
 
-		// Generate the default set of vertex data
-		std::vector<float> vertices = {
-			// Vertex 1
-			// Position
-			bl.x, bl.y, bl.z,
-			// Texture coordinates
-			// 0.0f, 1.0f,
-			textureCoords.x, textureCoords.y + textureCoords.w,
-
-			// Vertex 2
-			// Position
-			br.x, br.y, br.z,
-			// Texture coordinates
-			// 1.0f, 1.0f,
-			textureCoords.x + textureCoords.z, textureCoords.y + textureCoords.w,
-
-			// Vertex 3
-			// Position
-			tr.x, tr.y, tr.z,
-			// Texture coordinates
-			// 1.0f, 0.0f,
-			textureCoords.x + textureCoords.z, textureCoords.y,
-
-			// Vertex 4
-			// Position
-			tl.x, tl.y, tl.z,
-			// Texture coordinates
-			// 0.0f, 0.0f,
-			textureCoords.x, textureCoords.y,
-		};
+		glm::vec4 coords = getAtlasTextureCoords();
+
+		// Write the default set of vertex data
+		// Vertex 1
+		// Position
+		vertices[0] = bl.x;
+		vertices[1] = bl.y;
+		vertices[2] = bl.z;
+		// Texture coordinates
+		// 0.0f, 1.0f,
+		vertices[3] = coords.x;
+		vertices[4] = coords.y + coords.w;
+
+		// Vertex 2
+		// Position
+		vertices[5] = br.x;
+		vertices[6] = br.y;
+		vertices[7] = br.z;
+		// Texture coordinates
+		// 1.0f, 1.0f,
+		vertices[8] = coords.x + coords.z;
+		vertices[9] = coords.y + coords.w;
+
+		// Vertex 3
+		// Position
+		vertices[10] = tr.x;
+		vertices[11] = tr.y;
+		vertices[12] = tr.z;
+		// Texture coordinates
+		// 1.0f, 0.0f,
+		vertices[13] = coords.x + coords.z;
+		vertices[14] = coords.y;
+
+		// Vertex 4
+		// Position
+		vertices[15] = tl.x;
+		vertices[16] = tl.y;
+		vertices[17] = tl.z;
+		// Texture coordinates
+		// 0.0f, 0.0f,
+		vertices[18] = coords.x;
+		vertices[19] = coords.y;
 
 		// Flip vertex positions of needed
-		flip(&vertices);
+		flip(vertices);
+	}
 
+	void Sprite::writeInstanceData(float* instance) {
+		glm::vec4 coords = getAtlasTextureCoords();
+
+		// Position
+		instance[0] = position.x;
+		instance[1] = position.y;
+		instance[2] = position.z;
+		// Size
+		instance[3] = dimensions.x;
+		instance[4] = dimensions.y;
+		// Rotation in radians
+		instance[5] = (rotation % 360 != 0)
+			? (PI / 180.0f) * (float)(rotation % 360) : 0.0f;
+		// Texture coordinates
+		instance[6] = coords.x;
+		instance[7] = coords.y;
+		instance[8] = coords.z;
+		instance[9] = coords.w;
+		// Flip bits
+		instance[10] = (float)((flipHorizontal ? 1 : 0)
+			| (flipVertical ? 2 : 0));
+	}
+
+	std::vector<float> Sprite::getVertexData() {
+		std::vector<float> vertices(VERTEX_FLOATS);
+		writeVertexData(vertices.data());
 		return vertices;
 	}
 
@@ -108,19 +149,31 @@ namespace Milkweed {
 		flipHorizontal = flipVertical = false;
 	}
 
-	void Sprite::flip(std::vector<float>* vertices) {
+	void Sprite::flip(float* vertices) {
 		if (flipHorizontal) {
 			// Flip the positions of the vertices horizontally
-			swapElements(vertices, 3, 8);
-			swapElements(vertices, 13, 18);
+			std::swap(vertices[3], vertices[8]);
+			std::swap(vertices[13], vertices[18]);
 		}
 		if (flipVertical) {
 			// Flip the positions of the vertices vertically
-			swapElements(vertices, 4, 19);
-			swapElements(vertices, 9, 14);
+			std::swap(vertices[4], vertices[19]);
+			std::swap(vertices[9], vertices[14]);
 		}
 	}
 
+	glm::vec4 Sprite::getAtlasTextureCoords() const {
+		// Map this sprite's texture coordinates into the rectangle its texture
+		// occupies, which is only part of the OpenGL texture in an atlas
+		if (texture == nullptr) {
+			return textureCoords;
+		}
+		const glm::vec4& rect = texture->textureCoords;
+		return glm::vec4(rect.x + textureCoords.x * rect.z,
+			rect.y + textureCoords.y * rect.w, textureCoords.z * rect.z,
+			textureCoords.w * rect.w);
+	}
+
 	glm::vec3 Sprite::rotatePoint(const glm::vec3& p) {
 		float angle = (PI / 180.0f) * (float)rotation;
 		glm::vec2 c = glm::vec2(position.x, position.y) + (dimensions / 2.0f);
@@ -129,14 +182,6 @@ namespace Milkweed {
 		return glm::vec3(rx, ry, p.z);
 	}
 
-	void Sprite::swapElements(std::vector<float>* v, unsigned int a,
-		unsigned int b) {
-		// Swap the element of v at a with the element at b
-		float s = v->at(a);
-		v->at(a) = v->at(b);
-		v->at(b) = s;
-	}
-
 	void AnimatedSprite::init(const glm::vec3& position,
 		const glm::vec2& dimensions, Texture* texture,
 		const glm::ivec2& frameDimensions, float frameTime) {
@@ -25,6 +25,10 @@ namespace Milkweed {
 	public:
 		// The indices for a single-quad sprite
 		static std::vector<unsigned int> SPRITE_INDICES;
+		// The number of floats of vertex data making up a single sprite
+		const static unsigned int VERTEX_FLOATS = 20;
+		// The number of floats making up a single sprite's instance record
+		const static unsigned int INSTANCE_FLOATS = 11;
 
 		// The position of this sprite
 		glm::vec3 position = glm::vec3();
@@ -63,11 +67,28 @@ namespace Milkweed {
 		*/
 		virtual void update(float deltaTime);
 		/*
-		* Get the vertex data of this sprite to pass to OpenGL for rendering
+		* Write the vertex data of this sprite to pass to OpenGL for rendering
+		* into a caller-provided array without allocating
+		* 
+		* @param vertices: A pointer to at least VERTEX_FLOATS floats to write
+		* the vertices making up this sprite to
+		*/
+		virtual void writeVertexData(float* vertices);
+		/*
+		* Write the compact instance record of this sprite to pass to an
+		* instanced shader, which expands it into a quad on the GPU
+		* 
+		* @param instance: A pointer to at least INSTANCE_FLOATS floats to
+		* write this sprite's position, size, rotation in radians, texture
+		* coordinate rectangle and flip bits to
+		*/
+		virtual void writeInstanceData(float* instance);
+		/*
+		* Get a copy of the vertex data of this sprite
 		* 
 		* @return The array of vertices making up this sprite
 		*/
-		virtual std::vector<float> getVertexData();
+		std::vector<float> getVertexData();
 		/*
 		* Test if this sprite intersects with another given sprite
 		* 
@@ -87,7 +108,12 @@ namespace Milkweed {
 		* 
 		* @param vertices: The vertex data of the animated or static sprite
 		*/
-		void flip(std::vector<float>* vertices);
+		void flip(float* vertices);
+		/*
+		* Get this sprite's texture coordinates mapped into the rectangle its
+		* texture occupies in its OpenGL texture
+		*/
+		glm::vec4 getAtlasTextureCoords() const;
 		/*
 		* Rotate a point about the center of this sprite
 		* 
@@ -102,12 +128,6 @@ namespace Milkweed {
 		friend Renderer;
 		// The shader currently being used to draw this sprite
 		Shader* m_shader = nullptr;
-
-		/*
-		* Swap the elements of the vector v whose indices are a and b
-		*/
-		void swapElements(std::vector<float>* v, unsigned int a,
-			unsigned int b);
 	};
 
 	/*
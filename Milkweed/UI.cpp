@@ -417,13 +417,15 @@ namespace Milkweed {
 		void TextLabel::draw() {
 			m_parent->getTextShader()->upload3fVector(
 				m_parent->getTextColorUniform(), m_textColor);
-			MW::RENDERER.submit(m_text, m_textPosition, glm::vec4(m_position.x,
+			// Only lay the text out again if it or its placement has changed
+			m_layout.update(m_text, m_textPosition, glm::vec4(m_position.x,
 				m_position.y, m_dimensions.x, m_dimensions.y), m_textScale,
-				m_parent->getFont(), m_parent->getTextShader(), m_hJustification,
-				m_vJustification);
+				m_parent->getFont(), m_hJustification, m_vJustification);
+			MW::RENDERER.submit(&m_layout, m_parent->getTextShader());
 		}
 
 		void TextLabel::destroy() {
+			m_layout.destroy();
 			m_text = "";
 			m_position = glm::vec3();
 			m_dimensions = glm::vec2();
@@ -485,7 +487,7 @@ namespace Milkweed {
 
 		void Button::draw() {
 			MW::RENDERER.submit({ &m_sprite }, m_parent->getSpriteShader());
-			((TextLabel)*this).draw();
+			TextLabel::draw();
 		}
 
 		void Button::processInput() {
@@ -702,7 +704,7 @@ namespace Milkweed {
 		void TextBox::draw() {
 			MW::RENDERER.submit({ &m_sprite, &m_cursor },
 				m_parent->getSpriteShader());
-			((TextLabel)*this).draw();
+			TextLabel::draw();
 		}
 
 #define UI_UPDATE_TIME 10.0f
@@ -972,7 +974,7 @@ namespace Milkweed {
 
 		void Switch::draw() {
 			MW::RENDERER.submit({ &m_sprite }, m_parent->getSpriteShader());
-			((TextLabel)*this).draw();
+			TextLabel::draw();
 		}
 
 		void Switch::processInput() {
@@ -1111,7 +1113,7 @@ namespace Milkweed {
 
 		void Slider::draw() {
 			m_text = m_labelText + ": " + std::to_string(m_value);
-			((TextLabel)*this).draw();
+			TextLabel::draw();
 			MW::RENDERER.submit({ &m_sprite, &m_cursor },
 				m_parent->getSpriteShader());
 		}
@@ -1322,7 +1324,7 @@ namespace Milkweed {
 		}
 
 		void Cycle::draw() {
-			((TextLabel)*this).draw();
+			TextLabel::draw();
 			MW::RENDERER.submit({ &m_sprite, &m_leftArrow, &m_rightArrow },
 				m_parent->getSpriteShader());
 		}
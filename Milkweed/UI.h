@@ -527,6 +527,9 @@ namespace Milkweed {
 			Justification m_hJustification = Justification::LEFT;
 			// The justification to draw this label's text with on the y-axis
 			Justification m_vJustification = Justification::BOTTOM;
+			// The cached layout of this label's text, laid out again only when
+			// the text or its placement changes
+			TextLayout m_layout;
 
 			/*
 			* Add this text label to a UIGroup